@@ -0,0 +1,721 @@
+/*********************************************************************/
+/* BenchmarkHQ.cpp                                                   */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Times each stage of VC-2 High Quality profile coding, for         */
+/* synthetic (and optionally real) pictures, and checks that the     */
+/* optimised functions are bit exact with the reference functions.   */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+const char version[] = __DATE__ " @ " __TIME__;
+const char summary[] = "Benchmarks VC-2 High Quality profile coding stages and checks they are bit exact";
+const char description[] = "\
+This program times each stage of VC-2 HQ profile coding:\n\
+  1 the forward and inverse wavelet transforms, for every kernel and depth\n\
+  2 rate control (choosing quantisation indices for constant bit rate)\n\
+  3 quantisation\n\
+  4 splitting into slices, writing and reading slices, and merging slices\n\
+  5 inverse quantisation and the inverse wavelet transform\n\
+  6 coding a frame as two interlaced fields and writing it as an interlaced Y4M frame\n\
+It reports the time per frame, the throughput (MB/s of uncompressed picture) and frames/s.\n\
+Every optimised path (in place, 16 bit, slice sizing) is checked bit exactly against the\n\
+reference functions. The stages are also run concurrently, on a task scheduler with several\n\
+threads, and must give identical results. The reference wavelet transforms are a frozen copy of the original,\n\
+unoptimised, transform and padding code. The program exits with a failure status if any check fails.\n\
+Synthetic pictures are 1080p, 2160p and 4320p. A planar input file may be benchmarked too.\n\
+For meaningful timings build with optimisation (e.g. cmake -DCMAKE_BUILD_TYPE=Release).\n\
+\n\
+Example: BenchmarkHQ -s 1080p -f 4:2:2 -z 10 -k LeGall -d 3";
+const char* details[] = {version, summary, description};
+
+#include <cstdlib> //for EXIT_SUCCESS, EXIT_FAILURE, rand
+#include <stdexcept> //For standard logic errors
+#include <iostream> //For cin, cout, cerr
+#include <iomanip> // For formatting the results table
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "BenchmarkParams.h"
+#include "Arrays.h"
+#include "Picture.h"
+#include "Frame.h"
+#include "WaveletTransform.h"
+#include "Quantisation.h"
+#include "Slices.h"
+#include "BufferPool.h"
+#include "Y4MIO.h"
+#include "TaskScheduler.h"
+#include "Utils.h"
+#include "ReferenceTransform.h"
+
+using std::cout;
+using std::cerr;
+using std::clog;
+using std::endl;
+using std::string;
+using std::setw;
+
+namespace {
+
+  // Times repeated runs of a stage. The fastest run is reported, since it is
+  // least affected by other activity on the machine.
+  class StageTimer {
+    public:
+      StageTimer(): fastest(-1.0) {};
+      void start() {
+        begin = boost::posix_time::microsec_clock::universal_time();
+      }
+      void stop() {
+        const boost::posix_time::time_duration elapsed =
+          boost::posix_time::microsec_clock::universal_time() - begin;
+        const double seconds = elapsed.total_microseconds()/1.0e6;
+        if ((fastest<0.0) || (seconds<fastest)) fastest = seconds;
+      }
+      const double seconds() const {return fastest;}
+    private:
+      boost::posix_time::ptime begin;
+      double fastest;
+  };
+
+  int failures = 0;
+
+  // Result of a bit exactness check for the results table
+  const string check(bool passed) {
+    if (!passed) ++failures;
+    return passed ? "ok" : "FAILED";
+  }
+
+  void reportHeader() {
+    cout << std::left << setw(24) << "stage" << setw(8) << "size"
+         << setw(36) << "configuration" << std::right
+         << setw(12) << "ms/frame" << setw(12) << "MB/s"
+         << setw(12) << "frames/s" << "  check" << endl;
+  }
+
+  // "pictureBytes" is the size of the uncompressed picture
+  void report(const string& stage, const string& size, const string& configuration,
+              const StageTimer& timer, double pictureBytes, const string& result) {
+    const double seconds = timer.seconds();
+    cout << std::left << setw(24) << stage << setw(8) << size
+         << setw(36) << configuration << std::right << std::fixed
+         << setw(12) << std::setprecision(2) << 1000.0*seconds
+         << setw(12) << std::setprecision(1) << pictureBytes/seconds/1.0e6
+         << setw(12) << std::setprecision(2) << 1.0/seconds
+         << "  " << result << endl;
+  }
+
+  const string configuration(WaveletKernel kernel, int depth, const string& detail) {
+    std::ostringstream text;
+    text << kernel << " depth " << depth;
+    if (!detail.empty()) text << " " << detail;
+    // Only the short name of the kernel, e.g. "LeGall", is wanted
+    const string full = text.str();
+    const string::size_type open = full.find("(\"");
+    const string::size_type close = full.find("\")");
+    if ((open==string::npos) || (close==string::npos)) return full;
+    return full.substr(open+2, close-open-2) + full.substr(close+2);
+  }
+
+  // Configuration detail for the concurrent version of a stage, e.g. "16 bit 4 threads"
+  const string concurrent(const TaskScheduler& scheduler, const string& detail) {
+    std::ostringstream text;
+    if (!detail.empty()) text << detail << " ";
+    text << scheduler.threads() << " threads";
+    return text.str();
+  }
+
+  // Fill a component with samples from 0 to maxValue. A mixture of gradients,
+  // blocks with sharp edges and noise, so that all the subbands have energy.
+  void synthesise(Array2D& component, int maxValue) {
+    const int height = component.shape()[0];
+    const int width = component.shape()[1];
+    const int noise = maxValue/16+1;
+    for (int y=0; y<height; ++y) {
+      for (int x=0; x<width; ++x) {
+        const int gradient = ((x+2*y)*maxValue)/(width+2*height);
+        const int block = (((x/37)+(y/29))&1) ? maxValue/4 : 0;
+        const int value = (gradient*5)/8 + block + std::rand()%noise;
+        component[y][x] = std::min(value, maxValue);
+      }
+    }
+  }
+
+  const Picture syntheticPicture(const PictureFormat& format, int bitDepth) {
+    Picture picture(format);
+    const int maxValue = utils::pow(2, bitDepth)-1;
+    synthesise(picture.y(), maxValue);
+    synthesise(picture.c1(), maxValue);
+    synthesise(picture.c2(), maxValue);
+    return picture;
+  }
+
+  // Read the first picture from a planar file (samples are unsigned and left justified)
+  const Picture readPicture(const string& fileName, const PictureFormat& format,
+                            int bytes, int bitDepth) {
+    std::ifstream input(fileName.c_str(), std::ios_base::in|std::ios_base::binary);
+    if (!input) throw std::runtime_error("failed to open input file \"" + fileName + "\"");
+    input >> pictureio::wordWidth(bytes);
+    input >> pictureio::bitDepth(bitDepth);
+    input >> pictureio::left_justified;
+    input >> pictureio::unsigned_binary;
+    Picture picture(format);
+    input >> picture;
+    if (!input) throw std::runtime_error("failed to read a picture from \"" + fileName + "\"");
+    return picture;
+  }
+
+  const bool equal(const Array2D& a, const ShortArray2D& b) {
+    if ((a.shape()[0]!=b.shape()[0]) || (a.shape()[1]!=b.shape()[1])) return false;
+    return std::equal(a.data(), a.data()+a.num_elements(), b.data());
+  }
+
+  const bool equal(const Picture& a, const ShortPicture& b) {
+    return equal(a.y(), b.y()) && equal(a.c1(), b.c1()) && equal(a.c2(), b.c2());
+  }
+
+  const bool equal(const Picture& a, const Picture& b) {
+    return (a.y()==b.y()) && (a.c1()==b.c1()) && (a.c2()==b.c2());
+  }
+
+  const bool equal(const PictureArray& a, const PictureArray& b) {
+    if ((a.shape()[0]!=b.shape()[0]) || (a.shape()[1]!=b.shape()[1])) return false;
+    for (unsigned int v=0; v<a.shape()[0]; ++v) {
+      for (unsigned int h=0; h<a.shape()[1]; ++h) {
+        if (!equal(a[v][h], b[v][h])) return false;
+      }
+    }
+    return true;
+  }
+
+  // Reference (inverse) quantisation, subband by subband, using quantise_block
+  // (which quantises each slice of a subband with its own quantisation index).
+  const Array2D referenceQuantise(const Array2D& coefficients,
+                                  const Array2D& qIndices,
+                                  const Array1D& qMatrix,
+                                  bool inverse) {
+    const int numberOfSubbands = qMatrix.size();
+    const int waveletDepth = (numberOfSubbands-1)/3;
+    BlockVector subbands = split_into_subbands(coefficients, waveletDepth);
+    for (int band=0; band<numberOfSubbands; ++band) {
+      const Array2D& subband = subbands[band];
+      const ConstView2D view =
+        subband[indices[Range(0, subband.shape()[0])][Range(0, subband.shape()[1])]];
+      const Array2D bandIndices = adjust_quant_indices(qIndices, qMatrix[band]);
+      subbands[band] = inverse ? inverse_quantise_block(view, bandIndices) :
+                                 quantise_block(view, bandIndices);
+    }
+    return merge_subbands(subbands);
+  }
+
+  const Picture referenceQuantise(const Picture& coefficients,
+                                  const Array2D& qIndices,
+                                  const Array1D& qMatrix,
+                                  bool inverse) {
+    Picture result(coefficients.format());
+    result.y(referenceQuantise(coefficients.y(), qIndices, qMatrix, inverse));
+    result.c1(referenceQuantise(coefficients.c1(), qIndices, qMatrix, inverse));
+    result.c2(referenceQuantise(coefficients.c2(), qIndices, qMatrix, inverse));
+    return result;
+  }
+
+  // Check the slice sizes estimated by HQSliceSizer, for the chosen quantisation
+  // indices, against the size of each (reference) quantised slice.
+  const bool checkSliceSizes(const Picture& transform,
+                             const PictureArray& quantisedSlices,
+                             const Array2D& qIndices,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             int waveletDepth, int scalar) {
+    const int ySlices = qIndices.shape()[0];
+    const int xSlices = qIndices.shape()[1];
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        const Picture& slice = quantisedSlices[v][h];
+        const int bytes = component_slice_bytes(slice.y(), waveletDepth, scalar) +
+                          component_slice_bytes(slice.c1(), waveletDepth, scalar) +
+                          component_slice_bytes(slice.c2(), waveletDepth, scalar);
+        const HQSliceSizer sizer(transform, ySlices, xSlices, v, h, qMatrix, scalar);
+        if (sizer.bytes(qIndices[v][h])!=bytes) return false;
+        // Rate control must have made the slice fit (with its 4 byte overhead)
+        if ((bytes+4)>sliceBytes[v][h]) return false;
+      }
+    }
+    return true;
+  }
+
+  // Benchmark the forward and inverse transforms of a picture for one kernel
+  // and depth. Both, and the 16 bit forward transform, are checked against the
+  // reference transforms, serially and on the scheduler.
+  void benchmarkTransform(const Picture& picture, const string& size,
+                          WaveletKernel kernel, int depth, int bitDepth,
+                          int repeats, double pictureBytes, TaskScheduler& scheduler) {
+    const PictureFormat transformFormat = paddedFormat(picture.format(), depth);
+    const Picture referenceTransform = reference::waveletTransform(picture, kernel, depth);
+    Picture transform(transformFormat);
+    StageTimer timer;
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      waveletTransform(picture, kernel, depth, transform);
+      timer.stop();
+    }
+    report("forward transform", size, configuration(kernel, depth, ""),
+           timer, pictureBytes, check(equal(transform, referenceTransform)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      waveletTransform(picture, kernel, depth, transform, scheduler);
+      timer.stop();
+    }
+    report("forward transform", size, configuration(kernel, depth, concurrent(scheduler, "")),
+           timer, pictureBytes, check(equal(transform, referenceTransform)));
+    if (shortCoefficients(kernel, depth, bitDepth)) {
+      ShortPicture shortTransform(transformFormat);
+      StageTimer shortTimer;
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        waveletTransform(picture, kernel, depth, bitDepth, shortTransform);
+        shortTimer.stop();
+      }
+      report("forward transform", size, configuration(kernel, depth, "16 bit"),
+             shortTimer, pictureBytes, check(equal(referenceTransform, shortTransform)));
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        waveletTransform(picture, kernel, depth, bitDepth, shortTransform, scheduler);
+        shortTimer.stop();
+      }
+      report("forward transform", size, configuration(kernel, depth, concurrent(scheduler, "16 bit")),
+             shortTimer, pictureBytes, check(equal(referenceTransform, shortTransform)));
+    }
+    // Inverse transform (which overwrites its input, so restore it before each run)
+    const Picture referencePicture =
+      reference::inverseWaveletTransform(referenceTransform, kernel, depth, picture.format());
+    Picture decoded(picture.format());
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      transform = referenceTransform;
+      timer.start();
+      inverseWaveletTransform(transform, kernel, depth, decoded);
+      timer.stop();
+    }
+    report("inverse transform", size, configuration(kernel, depth, ""),
+           timer, pictureBytes, check(equal(decoded, referencePicture)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      transform = referenceTransform;
+      timer.start();
+      inverseWaveletTransform(transform, kernel, depth, decoded, scheduler);
+      timer.stop();
+    }
+    report("inverse transform", size, configuration(kernel, depth, concurrent(scheduler, "")),
+           timer, pictureBytes, check(equal(decoded, referencePicture)));
+  }
+
+  // Benchmark all the stages of encoding and decoding a picture, serially and
+  // then concurrently on the scheduler (which must give identical results)
+  void benchmarkPipeline(const Picture& picture, const string& size,
+                         const ProgramParams& params, double pictureBytes,
+                         TaskScheduler& scheduler) {
+    const WaveletKernel kernel = params.kernel;
+    const int depth = params.waveletDepth;
+    const int repeats = params.repeats;
+    const PictureFormat format = picture.format();
+
+    // Calculate number of slices per picture
+    const int yTransformSize = params.ySize*utils::pow(2, depth);
+    const int xTransformSize = params.xSize*utils::pow(2, depth);
+    const int paddedHeight = paddedSize(format.lumaHeight(), depth);
+    const int paddedWidth = paddedSize(format.lumaWidth(), depth);
+    const int ySlices = paddedHeight/yTransformSize;
+    const int xSlices = paddedWidth/xTransformSize;
+    if ((paddedHeight!=(ySlices*yTransformSize)) || (paddedWidth!=(xSlices*xTransformSize))) {
+      throw std::logic_error("padded picture size is not divisible by the slice size");
+    }
+    const int compressedBytes = static_cast<int>(pictureBytes/params.compressionRatio);
+    // Choose a slice size scalar big enough for any component to fit in a slice
+    const int scalar = (compressedBytes/(ySlices*xSlices))/255+1;
+    const Array2D sliceBytes = slice_bytes(ySlices, xSlices, compressedBytes, scalar);
+    const Array1D qMatrix = quantMatrix(kernel, depth);
+    const bool shortCoeffs = shortCoefficients(kernel, depth, params.bitDepth);
+    if (params.verbose) {
+      clog << size << ": " << ySlices << "x" << xSlices << " slices, "
+           << compressedBytes << " compressed bytes, slice scalar " << scalar
+           << ", 16 bit coefficients " << std::boolalpha << shortCoeffs << endl;
+    }
+    const string config = configuration(kernel, depth, "");
+    const string config16 = configuration(kernel, depth, "16 bit");
+    const string configThreads = configuration(kernel, depth, concurrent(scheduler, ""));
+    const string config16Threads = configuration(kernel, depth, concurrent(scheduler, "16 bit"));
+
+    FrameBuffers buffers(format, depth, ySlices, xSlices);
+    ShortPicture shortTransform;
+    if (shortCoeffs) shortTransform = ShortPicture(buffers.transformFormat());
+    StageTimer timer, shortTimer;
+
+    // Forward transform
+    waveletTransform(picture, kernel, depth, buffers.transform);
+    if (shortCoeffs) waveletTransform(picture, kernel, depth, params.bitDepth, shortTransform);
+
+    // Rate control
+    Array2D& qIndices = buffers.slices.qIndices;
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      qIndices = quantIndices(buffers.transform, qMatrix, sliceBytes, scalar);
+      timer.stop();
+    }
+    // The reference quantised slices check the slice sizes used by rate control
+    const Picture quantised = referenceQuantise(buffers.transform, qIndices, qMatrix, false);
+    const PictureArray referenceSlices = split_into_blocks(quantised, ySlices, xSlices);
+    report("rate control", size, config, timer, pictureBytes,
+           check(checkSliceSizes(buffers.transform, referenceSlices, qIndices,
+                                 qMatrix, sliceBytes, depth, scalar)));
+    Array2D concurrentIndices, codedBytes;
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      concurrentIndices = quantIndices(buffers.transform, qMatrix, sliceBytes, scalar, codedBytes, scheduler);
+      timer.stop();
+    }
+    report("rate control", size, configThreads, timer, pictureBytes, check(concurrentIndices==qIndices));
+    if (shortCoeffs) {
+      Array2D shortIndices;
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        shortIndices = quantIndices(shortTransform, qMatrix, sliceBytes, scalar);
+        shortTimer.stop();
+      }
+      report("rate control", size, config16, shortTimer, pictureBytes, check(shortIndices==qIndices));
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        shortIndices = quantIndices(shortTransform, qMatrix, sliceBytes, scalar, codedBytes, scheduler);
+        shortTimer.stop();
+      }
+      report("rate control", size, config16Threads, shortTimer, pictureBytes, check(shortIndices==qIndices));
+    }
+
+    // Quantisation
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      quantise_transform_np(buffers.transform, qIndices, qMatrix, buffers.quantised);
+      timer.stop();
+    }
+    report("quantise", size, config, timer, pictureBytes, check(equal(buffers.quantised, quantised)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      quantise_transform_np(buffers.transform, qIndices, qMatrix, buffers.quantised, scheduler);
+      timer.stop();
+    }
+    report("quantise", size, configThreads, timer, pictureBytes, check(equal(buffers.quantised, quantised)));
+    if (shortCoeffs) {
+      Picture shortQuantised(buffers.transformFormat());
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        quantise_transform_np(shortTransform, qIndices, qMatrix, shortQuantised);
+        shortTimer.stop();
+      }
+      report("quantise", size, config16, shortTimer, pictureBytes, check(equal(shortQuantised, quantised)));
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        quantise_transform_np(shortTransform, qIndices, qMatrix, shortQuantised, scheduler);
+        shortTimer.stop();
+      }
+      report("quantise", size, config16Threads, shortTimer, pictureBytes, check(equal(shortQuantised, quantised)));
+    }
+
+    // Split into slices
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      split_into_blocks(buffers.quantised, buffers.slices.yuvSlices);
+      timer.stop();
+    }
+    report("split slices", size, config, timer, pictureBytes,
+           check(equal(buffers.slices.yuvSlices, referenceSlices)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      split_into_blocks(buffers.quantised, buffers.slices.yuvSlices, scheduler);
+      timer.stop();
+    }
+    report("split slices", size, configThreads, timer, pictureBytes,
+           check(equal(buffers.slices.yuvSlices, referenceSlices)));
+
+    // Write slices
+    std::string stream;
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      std::ostringstream output;
+      timer.start();
+      output << sliceio::highQualityCBR(sliceBytes, scalar);
+      output << buffers.slices;
+      timer.stop();
+      stream = output.str();
+    }
+    // Constant bit rate, so the stream must be exactly the size requested
+    int totalBytes = 0;
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) totalBytes += sliceBytes[v][h];
+    }
+    report("write slices", size, config, timer, pictureBytes,
+           check(static_cast<int>(stream.size())==totalBytes));
+
+    // Read slices (back into the same buffers)
+    const Array2D writtenIndices = qIndices;
+    bool readOK = true;
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      std::istringstream input(stream);
+      timer.start();
+      input >> sliceio::highQualityCBR(sliceBytes, scalar);
+      input >> buffers.slices;
+      timer.stop();
+      readOK = readOK && input;
+    }
+    report("read slices", size, config, timer, pictureBytes,
+           check(readOK && (qIndices==writtenIndices) &&
+                 equal(buffers.slices.yuvSlices, referenceSlices)));
+
+    // Merge slices
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      merge_blocks(buffers.slices.yuvSlices, buffers.quantised);
+      timer.stop();
+    }
+    report("merge slices", size, config, timer, pictureBytes, check(equal(buffers.quantised, quantised)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      merge_blocks(buffers.slices.yuvSlices, buffers.quantised, scheduler);
+      timer.stop();
+    }
+    report("merge slices", size, configThreads, timer, pictureBytes, check(equal(buffers.quantised, quantised)));
+
+    // Write and read CBR slices with a larger slice size scalar (component
+    // lengths are then in units of the scalar, rather than bytes)
+    const int bigScalar = 4*scalar;
+    const Array2D bigBytes = slice_bytes(ySlices, xSlices, compressedBytes, bigScalar);
+    const Array2D bigIndices = quantIndices(buffers.transform, qMatrix, bigBytes, bigScalar);
+    const Slices bigSlices(split_into_blocks(referenceQuantise(buffers.transform, bigIndices, qMatrix, false),
+                                             ySlices, xSlices),
+                           depth, bigIndices);
+    std::ostringstream bigOutput;
+    bigOutput << sliceio::highQualityCBR(bigBytes, bigScalar) << bigSlices;
+    Slices readSlices(split_into_blocks(quantised, ySlices, xSlices), depth, Array2D(extents[ySlices][xSlices]));
+    bool scalarOK = true;
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      std::istringstream input(bigOutput.str());
+      try {
+        timer.start();
+        input >> sliceio::highQualityCBR(bigBytes, bigScalar);
+        input >> readSlices;
+        timer.stop();
+      }
+      catch (const std::logic_error&) { // Slice lengths misread
+        timer.stop();
+        scalarOK = false;
+      }
+      scalarOK = scalarOK && input;
+    }
+    std::ostringstream scalarConfig;
+    scalarConfig << "scalar " << bigScalar;
+    report("read slices", size, configuration(kernel, depth, scalarConfig.str()), timer, pictureBytes,
+           check(scalarOK && (readSlices.qIndices==bigIndices) &&
+                 equal(readSlices.yuvSlices, bigSlices.yuvSlices)));
+
+    // Inverse quantisation
+    const Picture dequantised = referenceQuantise(quantised, qIndices, qMatrix, true);
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, buffers.transform);
+      timer.stop();
+    }
+    report("inverse quantise", size, config, timer, pictureBytes,
+           check(equal(buffers.transform, dequantised)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      timer.start();
+      inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, buffers.transform, scheduler);
+      timer.stop();
+    }
+    report("inverse quantise", size, configThreads, timer, pictureBytes,
+           check(equal(buffers.transform, dequantised)));
+    if (shortCoeffs) {
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, shortTransform);
+        shortTimer.stop();
+      }
+      report("inverse quantise", size, config16, shortTimer, pictureBytes,
+             check(equal(dequantised, shortTransform)));
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        shortTimer.start();
+        inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, shortTransform, scheduler);
+        shortTimer.stop();
+      }
+      report("inverse quantise", size, config16Threads, shortTimer, pictureBytes,
+             check(equal(dequantised, shortTransform)));
+    }
+
+    // Inverse transform (which overwrites its input, so restore it before each run)
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      buffers.transform = dequantised;
+      timer.start();
+      inverseWaveletTransform(buffers.transform, kernel, depth, buffers.picture);
+      timer.stop();
+    }
+    const Picture referencePicture = reference::inverseWaveletTransform(dequantised, kernel, depth, format);
+    report("inverse transform", size, config, timer, pictureBytes,
+           check(equal(buffers.picture, referencePicture)));
+    timer = StageTimer();
+    for (int r=0; r<repeats; ++r) {
+      buffers.transform = dequantised;
+      timer.start();
+      inverseWaveletTransform(buffers.transform, kernel, depth, buffers.picture, scheduler);
+      timer.stop();
+    }
+    report("inverse transform", size, configThreads, timer, pictureBytes,
+           check(equal(buffers.picture, referencePicture)));
+    if (shortCoeffs) {
+      Picture decoded(format);
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        inverse_quantise_transform_np(quantised, qIndices, qMatrix, shortTransform);
+        shortTimer.start();
+        inverseWaveletTransform(shortTransform, kernel, depth, decoded);
+        shortTimer.stop();
+      }
+      report("inverse transform", size, config16, shortTimer, pictureBytes,
+             check(equal(decoded, referencePicture)));
+      shortTimer = StageTimer();
+      for (int r=0; r<repeats; ++r) {
+        inverse_quantise_transform_np(quantised, qIndices, qMatrix, shortTransform);
+        shortTimer.start();
+        inverseWaveletTransform(shortTransform, kernel, depth, decoded, scheduler);
+        shortTimer.stop();
+      }
+      report("inverse transform", size, config16Threads, shortTimer, pictureBytes,
+             check(equal(decoded, referencePicture)));
+    }
+  }
+
+  // Check the round trip of an interlaced frame, coded as two fields, through
+  // interlaced Y4M output, as the decoder does it. Each field is transformed
+  // from the frame and inverse transformed, both are assembled into a frame
+  // and it is written as Y4M, then read back. The transform is lossless, so
+  // the frame read back must be the original picture.
+  void benchmarkInterlacedY4M(const Picture& picture, const string& size,
+                              const ProgramParams& params, double pictureBytes) {
+    const WaveletKernel kernel = params.kernel;
+    const int depth = params.waveletDepth;
+    const PictureFormat format = picture.format();
+    // Fields must have whole lines, and Y4M samples 8 to 16 bits
+    if ((format.lumaHeight()%2!=0) || (format.chromaHeight()%2!=0) ||
+        (params.bitDepth<8) || (params.bitDepth>16)) return;
+    const PictureFormat fieldFormat(format.lumaHeight()/2, format.lumaWidth(),
+                                    format.chromaHeight()/2, format.chromaWidth(),
+                                    format.chromaFormat());
+    const bool topFieldFirst = true;
+    const Y4MFormat y4mFormat(format, params.bitDepth, true, topFieldFirst);
+    Picture transform(paddedFormat(fieldFormat, depth));
+    Picture field(fieldFormat);
+    Frame frame(format, true, topFieldFirst);
+    string stream;
+    StageTimer timer;
+    for (int r=0; r<params.repeats; ++r) {
+      std::ostringstream output;
+      output << y4mFormat;
+      timer.start();
+      for (int f=0; f<2; ++f) { // Top field (line 0) first
+        fieldWaveletTransform(picture, f, kernel, depth, transform);
+        inverseWaveletTransform(transform, kernel, depth, field);
+        if (f==0) frame.firstField(field);
+        else frame.secondField(field);
+      }
+      writeY4MFrame(output, y4mFormat, frame);
+      timer.stop();
+      stream = output.str();
+    }
+    std::istringstream input(stream);
+    Y4MFormat readFormat;
+    input >> readFormat;
+    Picture readBack(format);
+    if (input) readY4MFrame(input, readFormat, readBack);
+    report("interlaced y4m", size, configuration(kernel, depth, ""), timer, pictureBytes,
+           check(input && readFormat.interlaced() && readFormat.topFieldFirst() &&
+                 equal(readBack, picture)));
+  }
+
+} // end unnamed namespace
+
+int main(int argc, char * argv[]) {
+
+  ProgramParams params = getCommandLineParams(argc, argv, details);
+  if (!params.error.empty()) {
+    cerr << params.error << endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    const int bytesPerSample = (params.bitDepth+7)/8;
+    std::srand(1); // Synthetic pictures are the same every run
+
+    // Concurrent versions of the stages share one scheduler
+    TaskScheduler scheduler(params.threads);
+    if (params.verbose) clog << "threads = " << scheduler.threads() << endl;
+
+    reportHeader();
+    for (std::vector<BenchmarkSize>::const_iterator s=params.sizes.begin();
+         s!=params.sizes.end(); ++s) {
+      const PictureFormat format(s->height, s->width, params.chromaFormat);
+      if (params.verbose) clog << "Creating " << s->name << " picture" << endl;
+      const Picture picture = (s->name=="input") ?
+        readPicture(params.inFileName, format, params.bytes, params.bitDepth) :
+        syntheticPicture(format, params.bitDepth);
+      const double pictureBytes = static_cast<double>(format.samples())*bytesPerSample;
+
+      // Forward and inverse transforms of every kernel and depth
+      const WaveletKernel kernels[] = {DD97, LeGall, DD137, Haar0, Haar1, Fidelity, Daub97};
+      for (unsigned int k=0; k<sizeof(kernels)/sizeof(WaveletKernel); ++k) {
+        for (int depth=1; depth<=params.maxDepth; ++depth) {
+          benchmarkTransform(picture, s->name, kernels[k], depth, params.bitDepth,
+                             params.repeats, pictureBytes, scheduler);
+        }
+      }
+
+      // All the stages for one kernel and depth
+      benchmarkPipeline(picture, s->name, params, pictureBytes, scheduler);
+
+      // Coding as interlaced fields, with interlaced Y4M output
+      benchmarkInterlacedY4M(picture, s->name, params, pictureBytes);
+    }
+  }
+
+  catch (const std::exception& ex) {
+    cout << "Error: " << ex.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (failures>0) {
+    cout << failures << " check(s) FAILED" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "All checks passed" << endl;
+  return EXIT_SUCCESS;
+}
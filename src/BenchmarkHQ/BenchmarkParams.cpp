@@ -0,0 +1,165 @@
+/*********************************************************************/
+/* BenchmarkParams.cpp                                               */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines getting benchmark parameters from command line.           */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "BenchmarkParams.h"
+#include "Picture.h"
+#include "WaveletTransform.h"
+
+#include <iostream> //For cin, cout, cerr
+#include <stdexcept> // For invalid_argument
+#include <string>
+
+using std::string;
+using std::vector;
+using std::invalid_argument;
+
+#include <tclap/CmdLine.h>
+
+using TCLAP::CmdLine;
+using TCLAP::SwitchArg;
+using TCLAP::ValueArg;
+using TCLAP::MultiArg;
+
+// Tell tclap that various enums are to be treated as tclap values
+namespace TCLAP {
+  template <>
+  struct ArgTraits<ColourFormat> { // Let TCLAP parse ColourFormat objects
+    typedef ValueLike ValueCategory;
+  };
+
+  template <>
+  struct ArgTraits<WaveletKernel> { // Let TCLAP parse WaveletKernel objects
+    typedef ValueLike ValueCategory;
+  };
+}
+
+namespace {
+
+  // Standard picture sizes that may be benchmarked
+  const BenchmarkSize standardSizes[] = {
+    {"1080p", 1080, 1920},
+    {"2160p", 2160, 3840},
+    {"4320p", 4320, 7680}};
+
+  const int numberOfStandardSizes = sizeof(standardSizes)/sizeof(BenchmarkSize);
+
+  const BenchmarkSize standardSize(const string& name) {
+    for (int s=0; s<numberOfStandardSizes; ++s) {
+      if (standardSizes[s].name==name) return standardSizes[s];
+    }
+    throw invalid_argument("unknown picture size \"" + name + "\" (use 1080p, 2160p or 4320p)");
+  }
+
+} // end unnamed namespace
+
+ProgramParams getCommandLineParams(int argc, char * argv[], const char * details[]) {
+
+  const char * const version = details[0];
+  const char * const summary = details[1];
+
+  ProgramParams params;
+
+  try {
+
+    // Define tclap command line object
+    CmdLine cmd(summary, ' ', version);
+
+    // Define tclap command line parameters (and add them to tclap command line)
+    SwitchArg verbosity("v", "verbose", "Output extra information to standard log", cmd);
+    // "cla" prefix == command line argument
+    ValueArg<string> cla_inFile("i", "input", "Planar input file, benchmarked in addition to the synthetic pictures (requires -x and -y)", false, "", "string", cmd);
+    ValueArg<int> cla_width("x", "width", "Width of the input file pictures", false, 0, "integer", cmd);
+    ValueArg<int> cla_height("y", "height", "Height of the input file pictures", false, 0, "integer", cmd);
+    ValueArg<int> cla_bytes("n", "bytes", "Number of bytes per sample in the input file (default 2)", false, 2, "integer", cmd);
+    MultiArg<string> cla_sizes("s", "size", "Synthetic picture size (1080p, 2160p or 4320p, may be repeated, defaults to all three)", false, "string", cmd);
+    ValueArg<ColourFormat> cla_format("f", "format", "Colour format (4:4:4, 4:2:2, 4:2:0 or RGB, default 4:2:2)", false, CF422, "string", cmd);
+    ValueArg<int> cla_bitDepth("z", "bitDepth", "Bit depth of all components (default 10)", false, 10, "integer", cmd);
+    ValueArg<WaveletKernel> cla_kernel("k", "kernel", "Wavelet kernel for the whole pipeline (DD97, LeGall, DD137, Haar0, Haar1, Fidelity, Daub97, default LeGall)", false, LeGall, "string", cmd);
+    ValueArg<int> cla_waveletDepth("d", "waveletDepth", "Wavelet depth for the whole pipeline (default 3)", false, 3, "integer", cmd);
+    ValueArg<int> cla_maxDepth("m", "maxDepth", "Benchmark transforms, for every kernel, up to this depth (default 4, 0 for none)", false, 4, "integer", cmd);
+    ValueArg<int> cla_hSliceSize("a", "hSlice", "Horizontal slice size (in units of 2**(wavelet depth), default 2)", false, 2, "integer", cmd);
+    ValueArg<int> cla_vSliceSize("u", "vSlice", "Vertical slice size (in units of 2**(wavelet depth), default 1)", false, 1, "integer", cmd);
+    ValueArg<double> cla_ratio("r", "ratio", "Compression ratio (default 4)", false, 4.0, "number", cmd);
+    ValueArg<int> cla_repeats("R", "repeats", "Number of times each stage is timed (default 3)", false, 3, "integer", cmd);
+    ValueArg<int> cla_threads("t", "threads", "Threads for the concurrent versions of the stages (default 4, 0 for one per core)", false, 4, "integer", cmd);
+
+    // Parse the argv array
+    cmd.parse(argc, argv);
+
+    // Check parameter values
+    if (cla_inFile.isSet() && (!cla_width.isSet() || !cla_height.isSet()))
+      throw invalid_argument("input file requires picture width and height");
+    if (cla_inFile.isSet() && ((cla_width.getValue()<1) || (cla_height.getValue()<1)))
+      throw invalid_argument("picture width and height must be > 0");
+    if (cla_format.getValue()==UNKNOWN)
+      throw invalid_argument("unknown colour format");
+    if ((1>cla_bytes.getValue()) || (cla_bytes.getValue()>2))
+      throw invalid_argument("bytes must be 1 or 2");
+    if ((1>cla_bitDepth.getValue()) || (cla_bitDepth.getValue()>16))
+      throw invalid_argument("bit depth must be in range 1 to 16");
+    if (cla_kernel.getValue()==NullKernel)
+      throw invalid_argument("invalid wavelet kernel");
+    if (cla_waveletDepth.getValue()<1)
+      throw invalid_argument("wavelet depth must be 1 or more");
+    if (cla_maxDepth.getValue()<0)
+      throw invalid_argument("maximum transform depth must not be negative");
+    if ((cla_hSliceSize.getValue()<1) || (cla_vSliceSize.getValue()<1))
+      throw invalid_argument("slice sizes must be > 0");
+    if (cla_ratio.getValue()<1.0)
+      throw invalid_argument("compression ratio must be at least 1");
+    if (cla_repeats.getValue()<1)
+      throw invalid_argument("repeats must be > 0");
+    if (cla_threads.getValue()<0)
+      throw invalid_argument("threads must not be negative");
+
+    // Synthetic picture sizes
+    const vector<string> sizeNames = cla_sizes.getValue();
+    if (sizeNames.empty()) {
+      // Default is all the standard sizes, unless only the input file is wanted
+      if (!cla_inFile.isSet()) {
+        params.sizes.assign(standardSizes, standardSizes+numberOfStandardSizes);
+      }
+    }
+    else {
+      for (vector<string>::const_iterator s=sizeNames.begin(); s!=sizeNames.end(); ++s) {
+        params.sizes.push_back(standardSize(*s));
+      }
+    }
+
+    params.inFileName = cla_inFile.getValue();
+    params.verbose = verbosity.getValue();
+    if (cla_inFile.isSet()) {
+      const BenchmarkSize input = {"input", cla_height.getValue(), cla_width.getValue()};
+      params.sizes.push_back(input);
+    }
+    params.chromaFormat = cla_format.getValue();
+    params.bytes = cla_bytes.getValue();
+    params.bitDepth = cla_bitDepth.getValue();
+    params.kernel = cla_kernel.getValue();
+    params.waveletDepth = cla_waveletDepth.getValue();
+    params.maxDepth = cla_maxDepth.getValue();
+    params.ySize = cla_vSliceSize.getValue();
+    params.xSize = cla_hSliceSize.getValue();
+    params.compressionRatio = cla_ratio.getValue();
+    params.repeats = cla_repeats.getValue();
+    params.threads = cla_threads.getValue();
+  }
+
+  // catch any TCLAP exceptions
+  catch (TCLAP::ArgException &e) {
+    params.error = string("Command line error: ") + e.error() + " for arg " + e.argId();
+  }
+
+  // catch other exceptions
+  catch(const std::exception& ex) {
+    params.error = string(ex.what());
+  }
+
+  return params;
+}
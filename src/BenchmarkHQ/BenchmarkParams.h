@@ -0,0 +1,46 @@
+/*********************************************************************/
+/* BenchmarkParams.h                                                 */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares getting benchmark parameters from command line.          */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef BENCHMARKPARAMS_18OCT26
+#define BENCHMARKPARAMS_18OCT26
+
+#include <string>
+#include <vector>
+
+#include "Picture.h"
+#include "WaveletTransform.h"
+
+// A picture size to benchmark
+struct BenchmarkSize {
+  std::string name;
+  int height;
+  int width;
+};
+
+struct ProgramParams {
+  std::string inFileName; // Empty for synthetic pictures only
+  bool verbose;
+  std::vector<BenchmarkSize> sizes;
+  enum ColourFormat chromaFormat;
+  int bytes; // Bytes per sample of the input file
+  int bitDepth;
+  enum WaveletKernel kernel; // Kernel for the whole pipeline benchmark
+  int waveletDepth; // Depth for the whole pipeline benchmark
+  int maxDepth; // Transforms are benchmarked for all kernels at depths 1 to maxDepth
+  int ySize; // Slice size (in units of 2**(wavelet depth))
+  int xSize;
+  double compressionRatio;
+  int repeats; // Number of times each stage is timed
+  int threads; // Threads for the concurrent versions of the stages (0 for one per core)
+  std::string error;
+};
+
+ProgramParams getCommandLineParams(int argc, char * argv[], const char* details[]);
+
+#endif // BENCHMARKPARAMS_18OCT26
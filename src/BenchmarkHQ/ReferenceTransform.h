@@ -0,0 +1,49 @@
+/*********************************************************************/
+/* ReferenceTransform.h                                              */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares the reference wavelet transforms, against which the      */
+/* library's (optimised) transforms are checked for bit exactness.   */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef REFERENCETRANSFORM_18OCT26
+#define REFERENCETRANSFORM_18OCT26
+
+#include "Arrays.h"
+#include "Picture.h"
+#include "WaveletTransform.h" // For WaveletKernel
+
+// A frozen copy of the library's transform (and padding) code as it was
+// before it was optimised (in place transforms, 16 bit coefficients, padding
+// with the accuracy shift, ...). It is deliberately simple and slow, and
+// must not be changed, so that it remains an independent reference.
+namespace reference {
+
+  // Return the size of a padded array given image size and wavelet depth.
+  const int paddedSize(int size, int depth);
+
+  //Forward wavelet transform, including padding if necessary
+  const Array2D waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth);
+
+  //Inverse wavelet transform, removes padding if necessary.
+  // "shape" give size of unpadded image
+  const Array2D inverseWaveletTransform(const Array2D& transform,
+                                        WaveletKernel kernel,
+                                        int depth,
+                                        Shape2D shape);
+
+  //Forward wavelet transform, including padding if necessary
+  const Picture waveletTransform(const Picture& picture, WaveletKernel kernel, int depth);
+
+  //Inverse wavelet transform, removes padding if necessary.
+  // "format" specifies format of unpadded image
+  const Picture inverseWaveletTransform(const Picture& transform,
+                                        WaveletKernel kernel,
+                                        int depth,
+                                        PictureFormat format);
+
+} // end namespace reference
+
+#endif //REFERENCETRANSFORM_18OCT26
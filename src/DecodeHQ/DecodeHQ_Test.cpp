@@ -20,7 +20,16 @@ Its primary output is the decoded image sequence. However it may produce alterna
   3 the quantisation indices used for each slice\n\
   4 the decoded sequence\n\
 Input is just a sequence of compressed bytes.\n\
+It may, alternatively, decode the Low Delay profile, in which case each picture is a data unit.\n\
+HQ slices each give their own size, so pictures may be coded at constant or variable bit rate,\n\
+with slices of fixed or varying size. Each picture's header gives its slice prefix bytes and\n\
+slice size scalar.\n\
+The work of decoding is shared between a fixed number of threads (by default one per core).\n\
+It may, alternatively, decode just a region of each HQ picture (e.g. a crop for a multiviewer),\n\
+from the slices that cover it, skipping the others.\n\
 Output (where appropriate) are in planar format (4:4:4, 4:2:2, 4:2:0 or RGB).\n\
+Decoded output may, alternatively, be a Y4M file (or \"-\" for Y4M on standard output).\n\
+Input \"-\" reads the compressed frames from standard input.\n\
 There can be 1 to 4 bytes per sample and the data is left (MSB) justified.\n\
 Data is assumed offset binary (which is fine for both YCbCr or RGB).\n\
 \n\
@@ -33,14 +42,28 @@ const char* details[] = { version, summary, description };
 #include <string>
 #include <fstream>
 #include <cstdio> // for perror
+#ifdef _WIN32
+#include <io.h> // For _setmode
+#include <fcntl.h> // For _O_BINARY
+#endif
+
+#include "boost/scoped_ptr.hpp"
 
 #include "DecodeParams.h"
 #include "Arrays.h"
 #include "Slices.h"
+#include "DataUnit.h"
 #include "Picture.h"
 #include "Frame.h"
 #include "Quantisation.h"
 #include "WaveletTransform.h"
+#include "ColourConversion.h"
+#include "PackedIO.h"
+#include "Y4MIO.h"
+#include "BufferPool.h"
+#include "Instrumentation.h"
+#include "TaskScheduler.h"
+#include "RegionDecoder.h"
 #include "Utils.h"
 
 using std::cout;
@@ -55,7 +78,6 @@ using std::ios_base;
 using std::istream;
 using std::ostream;
 using std::fstream;
-using std::fill_n;
 
 using arrayio::ioFormat;  // enu
 using arrayio::format;    // class
@@ -63,6 +85,10 @@ using arrayio::wordWidth;  //class
 using arrayio::bitDepth;   //class
 using arrayio::offset;    //class
 
+using instrumentation::FrameStats;
+using instrumentation::StageTimer;
+using instrumentation::StatsWriter;
+
 int main(void) {
 
 	int bits = 8;
@@ -82,7 +108,42 @@ int main(void) {
 	const bool interlaced = 0;
 	const bool topFieldFirst = 0;
 	const Output output = DECODED;
+	// Decoded output may, alternatively, be written directly in a packed
+	// format (for playout) instead of as RGB PPM
+	const bool packedOutput = false;
+	const PackedFormat outputFormat = V210;
+	// Otherwise decoded output is Y4M if the output file is ".y4m", or "-"
+	// (standard output), and RGB PPM if not.
+	const bool y4mOutput = isY4MFileName(outFileName);
 	int sliceScalar = 1;
+	// Decode the VC-2 Low Delay profile (as written by the encoder in LD mode),
+	// rather than the High Quality profile.
+	const bool lowDelay = false;
+	// Threads that share the work of decoding (0 for one per core), optionally
+	// each pinned to its own core.
+	const int threads = 0;
+	const bool pinThreads = false;
+	// Decode only a region of each picture (e.g. a crop for a multiviewer tile),
+	// in luma samples, rather than the whole picture. Only the slices covering
+	// the region (with a margin for the wavelet filters) are decoded, the others
+	// are skipped using their lengths (so HQ progressive pictures only). The
+	// decoded output is then just the region. A height or width of 0 decodes
+	// the whole picture.
+	const int regionTop = 0;
+	const int regionLeft = 0;
+	const int regionHeight = 0;
+	const int regionWidth = 0;
+	const bool decodeRegion = (regionHeight > 0) && (regionWidth > 0);
+	if (decodeRegion && (lowDelay || interlaced || (output != DECODED))) {
+		cerr << "Error: only the decoded output of HQ progressive pictures may be a region" << endl;
+		return EXIT_FAILURE;
+	}
+
+	// Per frame statistics. JSON lines go to this file (or, if empty, to
+	// the log when verbose). Counters are dumped to the counters file
+	// (if not empty) for monitoring.
+	const string statsFileName = "";
+	const string countersFileName = "";
 	int ySize;
 	int xSize;
 	int compressedBytes;
@@ -131,8 +192,15 @@ int main(void) {
 	// No point in continuing if can't open input file.
 	filebuf inFileBuffer; // For file input. Needs to be defined here to remain in scope
 	streambuf *pInBuffer; // Either standard input buffer or a file buffer
-
-	pInBuffer = inFileBuffer.open(inFileName.c_str(), ios_base::in | ios_base::binary);
+	if (inFileName == "-") {
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		pInBuffer = cin.rdbuf();
+	}
+	else {
+		pInBuffer = inFileBuffer.open(inFileName.c_str(), ios_base::in | ios_base::binary);
+	}
 	if (!pInBuffer) {
 		perror((string("Failed to open input file \"") + inFileName + "\"").c_str());
 		return EXIT_FAILURE;
@@ -144,7 +212,15 @@ int main(void) {
 	// No point in continuing if can't open output file.
 	filebuf outFileBuffer; // For file output. Needs to be defined here to remain in scope
 	streambuf *pOutBuffer; // Either standard output buffer or a file buffer
-	pOutBuffer = outFileBuffer.open(outFileName.c_str(), ios_base::out | ios_base::binary);
+	if (outFileName == "-") {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		pOutBuffer = cout.rdbuf();
+	}
+	else {
+		pOutBuffer = outFileBuffer.open(outFileName.c_str(), ios_base::out | ios_base::binary);
+	}
 	if (!pOutBuffer) {
 		perror((string("Failed to open output file \"") + outFileName + "\"").c_str());
 		return EXIT_FAILURE;
@@ -165,6 +241,7 @@ int main(void) {
 		clog << "vertical slice size (in units of 2**(wavelet depth)) = " << ySize << endl;
 		clog << "horizontal slice size (in units of 2**(wavelet depth)) = " << xSize << endl;
 		clog << "output = " << output << endl;
+		clog << "profile = " << (lowDelay ? "LD" : "HQ") << endl;
 	}
 
 		// Calculate number of slices per picture
@@ -203,250 +280,226 @@ int main(void) {
 		if (verbose) clog << "Determine quantisation indices" << endl;
 		const int pictureBytes = (interlaced ? compressedBytes / 2 : compressedBytes);
 		// Calculate number of bytes for each slice
-		const Array2D bytes = slice_bytes(ySlices, xSlices, pictureBytes, sliceScalar);
-
-		// Construct an container to read the compressed data into.
-		const PictureFormat transformFormat(paddedPictureHeight, paddedWidth, chromaFormat);
-		Slices inSlices(transformFormat, waveletDepth, ySlices, xSlices);
+		// (LD slice sizes are in bytes, i.e. a scalar of 1)
+		const Array2D bytes = slice_bytes(ySlices, xSlices, pictureBytes, (lowDelay ? 1 : sliceScalar));
 
 		// Define picture format (field or frame)
 		const PictureFormat picFormat(pictureHeight, width, chromaFormat);
 
+		// Pre-allocate the buffers for decoding a picture (compressed slices,
+		// coefficients and decoded picture), so no memory is allocated per frame.
+		// Use 16 bit coefficients if the picture's coefficients must fit in 16 bits.
+		// (Inverse quantisation throws std::overflow_error if a corrupt stream breaks this.)
+		const bool shortCoeffs =
+			shortCoefficients(kernel, waveletDepth, (lumaDepth>chromaDepth) ? lumaDepth : chromaDepth);
+		if (verbose) clog << "16 bit coefficients = " << std::boolalpha << shortCoeffs << endl;
+		FramePool framePool(FrameBuffersFactory(picFormat, waveletDepth, ySlices, xSlices, shortCoeffs));
+		FrameBuffers& buffers = framePool.acquire();
+		TaskScheduler scheduler(threads, pinThreads);
+		if (verbose) clog << "threads = " << scheduler.threads() << (pinThreads ? " (pinned)" : "") << endl;
+		Slices& inSlices = buffers.slices; // Container to read the compressed data into
+
 		// Create Frame to hold output data
 		const PictureFormat frameFormat(height, width, chromaFormat);
 		Frame outFrame(frameFormat, interlaced, topFieldFirst);
 
-		int frame = 0;
+		const int MaxValue = utils::pow(2, bits) - 1;
 
-		inStream >> sliceio::highQualityCBR(bytes, sliceScalar); // Read input in HQ VBR mode
-		inStream >> inSlices; // Read the compressed input picture
-								// Check picture was read OK
-		if (!inStream) {
-			if (frame == 0) {
-				cerr << "\rFailed to read the first compressed frame" << endl;
-				return EXIT_FAILURE;
-			}
-			else {
-				if (verbose) clog << "\rEnd of input reached after " << frame << " frames     " << endl;
-				if (inFileName != "-") inFileBuffer.close();
-				if (outFileName != "-") outFileBuffer.close();
-				return EXIT_SUCCESS;
+		// Decode just a region, if required, from the slices that cover it
+		boost::scoped_ptr<RegionDecoder> regionDecoder(decodeRegion ?
+			new RegionDecoder(picFormat, kernel, waveletDepth, ySlices, xSlices,
+			                  PictureRegion(regionTop, regionLeft, regionHeight, regionWidth)) : 0);
+		Picture regionPicture(decodeRegion ? regionDecoder->format() : PictureFormat());
+		if (regionDecoder) {
+			const SliceRegion& slices = regionDecoder->slices();
+			if (verbose) {
+				clog << "region = " << regionWidth << "x" << regionHeight << " at (" << regionLeft << ", " << regionTop
+				     << "), from " << slices.width << "x" << slices.height << " slices at (" << slices.left << ", " << slices.top << ")" << endl;
 			}
+			inStream >> sliceio::region(slices); // Skip the other slices
+		}
+		const PictureFormat decodedFormat(decodeRegion ? regionDecoder->format() : frameFormat);
+
+		// Y4M output starts with a stream header describing the pictures.
+		// Y4M pictures are frames, so interlaced fields are assembled into outFrame
+		// and written once both fields of the frame are decoded.
+		const Y4MFormat y4mFormat(decodedFormat, bits, interlaced, topFieldFirst);
+		if ((output == DECODED) && !packedOutput && y4mOutput) {
+			outStream << y4mFormat;
 		}
-		else clog << endl;
-
-		// Reorder quantised coefficients from slice order to transform order
-		if (verbose) clog << "Merge slices into full picture" << endl;
-		const Picture yuvQCoeffs = merge_blocks(inSlices.yuvSlices);
-
-
-		// Inverse quantise in transform order
-		if (verbose) clog << "Inverse quantise" << endl;
-		const Picture yuvTransform = inverse_quantise_transform_np(yuvQCoeffs, inSlices.qIndices, qMatrix);
-		
-		// Inverse wavelet transform
-		if (verbose) clog << "Inverse transform" << endl;
-		const Picture outPicture = inverseWaveletTransform(yuvTransform, kernel, waveletDepth, picFormat);
-
-		const Shape2D  restoredSize = { { height, width } };
-		Array2D restoredR(restoredSize);
-		Array2D restoredG(restoredSize);
-		Array2D restoredB(restoredSize);
-
-		Array2D restoredY;
-		Array2D restoredU;
-		Array2D restoredV;
-
-		const int MaxValue = utils::pow(2, bits) - 1;
 
-		restoredY = clip(outPicture.y(), 0, MaxValue);
-		restoredU = clip(outPicture.c1(), 0, MaxValue);
-		restoredV = clip(outPicture.c2(), 0, MaxValue);
-
-		int *ULine = (new int[width + 2]) + 1;
-		int *VLine = (new int[width + 2]) + 1;
-		fill_n(&ULine[-1], width + 2, 0);
-		fill_n(&VLine[-1], width + 2, 0);
-
-		const int UVHeight = height + 2;
-		const int UVWidth = width + 2;
-		const int UVImageSize = UVHeight*UVWidth;
-		int *UImage = (new int[UVImageSize]) + UVWidth + 1;
-		int *VImage = (new int[UVImageSize]) + UVWidth + 1;
-		fill_n(&UImage[-(UVWidth + 1)], UVImageSize, 0);
-		fill_n(&VImage[-(UVWidth + 1)], UVImageSize, 0);
-		int R, G, B;
-		int Y, U, V;
-
-		switch (chromaFormat) {
-		case RGB:
-			restoredR = clip(outPicture.y(), 0, MaxValue);
-			restoredG = clip(outPicture.c1(), 0, MaxValue);
-			restoredB = clip(outPicture.c2(), 0, MaxValue);
-			break;
-		case CF444:
-			for (int line = 0; line<height; ++line) {
-				for (int pixel = 0; pixel<width; ++pixel) {
-
-					Y = restoredY[line][pixel] - 16;
-					U = restoredU[line][pixel] - 128;
-					V = restoredV[line][pixel] - 128;
-
-					R = ((298 * Y + 409 * V + 128) >> 8);
-					G = ((298 * Y - 100 * U - 208 * V + 128) >> 8);
-					B = ((298 * Y + 516 * U + 128) >> 8);
-
-					//Clip RGB Values
-					restoredR[line][pixel] = static_cast<int>((R<0) ? 0 : ((R>MaxValue) ? MaxValue : R));
-					restoredG[line][pixel] = static_cast<int>((G<0) ? 0 : ((G>MaxValue) ? MaxValue : G));
-					restoredB[line][pixel] = static_cast<int>((B<0) ? 0 : ((B>MaxValue) ? MaxValue : B));
-				}
+		// Export the frame statistics
+		std::ofstream statsStream;
+		if (!statsFileName.empty()) {
+			statsStream.open(statsFileName.c_str(), ios_base::out | ios_base::app);
+			if (!statsStream) {
+				cerr << "Error: failed to open statistics file " << statsFileName << endl;
+				return EXIT_FAILURE;
 			}
-			break;
-		case CF422:
-			for (int line = 0; line<height; ++line) {
-				int UVIndex = width*line / 2;
-				for (int pixel = 0; pixel<width; pixel += 2) {
-					//Copy (sub-sampled) UV components to line buffer.
-					ULine[pixel] = restoredU[line][pixel / 2] - 128;
-					VLine[pixel] = restoredV[line][pixel / 2] - 128;
+		}
+		ostream* jsonStream = statsStream.is_open() ? &statsStream : (verbose ? &clog : 0);
+		StatsWriter statsWriter(jsonStream, countersFileName);
+
+		// Decode each compressed frame in turn, until the end of the input
+		for (int frame = 0; ; ++frame) {
+			FrameStats stats(frame + 1);
+
+			StageTimer readTimer(stats, instrumentation::READ);
+			// Each picture is a data unit: parse info, picture header, then slices.
+			// HQ slices are read using the lengths they contain, so slice sizes may
+			// vary (between pictures for VBR, or within a CBR picture).
+			DataUnit dataUnit;
+			PicturePreamble preamble;
+			if (lowDelay) inStream >> sliceio::lowDelay(bytes); // Read input in LD mode
+			else inStream >> sliceio::highQualityVBR(sliceScalar); // Read input in HQ mode
+			inStream >> dataunitio::synchronise >> dataUnit;
+			if (inStream) { // Not the end of the input
+				if (dataUnit.type != (lowDelay ? LD_PICTURE : HQ_PICTURE)) {
+					cerr << "\rUnexpected data unit \"" << dataUnit.type << "\" in frame " << (frame + 1) << endl;
+					return EXIT_FAILURE;
 				}
-
-				int YIndex = width*line;
-				int RGBIndex = 3 * width*line;
-				for (int pixel = 0; pixel<width; ++pixel) {
-
-					//Copy Y value and  filter UV values.
-					Y = restoredY[line][pixel] - 16;
-					U = (ULine[pixel - 1] + 2 * ULine[pixel] + ULine[pixel + 1] + 1) >> 1;
-					V = (VLine[pixel - 1] + 2 * VLine[pixel] + VLine[pixel + 1] + 1) >> 1;
-
-					//Matrix YUV to RGB
-					R = ((298 * Y + 409 * V + 128) >> 8);
-					G = ((298 * Y - 100 * U - 208 * V + 128) >> 8);
-					B = ((298 * Y + 516 * U + 128) >> 8);
-
-					//Clip RGB Values
-					restoredR[line][pixel] = static_cast<int>((R<0) ? 0 : ((R>MaxValue) ? MaxValue : R));
-					restoredG[line][pixel] = static_cast<int>((G<0) ? 0 : ((G>MaxValue) ? MaxValue : G));
-					restoredB[line][pixel] = static_cast<int>((B<0) ? 0 : ((B>MaxValue) ? MaxValue : B));
+				inStream >> preamble;
+				if (inStream && ((preamble.slices_x != xSlices) || (preamble.slices_y != ySlices) ||
+				                 (preamble.wavelet_kernel != kernel) || (preamble.depth != waveletDepth))) {
+					cerr << "\rCompressed picture " << preamble.picture_number
+					     << " does not match the decoder parameters" << endl;
+					return EXIT_FAILURE;
+				}
+				// HQ slices use the prefix and slice size scalar of their picture
+				if (!lowDelay) {
+					inStream >> sliceio::highQualityVBR(preamble.slice_size_scalar, preamble.slice_prefix);
 				}
 			}
-			break;
-		case CF420:
-			for (int line = 0; line<height; line += 2) {
-				for (int pixel = 0; pixel<width; pixel += 2) {
-					UImage[line*UVWidth + pixel] = restoredU[line / 2][pixel / 2] - 128;
-					VImage[line*UVWidth + pixel] = restoredV[line / 2][pixel / 2] - 128;
+			inStream >> inSlices; // Read the compressed input picture
+			readTimer.stop();
+									// Check picture was read OK
+			if (!inStream) {
+				if (frame == 0) {
+					cerr << "\rFailed to read the first compressed frame" << endl;
+					return EXIT_FAILURE;
+				}
+				else {
+					if (verbose) clog << "\rEnd of input reached after " << frame << " frames     " << endl;
+					if (interlaced && y4mOutput && (output == DECODED) && !packedOutput && (frame % 2 != 0)) {
+						cerr << "Warning: the input ended with a single field, which was not written" << endl;
+					}
+					break;
 				}
 			}
-
-			//Vertically interpolate the UV samples
-			for (int line = 1; line<height; line += 2) {
-				for (int pixel = 0; pixel<width; pixel += 2) {
-					UImage[line*UVWidth + pixel] = ((UImage[(line - 1)*UVWidth + pixel] +
-						2 * UImage[line*UVWidth + pixel] + UImage[(line + 1)*UVWidth + pixel] + 1) >> 1);
-					VImage[line*UVWidth + pixel] = ((VImage[(line - 1)*UVWidth + pixel] +
-						2 * VImage[line*UVWidth + pixel] + VImage[(line + 1)*UVWidth + pixel] + 1) >> 1);
+			else clog << endl;
+			// Slice sizes as read (HQ slice sizes may vary)
+			stats.slices(inSlices.qIndices, inSlices.bytes, Array2D());
+
+			// A region is decoded from its own slices (the only ones read)
+			Picture& decodedPicture = (regionDecoder ? regionPicture : buffers.picture);
+			if (regionDecoder) {
+				if (verbose) clog << "Decode region" << endl;
+				StageTimer inverseTransformTimer(stats, instrumentation::INVERSE_TRANSFORM);
+				regionDecoder->decode(inSlices, qMatrix, regionPicture, scheduler);
+				inverseTransformTimer.stop();
+			}
+			else {
+				// Reorder quantised coefficients from slice order to transform order
+				if (verbose) clog << "Merge slices into full picture" << endl;
+				StageTimer unpackTimer(stats, instrumentation::SLICE_UNPACK);
+				merge_blocks(inSlices.yuvSlices, buffers.quantised, scheduler);
+				unpackTimer.stop();
+
+				// Inverse quantise in transform order
+				if (verbose) clog << "Inverse quantise" << endl;
+				StageTimer inverseQuantiseTimer(stats, instrumentation::INVERSE_QUANTISE);
+				if (lowDelay) {
+					if (shortCoeffs) inverse_quantise_transform(buffers.quantised, inSlices.qIndices, qMatrix, buffers.shortTransform);
+					else inverse_quantise_transform(buffers.quantised, inSlices.qIndices, qMatrix, buffers.transform);
 				}
+				else {
+					if (shortCoeffs) inverse_quantise_transform_np(buffers.quantised, inSlices.qIndices, qMatrix, buffers.shortTransform, scheduler);
+					else inverse_quantise_transform_np(buffers.quantised, inSlices.qIndices, qMatrix, buffers.transform, scheduler);
+				}
+				inverseQuantiseTimer.stop();
+			
+				// Inverse wavelet transform
+				if (verbose) clog << "Inverse transform" << endl;
+				StageTimer inverseTransformTimer(stats, instrumentation::INVERSE_TRANSFORM);
+				if (shortCoeffs) inverseWaveletTransform(buffers.shortTransform, kernel, waveletDepth, buffers.picture, scheduler);
+				else inverseWaveletTransform(buffers.transform, kernel, waveletDepth, buffers.picture, scheduler);
+				inverseTransformTimer.stop();
 			}
+			const Picture& outPicture = decodedPicture;
 
-			for (int line = 0; line<height; ++line) {
-				for (int pixel = 0; pixel<width; ++pixel) {
-
-					//Copy Y value and  filter UV values.
-					Y = restoredY[line][pixel] - 16;
-					U = (UImage[line*UVWidth + pixel - 1] + 2 * UImage[line*UVWidth + pixel] + UImage[line*UVWidth + pixel + 1] + 1) >> 1;
-					V = (VImage[line*UVWidth + pixel - 1] + 2 * VImage[line*UVWidth + pixel] + VImage[line*UVWidth + pixel + 1] + 1) >> 1;
+			// Colour conversion and output are timed as the write stage
+			StageTimer writeTimer(stats, instrumentation::WRITE);
 
-					//Matrix YUV to RGB
-					R = ((298 * Y + 409 * V + 128) >> 8);
-					G = ((298 * Y - 100 * U - 208 * V + 128) >> 8);
-					B = ((298 * Y + 516 * U + 128) >> 8);
-
-					//Clip RGB Values
-					restoredR[line][pixel] = static_cast<int>((R<0) ? 0 : ((R>MaxValue) ? MaxValue : R));
-					restoredG[line][pixel] = static_cast<int>((G<0) ? 0 : ((G>MaxValue) ? MaxValue : G));
-					restoredB[line][pixel] = static_cast<int>((B<0) ? 0 : ((B>MaxValue) ? MaxValue : B));
+			if ((output == DECODED) && packedOutput) {
+				if (verbose) clog << "Writing decoded picture as " << outputFormat << endl;
+				writePacked(outStream, outputFormat, outPicture, bits);
+				if (!outStream) {
+					cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+					return EXIT_FAILURE;
 				}
 			}
-			break;
-		default:
-			cerr << "output Image format ERROR" << endl;
-			return EXIT_FAILURE;
-		}
-
-		delete[](&VLine[-1]);
-		delete[](&ULine[-1]);
-		delete[](&VImage[-(UVWidth + 1)]);
-		delete[](&UImage[-(UVWidth + 1)]);
-
-		if (output == DECODED) {
-
-			string headP6 = "P6";
-
-			outStream << headP6 << endl;
-			outStream << height << " " << width << endl;
-			outStream << MaxValue << endl;
-
-			outStream << pictureio::wordWidth(nbytes); // Set number of bytes per value in file
-			outStream << pictureio::right_justified;
-			outStream << pictureio::offset_binary;
-			outStream << pictureio::bitDepth(bits, bits); // Set luma and chroma bit depths
-
-														  //Write pixel data line by line
-														  //(starting at the botom of the frame because bitmaps are stored upside down!)
-			std::streambuf& outbuf = *(outStream.rdbuf());
-			int outBufferSize = 3 * width*nbytes;
-			unsigned char *outlineBuffer = new unsigned char[outBufferSize];
-
-			unsigned char temp;
-			for (int line = 0; line<height; line++) {
-				int bufferOffset = 0;
-				for (register int pixel = 0; pixel<width; ++pixel) {
-					//read RGB values
-					R = restoredR[line][pixel];
-					G = restoredG[line][pixel];
-					B = restoredB[line][pixel];
-
-					//Store RGB values
-					if (nbytes == 1)
-					{
-						outlineBuffer[bufferOffset++] = R;
-						outlineBuffer[bufferOffset++] = G;
-						outlineBuffer[bufferOffset++] = B;
-					}
-					else if (nbytes == 2)
-					{
-						outlineBuffer[bufferOffset++] = R >> 8;
-						outlineBuffer[bufferOffset++] = R;
-						outlineBuffer[bufferOffset++] = G >> 8;
-						outlineBuffer[bufferOffset++] = G;
-						outlineBuffer[bufferOffset++] = B >> 8;
-						outlineBuffer[bufferOffset++] = B;
-					}
-					else
-					{
-						cerr << "Error: nbytes must be 1 or 2" << endl;
+			else if ((output == DECODED) && y4mOutput) {
+				if (verbose) clog << "Writing decoded picture as Y4M" << endl;
+				// Clip in place, the pooled picture is overwritten by the next frame
+				clip(outPicture, 0, MaxValue, decodedPicture);
+				if (!interlaced) writeY4MFrame(outStream, y4mFormat, outPicture);
+				else if (frame % 2 == 0) outFrame.firstField(outPicture);
+				else {
+					outFrame.secondField(outPicture);
+					writeY4MFrame(outStream, y4mFormat, outFrame);
+				}
+				if (!outStream) {
+					cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+					return EXIT_FAILURE;
+				}
+			}
+			else if (output == DECODED) {
+
+				string headP6 = "P6";
+
+				outStream << headP6 << endl;
+				const int outHeight = decodedFormat.lumaHeight();
+				const int outWidth = decodedFormat.lumaWidth();
+				outStream << outHeight << " " << outWidth << endl;
+				outStream << MaxValue << endl;
+
+				outStream << pictureio::wordWidth(nbytes); // Set number of bytes per value in file
+				outStream << pictureio::right_justified;
+				outStream << pictureio::offset_binary;
+				outStream << pictureio::bitDepth(bits, bits); // Set luma and chroma bit depths
+
+															  //Write pixel data line by line
+															  //(starting at the botom of the frame because bitmaps are stored upside down!)
+				std::streambuf& outbuf = *(outStream.rdbuf());
+				int outBufferSize = 3 * outWidth*nbytes;
+				unsigned char *outlineBuffer = new unsigned char[outBufferSize];
+
+				for (int line = 0; line<outHeight; line++) {
+					// Clip, upsample chroma, convert to RGB and pack in a single pass
+					yCbCrToRGB(outPicture, BT601, bits, line, nbytes, outlineBuffer);
+					if ((outbuf.sputn(reinterpret_cast<char*>(outlineBuffer), outBufferSize)) < outBufferSize) {
+						cerr << "Error: failed to write line " << line << endl;
 						return EXIT_FAILURE;
 					}
+				} //end line loop
 
-				} //end pixel loop
-				if ((outbuf.sputn(reinterpret_cast<char*>(outlineBuffer), outBufferSize)) < outBufferSize) {
-					cerr << "Error: failed to write line " << line << endl;
-					return EXIT_FAILURE;
-				}
-			} //end line loop
 
+				delete[] outlineBuffer;
+			}// if (output== DECODE)
+			outStream.flush();
+			writeTimer.stop();
 
-			delete[] outlineBuffer;
-		}// if (output== DECODE)
+			statsWriter.record(stats);
+		} // end frame loop
 
+		framePool.release(buffers);
+		statsWriter.flush();
 
-		inFileBuffer.close();
-		outFileBuffer.close();
+		if (inFileName != "-") inFileBuffer.close();
+		if (outFileName != "-") outFileBuffer.close();
 
-		cout << "Decode HD CBR Done " <<endl;
+		// Don't mix messages with the decoded output on standard output
+		if (outFileName != "-") cout << "Decode HD CBR Done " <<endl;
 #ifdef _WIN32
 		cout << "Please input a character : ";
 		cin.get();
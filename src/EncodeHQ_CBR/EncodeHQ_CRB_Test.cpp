@@ -15,6 +15,13 @@ const char summary[] = "Encodes an uncompressed planar video file with VC-2 High
 const char description[] = "\
 This program compresses an image sequence using SMPTE VC-2 HQ profile.\n\
 It implements constant bit rate coding.\n\
+The bytes of each picture are shared between its slices, so that slice sizes vary with their content.\n\
+It may, alternatively, use the Low Delay profile (for receivers that only support LD).\n\
+It may, alternatively, code at variable bit rate, to a quality target (a quantisation\n\
+index or a PSNR) with the bit rate as a maximum, sharing bits between pictures within\n\
+a look-ahead window.\n\
+Each HQ picture is sent with its picture header, so HQ slices may start with prefix bytes\n\
+and the slice size scalar may be chosen automatically for each picture (for large slices).\n\
 The bit rate is specified by defining the number of compressed bytes per frame.\n\
 Its primary output is the compressed bytes. However it may produce alternative outputs which are:\n\
   1 the wavelet transform of the input\n\
@@ -24,7 +31,20 @@ Its primary output is the compressed bytes. However it may produce alternative o
   5 VC2 bitstream (default output)\n\
   6 the decoded sequence\n\
   7 the PSNR for each frame\n\
+The PSNR of each picture is measured from its quantised coefficients, without decoding\n\
+the stream, and may also be written (as JSON lines) alongside the compressed output.\n\
+The decoded sequence is reconstructed in the same way and written in the format of the\n\
+input (packed, Y4M, or PPM).\n\
+The work of coding is shared between a fixed number of threads (by default one per core).\n\
+Several channels may, alternatively, be encoded by one process (a multi-channel server),\n\
+each from its own file or named pipe, sharing a thread per core of each NUMA node and\n\
+keeping each channel's buffers on its node.\n\
 Input and output (where appropriate) are in planar format (4:4:4, 4:2:2, 4:2:0 or RGB).\n\
+Input may, alternatively, be a Y4M file (or \"-\" for Y4M on standard input),\n\
+in which case the picture size, chroma format and bit depth are taken from its header\n\
+and every frame is encoded. Output \"-\" writes to standard output.\n\
+Input may, instead, be raw packed video (UYVY, v210 or P010, as from a capture card),\n\
+which is unpacked straight into the (padded) buffers of the wavelet transform.\n\
 There can be 1 to 4 bytes per sample and the data is left (MSB) justified.\n\
 Data is assumed offset binary (which is fine for both YCbCr or RGB).\n\
 \n\
@@ -40,16 +60,39 @@ const char* details[] = { version, summary, description };
 #include <iomanip> // For reporting stats only
 #include <algorithm>
 #include <functional>
+#include <numeric> // For accumulate
 #include <cmath>
+#include <deque>
+#include <sstream> // For istringstream
+#include <vector>
+#ifdef _WIN32
+#include <io.h> // For _setmode
+#include <fcntl.h> // For _O_BINARY
+#endif
+
+#include "boost/bind.hpp"
+#include "boost/ref.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/scoped_ptr.hpp"
 
 #include "EncodeParams.h"
 #include "Arrays.h"
 #include "Picture.h"
 #include "Frame.h"
+#include "ColourConversion.h"
 #include "WaveletTransform.h"
 #include "Quantisation.h"
 #include "Slices.h"
 #include "DataUnit.h"
+#include "BufferPool.h"
+#include "Y4MIO.h"
+#include "PackedIO.h"
+#include "Instrumentation.h"
+#include "RateControl.h"
+#include "QualityMonitor.h"
+#include "SliceGeometry.h"
+#include "TaskScheduler.h"
+#include "Numa.h"
 #include "Utils.h"
 
 using std::cout;
@@ -58,12 +101,12 @@ using std::cerr;
 using std::clog;
 using std::endl;
 using std::string;
-using std::ifstream;
 using std::ofstream;
 using std::ios_base;
 using std::filebuf;
 using std::streambuf;
-using std::fill_n;
+using std::istream;
+using std::ostream;
 
 using arrayio::ioFormat;  // enu
 using arrayio::format;    // class
@@ -73,64 +116,380 @@ using arrayio::offset;    //class
 using arrayio::left_justified;
 using arrayio::right_justified;
 
-// Calculate quantisation indices using a binary search
-const Array2D quantIndices(const Picture& coefficients,
-	const Array1D& qMatrix,
-	const Array2D& sliceBytes,
-	const int scalar) {
-	const int ySlices = sliceBytes.shape()[0];
-	const int xSlices = sliceBytes.shape()[1];
-	// Create an empty array of indices to fill and return
-	Array2D indices(extents[ySlices][xSlices]);
-	// Wavelet depth & number of subbands derived from dimensions of qMatrix
-	const int numberOfSubbands = qMatrix.size();
-	const int waveletDepth = (numberOfSubbands - 1) / 3;
-	const PictureArray slices = split_into_blocks(coefficients, ySlices, xSlices);
-	for (int row = 0; row<ySlices; ++row) {
-		for (int column = 0; column<xSlices; ++column) {
-			// Available bytes is the size of slice less 4 byte overhead
-			const int bytesAvailable = sliceBytes[row][column] - 4;
-			int trialQ = 63;
-			int q = 127;
-			int delta = 64;
-			while (delta>0) {
-				delta >>= 1;
-				const Picture trialSlice = quantise_transform_np(slices[row][column], trialQ, qMatrix);
-				int bytesRequired = component_slice_bytes(trialSlice.y(), waveletDepth, scalar);
-				bytesRequired += component_slice_bytes(trialSlice.c1(), waveletDepth, scalar);
-				bytesRequired += component_slice_bytes(trialSlice.c2(), waveletDepth, scalar);
-				if (bytesRequired <= bytesAvailable) {
-					if (trialQ<q) q = trialQ;
-					trialQ -= delta;
+using instrumentation::FrameStats;
+using instrumentation::StageTimer;
+using instrumentation::StatsWriter;
+
+namespace {
+
+// Encodes one picture, a frame or one field of a frame, into its (pooled)
+// buffers: wavelet transform, choice of quantisation indices, quantisation
+// and splitting into slices. Pictures are coded with the HQ profile or, for
+// receivers that only accept it, the LD profile (with LL subband prediction).
+// For VBR only the first pass is done here: the transform, its rate curve
+// (see "analysis") and the index meeting the quality target (see
+// "qualityIndex"). Quantisation waits for the look-ahead (see quantiseVBR).
+// A field is transformed straight from a strided view of the frame, so it is
+// never copied into a picture of its own. A picture read straight into the
+// (padded) transform buffers (see PackedIO.h) is transformed in place.
+// It is a function object so that the two fields of an interlaced frame can
+// be encoded concurrently, as tasks of the scheduler, which also shares the
+// rate control and slice packing of each picture between its threads.
+// Exceptions are caught and their message kept (see "error") to be reported
+// by the main thread.
+class PictureEncoder {
+	public:
+		static const int wholeFrame = -1; // Field number to encode a whole frame
+		static const int paddedFrame = -2; // Field number to encode a frame already in the transform buffers
+		PictureEncoder(const Picture& source, int field, // field: 0 top, 1 bottom
+		               WaveletKernel kernel, int waveletDepth, int bitDepth, bool shortCoeffs,
+		               const Array1D& qMatrix, const Array2D& sliceBytes, int sliceScalar, bool autoSliceScalar, bool lowDelay,
+		               bool shareSliceBytes, bool minimiseDistortion, bool vbr, int vbrQIndex, double vbrPSNR, FrameBuffers* scratch,
+		               TaskScheduler& scheduler, FrameBuffers& buffers, FrameStats& stats):
+			source(source), field(field),
+			kernel(kernel), waveletDepth(waveletDepth), bitDepth(bitDepth), shortCoeffs(shortCoeffs),
+			qMatrix(qMatrix), sliceBytes(sliceBytes), sliceScalar(sliceScalar), autoSliceScalar(autoSliceScalar && !lowDelay), lowDelay(lowDelay),
+			shareSliceBytes(shareSliceBytes && !lowDelay), minimiseDistortion(minimiseDistortion), vbr(vbr), vbrQIndex(vbrQIndex), vbrPSNR(vbrPSNR), scratch(scratch),
+			scheduler(scheduler), buffers(buffers), stats(stats), quality(vbrQIndex) {
+		}
+		void operator()() {
+			try {
+				encode();
+			}
+			catch (const std::exception& e) {
+				message = e.what();
+			}
+		}
+		const string& error() const { return message; }
+		const VBRAnalysis& analysis() const { return vbrAnalysis; }
+		const int qualityIndex() const { return quality; }
+	private:
+		void encode() {
+			//Forward wavelet transform
+			StageTimer transformTimer(stats, instrumentation::TRANSFORM);
+			if (field == paddedFrame) {
+				if (shortCoeffs) paddedWaveletTransform(buffers.shortTransform, kernel, waveletDepth, bitDepth, scheduler);
+				else paddedWaveletTransform(buffers.transform, kernel, waveletDepth, scheduler);
+			}
+			else if (field == wholeFrame) {
+				if (shortCoeffs) waveletTransform(source, kernel, waveletDepth, bitDepth, buffers.shortTransform, scheduler);
+				else waveletTransform(source, kernel, waveletDepth, buffers.transform, scheduler);
+			}
+			else {
+				if (shortCoeffs) fieldWaveletTransform(source, field, kernel, waveletDepth, bitDepth, buffers.shortTransform, scheduler);
+				else fieldWaveletTransform(source, field, kernel, waveletDepth, buffers.transform, scheduler);
+			}
+			transformTimer.stop();
+
+			buffers.sliceScalar = sliceScalar;
+			if (vbr) {
+				// First pass: the rate curve and the index that meets the quality target
+				StageTimer rateControlTimer(stats, instrumentation::RATE_CONTROL);
+				const int ySlices = sliceBytes.shape()[0];
+				const int xSlices = sliceBytes.shape()[1];
+				if (shortCoeffs) vbrAnalysis = VBRAnalysis(buffers.shortTransform, ySlices, xSlices, qMatrix, sliceScalar);
+				else vbrAnalysis = VBRAnalysis(buffers.transform, ySlices, xSlices, qMatrix, sliceScalar);
+				if (vbrPSNR > 0.0) {
+					quality = psnrQIndex(vbrAnalysis, vbrPSNR, source, (field == paddedFrame ? wholeFrame : field),
+					                     kernel, bitDepth, *scratch);
 				}
-				else {
-					trialQ += delta;
+				return;
+			}
+
+			// Choose quantisation indices to achieve the compressed size of the picture
+			Array2D& qIndices = buffers.slices.qIndices;
+			Array2D codedBytes; // Bytes actually needed by each slice
+			StageTimer rateControlTimer(stats, instrumentation::RATE_CONTROL);
+			if (autoSliceScalar) {
+				// The smallest slice scalar that does not limit the coding of the picture,
+				// with its slices sized (in buffers.sliceBytes) in units of that scalar
+				const int ySlices = sliceBytes.shape()[0];
+				const int xSlices = sliceBytes.shape()[1];
+				const int pictureBytes = std::accumulate(sliceBytes.data(), sliceBytes.data() + sliceBytes.num_elements(), 0);
+				int scalar = min_slice_scalar(pictureBytes / (ySlices*xSlices));
+				for (;;) {
+					const Array2D scaledBytes = slice_bytes(ySlices, xSlices, pictureBytes, scalar);
+					chooseIndices(scaledBytes, scalar, codedBytes);
+					if (!shareSliceBytes) buffers.sliceBytes = scaledBytes;
+					const int required = shortCoeffs ?
+						required_slice_scalar(buffers.shortTransform, qMatrix, qIndices, buffers.sliceBytes) :
+						required_slice_scalar(buffers.transform, qMatrix, qIndices, buffers.sliceBytes);
+					if (required <= scalar) break;
+					scalar = required;
 				}
+				buffers.sliceScalar = scalar;
+			}
+			else chooseIndices(sliceBytes, sliceScalar, codedBytes);
+			rateControlTimer.stop();
+			stats.slices(qIndices, ((shareSliceBytes || autoSliceScalar) ? buffers.sliceBytes : sliceBytes), codedBytes);
+
+			// Quantise transform coefficients
+			StageTimer quantiseTimer(stats, instrumentation::QUANTISE);
+			if (lowDelay) {
+				if (shortCoeffs) quantise_transform(buffers.shortTransform, qIndices, qMatrix, buffers.quantised);
+				else quantise_transform(buffers.transform, qIndices, qMatrix, buffers.quantised);
+			}
+			else {
+				if (shortCoeffs) quantise_transform_np(buffers.shortTransform, qIndices, qMatrix, buffers.quantised, scheduler);
+				else quantise_transform_np(buffers.transform, qIndices, qMatrix, buffers.quantised, scheduler);
+			}
+			quantiseTimer.stop();
+
+			// Split quantised coefficients into slices
+			StageTimer slicePackTimer(stats, instrumentation::SLICE_PACK);
+			split_into_blocks(buffers.quantised, buffers.slices.yuvSlices, scheduler);
+			slicePackTimer.stop();
+		}
+		// Quantisation indices for slices of the given sizes, with the slice scalar
+		void chooseIndices(const Array2D& sizes, int scalar, Array2D& codedBytes) {
+			Array2D& qIndices = buffers.slices.qIndices;
+			if (lowDelay) {
+				if (shortCoeffs) qIndices = quantIndicesLD(buffers.shortTransform, qMatrix, sizes, codedBytes);
+				else qIndices = quantIndicesLD(buffers.transform, qMatrix, sizes, codedBytes);
+			}
+			else if (shareSliceBytes && minimiseDistortion) {
+				// Slice sizes vary, sharing the bytes of the picture (in buffers.sliceBytes),
+				// with the indices that minimise the (estimated) distortion of the picture
+				if (shortCoeffs) qIndices = rdQuantIndices(buffers.shortTransform, qMatrix, sizes, scalar,
+				                                           codedBytes, buffers.sliceBytes);
+				else qIndices = rdQuantIndices(buffers.transform, qMatrix, sizes, scalar,
+				                               codedBytes, buffers.sliceBytes);
+			}
+			else if (shareSliceBytes) {
+				// Slice sizes vary, sharing the bytes of the picture (in buffers.sliceBytes)
+				if (shortCoeffs) qIndices = pictureQuantIndices(buffers.shortTransform, qMatrix, sizes, scalar,
+				                                                codedBytes, buffers.sliceBytes);
+				else qIndices = pictureQuantIndices(buffers.transform, qMatrix, sizes, scalar,
+				                                    codedBytes, buffers.sliceBytes);
+			}
+			else {
+				if (shortCoeffs) qIndices = quantIndices(buffers.shortTransform, qMatrix, sizes, scalar, codedBytes, scheduler);
+				else qIndices = quantIndices(buffers.transform, qMatrix, sizes, scalar, codedBytes, scheduler);
 			}
-			indices[row][column] = q;
 		}
+		const Picture& source;
+		const int field;
+		const WaveletKernel kernel;
+		const int waveletDepth;
+		const int bitDepth;
+		const bool shortCoeffs;
+		const Array1D& qMatrix;
+		const Array2D& sliceBytes;
+		const int sliceScalar;
+		const bool autoSliceScalar; // Choose the HQ CBR picture's slice scalar
+		const bool lowDelay;
+		const bool shareSliceBytes; // HQ CBR slice sizes vary
+		const bool minimiseDistortion; // Rate-distortion choice of indices (if slice sizes vary)
+		const bool vbr;
+		const int vbrQIndex;
+		const double vbrPSNR;
+		FrameBuffers* const scratch; // For the PSNR of trial indices (VBR)
+		TaskScheduler& scheduler;
+		FrameBuffers& buffers;
+		FrameStats& stats;
+		string message;
+		VBRAnalysis vbrAnalysis;
+		int quality;
+};
+
+// A picture that has been transformed, waiting to be coded and written.
+// VBR pictures wait here, in coding order, for the look-ahead.
+struct PendingPicture {
+	PendingPicture(FrameBuffers& buffers, const FrameStats& stats,
+	               const VBRAnalysis& analysis, int qualityIndex):
+		buffers(&buffers), stats(stats), analysis(analysis), qualityIndex(qualityIndex) {
 	}
-	return indices;
+	FrameBuffers* buffers;
+	FrameStats stats;
+	VBRAnalysis analysis; // VBR rate curve
+	int qualityIndex; // VBR index meeting the quality target
+};
+
+// Second pass of VBR coding: quantise a picture with the index chosen by the
+// rate control and split it into slices (in its buffers).
+// Returns the bytes used by the picture's slices.
+const int quantiseVBR(PendingPicture& picture, int qIndex,
+                      const Array1D& qMatrix, bool shortCoeffs,
+                      TaskScheduler& scheduler) {
+	FrameBuffers& buffers = *picture.buffers;
+	Array2D& qIndices = buffers.slices.qIndices;
+	Array2D sliceBytes;
+	StageTimer rateControlTimer(picture.stats, instrumentation::RATE_CONTROL);
+	picture.analysis.quantIndices(qIndex, qIndices, sliceBytes);
+	rateControlTimer.stop();
+	// VBR slices are their coded size, so there is no padding
+	picture.stats.slices(qIndices, sliceBytes, sliceBytes);
+
+	StageTimer quantiseTimer(picture.stats, instrumentation::QUANTISE);
+	if (shortCoeffs) quantise_transform_np(buffers.shortTransform, qIndices, qMatrix, buffers.quantised, scheduler);
+	else quantise_transform_np(buffers.transform, qIndices, qMatrix, buffers.quantised, scheduler);
+	quantiseTimer.stop();
+
+	StageTimer slicePackTimer(picture.stats, instrumentation::SLICE_PACK);
+	split_into_blocks(buffers.quantised, buffers.slices.yuvSlices, scheduler);
+	slicePackTimer.stop();
+
+	return picture.analysis.bytes(qIndex);
 }
 
-int main(void) {
+// A channel (stream) to encode: its input and output (files, named pipes or
+// "-" for standard input or output), its compression ratio and, optionally,
+// files for its statistics (see encodeChannel).
+struct Channel {
+	Channel() : compressedRate(2.0) {}
+	string inFileName;
+	string outFileName;
+	float compressedRate; // Uncompressed bytes / compressed bytes
+	string statsFileName;
+	string countersFileName;
+	string psnrFileName;
+};
+
+// Reads the channels of a multi-channel encoder, one per line:
+//   input output ratio [stats [psnr [counters]]]
+// Use "" to skip an optional file, e.g. to give a counters file only.
+// Blank lines, and lines starting with '#', are ignored.
+// Throws std::invalid_argument if a line cannot be parsed.
+const std::vector<Channel> readChannels(istream& input) {
+	std::vector<Channel> channels;
+	string line;
+	while (std::getline(input, line)) {
+		std::istringstream fields(line);
+		Channel channel;
+		if (!(fields >> channel.inFileName) || (channel.inFileName[0] == '#')) continue;
+		if (!(fields >> channel.outFileName >> channel.compressedRate) || (channel.compressedRate <= 0.0)) {
+			throw std::invalid_argument("Invalid channel: \"" + line + "\"");
+		}
+		fields >> channel.statsFileName >> channel.psnrFileName >> channel.countersFileName;
+		if (channel.statsFileName == "\"\"") channel.statsFileName.clear();
+		if (channel.psnrFileName == "\"\"") channel.psnrFileName.clear();
+		if (channel.countersFileName == "\"\"") channel.countersFileName.clear();
+		channels.push_back(channel);
+	}
+	return channels;
+}
 
+// Encodes a channel, sharing the work of coding with the scheduler's threads.
+// The buffers for coding are allocated here, by the calling thread.
+// Returns EXIT_SUCCESS, or EXIT_FAILURE if its files cannot be read or written.
+int encodeChannel(const Channel& channel, TaskScheduler& scheduler, bool verbose) {
 
+		const string& inFileName = channel.inFileName;
+		const string& outFileName = channel.outFileName;
 
 		  //Open input file in binary mode.
 		int bits = 8;
 		ColourFormat chromaFormat = CF422;  // {UNKNOWN, CF444, CF422, CF420, RGB};
 
-		string inFileName = "D:/resource/history/TEST8.PPM";
-		string outFileName = "Haar1D1YUV422Bits10.drc";
+		// Input may be raw packed video (as from a capture card, see PackedIO.h),
+		// which is unpacked straight into the (padded) transform buffers, so frames
+		// are not copied to pad them. It has no header, so its picture size is
+		// given here, and its chroma format and bit depth are the packed format's.
+		const bool packedInput = false;
+		const PackedFormat inputFormat = V210; // {UYVY, V210, P010}
+		const int packedHeight = 1080;
+		const int packedWidth = 1920;
+
+		// Otherwise Y4M input (a ".y4m" file, or "-" for standard input) provides
+		// the picture size, chroma format and bit depth. Else input is a PPM file.
+		const bool y4mInput = !packedInput && isY4MFileName(inFileName);
 
 		const WaveletKernel kernel = LeGall; // {DD97, LeGall, DD137, Haar0, Haar1, Fidelity, Daub97, NullKernel};
 		const int waveletDepth = 3;
-		float CompressedRate = 2.0;   // 2, 5, 8
+		const float CompressedRate = channel.compressedRate;   // 2, 5, 8
 		int height;
 		int width;
 		int MaxValue;
 		const int sliceScalar = 1;
+		// HQ slices may start with prefix bytes (reserved for applications). The
+		// HQ CBR slice scalar may, instead, be chosen for each picture, as the
+		// smallest that does not limit its coding, so large slices need not use a
+		// large scalar throughout. Each picture's prefix and scalar are sent in its
+		// picture header.
+		const int slicePrefix = 0;
+		// Choose the slice size (rather than the ySize and xSize for the chroma
+		// format) from the picture size, bit rate and number of cores, balancing
+		// slice overheads against parallelism (see chooseSliceGeometry). The
+		// decoder must then be given the slice size reported. The slice scalar
+		// is then chosen for each picture too, to suit the slice size.
+		const bool autoSliceGeometry = false;
+		const bool autoSliceScalar = autoSliceGeometry;
+		int frame = 1;
+		// Code with the VC-2 Low Delay profile, for receivers that only accept LD,
+		// rather than the High Quality profile.
+		const bool lowDelay = false;
+		// Share the bytes of each (HQ CBR) picture between its slices, so that slice
+		// sizes vary with their content, rather than every slice having the same size.
+		const bool shareSliceBytes = true;
+		// When slice sizes vary, choose the slices' indices to minimise the distortion
+		// of the picture (estimated from the coefficients), rather than coding them
+		// with (nearly) the same index. This gains a little quality (a few tenths
+		// of a dB) but roughly doubles the time taken by rate control.
+		const bool minimiseDistortion = false;
+		// Code at variable bit rate (HQ profile only). Each picture is coded at a
+		// quality target: the quantisation index vbrQIndex or, if vbrPSNR is not 0,
+		// the largest index reaching that PSNR (dB). The compressed bytes (see
+		// CompressedRate) are then a maximum rate, averaged over vbrLookAhead pictures.
+		const bool vbr = false;
+		const int vbrQIndex = 24;
+		const double vbrPSNR = 0.0;
+		const int vbrLookAhead = 8;
+		if (lowDelay && vbr) {
+			cerr << "Error: VBR coding uses the HQ profile, not LD" << endl;
+			return EXIT_FAILURE;
+		}
+
+		// Per frame statistics. JSON lines go to this file (or, if empty, to
+		// the log when verbose). Counters are dumped to the counters file
+		// (if not empty) for monitoring.
+		const string& statsFileName = channel.statsFileName;
+		const string& countersFileName = channel.countersFileName;
+		// Quality of each coded picture, measured in the encoder from its quantised
+		// coefficients (on a worker thread, without decoding the stream). JSON lines
+		// of per component MSE and PSNR go to this file (if not empty) or, if the
+		// output is PSNR, to the output file instead of the stream.
+		const string& psnrFileName = channel.psnrFileName;
+
+		int ySize;
+		int xSize;
+
+		// Open input file or use standard input, in binary mode.
+		filebuf inFileBuffer; // For file input. Needs to be defined here to remain in scope
+		streambuf *pInBuffer; // Either standard input buffer or a file buffer
+		if (inFileName == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			pInBuffer = cin.rdbuf();
+		}
+		else {
+			pInBuffer = inFileBuffer.open(inFileName.c_str(), ios_base::in | ios_base::binary);
+		}
+		if (!pInBuffer)
+		{
+			cerr << "Error: failed to open input file " << inFileName << endl;
+			return EXIT_FAILURE;
+		}
+		istream input(pInBuffer);
+
+		Y4MFormat y4mFormat;
+		if (y4mInput) {
+			input >> y4mFormat;
+			if (!input) {
+				cerr << "Error: failed to read Y4M header from " << inFileName << endl;
+				return EXIT_FAILURE;
+			}
+			height = y4mFormat.pictureFormat().lumaHeight();
+			width = y4mFormat.pictureFormat().lumaWidth();
+			chromaFormat = y4mFormat.pictureFormat().chromaFormat();
+			bits = y4mFormat.bitDepth();
+		}
+		else if (packedInput) {
+			height = packedHeight;
+			width = packedWidth;
+			chromaFormat = packedColourFormat(inputFormat);
+			bits = packedBitDepth(inputFormat);
+		}
 
 		int nbytes;
 		if (bits <= 8)
@@ -142,29 +501,20 @@ int main(void) {
 			nbytes = 2;
 		}
 
-		int ySize;
-		int xSize;
-
-		ifstream input;
-		input.open(inFileName.c_str(), ios_base::in | ios_base::binary);
-		if (!input)
-		{
-			cerr << "Error: failed to open input file " << inFileName << endl;
-			return 0;
+		if (!y4mInput && !packedInput) {
+			input >> wordWidth(nbytes);
+			input >> bitDepth(bits);
+			input >> right_justified;
+			input >> offset(0);
+
+			string headP6;
+			input >> headP6;
+			input >> height;
+			input >> width;
+			input >> MaxValue;
+			input.get();
 		}
 
-		input >> wordWidth(nbytes);
-		input >> bitDepth(bits);
-		input >> right_justified;
-		input >> offset(0);
-
-		string headP6;
-		input >> headP6;
-		input >> height;
-		input >> width;
-		input >> MaxValue;
-		input.get();
-
 		int compressedBytes;
 		switch (chromaFormat) {
 		case RGB:
@@ -184,192 +534,52 @@ int main(void) {
 			xSize = 2;
 			break;
 		}
-		//Read pixel data, line by line (to maximise cache occupancy).
-
-		const Shape2D  ppmsize = { { height, 3 * width } };
-		Array2D  RGBArray(ppmsize);
 
-		input >> RGBArray;
+		// Buffer for the RGB pixel data of a PPM file
+		Array2D  RGBArray;
+		if (!y4mInput && !packedInput) {
+			const Shape2D  ppmsize = { { height, 3 * width } };
+			RGBArray.resize(ppmsize);
+		}
 		PictureFormat pctFormat(height, width, chromaFormat);
 
-		const Shape2D  result = { { height, width } };
-		const Shape2D  UVresult422 = { { height, width / 2 } };
-		const Shape2D  UVresult420 = { { height / 2, width / 2 } };
-
-		Array2D  YArray;
-		Array2D  UArray;
-		Array2D  VArray;
-
-
-		const int UVHeight = height + 2;
-		const int UVWidth = width + 2;
-		const int UVImageSize = UVHeight*UVWidth;
-
-		int *ULine = (new int[width + 2]) + 1;
-		int *VLine = (new int[width + 2]) + 1;
-		int *UImage = (new int[UVImageSize]) + UVWidth + 1;
-		int *VImage = (new int[UVImageSize]) + UVWidth + 1;
-		ULine[-1] = ULine[width] = 128;
-		VLine[-1] = VLine[width] = 128;
-
-
-		int Y, U, V;
-		int R, G, B;
-		switch (chromaFormat) {
-		case RGB:
-			YArray.resize(result);
-			UArray.resize(result);
-			VArray.resize(result);
-			for (int line = 0; line<height; line++) {
-				for (register int pixel = 0; pixel<width; ++pixel) {
-					R = RGBArray[line][3 * pixel];
-					G = RGBArray[line][3 * pixel + 1];
-					B = RGBArray[line][3 * pixel + 2];
-
-					YArray[line][pixel] = R;
-					UArray[line][pixel] = G;
-					VArray[line][pixel] = B;
-				}
-			}
-			break;
-		case CF444:
-			YArray.resize(result);
-			UArray.resize(result);
-			VArray.resize(result);
-			for (int line = 0; line<height; line++) {
-				for (register int pixel = 0; pixel<width; ++pixel) {
-					R = RGBArray[line][3 * pixel];
-					G = RGBArray[line][3 * pixel + 1];
-					B = RGBArray[line][3 * pixel + 2];
-
-					//Convert RGB to YUV
-					Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
-					U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
-					V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
-
-					//Clip YUV values
-					YArray[line][pixel] = static_cast<int>((Y<0) ? 0 : ((Y>MaxValue) ? MaxValue : Y));
-					UArray[line][pixel] = static_cast<int>((U<0) ? 0 : ((U>MaxValue) ? MaxValue : U));
-					VArray[line][pixel] = static_cast<int>((V<0) ? 0 : ((V>MaxValue) ? MaxValue : V));
-				}
-			}
-			break;
-		case CF422:
-
-			YArray.resize(result);
-			UArray.resize(UVresult422);
-			VArray.resize(UVresult422);
-
-			for (int line = 0; line<height; ++line) {
-				for (int pixel = 0; pixel<width; ++pixel) {
-
-					R = RGBArray[line][3 * pixel];
-					G = RGBArray[line][3 * pixel + 1];
-					B = RGBArray[line][3 * pixel + 2];
-
-					//Convert RGB to YUV
-					Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
-					U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
-					V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
-
-					//Clip Y ready for output & copy UV ready for filtering
-					YArray[line][pixel] = static_cast<int>((Y<0) ? 0 : ((Y>MaxValue) ? MaxValue : Y));
-					ULine[pixel] = U;
-					VLine[pixel] = V;
-				}
-
-				for (int pixel = 0; pixel<width; pixel += 2) {
-
-					//Filter line
-					U = ((ULine[pixel - 1] + 2 * ULine[pixel] + ULine[pixel + 1] + 2) >> 2);
-					V = ((VLine[pixel - 1] + 2 * VLine[pixel] + VLine[pixel + 1] + 2) >> 2);
-
-					//Clip and copy UV to output buffer
-					UArray[line][pixel / 2] = static_cast<int>((U<0) ? 0 : ((U>MaxValue) ? MaxValue : U));
-					VArray[line][pixel / 2] = static_cast<int>((V<0) ? 0 : ((V>MaxValue) ? MaxValue : V));
-				}
-			}
-			break;
-		case CF420:
-			YArray.resize(result);
-			UArray.resize(UVresult420);
-			VArray.resize(UVresult420);
-
-			fill_n(&UImage[-(UVWidth + 1)], UVImageSize, 128);
-			fill_n(&VImage[-(UVWidth + 1)], UVImageSize, 128);
-			for (int line = 0; line<height; ++line) {
-				for (int pixel = 0; pixel<width; ++pixel) {
-
-					R = RGBArray[line][3 * pixel];
-					G = RGBArray[line][3 * pixel + 1];
-					B = RGBArray[line][3 * pixel + 2];
-
-					//Convert RGB to YUV
-					Y = ((66 * R + 129 * G + 25 * B + 128) >> 8) + 16;
-					U = ((-38 * R - 74 * G + 112 * B + 128) >> 8) + 128;
-					V = ((112 * R - 94 * G - 18 * B + 128) >> 8) + 128;
-
-					//Clip Y ready for output & copy UV ready for filtering
-					YArray[line][pixel] = static_cast<int>((Y<0) ? 0 : ((Y>MaxValue) ? MaxValue : Y));
-					ULine[pixel] = U;
-					VLine[pixel] = V;
-				}
-
-				for (int pixel = 0; pixel<width; pixel += 2) {
-					//Filter line & horizontally subsample by 2
-					//                UImage[line*UVWidth+pixel] = ULine[pixel];
-					//                VImage[line*UVWidth+pixel] = VLine[pixel];
-					UImage[line*UVWidth + pixel] = ((ULine[pixel - 1] + 2 * ULine[pixel] + ULine[pixel + 1] + 2) >> 2);
-					VImage[line*UVWidth + pixel] = ((VLine[pixel - 1] + 2 * VLine[pixel] + VLine[pixel + 1] + 2) >> 2);
-				}
-			}
-
-			for (int line = 0; line<height; line += 2) {
-				for (int pixel = 0; pixel<width; pixel += 2) {
-
-					//Filter vertically and subsample by 2
-					//                U = UImage[line*UVWidth+pixel];
-					//                V = VImage[line*UVWidth+pixel];
-					U = ((UImage[(line - 1)*UVWidth + pixel] +
-						2 * UImage[line*UVWidth + pixel] + UImage[(line + 1)*UVWidth + pixel] + 2) >> 2);
-					V = ((VImage[(line - 1)*UVWidth + pixel] +
-						2 * VImage[line*UVWidth + pixel] + VImage[(line + 1)*UVWidth + pixel] + 2) >> 2);
 
-					//Clip and copy UV to output buffer
-					UArray[line / 2][pixel / 2] = static_cast<int>((U<0) ? 0 : ((U>MaxValue) ? MaxValue : U));
-					VArray[line / 2][pixel / 2] = static_cast<int>((V<0) ? 0 : ((V>MaxValue) ? MaxValue : V));
-				}
-			}
-			break;
-		default:
-			cerr << "output Image format ERROR" << endl;
-			return EXIT_FAILURE;
-		} // switch
-
-
-		delete[](&VLine[-1]);
-		delete[](&ULine[-1]);
-		delete[](&VImage[-(UVWidth + 1)]);
-		delete[](&UImage[-(UVWidth + 1)]);
-
-
-		Picture picture(pctFormat, YArray, UArray, VArray);
-
-		const bool verbose = 1;
 		const int lumaDepth = bits;
 		int chromaDepth = bits;
 
-		const bool interlaced = 0;
-		const bool topFieldFirst = 0;
+		// Y4M input may be interlaced, each field is then coded as a picture
+		const bool interlaced = (y4mInput ? y4mFormat.interlaced() : false);
+		const bool topFieldFirst = (y4mInput ? y4mFormat.topFieldFirst() : false);
 		const Output output = STREAM;
 
 		
-		ofstream outStream;
-		outStream.open(outFileName.c_str(), ios_base::out | ios_base::binary);
-		if (!outStream)
+		// Open output file or use standard output, in binary mode.
+		filebuf outFileBuffer; // For file output. Needs to be defined here to remain in scope
+		streambuf *pOutBuffer; // Either standard output buffer or a file buffer
+		if (outFileName == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			pOutBuffer = cout.rdbuf();
+		}
+		else {
+			pOutBuffer = outFileBuffer.open(outFileName.c_str(), ios_base::out | ios_base::binary);
+		}
+		if (!pOutBuffer)
 		{
-			cerr << "Error: failed to open input file " << outFileName << endl;
-			return 0;
+			cerr << "Error: failed to open output file " << outFileName << endl;
+			return EXIT_FAILURE;
+		}
+		ostream outStream(pOutBuffer);
+
+		if (autoSliceGeometry) {
+			const PictureFormat pictureFormat((interlaced ? height / 2 : height), width, chromaFormat);
+			const SliceGeometry geometry =
+				chooseSliceGeometry(pictureFormat, waveletDepth, (interlaced ? compressedBytes / 2 : compressedBytes),
+				                    scheduler.threads(), (lowDelay ? 0 : slicePrefix));
+			ySize = geometry.ySize;
+			xSize = geometry.xSize;
+			if (verbose) clog << "slice geometry = " << geometry << " on " << scheduler.threads() << " threads" << endl;
 		}
 
 		PictureFormat format(height, width, chromaFormat);
@@ -381,6 +591,7 @@ int main(void) {
 			clog << "height = " << format.lumaHeight() << endl;
 			clog << "width = " << format.lumaWidth() << endl;
 			clog << "chroma format = " << format.chromaFormat() << endl;
+			if (packedInput) clog << "input format = " << inputFormat << endl;
 			clog << "interlaced = " << std::boolalpha << interlaced << endl;
 			if (interlaced) clog << "top field first = " << std::boolalpha << topFieldFirst << endl;
 			clog << "wavelet kernel = " << kernel << endl;
@@ -388,7 +599,22 @@ int main(void) {
 			clog << "vertical slice size (in units of 2**(wavelet depth)) = " << ySize << endl;
 			clog << "horizontal slice size (in units of 2**(wavelet depth)) = " << xSize << endl;
 			clog << "compressed bytes = " << compressedBytes << endl;
+			clog << "profile = " << (lowDelay ? "LD" : "HQ") << endl;
+			clog << "rate control = " << (vbr ? "VBR" : "CBR") << endl;
+			if (!lowDelay && !vbr) clog << "slice sizes = " << (shareSliceBytes ? "shared across the picture" : "fixed") << endl;
+			if (!lowDelay && !vbr && shareSliceBytes) clog << "minimise distortion = " << std::boolalpha << minimiseDistortion << endl;
+			if (!lowDelay) {
+				clog << "slice prefix bytes = " << slicePrefix << endl;
+				if (!vbr && autoSliceScalar) clog << "slice size scalar = automatic" << endl;
+				else clog << "slice size scalar = " << sliceScalar << endl;
+			}
+			if (vbr) {
+				if (vbrPSNR > 0.0) clog << "VBR target PSNR (dB) = " << vbrPSNR << endl;
+				else clog << "VBR quantisation index = " << vbrQIndex << endl;
+				clog << "VBR look ahead (pictures) = " << vbrLookAhead << endl;
+			}
 			clog << "output = " << output << endl;
+			if (!psnrFileName.empty()) clog << "PSNR file = " << psnrFileName << endl;
 		}
 
 		// Calculate number of slices per picture
@@ -408,12 +634,12 @@ int main(void) {
 			return EXIT_FAILURE;
 		}
 
+		// Calculate slice bytes numerator and denominator (sent in the LD picture header)
+		const utils::Rational sliceBytesNandD =
+			utils::rationalise((interlaced ? compressedBytes / 2 : compressedBytes), (ySlices*xSlices));
 		if (verbose) {
 			clog << "Vertical slices per picture          = " << ySlices << endl;
 			clog << "Horizontal slices per picture        = " << xSlices << endl;
-			// Calculate slice bytes numerator and denominator
-			const utils::Rational sliceBytesNandD =
-				utils::rationalise((interlaced ? compressedBytes / 2 : compressedBytes), (ySlices*xSlices));
 			const int SliceBytesNum = sliceBytesNandD.numerator;
 			const int SliceBytesDenom = sliceBytesNandD.denominator;
 			clog << "Slice bytes numerator                = " << SliceBytesNum << endl;
@@ -431,70 +657,414 @@ int main(void) {
 		}
 
 
-		//Forward wavelet transform
-		if (verbose) clog << "Forward transform" << endl;
-		Picture transform = waveletTransform(picture, kernel, waveletDepth);
+		// Pre-allocate the buffers for encoding a picture (coefficients and slices),
+		// so no memory is allocated per frame.
+		// Use 16 bit coefficients if they cannot overflow (unless the transform is output)
+		const bool shortCoeffs = (output != TRANSFORM) &&
+			shortCoefficients(kernel, waveletDepth, std::max(lumaDepth, chromaDepth));
+		if (verbose) clog << "16 bit coefficients = " << std::boolalpha << shortCoeffs << endl;
+		const PictureFormat codedFormat(pictureHeight, width, chromaFormat); // Frame or field
+		FramePool framePool(FrameBuffersFactory(codedFormat, waveletDepth, ySlices, xSlices, shortCoeffs));
 
-		if (output == TRANSFORM) {
-			//Write transform output as 4 byte 2's comp values
-			clog << "Writing transform coefficients to output file" << endl;
-			outStream << pictureio::wordWidth(4); //4 bytes per sample
-			outStream << pictureio::signed_binary;
-			outStream << transform;
-			if (!outStream) {
-				cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+		// Each frame is coded as a picture or, if interlaced, as two field pictures.
+		// Interlaced frames are read into a frame buffer, from which both fields are
+		// encoded in place. Progressive frames are read straight into the pooled picture.
+		const int fields = (interlaced ? 2 : 1);
+		Picture framePicture(interlaced ? pctFormat : PictureFormat());
+		const int bitDepth = std::max(lumaDepth, chromaDepth);
+
+		// Calculate number of bytes for each slice
+		const int pictureBytes = (interlaced ? compressedBytes / 2 : compressedBytes);
+		// (LD slice sizes are in bytes, i.e. a scalar of 1)
+		// (LD slices have no prefix, HQ slice sizes exclude it)
+		const int prefixBytes = (lowDelay ? 0 : slicePrefix*ySlices*xSlices);
+		const Array2D bytes = slice_bytes(ySlices, xSlices, pictureBytes - prefixBytes, (lowDelay ? 1 : sliceScalar));
+
+		// Export the picture statistics
+		ofstream statsStream;
+		if (!statsFileName.empty()) {
+			statsStream.open(statsFileName.c_str(), ios_base::out | ios_base::app);
+			if (!statsStream) {
+				cerr << "Error: failed to open statistics file " << statsFileName << endl;
+				return EXIT_FAILURE;
+			}
+		}
+		std::ostream* jsonStream = statsStream.is_open() ? &statsStream : (verbose ? &clog : 0);
+		StatsWriter statsWriter(jsonStream, countersFileName);
+
+		// Measure the quality of the coded pictures, if it is to be output, or
+		// decode them, for the decoded output. Pictures wait (in coding order), in
+		// their pooled buffers, until they are measured.
+		ofstream psnrStream;
+		if (!psnrFileName.empty()) {
+			psnrStream.open(psnrFileName.c_str(), ios_base::out);
+			if (!psnrStream) {
+				cerr << "Error: failed to open PSNR file " << psnrFileName << endl;
 				return EXIT_FAILURE;
 			}
 		}
+		std::ostream* psnrOut = (output == PSNR) ? &outStream : (psnrStream.is_open() ? &psnrStream : 0);
+		boost::scoped_ptr<QualityMonitor> qualityMonitor((psnrOut || (output == DECODED)) ?
+			new QualityMonitor(FrameBuffers(codedFormat, waveletDepth, ySlices, xSlices, shortCoeffs),
+			                   kernel, waveletDepth, qMatrix, bitDepth, lowDelay, (output == DECODED)) : 0);
+		std::deque<FrameBuffers*> measuring;
+		const unsigned int maxMeasuring = 4; // Pictures waiting before the encoder waits for the monitor
+
+		// The decoded sequence is written in the input's format: packed, Y4M (with
+		// the input's header, interlaced fields assembled into outFrame) or PPM.
+		Picture decodedPicture(output == DECODED ? codedFormat : PictureFormat());
+		Frame outFrame(output == DECODED ? pctFormat : PictureFormat(), interlaced, topFieldFirst);
+		if ((output == DECODED) && y4mInput) outStream << y4mFormat;
+
+		// VBR rate control, with the bit rate as a maximum. Transformed pictures
+		// wait (in coding order) until the look-ahead is full, or the input ends.
+		VBRRateControl vbrControl(vbrLookAhead, pictureBytes - prefixBytes);
+		std::deque<PendingPicture> pending;
+
+		// Encode each frame in turn (a PPM file contains a single frame)
+		for (bool endOfInput = false; !endOfInput; ++frame) {
+			// Pictures are numbered from 1, so a progressive picture has the frame number
+			const int firstPicture = fields*(frame - 1) + 1;
+			FrameStats stats[2] = { FrameStats(firstPicture), FrameStats(firstPicture + 1) };
+			FrameBuffers* buffers[2] = { &framePool.acquire(), (interlaced ? &framePool.acquire() : 0) };
+
+			// Read the next frame straight into the frame or pooled picture buffer
+			// (or, if packed, into the pooled transform buffer)
+			StageTimer readTimer(stats[0], instrumentation::READ);
+			Picture& inPicture = (interlaced ? framePicture : buffers[0]->picture);
+			if (packedInput) {
+				if (shortCoeffs) readPacked(input, inputFormat, height, width, buffers[0]->shortTransform);
+				else readPacked(input, inputFormat, height, width, buffers[0]->transform);
+			}
+			else if (y4mInput) {
+				readY4MFrame(input, y4mFormat, inPicture);
+			}
+			else if (frame == 1) {
+				//Read pixel data
+				input >> RGBArray;
+				// Convert RGB to YCbCr (BT.601), subsampling chroma as required
+				rgbToYCbCr(RGBArray, BT601, bits, inPicture);
+			}
+			readTimer.stop();
+			endOfInput = (!input || (!y4mInput && !packedInput && (frame > 1)));
+			if (endOfInput) {
+				for (int field = 0; field < fields; ++field) framePool.release(*buffers[field]);
+				if (frame == 1) {
+					cerr << "Failed to read the first frame from " << inFileName << endl;
+					return EXIT_FAILURE;
+				}
+				if (verbose) clog << "End of input reached after " << (frame - 1) << " frames" << endl;
+			}
+			else {
+				// Fields are measured against their own copy of the original, since
+				// the frame buffer is overwritten by the next frame
+				if (qualityMonitor && interlaced) {
+					for (int field = 0; field < fields; ++field) {
+						copy_field(framePicture, (topFieldFirst ? field : 1 - field), buffers[field]->picture);
+					}
+				}
+				// A packed picture's original is needed, before it is transformed in
+				// place, to measure its quality or to find the index for a target PSNR
+				if (packedInput && (qualityMonitor || (vbr && (vbrPSNR > 0.0)))) {
+					if (shortCoeffs) copy_unpadded(buffers[0]->shortTransform, buffers[0]->picture);
+					else copy_unpadded(buffers[0]->transform, buffers[0]->picture);
+				}
+				// Encode the picture, or both fields in field order, the fields as concurrent
+				// tasks (they are independent so need no synchronisation).
+				if (verbose) clog << "Transform, quantise and split into slices" << endl;
+				// Buffers in which to decode trial indices, when VBR targets a PSNR
+				FrameBuffers* scratch[2] = { 0, 0 };
+				if (vbr && (vbrPSNR > 0.0)) {
+					for (int field = 0; field < fields; ++field) scratch[field] = &framePool.acquire();
+				}
+				PictureEncoder firstEncoder(inPicture,
+				                            (interlaced ? (topFieldFirst ? 0 : 1) :
+				                             (packedInput ? PictureEncoder::paddedFrame : PictureEncoder::wholeFrame)),
+				                            kernel, waveletDepth, bitDepth, shortCoeffs,
+				                            qMatrix, bytes, sliceScalar, autoSliceScalar, lowDelay,
+				                            shareSliceBytes, minimiseDistortion, vbr, vbrQIndex, vbrPSNR, scratch[0],
+				                            scheduler, *buffers[0], stats[0]);
+				if (interlaced) {
+					PictureEncoder secondEncoder(inPicture, (topFieldFirst ? 1 : 0),
+					                             kernel, waveletDepth, bitDepth, shortCoeffs,
+					                             qMatrix, bytes, sliceScalar, autoSliceScalar, lowDelay,
+					                             shareSliceBytes, minimiseDistortion, vbr, vbrQIndex, vbrPSNR, scratch[1],
+					                             scheduler, *buffers[1], stats[1]);
+					TaskGroup fieldTasks(scheduler);
+					fieldTasks.run(boost::ref(firstEncoder));
+					fieldTasks.run(boost::ref(secondEncoder));
+					fieldTasks.wait();
+					if (!secondEncoder.error().empty()) throw std::runtime_error(secondEncoder.error());
+					if (!firstEncoder.error().empty()) throw std::runtime_error(firstEncoder.error());
+					// Queue the pictures in field order
+					pending.push_back(PendingPicture(*buffers[0], stats[0],
+					                                 firstEncoder.analysis(), firstEncoder.qualityIndex()));
+					pending.push_back(PendingPicture(*buffers[1], stats[1],
+					                                 secondEncoder.analysis(), secondEncoder.qualityIndex()));
+				}
+				else {
+					firstEncoder();
+					if (!firstEncoder.error().empty()) throw std::runtime_error(firstEncoder.error());
+					pending.push_back(PendingPicture(*buffers[0], stats[0],
+					                                 firstEncoder.analysis(), firstEncoder.qualityIndex()));
+				}
+				for (int field = 0; field < fields; ++field) {
+					if (scratch[field]) framePool.release(*scratch[field]);
+				}
+			}
 
-		// Choose quantisation indices to achieve a size of compressedBytes for the frame
-		if (verbose) clog << "Determine quantisation indices" << endl;
-		const int pictureBytes = (interlaced ? compressedBytes / 2 : compressedBytes);
-		// Calculate number of bytes for each slice
-		const Array2D bytes = slice_bytes(ySlices, xSlices, pictureBytes, sliceScalar);
-		Array2D qIndices = quantIndices(transform, qMatrix, bytes, sliceScalar);
+			// Write the pictures that are ready. CBR pictures are ready once encoded,
+			// VBR pictures when the look-ahead is full (or at the end of the input).
+			while (!pending.empty() &&
+			       (!vbr || endOfInput || (static_cast<int>(pending.size()) >= vbrLookAhead))) {
+				PendingPicture& picture = pending.front();
+				const FrameBuffers& pictureBuffers = *picture.buffers;
+				const int pictureNumber = picture.stats.frame();
+
+				if (vbr) {
+					// Choose the picture's index given those waiting, then quantise it
+					std::vector<const VBRAnalysis*> window;
+					std::vector<int> qualityIndices;
+					for (std::deque<PendingPicture>::const_iterator i = pending.begin(); i != pending.end(); ++i) {
+						window.push_back(&i->analysis);
+						qualityIndices.push_back(i->qualityIndex);
+					}
+					StageTimer rateControlTimer(picture.stats, instrumentation::RATE_CONTROL);
+					const int qIndex = vbrControl.qIndex(window, qualityIndices);
+					rateControlTimer.stop();
+					const int codedBytes = quantiseVBR(picture, qIndex, qMatrix, shortCoeffs, scheduler);
+					vbrControl.coded(codedBytes);
+					if (verbose) {
+						clog << "Picture " << pictureNumber << ": quality index " << picture.qualityIndex
+						     << ", coded with index " << qIndex << " in " << codedBytes << " bytes" << endl;
+					}
+				}
 
-		if (verbose) clog << "Quantise transform coefficients" << endl;
-		const Picture quantisedSlices = quantise_transform_np(transform, qIndices, qMatrix);
+				if (output == TRANSFORM) {
+					//Write transform output as 4 byte 2's comp values
+					clog << "Writing transform coefficients to output file" << endl;
+					outStream << pictureio::wordWidth(4); //4 bytes per sample
+					outStream << pictureio::signed_binary;
+					outStream << pictureBuffers.transform;
+					if (!outStream) {
+						cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+						return EXIT_FAILURE;
+					}
+				}
 
+				if (output == STREAM) {
+					const Slices& outSlices = pictureBuffers.slices;
+					const WrappedPicture outWrapped(pictureNumber,
+											kernel,
+											waveletDepth,
+											xSlices,
+											ySlices,
+											slicePrefix,
+											pictureBuffers.sliceScalar,
+											outSlices);
+					// LD pictures are wrapped in a data unit with their picture header
+					const WrappedPicture outWrappedLD(pictureNumber,
+											kernel,
+											waveletDepth,
+											xSlices,
+											ySlices,
+											sliceBytesNandD,
+											outSlices);
+
+					//Write packaged output
+					if (verbose) clog << "Writing compressed output to file" << endl;
+					StageTimer writeTimer(picture.stats, instrumentation::WRITE);
+					if (lowDelay) {
+						outStream << sliceio::lowDelay(bytes); // Write output in LD mode
+						outStream << outWrappedLD;
+					}
+					else if (vbr) {
+						outStream << dataunitio::highQualityVBR(sliceScalar, slicePrefix); // Write output in HQ VBR mode
+						outStream << outWrapped;
+					}
+					else {
+						// Slices are the sizes chosen for the picture, if sizes vary, else all the same
+						const Array2D& sliceSizes = ((shareSliceBytes || autoSliceScalar) ? pictureBuffers.sliceBytes : bytes);
+						outStream << dataunitio::highQualityCBR(sliceSizes, pictureBuffers.sliceScalar, slicePrefix); // Write output in HQ CBR mode
+						outStream << outWrapped;
+					}
+					outStream.flush();
+					writeTimer.stop();
+					if (!outStream) {
+						cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+						return EXIT_FAILURE;
+					}
+				}
 
-		// Split transform into slices
-		if (verbose) clog << "Split quantised coefficients into slices" << endl;
-		const PictureArray slices = split_into_blocks(quantisedSlices, ySlices, xSlices);
+				// Measure the picture's quality before its buffers are released
+				if (qualityMonitor) {
+					qualityMonitor->submit(pictureBuffers, pictureNumber);
+					measuring.push_back(picture.buffers);
+				}
+				else framePool.release(*picture.buffers);
+				statsWriter.record(picture.stats);
+				pending.pop_front();
+			}
 
-		int frame = 1;
-		if (output == STREAM) {
-			const int slicePrefix = 0;
-			const Slices outSlices(slices, waveletDepth, qIndices);
-			const WrappedPicture outWrapped(frame,
-									kernel,
-									waveletDepth,
-									xSlices,
-									ySlices,
-									slicePrefix,
-									sliceScalar,
-									outSlices);
-
-			//Write packaged output
-			if (verbose) clog << "Writing compressed output to file" << endl;
-			//for (int r = 0; r < bytes.shape()[0]; r++) {
-			//	for (int c = 0; c < bytes.shape()[1]; c++)
-			//		std::cout << bytes[r][c] << "\t";
-			//	std::cout << std::endl;
-			//}
-			outStream << dataunitio::highQualityCBR(bytes, sliceScalar); // Write output in HQ CBR mode
-			outStream << outWrapped;
-			if (!outStream) {
-				cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
-				return EXIT_FAILURE;
+			// Output the quality of the pictures measured so far, without waiting
+			// unless too many are waiting or the input has ended
+			if (qualityMonitor) {
+				PictureQuality quality;
+				const bool wait = endOfInput || (measuring.size() > maxMeasuring);
+				while ((output == DECODED) ? qualityMonitor->collect(quality, decodedPicture, wait)
+				                           : qualityMonitor->collect(quality, wait)) {
+					if (psnrOut) *psnrOut << quality << '\n';
+					if (verbose) clog << "Picture " << quality.picture << ": PSNR (dB) = " << quality.psnr() << endl;
+					framePool.release(*measuring.front());
+					measuring.pop_front();
+					if (output == DECODED) {
+						if (verbose) clog << "Writing decoded picture " << quality.picture << endl;
+						if (packedInput) writePacked(outStream, inputFormat, decodedPicture, bits);
+						else if (y4mInput) {
+							// Pictures are numbered from 1, so first fields are odd
+							if (!interlaced) writeY4MFrame(outStream, y4mFormat, decodedPicture);
+							else if (quality.picture % 2 != 0) outFrame.firstField(decodedPicture);
+							else {
+								outFrame.secondField(decodedPicture);
+								writeY4MFrame(outStream, y4mFormat, outFrame);
+							}
+						}
+						else {
+							outStream << "P6" << endl;
+							outStream << height << " " << width << endl;
+							outStream << ((1 << bits) - 1) << endl;
+							// Clip, upsample chroma, convert to RGB and pack a line at a time
+							const int lineBytes = 3 * width * nbytes;
+							std::vector<unsigned char> outLine(lineBytes);
+							for (int line = 0; line < height; ++line) {
+								yCbCrToRGB(decodedPicture, BT601, bits, line, nbytes, &outLine[0]);
+								outStream.write(reinterpret_cast<const char*>(&outLine[0]), lineBytes);
+							}
+						}
+						if (!outStream) {
+							cerr << "Failed to write output file \"" << outFileName << "\"" << endl;
+							return EXIT_FAILURE;
+						}
+					}
+				}
+				if (psnrOut) {
+					psnrOut->flush();
+					if (!*psnrOut) {
+						cerr << "Failed to write PSNR for picture " << quality.picture << endl;
+						return EXIT_FAILURE;
+					}
+				}
+				if (output == DECODED) outStream.flush();
 			}
-		}
+		} // end frame loop
 
-		cout << "Encode HQ CBR Done" << endl;
+		statsWriter.flush();
+
+	return EXIT_SUCCESS;
+}
+
+// Encodes a channel on its own thread, bound to the cores of its NUMA node, so
+// that its buffers are allocated on, and its tasks run on, that node.
+void runChannel(const Channel* channel, TaskScheduler* scheduler, const CoreSet* cores, int* result) {
+	bindThread(*cores);
+	try {
+		*result = encodeChannel(*channel, *scheduler, false);
+	}
+	catch (const std::exception& e) {
+		cerr << "Error: channel " << channel->inFileName << ": " << e.what() << endl;
+		*result = EXIT_FAILURE;
+	}
+}
+
+// Encodes every channel listed in a file (see readChannels) concurrently, in
+// one process. There is a scheduler for each NUMA node (e.g. socket) in use,
+// with a thread per core of the node, bound to the node. Channels are
+// assigned to nodes in turn, and share their node's scheduler, so the process
+// uses a fixed number of threads and its channels' data stay on their node.
+// Returns EXIT_FAILURE if any channel fails.
+int encodeChannels(const string& channelsFileName, bool verbose) {
+	std::ifstream channelsFile(channelsFileName.c_str());
+	if (!channelsFile) {
+		cerr << "Error: failed to open channels file " << channelsFileName << endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<Channel> channels;
+	try {
+		channels = readChannels(channelsFile);
+	}
+	catch (const std::invalid_argument& e) {
+		cerr << "Error: " << e.what() << " in " << channelsFileName << endl;
+		return EXIT_FAILURE;
+	}
+	if (channels.empty()) {
+		cerr << "Error: no channels in " << channelsFileName << endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<CoreSet> nodes = numaNodes();
+	if (nodes.size() > channels.size()) nodes.resize(channels.size());
+	std::vector<TaskScheduler*> schedulers;
+	for (unsigned int node = 0; node < nodes.size(); ++node) {
+		schedulers.push_back(new TaskScheduler(nodes[node]));
+		if (verbose) clog << "NUMA node " << node << ": " << nodes[node].size() << " threads" << endl;
+	}
+	std::vector<int> results(channels.size(), EXIT_FAILURE);
+	boost::thread_group channelThreads;
+	for (unsigned int c = 0; c < channels.size(); ++c) {
+		const int node = c % nodes.size();
+		if (verbose) clog << "Channel " << channels[c].inFileName << " -> " << channels[c].outFileName << " on node " << node << endl;
+		channelThreads.create_thread(boost::bind(&runChannel, &channels[c], schedulers[node], &nodes[node], &results[c]));
+	}
+	channelThreads.join_all();
+	for (std::vector<TaskScheduler*>::iterator s = schedulers.begin(); s != schedulers.end(); ++s) delete *s;
+	int failed = 0;
+	for (unsigned int c = 0; c < channels.size(); ++c) {
+		if (results[c] != EXIT_SUCCESS) ++failed;
+	}
+	if (verbose) clog << (channels.size() - failed) << " of " << channels.size() << " channels encoded" << endl;
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // end unnamed namespace
+
+int main(void) {
+
+		string inFileName = "D:/resource/history/TEST8.PPM";
+		string outFileName = "Haar1D1YUV422Bits10.drc";
+		// Multi-channel (server) mode: if this is not empty, encode every channel
+		// listed in this file (see readChannels), instead of the file above, in
+		// one process with shared threads and NUMA local buffers (see encodeChannels).
+		const string channelsFileName = "";
+		// Threads that share the work of coding (0 for one per core), optionally
+		// each pinned to its own core. (In multi-channel mode there is, instead,
+		// a thread per core of each NUMA node, bound to the node.)
+		const int threads = 0;
+		const bool pinThreads = false;
+		const bool verbose = 1;
+
+		if (!channelsFileName.empty()) return encodeChannels(channelsFileName, verbose);
+
+		Channel channel;
+		channel.inFileName = inFileName;
+		channel.outFileName = outFileName;
+		channel.compressedRate = 2.0;   // 2, 5, 8
+		// Per frame statistics. JSON lines go to the stats file (or, if empty, to
+		// the log when verbose). Counters are dumped to the counters file (if not
+		// empty) for monitoring. The quality (PSNR) of each picture goes to the
+		// PSNR file (see encodeChannel).
+		channel.statsFileName = "";
+		channel.countersFileName = "";
+		channel.psnrFileName = "";
+
+		TaskScheduler scheduler(threads, pinThreads);
+		if (verbose) clog << "threads = " << scheduler.threads() << (pinThreads ? " (pinned)" : "") << endl;
+		const int result = encodeChannel(channel, scheduler, verbose);
+
+		// Don't mix messages with the compressed output on standard output
+		if ((result == EXIT_SUCCESS) && (outFileName != "-")) cout << "Encode HQ CBR Done" << endl;
 #if 0
 		cout << "Please input any kety to exit :";
 		cin.get();
 #endif
 
-	return EXIT_SUCCESS;
+	return result;
 }
@@ -0,0 +1,63 @@
+/*********************************************************************/
+/* Arena.h                                                           */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares a simple "bump" allocator for short lived scratch        */
+/* storage, such as the temporaries used to code a single slice.     */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef ARENA_18OCT26
+#define ARENA_18OCT26
+
+#include <cstddef> // For size_t
+#include <vector>
+
+// A ScratchArena hands out blocks of ints by incrementing a pointer.
+// Individual allocations are never freed. Instead the whole arena is rolled
+// back, to a mark or to empty, when the temporaries are no longer needed
+// (e.g. after each slice). If the arena runs out of space it allocates a
+// further block and, when next emptied, replaces all its blocks with a single
+// block big enough for the high water mark. So after the first few slices no
+// further memory is allocated.
+// Each thread has its own arena (see "local") so no locking is needed.
+class ScratchArena {
+  public:
+    explicit ScratchArena(std::size_t initialSize=0); // initial size in ints
+    ~ScratchArena();
+    int* allocate(std::size_t n); // Get (uninitialised) space for n ints
+    std::size_t mark() const {return used;} // Position to roll back to
+    void release(std::size_t mark); // Free all allocations made since "mark"
+    void reset() {release(0);} // Free all allocations
+    const std::size_t capacity() const {return total;}
+    // The arena for the calling thread
+    static ScratchArena& local();
+  private:
+    ScratchArena(const ScratchArena&); //No copying
+    ScratchArena& operator=(const ScratchArena&); //No assignment
+    void coalesce();
+    struct Block {
+      int* data;
+      std::size_t size;
+      std::size_t start; // Offset of this block in the arena
+    };
+    std::vector<Block> blocks;
+    std::size_t used; // Ints allocated, including those wasted at the end of blocks
+    std::size_t total; // Sum of all block sizes
+};
+
+// Rolls the arena back, on destruction, to where it was on construction.
+// Use to scope slice temporaries: "ArenaScope scope(ScratchArena::local());"
+class ArenaScope {
+  public:
+    ArenaScope(ScratchArena& a): arena(a), position(a.mark()) {};
+    ~ArenaScope() {arena.release(position);}
+  private:
+    ArenaScope(const ArenaScope&); //No copying
+    ArenaScope& operator=(const ArenaScope&); //No assignment
+    ScratchArena& arena;
+    const std::size_t position;
+};
+
+#endif //ARENA_18OCT26
@@ -37,6 +37,13 @@ typedef Array2D::array_view<2>::type View2D;
 // ConstView2D is a constant view of a Array2D,
 typedef Array2D::const_array_view<2>::type ConstView2D;
 
+// ShortArray2D holds 16 bit samples, e.g. wavelet coefficients of 8 or 10 bit
+// video, which need half the memory (and memory bandwidth) of an Array2D.
+typedef boost::multi_array<short, 2> ShortArray2D;
+
+// ShortView2D is a view of a ShortArray2D
+typedef ShortArray2D::array_view<2>::type ShortView2D;
+
 // BlockVector is a 1D Array (i.e. vector) of 2D arrays (each element is, itself, a little 2D array)
 // A BlockVector may be used for storing an array of wavelet transform subbands (each subband is,
 // itself, a 2D array of coefficients).
@@ -70,6 +77,10 @@ const Array2D merge_blocks(const BlockArray& blocks);
 // Clip an array to specified limits
 const Array2D clip(const Array2D& values, const int min_value, const int max_value);
 
+// Version of clip that writes into a pre-allocated array of the same shape
+// (which may be "values" itself, to clip in place).
+void clip(const Array2D& values, const int min_value, const int max_value, Array2D& result);
+
 //**************** Array IO declarations ****************//
 
 namespace arrayio {
@@ -125,6 +136,18 @@ namespace arrayio {
   // Set data to be right justified within the data word
   std::istream& right_justified(std::istream& stream);
 
+  // Set words to be stored most significant byte first (the default)
+  std::ostream& big_endian(std::ostream& stream);
+
+  // Set words to be stored most significant byte first (the default)
+  std::istream& big_endian(std::istream& stream);
+
+  // Set words to be stored least significant byte first (e.g. Y4M files)
+  std::ostream& little_endian(std::ostream& stream);
+
+  // Set words to be stored least significant byte first (e.g. Y4M files)
+  std::istream& little_endian(std::istream& stream);
+
   // Set data format to offset binary
   std::ostream& offset_binary(std::ostream& stream);
 
@@ -0,0 +1,137 @@
+/*********************************************************************/
+/* BufferPool.h                                                      */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares pools of pre-allocated buffers so that the encoder and   */
+/* decoder can process a sequence of frames without allocating       */
+/* (multi-megabyte) pictures and coefficient arrays for every frame. */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef BUFFERPOOL_18OCT26
+#define BUFFERPOOL_18OCT26
+
+#include <vector>
+#include <stdexcept>
+
+#include "Arrays.h"
+#include "Picture.h"
+#include "Slices.h"
+
+// A pool of identical buffers, each made by a factory.
+// The factory is a (small) function object, of which "factory()" returns a new
+// buffer, allocated with new. It describes the buffers (e.g. their formats)
+// rather than being one, so the pool holds no buffer beyond those it hands out.
+// Buffers are acquired, used and then released back to the pool. If the pool
+// is exhausted a further buffer is made, so, once the pool has grown to the
+// maximum number of buffers simultaneously in use, no further memory is
+// allocated. The pool owns the buffers, which remain valid until the pool is
+// destroyed.
+template <class T, class Factory>
+class BufferPool {
+  public:
+    BufferPool(const Factory& factory, int count=1);
+    ~BufferPool();
+    T& acquire(); // Get an unused buffer from the pool
+    void release(T& buffer); // Return a buffer (obtained by "acquire") to the pool
+    const int size() const {return static_cast<int>(buffers.size());}
+    const int available() const {return static_cast<int>(unused.size());}
+  private:
+    BufferPool(const BufferPool&); //No copying
+    BufferPool& operator=(const BufferPool&); //No assignment
+    const Factory factory;
+    std::vector<T*> buffers; // All the buffers owned by the pool
+    std::vector<T*> unused; // Buffers available to be acquired
+};
+
+template <class T, class Factory>
+BufferPool<T, Factory>::BufferPool(const Factory& f, int count):
+  factory(f) {
+  if (count<0) throw std::invalid_argument("BufferPool size must not be negative");
+  buffers.reserve(count);
+  unused.reserve(count);
+  for (int i=0; i<count; ++i) {
+    buffers.push_back(factory());
+    unused.push_back(buffers.back());
+  }
+}
+
+template <class T, class Factory>
+BufferPool<T, Factory>::~BufferPool() {
+  for (typename std::vector<T*>::iterator i=buffers.begin(); i!=buffers.end(); ++i) {
+    delete *i;
+  }
+}
+
+template <class T, class Factory>
+T& BufferPool<T, Factory>::acquire() {
+  if (unused.empty()) {
+    // Grow the pool (only happens until the high water mark is reached)
+    buffers.push_back(factory());
+    unused.reserve(buffers.size());
+    return *buffers.back();
+  }
+  T* const buffer = unused.back();
+  unused.pop_back();
+  return *buffer;
+}
+
+template <class T, class Factory>
+void BufferPool<T, Factory>::release(T& buffer) {
+  if (unused.size()>=buffers.size()) {
+    throw std::logic_error("BufferPool: released more buffers than were acquired");
+  }
+  unused.push_back(&buffer);
+}
+
+// The set of buffers needed to encode, or decode, one picture.
+// Buffer sizes are derived from the picture format and the wavelet padding.
+// All the working storage for a picture is allocated on construction, the
+// in place versions of waveletTransform, quantise_transform_np,
+// split_into_blocks (and their inverses) then write into these buffers
+// without allocating memory.
+// If "shortCoefficients" is true the wavelet transform is held, with 16 bit
+// coefficients, in shortTransform and "transform" is left empty. Otherwise
+// shortTransform is empty.
+class FrameBuffers {
+  public:
+    FrameBuffers(const PictureFormat& format, int waveletDepth, int ySlices, int xSlices,
+                 bool shortCoefficients=false);
+    const PictureFormat& format() const {return pictureFormat;}
+    const PictureFormat& transformFormat() const {return coeffsFormat;}
+    const bool hasShortTransform() const {return shortCoeffs;}
+    Picture picture;   // Uncompressed picture (encoder input or decoder output)
+    Picture transform; // Wavelet transform of the picture (padded)
+    ShortPicture shortTransform; // 16 bit wavelet transform of the picture (padded)
+    Picture quantised; // Quantised wavelet coefficients (padded)
+    Slices slices;     // Quantised coefficients split into slices, with their qIndices
+    Array2D sliceBytes; // Size of each slice, if sizes vary (see pictureQuantIndices)
+    int sliceScalar;    // HQ slice size scalar, if it varies between pictures
+  private:
+    PictureFormat pictureFormat;
+    PictureFormat coeffsFormat;
+    bool shortCoeffs;
+};
+
+// Makes the FrameBuffers for a FramePool, from the same parameters as the
+// FrameBuffers constructor
+class FrameBuffersFactory {
+  public:
+    FrameBuffersFactory(const PictureFormat& format, int waveletDepth, int ySlices, int xSlices,
+                        bool shortCoefficients=false);
+    FrameBuffers* operator()() const;
+  private:
+    PictureFormat pictureFormat;
+    int waveletDepth;
+    int ySlices;
+    int xSlices;
+    bool shortCoeffs;
+};
+
+typedef BufferPool<FrameBuffers, FrameBuffersFactory> FramePool;
+
+// Format of the (padded) wavelet transform of a picture
+const PictureFormat paddedFormat(const PictureFormat& format, int waveletDepth);
+
+#endif //BUFFERPOOL_18OCT26
@@ -0,0 +1,62 @@
+/*********************************************************************/
+/* ColourConversion.h                                                */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares conversion between RGB and YCbCr, with chroma            */
+/* subsampling and upsampling.                                       */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef COLOURCONVERSION_18OCT26
+#define COLOURCONVERSION_18OCT26
+
+#include <iosfwd>
+
+#include "Arrays.h"
+#include "Picture.h"
+
+// The colour matrices of ITU-R BT.601, BT.709 and BT.2020 (non-constant luminance)
+enum ColourMatrix {BT601, BT709, BT2020};
+
+std::ostream& operator<<(std::ostream& os, ColourMatrix matrix);
+
+std::istream& operator>>(std::istream& strm, ColourMatrix& matrix);
+
+// Converts full range RGB, with samples in the range 0 to 2**bitDepth-1, to
+// video range YCbCr of the same bit depth and writes it, in place, into
+// "picture". The picture's colour format determines the chroma subsampling.
+// "rgb" holds one picture line per row, with samples ordered R, G, B, R, ...
+// (i.e. it is lumaHeight rows by 3*lumaWidth columns).
+// Chroma is subsampled with a [1,2,1]/4 filter, co-sited with the even luma
+// samples (horizontally and, for 4:2:0, vertically). Outside the picture
+// the colour difference signals are taken to be zero.
+// Each line is processed while it is in cache. It is first separated into R,
+// G and B lines (the only strided loop), then matrixed and subsampled by
+// simple loops over contiguous samples, which an optimising compiler (e.g.
+// g++ -O3) vectorises.
+// If the picture format is RGB the components are just separated.
+// bitDepth must be in the range 8 to 16. The coefficients have (up to 14 bit)
+// the same precision as the samples, so 8 bit conversion is identical to the
+// original EncodeHQ-CBR conversion.
+void rgbToYCbCr(const Array2D& rgb, ColourMatrix matrix, int bitDepth, Picture& picture);
+
+// As above but returns a new picture of the specified colour format
+const Picture rgbToYCbCr(const Array2D& rgb, ColourMatrix matrix, int bitDepth, ColourFormat format);
+
+// Converts one line of a video range YCbCr picture to full range RGB and
+// packs it, R, G, B, R, ..., into "out" with "bytes" (1 or 2) bytes per
+// sample, most significant byte first (as in a PPM file). So "out" must have
+// space for 3*bytes*lumaWidth bytes.
+// The components are clipped to 0 to 2**bitDepth-1 and chroma is upsampled
+// (the inverse of rgbToYCbCr): co-sited samples are copied and the others
+// are the average of their neighbours, taking the colour difference to be
+// zero outside the picture. Clipping, upsampling, matrixing and packing are
+// done in a single pass over the line, without intermediate pictures.
+// If the picture format is RGB the components are just clipped and packed.
+// bitDepth must be in the range 8 to 16. 8 bit BT.601 conversion is identical
+// to the original DecodeHQ conversion.
+void yCbCrToRGB(const Picture& picture, ColourMatrix matrix, int bitDepth,
+                int line, int bytes, unsigned char* out);
+
+#endif //COLOURCONVERSION_18OCT26
@@ -66,7 +66,9 @@ class WrappedPicture {
     int slice_prefix;
     int slice_size_scalar;
     utils::Rational slice_bytes;
-    Slices slices;
+    // Reference, not a copy, to avoid copying every slice of the picture.
+    // The Slices must therefore outlive the WrappedPicture.
+    const Slices& slices;
 };
 
 enum FrameRate { FR0, FR24000_1001, FR24, FR25, FR30000_1001, FR30, FR50, FR60000_1001, FR60, FR15000_1001, FR25_2, FR48 };
@@ -0,0 +1,141 @@
+/*********************************************************************/
+/* Instrumentation.h                                                 */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares lightweight per frame timing and counters for the        */
+/* encoder and decoder, exported as JSON lines and a counter dump.   */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef INSTRUMENTATION_18OCT26
+#define INSTRUMENTATION_18OCT26
+
+#include <iosfwd>
+#include <string>
+#include <map>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "Arrays.h"
+
+namespace instrumentation {
+
+  // The processing stages that are timed
+  enum Stage {READ, TRANSFORM, RATE_CONTROL, QUANTISE, SLICE_PACK, WRITE,
+              SLICE_UNPACK, INVERSE_QUANTISE, INVERSE_TRANSFORM};
+
+  const int numberOfStages = INVERSE_TRANSFORM+1;
+
+  // Name of a stage as used in the output, e.g. "rate_control"
+  const char* stageName(Stage stage);
+
+  std::ostream& operator<<(std::ostream& os, Stage stage);
+
+  // Statistics for a single frame.
+  // Stage times are accumulated, so a stage may be timed in several pieces.
+  class FrameStats {
+    public:
+      explicit FrameStats(int frame);
+      void addTime(Stage stage, double seconds);
+      // Record the slices of a frame. "sliceBytes" are the bytes allocated to
+      // each slice and "codedBytes" the bytes needed to code each slice; the
+      // difference is padding. Either byte array may be empty if not known.
+      void slices(const Array2D& qIndices,
+                  const Array2D& sliceBytes,
+                  const Array2D& codedBytes);
+      const int frame() const {return frameNumber;}
+      const bool timed(Stage stage) const {return stageTimed[stage];}
+      const double seconds(Stage stage) const {return stageSeconds[stage];}
+      const int numberOfSlices() const {return sliceCount;}
+      const int minSliceBytes() const {return minBytes;}
+      const int maxSliceBytes() const {return maxBytes;}
+      const long long totalSliceBytes() const {return totalBytes;}
+      const bool paddingKnown() const {return codedKnown;}
+      const long long paddingBytes() const {return padding;} // 0 if not known
+      // Number of slices using each quantisation index
+      const std::map<int, int>& qIndexHistogram() const {return histogram;}
+    private:
+      int frameNumber;
+      bool stageTimed[numberOfStages];
+      double stageSeconds[numberOfStages];
+      int sliceCount;
+      int minBytes;
+      int maxBytes;
+      long long totalBytes;
+      long long padding;
+      bool codedKnown;
+      std::map<int, int> histogram;
+  };
+
+  // Writes the frame statistics as a single line of JSON (without newline), e.g.
+  // {"frame":1,"stages_ms":{"read":1.2,...},"slices":8160,"slice_bytes":{...},
+  //  "padding_bytes":12,"qindex":{"min":4,"mean":5.1,"max":6,"histogram":[[4,10],...]}}
+  std::ostream& operator<<(std::ostream& os, const FrameStats& stats);
+
+  // Adds the time from construction to "stop" (or to destruction, if not
+  // stopped) to a stage of a frame.
+  // Use to time a block: "StageTimer timer(stats, TRANSFORM);"
+  class StageTimer {
+    public:
+      StageTimer(FrameStats& s, Stage st);
+      ~StageTimer();
+      void stop();
+    private:
+      StageTimer(const StageTimer&); //No copying
+      StageTimer& operator=(const StageTimer&); //No assignment
+      FrameStats& stats;
+      const Stage stage;
+      const boost::posix_time::ptime start;
+      bool running;
+  };
+
+  // Running totals over all frames recorded so far
+  class Counters {
+    public:
+      Counters();
+      void add(const FrameStats& stats);
+      const int frames() const {return frameCount;}
+    private:
+      friend std::ostream& operator<<(std::ostream& os, const Counters& counters);
+      int frameCount;
+      int stageCount[numberOfStages];
+      double stageTotal[numberOfStages];
+      double stageMax[numberOfStages];
+      long long sliceCount;
+      long long totalBytes;
+      long long padding;
+      std::map<int, long long> histogram;
+  };
+
+  // Writes the counters as text, one "name{labels} value" counter per line,
+  // in a form that monitoring systems can scrape.
+  std::ostream& operator<<(std::ostream& os, const Counters& counters);
+
+  // Exports frame statistics.
+  // Each frame is written as a JSON line to "jsonStream" (if not null).
+  // Every "period" frames, and on flush, the counters are written to the file
+  // "countersFileName" (if not empty). The file is replaced as a whole, so a
+  // scraper never sees a partial dump.
+  class StatsWriter {
+    public:
+      StatsWriter(std::ostream* jsonStream,
+                  const std::string& countersFileName,
+                  int period=25);
+      ~StatsWriter();
+      void record(const FrameStats& stats);
+      void flush();
+      const Counters& counters() const {return totals;}
+    private:
+      StatsWriter(const StatsWriter&); //No copying
+      StatsWriter& operator=(const StatsWriter&); //No assignment
+      std::ostream* json;
+      const std::string countersFile;
+      const int period;
+      Counters totals;
+      int unflushed;
+  };
+
+} // end namespace instrumentation
+
+#endif //INSTRUMENTATION_18OCT26
@@ -0,0 +1,33 @@
+/*********************************************************************/
+/* Numa.h                                                            */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares the NUMA topology of the machine (the cores of each      */
+/* node, e.g. socket) and binding of threads to a node.              */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef NUMA_18OCT26
+#define NUMA_18OCT26
+
+#include <string>
+#include <vector>
+
+typedef std::vector<int> CoreSet;
+
+// The cores of each NUMA node of the machine (from /sys/devices/system/node
+// on Linux). Nodes without cores (memory only) are omitted. Elsewhere, or if
+// the topology cannot be read, there is a single node with every core.
+const std::vector<CoreSet> numaNodes();
+
+// Parses a Linux CPU list, e.g. "0-3,8-11", into its cores.
+const CoreSet parseCoreList(const std::string& list);
+
+// Restricts the calling thread to run on the given cores (Linux only,
+// elsewhere it is ignored). Linux allocates memory on the node of the core
+// that first touches it, so buffers allocated (and zeroed) by a thread bound
+// to a node are local to that node.
+void bindThread(const CoreSet& cores);
+
+#endif //NUMA_18OCT26
@@ -0,0 +1,73 @@
+/*********************************************************************/
+/* PackedIO.h                                                        */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares reading and writing of packed video formats (UYVY, v210  */
+/* and P010) directly from/to picture or transform buffers.          */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef PACKEDIO_18OCT26
+#define PACKEDIO_18OCT26
+
+#include <iosfwd>
+
+#include "Picture.h"
+
+// Packed video formats, as produced by capture cards:
+//   UYVY  8 bit 4:2:2, bytes ordered Cb, Y, Cr, Y
+//   V210  10 bit 4:2:2, 6 pixels in four 32 bit little endian words,
+//         lines padded to a multiple of 128 bytes
+//   P010  10 bit 4:2:0, 16 bit little endian words with the data in the
+//         most significant bits; a luma plane followed by a plane of
+//         interleaved Cb, Cr
+enum PackedFormat {UYVY, V210, P010};
+
+std::ostream& operator<<(std::ostream& os, PackedFormat format);
+
+std::istream& operator>>(std::istream& strm, PackedFormat& format);
+
+// Colour format of the pictures in a packed format
+const ColourFormat packedColourFormat(PackedFormat format);
+
+// Bit depth of the samples in a packed format
+const int packedBitDepth(PackedFormat format);
+
+// Number of bytes in one picture in a packed format
+const int packedPictureBytes(PackedFormat format, int height, int width);
+
+// Read a picture, of height by width luma samples, from a packed format.
+// The samples are unpacked, a line at a time, straight into the top left of
+// the components of "picture" (no intermediate planes). The components may be
+// bigger than the picture, e.g. the (padded) transform buffers of a
+// FrameBuffers, in which case the rest of each component is filled by edge
+// extension, exactly as waveletPad would. So the picture is ready for
+// paddedWaveletTransform (see WaveletTransform.h) without further copying.
+// Throws std::invalid_argument if the components are too small or the size
+// is not valid for the format. If the stream ends before the picture is
+// complete the stream's failbit is set (as for other stream input).
+std::istream& readPacked(std::istream& stream, PackedFormat format,
+                         int height, int width, Picture& picture);
+
+// As above, into 16 bit components (for the 16 bit transforms)
+std::istream& readPacked(std::istream& stream, PackedFormat format,
+                         int height, int width, ShortPicture& picture);
+
+// Write a picture in a packed format, packing each line straight from the
+// components (no intermediate planes or repacking step).
+// Samples are clipped to the range 0 to 2**bitDepth-1 and, if the format has
+// a different bit depth, rounded (or shifted up) to the format's depth.
+// The picture must have the format's colour format (4:2:2 for UYVY and
+// v210, 4:2:0 for P010) or std::invalid_argument is thrown. v210 samples
+// beyond the end of a line, and the line padding, are written as zero.
+std::ostream& writePacked(std::ostream& stream, PackedFormat format,
+                          const Picture& picture, int bitDepth);
+
+// Write a picture as planar 16 bit samples, most significant byte first and
+// left (MSB) justified, i.e. the planar format read by EncodeHQ-CBR with 2
+// bytes per sample. Samples are clipped to the range 0 to 2**bitDepth-1.
+// Any colour format may be written.
+std::ostream& writePlanar16(std::ostream& stream, const Picture& picture, int bitDepth);
+
+#endif //PACKEDIO_18OCT26
@@ -14,6 +14,8 @@
 
 #include "Arrays.h"
 
+class TaskScheduler; // See TaskScheduler.h
+
 enum ColourFormat {UNKNOWN, CF444, CF422, CF420, RGB}; //UNKOWN needed for PictureFormat default constructor
 
 std::ostream& operator<<(std::ostream& os, ColourFormat format);
@@ -60,6 +62,11 @@ public:
   const Array2D& y() const;
   const Array2D& c1() const;
   const Array2D& c2() const;
+  // Non-const access allows components to be written in place (e.g. pooled buffers).
+  // The shape of the components must not be changed.
+  Array2D& y();
+  Array2D& c1();
+  Array2D& c2();
   void y(const Array2D&);
   void c1(const Array2D&);
   void c2(const Array2D&);
@@ -69,6 +76,25 @@ protected:
   friend std::istream& operator >> (std::istream&, Picture&);
 };
 
+// A picture with 16 bit components. Used for the wavelet transforms of 8 and
+// 10 bit video, whose coefficients fit in 16 bits (see shortCoefficients in
+// WaveletTransform.h), to halve the memory traffic of transform and quantisation.
+class ShortPicture {
+public:
+  ShortPicture();
+  ShortPicture(const PictureFormat&);
+  PictureFormat format() const;
+  const ShortArray2D& y() const;
+  const ShortArray2D& c1() const;
+  const ShortArray2D& c2() const;
+  ShortArray2D& y();
+  ShortArray2D& c1();
+  ShortArray2D& c2();
+private:
+  PictureFormat picFormat;
+  ShortArray2D luma, chroma1, chroma2;
+};
+
 typedef boost::multi_array<Picture, 2> PictureArray;
 
 // Get the shape of a PictureArray
@@ -78,6 +104,17 @@ const PictureArray split_into_blocks(const Picture& picture, int ySlices, int xS
 
 const Picture merge_blocks(const PictureArray& blocks);
 
+// Versions of split_into_blocks and merge_blocks that write into pre-allocated
+// outputs. No memory is allocated provided the outputs are already the right shape.
+void split_into_blocks(const Picture& picture, PictureArray& slices);
+
+void merge_blocks(const PictureArray& blocks, Picture& picture);
+
+// Versions that copy rows of slices concurrently, as tasks of a scheduler
+void split_into_blocks(const Picture& picture, PictureArray& slices, TaskScheduler& scheduler);
+
+void merge_blocks(const PictureArray& blocks, Picture& picture, TaskScheduler& scheduler);
+
 // Clip a Picture to specified limits
 // First function clips all components to the same values (good for RGB)
 const Picture clip(const Picture& picture, const int min_value, const int max_value);
@@ -85,6 +122,13 @@ const Picture clip(const Picture& picture, const int min_value, const int max_va
 const Picture clip(const Picture& picture,
                    const int luma_min, const int luma_max,
                    const int chroma_min, const int chroma_max);
+// Versions of clip that write into a pre-allocated picture of the same format
+// (which may be "picture" itself, to clip a pooled picture in place).
+void clip(const Picture& picture, const int min_value, const int max_value, Picture& result);
+void clip(const Picture& picture,
+          const int luma_min, const int luma_max,
+          const int chroma_min, const int chroma_max,
+          Picture& result);
 
 //**** Picture IO declarations ****//
 
@@ -93,6 +137,8 @@ namespace pictureio {
   // Use same io manipulators as in ArrayIO.h
   using arrayio::left_justified;
   using arrayio::right_justified;
+  using arrayio::big_endian;
+  using arrayio::little_endian;
   using arrayio::offset_binary;
   using arrayio::signed_binary;
   using arrayio::unsigned_binary;
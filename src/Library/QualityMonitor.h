@@ -0,0 +1,110 @@
+/*********************************************************************/
+/* QualityMonitor.h                                                  */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares measurement, in the encoder, of the quality of coded     */
+/* pictures: reconstruction from the quantised coefficients on a     */
+/* worker thread, and per component PSNR.                            */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef QUALITYMONITOR_18OCT26
+#define QUALITYMONITOR_18OCT26
+
+#include <iosfwd>
+#include <deque>
+#include <string>
+
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+#include "Arrays.h"
+#include "Picture.h"
+#include "WaveletTransform.h"
+#include "BufferPool.h"
+
+// The quality of one decoded picture, per component (0 luma, 1 and 2 chroma)
+struct PictureQuality {
+  PictureQuality();
+  int picture; // Picture number
+  int bitDepth;
+  double squaredError[3];
+  double samples[3];
+  const double mse(int component) const;
+  const double psnr(int component) const;
+  const double psnr() const; // Over all components
+};
+
+// Writes the quality as a single line of JSON (without newline), e.g.
+// {"picture":1,"mse":{"y":1.25,"c1":0.5,"c2":0.5},"psnr":{"y":47.2,"c1":51.1,"c2":51.1,"yuv":48.6}}
+// An infinite PSNR (lossless coding) is written as null.
+std::ostream& operator<<(std::ostream& os, const PictureQuality& quality);
+
+// Copy one field (0 top, 1 bottom) of a frame into a picture of the field's size
+void copy_field(const Picture& frame, int field, Picture& picture);
+
+// Copy a picture out of the top left of (padded) transform buffers, e.g. a
+// picture read straight into them (see PackedIO.h), before they are transformed
+void copy_unpadded(const Picture& padded, Picture& picture);
+
+void copy_unpadded(const ShortPicture& padded, Picture& picture);
+
+// Measures the quality of the pictures coded by the encoder, as a decoder would
+// reconstruct them, without parsing the stream. The encoder's quantised
+// coefficients (buffers.quantised, with buffers.slices.qIndices) are inverse
+// quantised and inverse transformed, into the monitor's own buffers, and
+// compared with the original picture (buffers.picture).
+// Pictures are measured in turn on a worker thread, so that encoding carries
+// on meanwhile. The buffers of a submitted picture must not be changed, or
+// released to their pool, until its quality has been collected.
+// If "keepDecoded" each reconstruction is also kept, until collected, so the
+// encoder can output the decoded sequence.
+// Exceptions on the worker thread are thrown, as std::runtime_error, by collect.
+class QualityMonitor {
+  public:
+    QualityMonitor(const FrameBuffers& prototype, // Shape of the buffers to measure
+                   WaveletKernel kernel, int waveletDepth,
+                   const Array1D& qMatrix, int bitDepth,
+                   bool lowDelay, // LD pictures are quantised with LL prediction
+                   bool keepDecoded=false);
+    ~QualityMonitor(); // Finishes the pictures submitted, then stops the thread
+    void submit(const FrameBuffers& buffers, int pictureNumber);
+    // Gets the quality of the next picture, in the order submitted. Returns
+    // false, if "wait" is false and it has not been measured yet, or if no
+    // pictures are outstanding.
+    const bool collect(PictureQuality& quality, bool wait);
+    // As above, also getting the picture as decoded, clipped to the bit depth,
+    // into "decoded" (which must have the format of the pictures measured).
+    // Requires keepDecoded.
+    const bool collect(PictureQuality& quality, Picture& decoded, bool wait);
+    const int outstanding() const; // Pictures submitted but not yet collected
+  private:
+    QualityMonitor(const QualityMonitor&); //No copying
+    QualityMonitor& operator=(const QualityMonitor&); //No assignment
+    void run(); // The worker thread
+    void measure(const FrameBuffers& buffers, PictureQuality& quality);
+    struct Job {
+      const FrameBuffers* buffers;
+      int picture;
+    };
+    FrameBuffers scratch; // Reconstructed transform and picture
+    const WaveletKernel kernel;
+    const int waveletDepth;
+    const Array1D qMatrix;
+    const int bitDepth;
+    const bool lowDelay;
+    const bool keepDecoded;
+    mutable boost::mutex mutex;
+    boost::condition_variable changed;
+    std::deque<Job> jobs;
+    std::deque<PictureQuality> results;
+    std::deque<Picture> decodedPictures; // If keepDecoded, one per result
+    int submitted; // Pictures not yet collected
+    bool stopping;
+    std::string error;
+    boost::thread worker; // Must be constructed last
+};
+
+#endif //QUALITYMONITOR_18OCT26
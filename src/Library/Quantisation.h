@@ -13,6 +13,12 @@
 #include "Arrays.h"
 #include "Picture.h"
 
+class TaskScheduler; // See TaskScheduler.h
+
+// Largest quantisation index for rate control to use. Larger indices have
+// quantisation factors that do not fit in an int (see quant_factor).
+const int maxQuantIndex = 107;
+
 const int adjust_quant_index(const int qIndex, const int qMatrix);
 
 const Array1D adjust_quant_indices(const Array1D& qIndices, const int qMatrix);
@@ -51,6 +57,15 @@ const Array2D inverse_quantise_block(const ConstView2D& block, const Array2D& qI
 // from its neighbours above and to the left.
 const int predictDC(const Array2D& llSubband, int y, int x);
 
+// Quantise n coefficients of one row of an LL subband, with DC prediction (as
+// predictDC) and quantisation index q, for rate control. "above" is the row of
+// restored (inverse quantised) coefficients above (null for the top row) and
+// "restored" receives the restored coefficients of this row. If "leftEdge" is
+// false, restored[-1] must be the restored coefficient to the left.
+// There are no divisions (dividing by 3 is done by multiply and shift).
+void quantise_LL_row(const int* coeffs, int* quantised, int n, int q,
+                     const int* above, int* restored, bool leftEdge);
+
 // Quantise in-place transformed coefficients (using LL subband prediction)
 const Array2D quantise_transform(const Array2D& coefficients,
                                  const Array2D& qIndices,
@@ -77,6 +92,31 @@ const Array2D inverse_quantise_transform_np(const Array2D& qCoeffs,
                                              const Array2D& qIndices,
                                              const Array1D& qMatrix);
 
+// Versions of the above that write into a pre-allocated array (e.g. from a BufferPool).
+// "result" is only reallocated if it is not the same shape as the input.
+void quantise_transform_np(const Array2D& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Array2D& result);
+
+void inverse_quantise_transform_np(const Array2D& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Array2D& result);
+
+// 16 bit versions (see shortCoefficients in WaveletTransform.h).
+// The quantised coefficients are stored as ints, as they are in the slices.
+// Inverse quantisation throws std::overflow_error if a value does not fit in 16 bits.
+void quantise_transform_np(const ShortArray2D& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Array2D& result);
+
+void inverse_quantise_transform_np(const Array2D& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortArray2D& result);
+
 // Quantise in-place transformed coefficients (using LL subband prediction)
 const Picture quantise_transform(const Picture& coefficients,
                                  const int qIndex,
@@ -113,4 +153,102 @@ const Picture inverse_quantise_transform_np(const Picture& qCoeffs,
                                             const Array2D& qIndices,
                                             const Array1D& qMatrix);
 
+// Picture versions writing into pre-allocated pictures
+void quantise_transform_np(const Picture& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result);
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Picture& result);
+
+// Picture versions of the 16 bit functions
+void quantise_transform_np(const ShortPicture& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result);
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortPicture& result);
+
+// Concurrent versions of the Picture functions above, run on a scheduler (see
+// TaskScheduler.h). The components are quantised concurrently, each in stripes
+// of rows of slices. The results are the same as the serial versions.
+void quantise_transform_np(const Picture& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result,
+                           TaskScheduler& scheduler);
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Picture& result,
+                                   TaskScheduler& scheduler);
+
+void quantise_transform_np(const ShortPicture& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result,
+                           TaskScheduler& scheduler);
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortPicture& result,
+                                   TaskScheduler& scheduler);
+
+/***** Pre-allocated Predictive Quantisation for Low Delay Profile *****/
+
+// Versions of quantise_transform and inverse_quantise_transform (using LL subband
+// prediction) that write into pre-allocated arrays, like the _np versions above.
+// The results are the same as the allocating versions. The restored LL subband,
+// needed for prediction, is held in the thread's scratch arena.
+void quantise_transform(const Array2D& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Array2D& result);
+
+void inverse_quantise_transform(const Array2D& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                Array2D& result);
+
+// 16 bit versions (inverse quantisation throws std::overflow_error if a value
+// does not fit in 16 bits)
+void quantise_transform(const ShortArray2D& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Array2D& result);
+
+void inverse_quantise_transform(const Array2D& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                ShortArray2D& result);
+
+// Picture versions
+void quantise_transform(const Picture& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Picture& result);
+
+void inverse_quantise_transform(const Picture& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                Picture& result);
+
+void quantise_transform(const ShortPicture& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Picture& result);
+
+void inverse_quantise_transform(const Picture& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                ShortPicture& result);
+
 #endif //QUANTISATION_14MAY10
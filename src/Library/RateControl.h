@@ -0,0 +1,121 @@
+/*********************************************************************/
+/* RateControl.h                                                     */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares variable bit rate (VBR) rate control: a first pass that  */
+/* measures each picture's rate and quality, and a look-ahead that   */
+/* shares a maximum bit rate between pictures.                       */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef RATECONTROL_18OCT26
+#define RATECONTROL_18OCT26
+
+#include <vector>
+#include <deque>
+
+#include "Arrays.h"
+#include "Picture.h"
+#include "WaveletTransform.h"
+#include "BufferPool.h"
+#include "Quantisation.h"
+
+/***** Picture quality *****/
+
+// Sum of the squared differences between a decoded component and the
+// original. Decoded samples are clipped to the range 0 to 2**bitDepth-1, as
+// they would be on output. If "field" is 0 or 1 the decoded component is that
+// field of the original frame (original lines 2*y+field), otherwise (e.g. -1)
+// it is the same size as the original.
+const double squared_error(const Array2D& original, int field,
+                           const Array2D& decoded, int bitDepth);
+
+// Peak signal to noise ratio, in dB, for a squared error over a number of
+// samples. Infinite if the squared error is 0.
+const double psnr(double squaredError, double samples, int bitDepth);
+
+// PSNR of a decoded picture (or field), over all components
+const double psnr(const Picture& original, int field, const Picture& decoded, int bitDepth);
+
+/***** Variable bit rate *****/
+
+// The first pass of VBR coding: the rate of one picture, in HQ VBR slices,
+// for any quantisation index (i.e. the picture's rate curve).
+// Each slice uses the picture's index unless one of its components would be
+// too big for the one byte length of an HQ VBR slice (255*scalar bytes), in
+// which case it uses the smallest index at which the slice can be coded.
+// The rate for an index is calculated (with HQSliceSizer) the first time it
+// is asked for and remembered, so a look-ahead may ask repeatedly.
+// The transform is referenced, not copied, so it must remain valid (e.g. in
+// its pooled buffers) while the analysis is used.
+class VBRAnalysis {
+  public:
+    VBRAnalysis(); // Empty, e.g. to be assigned later
+    VBRAnalysis(const Picture& transform,
+                int ySlices, int xSlices, // Number of slices
+                const Array1D& qMatrix,
+                int scalar);
+    // Same, for a 16 bit transform
+    VBRAnalysis(const ShortPicture& transform,
+                int ySlices, int xSlices,
+                const Array1D& qMatrix,
+                int scalar);
+    // Bytes to code the picture's slices (including the 4 byte slice overheads)
+    const int bytes(int qIndex) const;
+    // Quantisation index and bytes for each slice when coded with qIndex
+    void quantIndices(int qIndex, Array2D& qIndices, Array2D& sliceBytes) const;
+    // PSNR of the picture when coded with qIndex. The picture is quantised,
+    // inverse quantised and inverse transformed in "scratch", buffers of the
+    // same shape as the picture's, and compared with the original (see psnr).
+    const double psnr(int qIndex, const Picture& original, int field,
+                      WaveletKernel kernel, int bitDepth,
+                      FrameBuffers& scratch) const;
+  private:
+    template <class Transform> void analyse(const Transform& transform);
+    template <class Transform> const int pictureBytes(const Transform& transform, int qIndex) const;
+    const Picture* transform;
+    const ShortPicture* shortTransform;
+    const Array1D* qMatrix;
+    int ySlices;
+    int xSlices;
+    int scalar;
+    Array2D minIndices; // Smallest index at which each slice can be coded
+    mutable std::vector<int> curve; // Bytes for each index, or -1 if not known
+};
+
+// Largest quantisation index for which the picture reaches a PSNR target
+// (a binary search, so PSNR is assumed to fall as the index rises).
+// Returns 0 if the target cannot be reached. See VBRAnalysis::psnr.
+const int psnrQIndex(const VBRAnalysis& analysis, double targetPSNR,
+                     const Picture& original, int field,
+                     WaveletKernel kernel, int bitDepth,
+                     FrameBuffers& scratch);
+
+// Chooses the quantisation index of each picture, in coding order, for VBR.
+// Each picture has a quality index, the largest index that meets the quality
+// target. A picture is coded at its quality index unless that would exceed
+// the maximum bit rate, so simple pictures use fewer bytes than complex ones.
+// The rate is limited over a window of "lookAhead" pictures: no "lookAhead"
+// consecutive pictures may use more than lookAhead*maxBytes bytes.
+// Indices are chosen using the rate curves of the pictures waiting to be
+// coded (up to lookAhead of them). If they would exceed the rate, their
+// indices are raised to a common minimum, so bytes are taken from the
+// pictures that use most (and would be coded most finely) first.
+class VBRRateControl {
+  public:
+    VBRRateControl(int lookAhead, int maxBytes);
+    const int lookAhead() const {return window;}
+    // Index for the first picture of "pictures" (the next to be coded), given
+    // the rate curves and quality indices of the pictures waiting to be coded
+    const int qIndex(const std::vector<const VBRAnalysis*>& pictures,
+                     const std::vector<int>& qualityIndices) const;
+    // Record the bytes used by the picture just coded
+    void coded(int bytes);
+  private:
+    const int window;
+    const int maxBytes;
+    std::deque<int> history; // Bytes of the last lookAhead-1 coded pictures
+};
+
+#endif //RATECONTROL_18OCT26
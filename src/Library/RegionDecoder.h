@@ -0,0 +1,73 @@
+/*********************************************************************/
+/* RegionDecoder.h                                                   */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares decoding of a region of an HQ picture (e.g. a crop, or a */
+/* multiviewer tile) from just the slices that cover it.             */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef REGIONDECODER_18OCT26
+#define REGIONDECODER_18OCT26
+
+#include "Arrays.h"
+#include "Picture.h"
+#include "Slices.h"
+#include "WaveletTransform.h"
+
+class TaskScheduler; // See TaskScheduler.h
+
+// A rectangle of a picture, in luma samples
+struct PictureRegion {
+  PictureRegion(int top=0, int left=0, int height=0, int width=0);
+  int top;
+  int left;
+  int height;
+  int width;
+};
+
+// Decodes a region of HQ pictures. HQ slices are independent, so only the
+// slices covering the region, plus a margin for the support of the wavelet
+// filters, are needed (see "slices"). The rest may be skipped when reading
+// (see sliceio::region). Just those slices are inverse quantised and inverse
+// transformed, as a window of the transform, and the region copied out of
+// the window. The margin is wide enough that the region's samples are the
+// same as decoding the whole picture.
+// The buffers for a window are allocated on construction, so no memory is
+// allocated per picture.
+class RegionDecoder {
+  public:
+    // "format" is that of the coded pictures (frames, or fields if interlaced),
+    // the region is in luma samples of those pictures.
+    // Throws std::invalid_argument if the region is empty, is not within the
+    // picture or is not aligned with the chroma samples (e.g. has an odd left
+    // or width for 4:2:2).
+    RegionDecoder(const PictureFormat& format, WaveletKernel kernel, int waveletDepth,
+                  int ySlices, int xSlices, const PictureRegion& region);
+    const SliceRegion& slices() const {return sliceRegion;} // The slices needed
+    const PictureFormat& format() const {return regionFormat;} // Of the decoded region
+    // Decode the region from the slices of a picture, of which only those in
+    // "slices" need have been read. "picture" is resized (if need be) to the
+    // region's format.
+    void decode(const Slices& inSlices, const Array1D& qMatrix, Picture& picture);
+    // As above with the work shared between the threads of a scheduler
+    void decode(const Slices& inSlices, const Array1D& qMatrix, Picture& picture,
+                TaskScheduler& scheduler);
+  private:
+    void merge(const Slices& inSlices);
+    void crop(Picture& picture) const;
+    const WaveletKernel kernel;
+    const int waveletDepth;
+    const PictureRegion region;
+    const PictureFormat regionFormat;
+    SliceRegion sliceRegion;
+    int yRatio; // Luma lines per chroma line
+    int xRatio; // Luma samples per chroma sample
+    Array2D qIndices; // Of the slices needed
+    Picture quantised; // Quantised coefficients of the window of the transform
+    Picture transform; // Inverse quantised coefficients of the window
+    Picture window; // Decoded window (which contains the region)
+};
+
+#endif //REGIONDECODER_18OCT26
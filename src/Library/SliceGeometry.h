@@ -0,0 +1,66 @@
+/*********************************************************************/
+/* SliceGeometry.h                                                   */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares the choice of slice size for a picture format, bit rate  */
+/* and number of threads, with its expected cost.                    */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef SLICEGEOMETRY_18OCT26
+#define SLICEGEOMETRY_18OCT26
+
+#include <iosfwd>
+#include <vector>
+
+#include "Picture.h"
+
+// A slice size, for a picture (frame or field), with its expected cost.
+// Small slices cost bytes for their headers (4 bytes, plus any prefix, each).
+// Large slices need a larger slice size scalar (see min_slice_scalar), so
+// waste bytes rounding each component up to a whole number of scalar units,
+// and are fewer, so there is less work to share between threads and the rate
+// control adapts the quantisation to the picture more coarsely. Since each
+// slice has a single quantisation index, the cost of that coarseness is
+// modelled as the bytes of one slice per picture.
+struct SliceGeometry {
+  SliceGeometry();
+  int ySize; // Slice height in units of 2**waveletDepth luma lines (as -u)
+  int xSize; // Slice width in units of 2**waveletDepth luma samples (as -a)
+  int ySlices;
+  int xSlices;
+  double sliceBytes; // Average compressed bytes per slice
+  int sliceScalar; // Estimated scalar needed by the largest (luma) component
+  double overheadBytes; // Slice headers and prefixes, per picture
+  double roundingBytes; // Expected waste rounding components to the scalar, per picture
+  double granularityBytes; // Modelled cost of the rate control's coarseness, per picture
+  double efficiency; // Fraction of the threads kept busy, if each slice takes the same time
+  const int slices() const {return ySlices*xSlices;}
+  const double cost() const {return overheadBytes+roundingBytes+granularityBytes;} // Bytes per picture
+};
+
+// Reports the geometry and its costs, e.g.
+// "ySize 4, xSize 8 (17 x 15 slices of 406.6 bytes, scalar 2): overhead 1020 bytes (0.98%),
+// rounding 382.5 bytes (0.37%), granularity 406.6 bytes (0.39%), parallel efficiency 0.94"
+std::ostream& operator<<(std::ostream& os, const SliceGeometry& geometry);
+
+// Every valid slice size for a picture, in order of increasing ySize then
+// xSize. A slice size is valid if the (padded) wavelet transform of each
+// component is a whole number of slices. "pictureBytes" are the compressed
+// bytes of the picture, "threads" the threads that would share its slices.
+const std::vector<SliceGeometry> sliceGeometries(const PictureFormat& format, int waveletDepth,
+                                                 int pictureBytes, int threads,
+                                                 int slicePrefix=0);
+
+// The slice size of least cost (in bytes) with enough slices for the threads:
+// at least minSlicesPerThread slices per thread, with parallel efficiency of
+// at least 90%. Ties go to the most slices (finest rate control). Slices are
+// compact, at least as wide as they are high and at most 4 times as wide. If
+// no size has enough slices the one with most is chosen.
+// Throws std::invalid_argument if the picture cannot be divided into slices.
+const SliceGeometry chooseSliceGeometry(const PictureFormat& format, int waveletDepth,
+                                        int pictureBytes, int threads,
+                                        int slicePrefix=0, int minSlicesPerThread=4);
+
+#endif //SLICEGEOMETRY_18OCT26
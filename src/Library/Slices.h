@@ -13,6 +13,9 @@
 
 #include "Arrays.h"
 #include "Picture.h"
+#include "Arena.h"
+
+class TaskScheduler; // See TaskScheduler.h
 
 // This slice_bytes returns the actual number of bytes for a slice at specific co-ordinates
 const int slice_bytes(int v, int h, // Slice co-ordinates
@@ -60,8 +63,233 @@ class SliceQuantiser {
     SliceQuantiser& operator=(const SliceQuantiser&); //No assignment
 };
 
+// Calculates the size of an HQ slice for trial quantisation indices (for rate control).
+// The unquantised coefficients of the slice are copied, once, from the wavelet
+// transform into the thread's scratch arena, in coding order. Each trial then
+// just quantises and counts bits, allocating nothing. The result is the same as
+// quantise_transform_np followed by component_slice_bytes for each component.
+// The scratch memory is released when the HQSliceSizer is destroyed.
+class HQSliceSizer {
+  public:
+    HQSliceSizer(const Picture& transform,
+                 int ySlices, int xSlices, // Number of slices
+                 int v, int h, // Slice co-ordinates
+                 const Array1D& quantMatrix,
+                 const int scalar);
+    // Same, for a 16 bit transform
+    HQSliceSizer(const ShortPicture& transform,
+                 int ySlices, int xSlices,
+                 int v, int h,
+                 const Array1D& quantMatrix,
+                 const int scalar);
+    // Bytes for all three components (excluding the 4 byte slice overhead)
+    const int bytes(int qIndex) const;
+    // Same, also returning the bytes for each component
+    const int bytes(int qIndex, int componentBytes[3]) const;
+    // Same, also estimating the distortion: the squared error of the inverse
+    // quantised coefficients, with each subband weighted by its (power) gain in
+    // the picture, 2**(qMatrix[band]/2) (see quantMatrix). It is counted in the
+    // same pass as the bits, so needs no further quantisation.
+    const int bytes(int qIndex, double& distortion) const;
+  private:
+    HQSliceSizer(const HQSliceSizer&); //No copying
+    HQSliceSizer& operator=(const HQSliceSizer&); //No assignment
+    ArenaScope scope; // Must be constructed first (and so destroyed last)
+    const Array1D& qMatrix;
+    const int scalar;
+    const int numberOfSubbands;
+    const int waveletDepth;
+    int* coeffs[3]; // Slice coefficients for each component in coding order
+    int* bandEnds[3]; // End of each subband within coeffs
+};
+
+// Calculate quantisation indices, for HQ slices, using a binary search.
+// Finds the smallest qIndex for each slice such that the slice fits in the number
+// of bytes given by sliceBytes (including the 4 byte slice overhead).
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar);
+
+// Same, for a 16 bit transform
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar);
+
+// Versions that also return the bytes each slice actually needs (including the
+// 4 byte overhead) in "codedBytes". The rest of each slice is padding.
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes);
+
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes);
+
+// Versions that search rows of slices concurrently, as tasks of a scheduler
+// (each slice's index is independent of the others)
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes,
+                           TaskScheduler& scheduler);
+
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes,
+                           TaskScheduler& scheduler);
+
+// Calculate quantisation indices, for HQ slices, for the picture as a whole.
+// HQ slice sizes may vary, so rather than fitting each slice into its own
+// bytes, the slices share the picture's bytes (the sum of sliceBytes). All
+// slices are coded with the smallest common qIndex for which the picture fits,
+// then as many slices as the remaining bytes allow (those needing fewest bytes
+// first) use one less. A slice uses a larger index if its components would
+// not otherwise fit their one byte length (255*scalar bytes).
+// "codedBytes" is set to the bytes each slice needs and "allocatedBytes" to the
+// size of each slice, which is its coded size plus any remaining padding, so
+// that the slices fill the picture exactly. Write the slices with
+// sliceio::highQualityCBR(allocatedBytes, scalar).
+const Array2D pictureQuantIndices(const Picture& transform,
+                                  const Array1D& qMatrix,
+                                  const Array2D& sliceBytes,
+                                  const int scalar,
+                                  Array2D& codedBytes,
+                                  Array2D& allocatedBytes);
+
+// Same, for a 16 bit transform
+const Array2D pictureQuantIndices(const ShortPicture& transform,
+                                  const Array1D& qMatrix,
+                                  const Array2D& sliceBytes,
+                                  const int scalar,
+                                  Array2D& codedBytes,
+                                  Array2D& allocatedBytes);
+
+// Rate-distortion versions of pictureQuantIndices. Rather than coding the
+// slices with (nearly) the same index, the indices minimise the total
+// distortion of the picture (see HQSliceSizer), for the picture's bytes.
+// Each slice may use an index within 8 of the common index. Indices are chosen
+// with a Lagrange multiplier, then any bytes remaining code the slices that
+// gain most from them more finely. The results are as for pictureQuantIndices.
+const Array2D rdQuantIndices(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             const int scalar,
+                             Array2D& codedBytes,
+                             Array2D& allocatedBytes);
+
+const Array2D rdQuantIndices(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             const int scalar,
+                             Array2D& codedBytes,
+                             Array2D& allocatedBytes);
+
+// The slice size scalar. Each component of an HQ slice has a one byte length,
+// in units of the scalar, so is at most 255*scalar bytes. Large slices need a
+// larger scalar, but each component is rounded up to a whole number of units.
+
+// Smallest scalar with which a slice of sliceBytes (including the 4 byte
+// overhead) could be filled by its 3 components.
+const int min_slice_scalar(const int sliceBytes);
+
+// Smallest scalar that does not limit the coding of a picture, with the given
+// indices and slice sizes: every component fits its length (the last including
+// the padding to the slice's size) and would still fit coded one index finer,
+// so no slice's index need be raised to fit. If it is bigger than the scalar
+// with which the indices were chosen, choose them again with this scalar.
+const int required_slice_scalar(const Picture& transform, const Array1D& qMatrix,
+                                const Array2D& qIndices, const Array2D& sliceBytes);
+
+// Same, for a 16 bit transform
+const int required_slice_scalar(const ShortPicture& transform, const Array1D& qMatrix,
+                                const Array2D& qIndices, const Array2D& sliceBytes);
+
+// Calculates the size of an LD slice for trial quantisation indices (for rate control).
+// As HQSliceSizer, except that LD codes the LL subband with DC prediction and
+// splits each slice into a bounded block of luma bits and a block of interleaved
+// chroma bits. Prediction uses the restored (inverse quantised) LL coefficients
+// of the slices above and to the left, so slices must be sized in raster order.
+// The restored LL subband of each component (for the whole picture) is held in
+// "restoredLL", which the caller provides. Each trial also restores the LL
+// coefficients of this slice, so the last trial must be the chosen index (see
+// "restore"), before the next slice is sized.
+class LDSliceSizer {
+  public:
+    LDSliceSizer(const Picture& transform,
+                 int ySlices, int xSlices, // Number of slices
+                 int v, int h, // Slice co-ordinates
+                 const Array1D& quantMatrix,
+                 int* const restoredLL[3]);
+    // Same, for a 16 bit transform
+    LDSliceSizer(const ShortPicture& transform,
+                 int ySlices, int xSlices,
+                 int v, int h,
+                 const Array1D& quantMatrix,
+                 int* const restoredLL[3]);
+    // Coded luma bits and (interleaved) chroma bits, excluding trailing zeros
+    void bits(int qIndex, int& yBits, int& uvBits);
+    // Restore the LL coefficients of the slice with its chosen index
+    void restore(int qIndex);
+  private:
+    LDSliceSizer(const LDSliceSizer&); //No copying
+    LDSliceSizer& operator=(const LDSliceSizer&); //No assignment
+    template <class Array>
+    void gather(int c, const Array& component, int ySlices, int xSlices, int v, int h);
+    void quantise_LL(int c, int qIndex);
+    ArenaScope scope; // Must be constructed first (and so destroyed last)
+    const Array1D& qMatrix;
+    const int numberOfSubbands;
+    const int waveletDepth;
+    int* coeffs[3]; // Slice coefficients for each component in coding order
+    int* bandEnds[3]; // End of each subband within coeffs
+    int* quantised[3]; // Quantised coefficients of the latest trial
+    int* restored[3]; // Restored LL subbands (whole picture)
+    int llWidth[3]; // Width of each LL subband
+    int llTop[3]; // Boundaries of the slice within each LL subband
+    int llBottom[3];
+    int llLeft[3];
+    int llRight[3];
+};
+
+// Calculate quantisation indices, for LD slices, using a binary search.
+// Finds the smallest qIndex for each slice such that its luma and chroma
+// fit in the number of bytes given by sliceBytes (scalar 1, see slice_bytes).
+// Slices are sized in raster order with the LL prediction of quantise_transform.
+const Array2D quantIndicesLD(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes);
+
+// Same, for a 16 bit transform
+const Array2D quantIndicesLD(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes);
+
+// Versions that also return the bytes each slice actually needs in "codedBytes"
+const Array2D quantIndicesLD(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             Array2D& codedBytes);
+
+const Array2D quantIndicesLD(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             Array2D& codedBytes);
+
 //**** Slice IO declarations ****//
 
+// "bytes" is set when slices are read, to the size of each slice in the
+// stream (for HQ from the lengths in the slice, so the actual size whether
+// slice sizes are fixed or vary, excluding any prefix). It is not used for
+// writing.
 struct Slices { 
     Slices(const PictureArray& yuvSlices, const int waveletDepth, const Array2D& qIndices);
     Slices(const PictureFormat& pictureFormat, int waveletDepth,
@@ -69,12 +297,26 @@ struct Slices {
     PictureArray yuvSlices;
     const int waveletDepth;
     Array2D qIndices;
+    Array2D bytes; // Size of each slice read
 };
 
 std::ostream& operator << (std::ostream& stream, const Slices& s);
 
 std::istream& operator >> (std::istream& stream, Slices& s);
 
+// A rectangle of slices, rows [top, top+height) and columns [left, left+width),
+// e.g. those needed to decode a region of a picture (see RegionDecoder.h)
+struct SliceRegion {
+  SliceRegion(int top=0, int left=0, int height=0, int width=0);
+  const bool contains(int row, int column) const {
+    return (row>=top) && (row<top+height) && (column>=left) && (column<left+width);
+  }
+  int top;
+  int left;
+  int height;
+  int width;
+};
+
 namespace sliceio {
 
   enum SliceIOMode {UNKNOWN, LD, HQVBR, HQCBR};
@@ -89,21 +331,39 @@ namespace sliceio {
       const Array2D& bytes;
   };
 
+  // HQ slices start with "prefix" bytes (zero when written, skipped when
+  // read). Slice sizes ("bytes") exclude the prefix.
   class highQualityCBR {
     public:
-      highQualityCBR(const Array2D& b, const int s): bytes(b), scalar(s) {}; 
+      highQualityCBR(const Array2D& b, const int s, const int p=0): bytes(b), scalar(s), prefix(p) {}; 
       void operator () (std::ios_base& stream) const;
     private:
       const Array2D& bytes;
       const int scalar;
+      const int prefix;
   };
 
   class highQualityVBR {
     public:
-      highQualityVBR(const int s): scalar(s) {}; 
+      highQualityVBR(const int s, const int p=0): scalar(s), prefix(p) {}; 
       void operator () (std::ios_base& stream) const;
     private:
       const int scalar;
+      const int prefix;
+  };
+
+  // Read only the (HQ) slices in a region, skipping the others using the
+  // lengths of their components, without decoding them. Skipped slices, and
+  // their quantisation indices, are left unchanged. The region must outlive
+  // its use by the stream. region() reads every slice (the default).
+  // Reading a region of LD slices throws std::logic_error.
+  class region {
+    public:
+      region(): slices(0) {};
+      region(const SliceRegion& r): slices(&r) {};
+      void operator () (std::ios_base& stream) const;
+    private:
+      const SliceRegion* slices;
   };
 } // end namespace sliceio
 
@@ -125,4 +385,7 @@ std::ostream& operator << (std::ostream& stream, sliceio::highQualityVBR arg);
 // istream low delay format manipulator
 std::istream& operator >> (std::istream& stream, sliceio::highQualityVBR arg);
 
+// istream manipulator to read only the slices in a region
+std::istream& operator >> (std::istream& stream, sliceio::region arg);
+
 #endif //SLICES_24JUNE11
@@ -0,0 +1,113 @@
+/*********************************************************************/
+/* TaskScheduler.h                                                   */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares a work stealing task scheduler, with a fixed set of      */
+/* worker threads, shared by all the stages of coding a picture.     */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef TASKSCHEDULER_18OCT26
+#define TASKSCHEDULER_18OCT26
+
+#include <deque>
+#include <vector>
+
+#include "boost/exception_ptr.hpp"
+#include "boost/function.hpp"
+#include "boost/thread/thread.hpp"
+#include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
+
+class TaskGroup;
+typedef std::vector<int> CoreSet; // See Numa.h
+
+// Runs tasks (e.g. the slices, stripes or components of a picture) on a fixed
+// set of worker threads. Each worker has its own queue of tasks. Tasks
+// submitted by a worker (e.g. stripes of a component task) go on its own queue,
+// and are run last in first out, so a worker keeps working on the data it has
+// in cache. Tasks submitted by other threads go on a shared queue. A worker
+// whose own queue is empty takes from the shared queue and then steals from
+// the front (the oldest, and so largest, tasks) of the other workers' queues.
+// Tasks are submitted, and waited for, in a TaskGroup. A thread waiting for a
+// group runs tasks meanwhile, so it is one of the threads doing the work. So
+// "threads" is the total number of threads that run tasks, including the one
+// that waits, and threads-1 workers are created. With threads==1 every task is
+// run, in turn, by the waiting thread. Several channels (each on its own
+// thread) may share a scheduler, so the process as a whole uses a fixed number
+// of threads.
+// Each thread has its own ScratchArena (see Arena.h), so tasks may use it.
+class TaskScheduler {
+  public:
+    typedef boost::function<void ()> Task;
+    // threads==0 uses one thread per core (boost::thread::hardware_concurrency).
+    // If "pinThreads" worker i only runs on core (firstCore+1+i) modulo the
+    // number of cores, leaving firstCore for the thread that waits (Linux only,
+    // elsewhere it is ignored).
+    explicit TaskScheduler(int threads=0, bool pinThreads=false, int firstCore=0);
+    // A thread per core of the set (e.g. a NUMA node, see Numa.h), with the
+    // workers all bound to the set, so the scheduler's tasks stay on the node.
+    explicit TaskScheduler(const CoreSet& cores);
+    ~TaskScheduler(); // Finishes the tasks queued, then stops the workers
+    const int threads() const {return workerCount+1;}
+    // Run one queued task, if there is one, on the calling thread
+    const bool runOne();
+  private:
+    friend class TaskGroup;
+    TaskScheduler(const TaskScheduler&); //No copying
+    TaskScheduler& operator=(const TaskScheduler&); //No assignment
+    struct Item {
+      Task task;
+      TaskGroup* group;
+    };
+    struct Queue {
+      boost::mutex mutex;
+      std::deque<Item> items;
+    };
+    void submit(const Task& task, TaskGroup* group);
+    const bool take(Item& item);
+    void run(Item& item);
+    void work(int index, const CoreSet& cores); // A worker thread, bound to the cores if any
+    const int self() const; // Index of the calling worker, or -1 if not a worker
+    int workerCount;
+    std::vector<Queue*> queues; // One per worker, then the shared queue
+    boost::mutex idleMutex;
+    boost::condition_variable idle;
+    int queued; // Tasks in all the queues
+    bool stopping;
+    boost::thread_group workers; // Must be constructed last
+};
+
+// A set of tasks to wait for. The tasks may themselves use groups (e.g. for
+// the stripes of a component) without deadlock, since waiting threads run
+// tasks. The group must outlive its tasks, so wait before it is destroyed.
+// Exceptions thrown by tasks are caught and the first one rethrown by "wait",
+// with its type (boost::current_exception keeps the standard exception types;
+// a class derived from one is rethrown as that standard type).
+class TaskGroup {
+  public:
+    explicit TaskGroup(TaskScheduler& scheduler);
+    ~TaskGroup(); // Waits for the tasks (ignoring any errors)
+    void run(const TaskScheduler::Task& task);
+    void wait();
+  private:
+    friend class TaskScheduler;
+    TaskGroup(const TaskGroup&); //No copying
+    TaskGroup& operator=(const TaskGroup&); //No assignment
+    void finished(const boost::exception_ptr* error);
+    const bool waitAll(); // Returns false if a task failed
+    TaskScheduler& scheduler;
+    boost::mutex mutex;
+    boost::condition_variable done;
+    int outstanding;
+    boost::exception_ptr error; // The first exception thrown by a task
+};
+
+// Calls body(first, last) for consecutive ranges of [begin, end) as tasks, and
+// waits for them. The range is divided into about 4 tasks per thread, but
+// tasks are at least "grain" long.
+void parallel_for(TaskScheduler& scheduler, int begin, int end,
+                  const boost::function<void (int, int)>& body, int grain=1);
+
+#endif //TASKSCHEDULER_18OCT26
@@ -14,6 +14,8 @@
 #include "Arrays.h"
 #include "Picture.h"
 
+class TaskScheduler; // See TaskScheduler.h
+
 // Define enumeration for different ypes of wavelet kernel
 // Kernels are: Deslauriers-Dubuc (9,7)
 //              LeGall (5,3)
@@ -42,6 +44,57 @@ const Array2D inverseWaveletTransform(const Array2D& transform,
                                       int depth,
                                       Shape2D shape);
 
+// Versions of the transforms that write into pre-allocated arrays (e.g. from a BufferPool).
+// The forward transform only reallocates "transform" if it is not already the padded size.
+void waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth, Array2D& transform);
+
+// The inverse transform is performed in place, so "transform" is overwritten.
+// The size of "picture" (which must be set beforehand) gives the size of the unpadded image.
+void inverseWaveletTransform(Array2D& transform, WaveletKernel kernel, int depth, Array2D& picture);
+
+// 16 bit versions of the transforms, for pictures whose coefficients fit in
+// 16 bits (see shortCoefficients below). These halve the memory traffic of the
+// transform, and of quantisation, compared with using Array2Ds.
+// The forward transform throws std::overflow_error if shortCoefficients is false
+// or a picture sample is outside the range 0 to 2**bitDepth-1.
+void waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortArray2D& transform);
+
+// Note: overwrites "transform"
+void inverseWaveletTransform(ShortArray2D& transform, WaveletKernel kernel, int depth, Array2D& picture);
+
+// Forward transforms, in place, of arrays that already hold a padded picture
+// (e.g. read directly into the transform buffers, see PackedIO.h), which
+// avoids copying the picture to pad it.
+// The 16 bit version throws std::overflow_error if shortCoefficients is false.
+// Its samples are not checked, they must be in the range 0 to 2**bitDepth-1.
+void paddedWaveletTransform(Array2D& padded, WaveletKernel kernel, int depth);
+
+void paddedWaveletTransform(ShortArray2D& padded, WaveletKernel kernel, int depth, int bitDepth);
+
+// Forward transforms of one field of an interlaced frame, into pre-allocated
+// arrays. "field" is the first line of the field in the frame (0 for the top
+// field, 1 for the bottom field). The field is padded straight from a strided
+// view of the frame, so it is never copied into a picture of its own (as
+// Frame::topField would). Different fields may be transformed concurrently.
+void fieldWaveletTransform(const Array2D& frame, int field, WaveletKernel kernel, int depth,
+                           Array2D& transform);
+
+void fieldWaveletTransform(const Array2D& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortArray2D& transform);
+
+// Number of bits (including sign) needed for any value, final or intermediate, in
+// the wavelet transform of a picture with samples in the range 0 to 2**bitDepth-1.
+// This is a worst case bound, which no picture can exceed.
+const int coefficientBits(WaveletKernel kernel, int depth, int bitDepth);
+
+// True if the (16 bit) ShortArray2D versions of the transforms may be used.
+// Requires one bit spare, to allow for rounding in the lifting steps and, when
+// decoding, for quantisation errors.
+// E.g. true for 8 bit video with LeGall or DD97 up to depth 3 and for 10 bit
+// video with LeGall or DD97 up to depth 2.
+const bool shortCoefficients(WaveletKernel kernel, int depth, int bitDepth);
+
 // Return the default quantisation matrix for a given wavelet kernel and depth
 const Array1D quantMatrix(WaveletKernel kernel, int depth);
 
@@ -62,4 +115,59 @@ const Picture inverseWaveletTransform(const Picture& transform,
                                       int depth,
                                       PictureFormat format);
 
+// Picture versions of the transforms into pre-allocated buffers (see above).
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth, Picture& transform);
+
+// Note: overwrites "transform"
+void inverseWaveletTransform(Picture& transform, WaveletKernel kernel, int depth, Picture& picture);
+
+// Picture versions of the 16 bit transforms
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortPicture& transform);
+
+// Note: overwrites "transform"
+void inverseWaveletTransform(ShortPicture& transform, WaveletKernel kernel, int depth, Picture& picture);
+
+// Picture versions of the field transforms
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           Picture& transform);
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortPicture& transform);
+
+// Picture versions of the in place transforms of padded pictures
+void paddedWaveletTransform(Picture& padded, WaveletKernel kernel, int depth);
+
+void paddedWaveletTransform(ShortPicture& padded, WaveletKernel kernel, int depth, int bitDepth);
+
+// Concurrent versions of the Picture transforms, as tasks of a scheduler (see
+// TaskScheduler.h). The components are transformed concurrently, and each
+// level of a component in stripes: the horizontal filters on stripes of lines,
+// then the vertical filters on stripes of columns. The results are the same
+// as the versions above.
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      Picture& transform, TaskScheduler& scheduler);
+
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortPicture& transform, TaskScheduler& scheduler);
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           Picture& transform, TaskScheduler& scheduler);
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortPicture& transform, TaskScheduler& scheduler);
+
+void paddedWaveletTransform(Picture& padded, WaveletKernel kernel, int depth,
+                            TaskScheduler& scheduler);
+
+void paddedWaveletTransform(ShortPicture& padded, WaveletKernel kernel, int depth,
+                            int bitDepth, TaskScheduler& scheduler);
+
+// Note: overwrite "transform"
+void inverseWaveletTransform(Picture& transform, WaveletKernel kernel, int depth,
+                             Picture& picture, TaskScheduler& scheduler);
+
+void inverseWaveletTransform(ShortPicture& transform, WaveletKernel kernel, int depth,
+                             Picture& picture, TaskScheduler& scheduler);
+
 #endif //WAVELETTRANSFORM_1MARCH10
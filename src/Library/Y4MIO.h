@@ -0,0 +1,72 @@
+/*********************************************************************/
+/* Y4MIO.h                                                           */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Declares reading and writing of YUV4MPEG2 ("Y4M") streams, a      */
+/* frame at a time, so that video may be piped through the codec.    */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#ifndef Y4MIO_18OCT26
+#define Y4MIO_18OCT26
+
+#include <iosfwd>
+#include <string>
+
+#include "Picture.h"
+
+// The parameters of a Y4M stream, as given by its stream header.
+// Y4M supports 4:4:4, 4:2:2 and 4:2:0 YCbCr of 8 to 16 bits. Samples of more
+// than 8 bits are stored in 2 bytes, least significant byte first.
+class Y4MFormat {
+  public:
+    Y4MFormat(); // Unknown format, e.g. to be read from a stream
+    Y4MFormat(const PictureFormat& format, int bitDepth,
+              bool interlaced=false, bool topFieldFirst=true,
+              int frameRateNumerator=25, int frameRateDenominator=1);
+    operator const bool() const; // Test if valid (known) format
+    const PictureFormat& pictureFormat() const {return picFormat;}
+    const int bitDepth() const {return depth;}
+    const int bytesPerSample() const {return (depth>8) ? 2 : 1;}
+    const bool interlaced() const {return isInterlaced;}
+    const bool topFieldFirst() const {return isTopFieldFirst;}
+    const int frameRateNumerator() const {return rateNumerator;}
+    const int frameRateDenominator() const {return rateDenominator;}
+  private:
+    PictureFormat picFormat;
+    int depth;
+    bool isInterlaced;
+    bool isTopFieldFirst;
+    int rateNumerator;
+    int rateDenominator;
+};
+
+// Reads a Y4M stream header, e.g. "YUV4MPEG2 W1920 H1080 F25:1 It C422p10".
+// Missing parameters take the Y4M defaults (4:2:0, 8 bit, progressive).
+// Sets failbit if the stream does not start with a Y4M header, or the header
+// has no width or height. Throws std::invalid_argument for colour spaces the
+// codec does not support (e.g. "mono") and for mixed interlacing ("Im").
+std::istream& operator>>(std::istream& stream, Y4MFormat& format);
+
+// Writes a Y4M stream header (throws std::invalid_argument if format is not valid)
+std::ostream& operator<<(std::ostream& stream, const Y4MFormat& format);
+
+// Reads the next frame of a Y4M stream into an existing picture, which must
+// have the picture format of the stream (otherwise std::invalid_argument is
+// thrown). So frames may be streamed into pre-allocated (pooled) pictures
+// without allocating memory. The samples are read using pictureio, as
+// unsigned, right justified values.
+// At the end of the stream (no further frames) failbit is set.
+std::istream& readY4MFrame(std::istream& stream, const Y4MFormat& format, Picture& picture);
+
+// Writes a picture as the next frame of a Y4M stream (after the header).
+// The picture must have the picture format of the stream and its samples
+// must be in the range 0 to 2**bitDepth-1 (see clip in Picture.h).
+std::ostream& writeY4MFrame(std::ostream& stream, const Y4MFormat& format, const Picture& picture);
+
+// True if a file name should be treated as Y4M, i.e. it has the extension
+// ".y4m" or is "-" (meaning standard input or output, for use in pipelines).
+const bool isY4MFileName(const std::string& fileName);
+
+#endif //Y4MIO_18OCT26
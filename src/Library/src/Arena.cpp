@@ -0,0 +1,88 @@
+/*********************************************************************/
+/* Arena.cpp                                                         */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines a simple "bump" allocator for short lived scratch storage */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include <stdexcept>
+
+#include "boost/thread/tss.hpp"
+
+#include "Arena.h"
+
+ScratchArena::ScratchArena(std::size_t initialSize):
+  used(0), total(0) {
+  if (initialSize>0) {
+    const Block block = {new int[initialSize], initialSize, 0};
+    blocks.push_back(block);
+    total = initialSize;
+  }
+}
+
+ScratchArena::~ScratchArena() {
+  for (std::vector<Block>::iterator b=blocks.begin(); b!=blocks.end(); ++b) {
+    delete[] b->data;
+  }
+}
+
+int* ScratchArena::allocate(std::size_t n) {
+  // Find the block containing the next free int
+  // (search from the end, there are very few blocks)
+  for (std::size_t i=blocks.size(); i>0; --i) {
+    const Block& block = blocks[i-1];
+    if (block.start<=used) {
+      if ((used+n)<=(block.start+block.size)) {
+        int* const result = block.data + (used-block.start);
+        used += n;
+        return result;
+      }
+      // Doesn't fit, try the next block (if any), wasting the end of this one
+      if ((i<blocks.size()) && (n<=blocks[i].size)) {
+        used = blocks[i].start+n;
+        return blocks[i].data;
+      }
+      break;
+    }
+  }
+  // Need a new block; at least double the arena so that growth is rare.
+  // Any blocks after the current one are too small, so discard them.
+  while (!blocks.empty() && (blocks.back().start>used)) {
+    total -= blocks.back().size;
+    delete[] blocks.back().data;
+    blocks.pop_back();
+  }
+  const std::size_t size = (n>total) ? n : total;
+  const Block block = {new int[size], size, total};
+  blocks.push_back(block);
+  total += size;
+  used = block.start+n;
+  return block.data;
+}
+
+void ScratchArena::release(std::size_t position) {
+  if (position>used) {
+    throw std::logic_error("ScratchArena: release to a mark beyond the current position");
+  }
+  used = position;
+  if ((used==0) && (blocks.size()>1)) coalesce();
+}
+
+// Replace all the blocks with a single block of the same total size.
+// Only called when the arena is empty.
+void ScratchArena::coalesce() {
+  for (std::vector<Block>::iterator b=blocks.begin(); b!=blocks.end(); ++b) {
+    delete[] b->data;
+  }
+  blocks.clear();
+  const Block block = {new int[total], total, 0};
+  blocks.push_back(block);
+}
+
+ScratchArena& ScratchArena::local() {
+  static boost::thread_specific_ptr<ScratchArena> arena;
+  if (!arena.get()) arena.reset(new ScratchArena);
+  return *arena;
+}
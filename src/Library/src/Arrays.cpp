@@ -13,6 +13,7 @@
 #include <stdexcept>
 
 #include "Arrays.h"
+#include "Arena.h"
 #include "Utils.h"
 
 using utils::pow;
@@ -52,6 +53,18 @@ const Array2D clip(const Array2D& values, const int min_value, const int max_val
   return result;
 }
 
+void clip(const Array2D& values, const int min_value, const int max_value, Array2D& result) {
+  if ((result.shape()[0]!=values.shape()[0]) || (result.shape()[1]!=values.shape()[1])) {
+    throw std::invalid_argument("clip: result must be the same shape as the values");
+  }
+  const std::size_t count = values.num_elements();
+  const int* const in = values.data();
+  int* const out = result.data();
+  for (std::size_t i=0; i<count; ++i) {
+    out[i] = (in[i]<min_value) ? min_value : ((in[i]>max_value) ? max_value : in[i]);
+  }
+}
+
 // Splits a large 2D array into an array of smaller 2D arrays (blocks)
 // Note that if the number of blocks is not a sub-multiple of the input array dimensions then
 // the blocks will have different sizes!
@@ -142,6 +155,11 @@ namespace {
       return stream.iword(i);
   }
 
+  long& is_little_endian(std::ios_base& stream) {
+      static const int i = std::ios_base::xalloc();
+      return stream.iword(i);
+  }
+
 #if 0
   long& is_text(std::ios_base& stream) {
       static const int i = std::ios_base::xalloc();
@@ -288,6 +306,30 @@ std::istream& arrayio::right_justified(std::istream& stream) {
   return stream;
 }
 
+// ostream big endian format manipulator
+std::ostream& arrayio::big_endian(std::ostream& stream) {
+  is_little_endian(stream) = static_cast<long>(false);
+  return stream;
+}
+
+// istream big endian format manipulator
+std::istream& arrayio::big_endian(std::istream& stream) {
+  is_little_endian(stream) = static_cast<long>(false);
+  return stream;
+}
+
+// ostream little endian format manipulator
+std::ostream& arrayio::little_endian(std::ostream& stream) {
+  is_little_endian(stream) = static_cast<long>(true);
+  return stream;
+}
+
+// istream little endian format manipulator
+std::istream& arrayio::little_endian(std::istream& stream) {
+  is_little_endian(stream) = static_cast<long>(true);
+  return stream;
+}
+
 // Set data format to offset binary
 std::ostream& arrayio::offset_binary(std::ostream& stream) {
   is_signed(stream) = static_cast<long>(false);
@@ -330,51 +372,110 @@ std::istream& arrayio::unsigned_binary(std::istream& stream) {
   return stream;
 }
 
+namespace {
+
+  // Conversion kernels between words and array elements.
+  // There is one kernel for each word width, byte order (and, for reading 4
+  // byte words, signedness), selected once per array rather than once per element, so
+  // the inner loops have no switches or tests and can be unrolled (and
+  // vectorised) by the compiler.
+  // Words of less than 4 bytes are never negative, so logical and arithmetic
+  // shifts give the same result and signedness only matters for 4 byte words.
+  // "offset" is zero unless the data is offset binary.
+
+  template <int wordBytes, bool isSigned, bool littleEndian>
+  void unpackWords(const unsigned char* in, int* out, std::size_t count,
+                   int shift, int offset) {
+    for (std::size_t i=0; i<count; ++i, in+=wordBytes) {
+      unsigned int value = 0;
+      for (int byte=0; byte<wordBytes; ++byte) {
+        value = (value<<8) | in[littleEndian ? wordBytes-1-byte : byte];
+      }
+      // Use logical shift for unsigned data (value is unsigned int) and
+      // arithmetic shift for signed data (after conversion to int)
+      const int element = isSigned ? (static_cast<int>(value) >> shift)
+                                   : static_cast<int>(value >> shift);
+      out[i] = element - offset;
+    }
+  }
+
+  template <int wordBytes, bool littleEndian>
+  void packWords(const int* in, unsigned char* out, std::size_t count,
+                 int shift, int offset) {
+    for (std::size_t i=0; i<count; ++i, out+=wordBytes) {
+      const unsigned int value = static_cast<unsigned int>(in[i]+offset) << shift;
+      for (int byte=0; byte<wordBytes; ++byte) {
+        out[littleEndian ? wordBytes-1-byte : byte] =
+          static_cast<unsigned char>(value >> (8*(wordBytes-1-byte)));
+      }
+    }
+  }
+
+  // Select the kernel for the byte order
+  template <int wordBytes, bool isSigned>
+  void unpackArray(const unsigned char* in, int* out, std::size_t count,
+                   int shift, int offset, bool littleEndian) {
+    if (littleEndian) unpackWords<wordBytes, isSigned, true>(in, out, count, shift, offset);
+    else unpackWords<wordBytes, isSigned, false>(in, out, count, shift, offset);
+  }
+
+  template <int wordBytes>
+  void packArray(const int* in, unsigned char* out, std::size_t count,
+                 int shift, int offset, bool littleEndian) {
+    if (littleEndian) packWords<wordBytes, true>(in, out, count, shift, offset);
+    else packWords<wordBytes, false>(in, out, count, shift, offset);
+  }
+
+  // Byte buffer for a whole array, from the calling thread's scratch arena,
+  // so that the buffer is reused for every array (and frame) read or written.
+  unsigned char* byteBuffer(std::size_t size) {
+    const std::size_t ints = (size+sizeof(int)-1)/sizeof(int);
+    return reinterpret_cast<unsigned char*>(ScratchArena::local().allocate(ints));
+  }
+
+} // end unnamed namespace
+
 std::istream& operator >> (std::istream& stream, Array2D& array) {
   // Get word width and bit depth from stream
   // Default word width is size of int, default bit depth fills word width
   const int wordBytes = ioBytes(stream);
+  if ((wordBytes<1) || (wordBytes>4)) {
+    throw std::domain_error("Word width of input stream must be in range 1 to 4");
+  }
 
   //Create reference for input stream buffer (input via stream buffer for efficiency).
   std::streambuf& inbuf = *(stream.rdbuf());
   // Read wordBytes bytes per array element
-  const int size = wordBytes*array.num_elements();
-  unsigned char *inBuffer = new unsigned char[size];
+  const std::size_t count = array.num_elements();
+  const std::size_t size = wordBytes*count;
+  ArenaScope scope(ScratchArena::local());
+  unsigned char* const inBuffer = byteBuffer(size);
   std::istream::sentry s(stream, true);
   if (s) {
-    if ( inbuf.sgetn(reinterpret_cast<char*>(inBuffer), size) < size )
+    if ( inbuf.sgetn(reinterpret_cast<char*>(inBuffer), size) < static_cast<std::streamsize>(size) )
       stream.setstate(std::ios_base::eofbit|std::ios_base::failbit);
   }
 
-  const int height = array.shape()[0];
-  const int width = array.shape()[1];
   const int shift = ioShift(stream);
   const int offset = ioZero(stream);
-  unsigned int value, byte = 0;
-  for (int y=0; y<height; ++y) {
-    for (int x=0; x<width; ++x) {
-      value = 0;
-      switch (wordBytes) {
-        // Only allowed 4 bytes word width in 32 bit systems
-        case 4:
-          value |= (inBuffer[byte++]<<24);
-        case 3:
-          value |= (inBuffer[byte++]<<16);
-        case 2:
-          value |= (inBuffer[byte++]<<8);
-        case 1:
-          value |= inBuffer[byte++];
-          break;
-        default:
-          throw std::domain_error("Word width of input stream must be in range 1 to 4");
-      }
-      if (!is_signed(stream)) value >>= shift; //Use logical shift for unsigned data (value is unsigned int)
-      array[y][x] = value;
-      if (is_signed(stream)) array[y][x] >>= shift; //Use arithmetic shift for signed data (array[y][x] is int)
-      if (is_offset(stream)) array[y][x] -= offset;
-    }
+  const bool littleEndian = is_little_endian(stream);
+  int* const out = array.data();
+  switch (wordBytes) {
+    // Only allowed 4 bytes word width in 32 bit systems
+    case 4:
+      if (is_signed(stream)) unpackArray<4, true>(inBuffer, out, count, shift, offset, littleEndian);
+      else unpackArray<4, false>(inBuffer, out, count, shift, offset, littleEndian);
+      break;
+    case 3:
+      unpackArray<3, false>(inBuffer, out, count, shift, offset, littleEndian);
+      break;
+    case 2:
+      unpackArray<2, false>(inBuffer, out, count, shift, offset, littleEndian);
+      break;
+    case 1:
+      unpackWords<1, false, false>(inBuffer, out, count, shift, offset);
+      break;
   }
-  delete[] inBuffer;
   return stream;
 }
 
@@ -382,45 +483,42 @@ std::ostream& operator << (std::ostream& stream, const Array2D& array) {
   // Get word width and bit depth from stream
   // Default word width is size of int, default bit depth fills word width
   const int wordBytes = ioBytes(stream);
-  
+  if ((wordBytes<1) || (wordBytes>4)) {
+    throw std::domain_error("Word width of input stream must be in range 1 to 4");
+  }
+
   // Write wordBytes bytes per array element
-  const int size = wordBytes*array.num_elements();
-  unsigned char *outBuffer = new unsigned char[size];
-  const int height = array.shape()[0];
-  const int width = array.shape()[1];
+  const std::size_t count = array.num_elements();
+  const std::size_t size = wordBytes*count;
+  ArenaScope scope(ScratchArena::local());
+  unsigned char* const outBuffer = byteBuffer(size);
   const int shift = ioShift(stream);
   const int offset = ioZero(stream);
-  unsigned int value, byte = 0;
-  for (int y=0; y<height; ++y) {
-    for (int x=0; x<width; ++x) {
-      value = array[y][x]+offset;
-      value <<= shift;
-      switch (wordBytes) {
-        // Only allowed 4 bytes word width in 32 bit systems
-        case 4:
-          outBuffer[byte++] = (value>>24);
-        case 3:
-          outBuffer[byte++] = (value>>16);
-        case 2:
-          outBuffer[byte++] = (value>>8);
-        case 1:
-          outBuffer[byte++] = value;
-          break;
-        default:
-          throw std::domain_error("Word width of input stream must be in range 1 to 4");
-          ;
-      }
-    }
+  const bool littleEndian = is_little_endian(stream);
+  const int* const in = array.data();
+  switch (wordBytes) {
+    // Only allowed 4 bytes word width in 32 bit systems
+    case 4:
+      packArray<4>(in, outBuffer, count, shift, offset, littleEndian);
+      break;
+    case 3:
+      packArray<3>(in, outBuffer, count, shift, offset, littleEndian);
+      break;
+    case 2:
+      packArray<2>(in, outBuffer, count, shift, offset, littleEndian);
+      break;
+    case 1:
+      packWords<1, false>(in, outBuffer, count, shift, offset);
+      break;
   }
 
   //Create reference for output stream buffer (output via stream buffer for efficiency).
   std::streambuf& outbuf = *(stream.rdbuf());
   std::ostream::sentry s(stream);
   if (s) {
-    if ( outbuf.sputn(reinterpret_cast<char*>(outBuffer), size) < size )
+    if ( outbuf.sputn(reinterpret_cast<char*>(outBuffer), size) < static_cast<std::streamsize>(size) )
       stream.setstate(std::ios_base::eofbit|std::ios_base::failbit);
   }
-  delete[] outBuffer;
 
   return stream;
 }
@@ -0,0 +1,49 @@
+/*********************************************************************/
+/* BufferPool.cpp                                                    */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines the pre-allocated buffers for encoding/decoding a picture */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "BufferPool.h"
+#include "WaveletTransform.h"
+
+const PictureFormat paddedFormat(const PictureFormat& format, int waveletDepth) {
+  return PictureFormat(paddedSize(format.lumaHeight(), waveletDepth),
+                       paddedSize(format.lumaWidth(), waveletDepth),
+                       paddedSize(format.chromaHeight(), waveletDepth),
+                       paddedSize(format.chromaWidth(), waveletDepth),
+                       format.chromaFormat());
+}
+
+FrameBuffers::FrameBuffers(const PictureFormat& format, int waveletDepth,
+                           int ySlices, int xSlices, bool shortCoefficients):
+  picture(format),
+  transform(shortCoefficients ? Picture() : Picture(paddedFormat(format, waveletDepth))),
+  shortTransform(shortCoefficients ? ShortPicture(paddedFormat(format, waveletDepth)) : ShortPicture()),
+  quantised(paddedFormat(format, waveletDepth)),
+  slices(paddedFormat(format, waveletDepth), waveletDepth, ySlices, xSlices),
+  sliceBytes(extents[ySlices][xSlices]),
+  sliceScalar(1),
+  pictureFormat(format),
+  coeffsFormat(paddedFormat(format, waveletDepth)),
+  shortCoeffs(shortCoefficients) {
+  // Size each slice exactly as split_into_blocks would (slices need not all be
+  // the same size if the transform is not a multiple of the number of slices).
+  split_into_blocks(quantised, slices.yuvSlices);
+}
+
+FrameBuffersFactory::FrameBuffersFactory(const PictureFormat& format, int depth,
+                                         int yCount, int xCount, bool shortCoefficients):
+  pictureFormat(format),
+  waveletDepth(depth),
+  ySlices(yCount),
+  xSlices(xCount),
+  shortCoeffs(shortCoefficients) {
+}
+
+FrameBuffers* FrameBuffersFactory::operator()() const {
+  return new FrameBuffers(pictureFormat, waveletDepth, ySlices, xSlices, shortCoeffs);
+}
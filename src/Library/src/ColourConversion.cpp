@@ -0,0 +1,439 @@
+/*********************************************************************/
+/* ColourConversion.cpp                                              */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines conversion between RGB and YCbCr, with chroma             */
+/* subsampling and upsampling.                                       */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "ColourConversion.h"
+#include "Arena.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept> // For invalid_argument
+#include <cmath> // For floor
+#include <algorithm> // For fill
+
+std::ostream& operator<<(std::ostream& os, ColourMatrix matrix) {
+  const char* s;
+  switch (matrix) {
+    case BT601:
+      s = "ITU-R BT.601 (\"BT601\")";
+      break;
+    case BT709:
+      s = "ITU-R BT.709 (\"BT709\")";
+      break;
+    case BT2020:
+      s = "ITU-R BT.2020 (\"BT2020\")";
+      break;
+    default:
+      s = "Unknown colour matrix!";
+      break;
+  }
+  return os<<s;
+}
+
+std::istream& operator>>(std::istream& strm, ColourMatrix& matrix) {
+  std::string text;
+  strm >> text;
+  if (text == "BT601") matrix = BT601;
+  else if (text == "BT709") matrix = BT709;
+  else if (text == "BT2020") matrix = BT2020;
+  else throw std::invalid_argument("invalid colour matrix");
+  return strm;
+}
+
+namespace {
+
+  // Integer conversion coefficients, scaled by 2**shift
+  struct Coefficients {
+    int yr, yg, yb;
+    int ur, ug, ub;
+    int vr, vg, vb;
+    int shift;
+    int round; // 2**(shift-1)
+    int yOffset; // Video black level
+    int cOffset; // Zero colour difference
+    int maxValue;
+  };
+
+  const int roundToInt(double value) {
+    return static_cast<int>(std::floor(value+0.5));
+  }
+
+  // Red and blue weights of luma for a colour matrix (green is 1-kr-kb)
+  void lumaWeights(ColourMatrix matrix, double& kr, double& kb) {
+    switch (matrix) {
+      case BT601:
+        kr = 0.299;
+        kb = 0.114;
+        break;
+      case BT709:
+        kr = 0.2126;
+        kb = 0.0722;
+        break;
+      case BT2020:
+        kr = 0.2627;
+        kb = 0.0593;
+        break;
+      default:
+        throw std::invalid_argument("invalid colour matrix");
+    }
+  }
+
+  const Coefficients coefficients(ColourMatrix matrix, int bitDepth) {
+    if ((bitDepth<8) || (bitDepth>16)) {
+      throw std::invalid_argument("colour conversion bit depth must be in the range 8 to 16");
+    }
+    double kr, kb;
+    lumaWeights(matrix, kr, kb);
+    Coefficients k;
+    // Precision of the coefficients follows that of the samples, but is
+    // limited so that the weighted sums cannot overflow an int.
+    k.shift = (bitDepth<14) ? bitDepth : 14;
+    k.round = 1<<(k.shift-1);
+    k.yOffset = 16<<(bitDepth-8);
+    k.cOffset = 1<<(bitDepth-1);
+    k.maxValue = (1<<bitDepth)-1;
+    // Scale full range RGB to video range luma (219) and chroma (224)
+    const double yScale = (1<<k.shift)*static_cast<double>(219<<(bitDepth-8))/k.maxValue;
+    const double cScale = (1<<k.shift)*static_cast<double>(224<<(bitDepth-8))/k.maxValue;
+    // Green coefficients are chosen so that greys have exactly zero colour
+    // difference and full scale white maps to (rounded) peak white.
+    k.yr = roundToInt(yScale*kr);
+    k.yb = roundToInt(yScale*kb);
+    k.yg = roundToInt(yScale) - k.yr - k.yb;
+    k.ur = roundToInt(-cScale*kr/(2.0*(1.0-kb)));
+    k.ub = roundToInt(cScale*0.5);
+    k.ug = -k.ur - k.ub;
+    k.vr = roundToInt(cScale*0.5);
+    k.vb = roundToInt(-cScale*kb/(2.0*(1.0-kr)));
+    k.vg = -k.vr - k.vb;
+    return k;
+  }
+
+  // Integer inverse conversion coefficients, scaled by 2**shift
+  struct InverseCoefficients {
+    int ry, rv;
+    int gy, gu, gv;
+    int by, bu;
+    int shift;
+    int round; // 2**(shift-1)
+    int yOffset; // Video black level
+    int cOffset; // Zero colour difference
+    int maxValue;
+  };
+
+  const InverseCoefficients inverseCoefficients(ColourMatrix matrix, int bitDepth) {
+    // Forward coefficients check the parameters and provide the offsets
+    const Coefficients forward = coefficients(matrix, bitDepth);
+    double kr, kb;
+    lumaWeights(matrix, kr, kb);
+    const double kg = 1.0 - kr - kb;
+    InverseCoefficients k;
+    // Inverse coefficients are up to about 2.1, so need one bit less
+    // precision than the forward ones to avoid overflow.
+    k.shift = (bitDepth<13) ? bitDepth : 13;
+    k.round = 1<<(k.shift-1);
+    k.yOffset = forward.yOffset;
+    k.cOffset = forward.cOffset;
+    k.maxValue = forward.maxValue;
+    // Scale video range luma (219) and chroma (224) to full range RGB
+    const double yScale = (1<<k.shift)*static_cast<double>(k.maxValue)/(219<<(bitDepth-8));
+    const double cScale = (1<<k.shift)*static_cast<double>(k.maxValue)/(224<<(bitDepth-8));
+    k.ry = k.gy = k.by = roundToInt(yScale);
+    k.rv = roundToInt(cScale*2.0*(1.0-kr));
+    k.gu = roundToInt(-cScale*2.0*(1.0-kb)*kb/kg);
+    k.gv = roundToInt(-cScale*2.0*(1.0-kr)*kr/kg);
+    k.bu = roundToInt(cScale*2.0*(1.0-kb));
+    return k;
+  }
+
+  inline int clamp(int value, int maxValue) {
+    return (value<0) ? 0 : ((value>maxValue) ? maxValue : value);
+  }
+
+  // Separate a line of packed RGB into three contiguous lines
+  void deinterleaveLine(const int* rgb, int width, int* r, int* g, int* b) {
+    for (int pixel=0; pixel<width; ++pixel) {
+      r[pixel] = rgb[3*pixel];
+      g[pixel] = rgb[3*pixel+1];
+      b[pixel] = rgb[3*pixel+2];
+    }
+  }
+
+  // Matrix a line of separated RGB to clipped luma and unclipped, full
+  // resolution, colour difference signals (ready for filtering).
+  // Each output is produced by its own loop over contiguous samples. The
+  // coefficients are copied to locals so the compiler knows the outputs
+  // cannot alias them.
+  void matrixLine(const int* r, const int* g, const int* b, int width,
+                  const Coefficients& k, int* y, int* cb, int* cr) {
+    const int shift = k.shift;
+    const int round = k.round;
+    const int maxValue = k.maxValue;
+    const int yOffset = k.yOffset;
+    const int cOffset = k.cOffset;
+    const int yr = k.yr, yg = k.yg, yb = k.yb;
+    const int ur = k.ur, ug = k.ug, ub = k.ub;
+    const int vr = k.vr, vg = k.vg, vb = k.vb;
+    for (int pixel=0; pixel<width; ++pixel) {
+      y[pixel] = clamp(((yr*r[pixel] + yg*g[pixel] + yb*b[pixel] + round) >> shift) + yOffset, maxValue);
+    }
+    for (int pixel=0; pixel<width; ++pixel) {
+      cb[pixel] = ((ur*r[pixel] + ug*g[pixel] + ub*b[pixel] + round) >> shift) + cOffset;
+    }
+    for (int pixel=0; pixel<width; ++pixel) {
+      cr[pixel] = ((vr*r[pixel] + vg*g[pixel] + vb*b[pixel] + round) >> shift) + cOffset;
+    }
+  }
+
+  // Matrix a line of packed RGB, separating it first into "planes", which
+  // holds three lines of scratch space.
+  void matrixLine(const int* rgb, int width, const Coefficients& k,
+                  std::vector<int>& planes, int* y, int* cb, int* cr) {
+    int* r = &planes[0];
+    int* g = r + width;
+    int* b = g + width;
+    deinterleaveLine(rgb, width, r, g, b);
+    matrixLine(r, g, b, width, k, y, cb, cr);
+  }
+
+  // Filter a line [1,2,1]/4 and subsample by 2, keeping the even samples.
+  // "edge" is the value to the left of the line. The line must have at least
+  // 2*outWidth samples, so no value is needed to the right.
+  void subsampleLine(const int* line, int outWidth, int edge, int* out) {
+    if (outWidth<1) return;
+    out[0] = (edge + 2*line[0] + line[1] + 2) >> 2;
+    for (int i=1; i<outWidth; ++i) {
+      out[i] = (line[2*i-1] + 2*line[2*i] + line[2*i+1] + 2) >> 2;
+    }
+  }
+
+  // Filter vertically [1,2,1]/4 (the subsampling is done by the caller) and clip
+  void verticalFilter(const int* above, const int* centre, const int* below,
+                      int width, int maxValue, int* out) {
+    for (int i=0; i<width; ++i) {
+      out[i] = clamp((above[i] + 2*centre[i] + below[i] + 2) >> 2, maxValue);
+    }
+  }
+
+  void clipLine(const int* line, int width, int maxValue, int* out) {
+    for (int i=0; i<width; ++i) {
+      out[i] = clamp(line[i], maxValue);
+    }
+  }
+
+  // RGB pictures just need the components separated
+  void separate(const Array2D& rgb, Picture& picture) {
+    const int height = picture.format().lumaHeight();
+    const int width = picture.format().lumaWidth();
+    for (int line=0; line<height; ++line) {
+      const int* in = &rgb[line][0];
+      deinterleaveLine(in, width, &picture.y()[line][0],
+                       &picture.c1()[line][0], &picture.c2()[line][0]);
+    }
+  }
+
+  // Store a sample, most significant byte first
+  inline unsigned char* pack(int value, int bytes, unsigned char* out) {
+    if (bytes==2) *out++ = static_cast<unsigned char>(value>>8);
+    *out++ = static_cast<unsigned char>(value);
+    return out;
+  }
+
+  // Clip a line of chroma samples and remove the offset. If "below" is not
+  // null the result is the average of "above" and "below" (for lines between
+  // 4:2:0 chroma lines). The sample after the end of the line is set to zero,
+  // so upsampling can read one sample beyond the last.
+  void chromaLine(const int* above, const int* below, int width,
+                  int offset, int maxValue, int* out) {
+    if (below) {
+      for (int i=0; i<width; ++i) {
+        out[i] = ((clamp(above[i], maxValue)-offset) + (clamp(below[i], maxValue)-offset) + 1) >> 1;
+      }
+    }
+    else {
+      for (int i=0; i<width; ++i) {
+        out[i] = clamp(above[i], maxValue)-offset;
+      }
+    }
+    out[width] = 0;
+  }
+
+} // end unnamed namespace
+
+void rgbToYCbCr(const Array2D& rgb, ColourMatrix matrix, int bitDepth, Picture& picture) {
+  const PictureFormat format = picture.format();
+  const int height = format.lumaHeight();
+  const int width = format.lumaWidth();
+  const int chromaHeight = format.chromaHeight();
+  const int chromaWidth = format.chromaWidth();
+  if ((static_cast<int>(rgb.shape()[0])!=height) ||
+      (static_cast<int>(rgb.shape()[1])!=3*width)) {
+    throw std::invalid_argument("rgbToYCbCr: RGB array does not match the picture size");
+  }
+  if ((height==0) || (width==0)) return;
+  const Coefficients k = coefficients(matrix, bitDepth);
+  if (format.chromaFormat()==RGB) {
+    separate(rgb, picture);
+    return;
+  }
+  // Full resolution colour difference signals for one line
+  std::vector<int> cbLine(width), crLine(width);
+  // Separated R, G and B for one line
+  std::vector<int> planes(3*width);
+  switch (format.chromaFormat()) {
+    case CF444:
+      for (int line=0; line<height; ++line) {
+        matrixLine(&rgb[line][0], width, k, planes, &picture.y()[line][0], &cbLine[0], &crLine[0]);
+        clipLine(&cbLine[0], width, k.maxValue, &picture.c1()[line][0]);
+        clipLine(&crLine[0], width, k.maxValue, &picture.c2()[line][0]);
+      }
+      break;
+    case CF422: {
+      std::vector<int> cbSub(chromaWidth), crSub(chromaWidth);
+      for (int line=0; line<height; ++line) {
+        matrixLine(&rgb[line][0], width, k, planes, &picture.y()[line][0], &cbLine[0], &crLine[0]);
+        if (chromaWidth==0) continue;
+        subsampleLine(&cbLine[0], chromaWidth, k.cOffset, &cbSub[0]);
+        subsampleLine(&crLine[0], chromaWidth, k.cOffset, &crSub[0]);
+        clipLine(&cbSub[0], chromaWidth, k.maxValue, &picture.c1()[line][0]);
+        clipLine(&crSub[0], chromaWidth, k.maxValue, &picture.c2()[line][0]);
+      }
+      break;
+    }
+    case CF420: {
+      // Horizontally subsampled lines above, at and below each chroma line.
+      // The line above the picture has zero colour difference.
+      std::vector<int> cbAbove(chromaWidth, k.cOffset), cbCentre(chromaWidth), cbBelow(chromaWidth);
+      std::vector<int> crAbove(chromaWidth, k.cOffset), crCentre(chromaWidth), crBelow(chromaWidth);
+      for (int chromaLine=0; chromaLine<chromaHeight; ++chromaLine) {
+        const int line = 2*chromaLine;
+        matrixLine(&rgb[line][0], width, k, planes, &picture.y()[line][0], &cbLine[0], &crLine[0]);
+        subsampleLine(&cbLine[0], chromaWidth, k.cOffset, &cbCentre[0]);
+        subsampleLine(&crLine[0], chromaWidth, k.cOffset, &crCentre[0]);
+        matrixLine(&rgb[line+1][0], width, k, planes, &picture.y()[line+1][0], &cbLine[0], &crLine[0]);
+        subsampleLine(&cbLine[0], chromaWidth, k.cOffset, &cbBelow[0]);
+        subsampleLine(&crLine[0], chromaWidth, k.cOffset, &crBelow[0]);
+        if (chromaWidth>0) {
+          verticalFilter(&cbAbove[0], &cbCentre[0], &cbBelow[0], chromaWidth, k.maxValue,
+                         &picture.c1()[chromaLine][0]);
+          verticalFilter(&crAbove[0], &crCentre[0], &crBelow[0], chromaWidth, k.maxValue,
+                         &picture.c2()[chromaLine][0]);
+        }
+        // The line below becomes the line above the next chroma line
+        cbAbove.swap(cbBelow);
+        crAbove.swap(crBelow);
+      }
+      // Last line of a picture with an odd number of lines has no chroma
+      if (height>2*chromaHeight) {
+        const int line = height-1;
+        matrixLine(&rgb[line][0], width, k, planes, &picture.y()[line][0], &cbLine[0], &crLine[0]);
+      }
+      break;
+    }
+    default:
+      throw std::invalid_argument("rgbToYCbCr: invalid colour format");
+  }
+}
+
+const Picture rgbToYCbCr(const Array2D& rgb, ColourMatrix matrix, int bitDepth, ColourFormat format) {
+  const PictureFormat pictureFormat(rgb.shape()[0], rgb.shape()[1]/3, format);
+  Picture picture(pictureFormat);
+  rgbToYCbCr(rgb, matrix, bitDepth, picture);
+  return picture;
+}
+
+void yCbCrToRGB(const Picture& picture, ColourMatrix matrix, int bitDepth,
+                int line, int bytes, unsigned char* out) {
+  const PictureFormat format = picture.format();
+  const int height = format.lumaHeight();
+  const int width = format.lumaWidth();
+  if ((line<0) || (line>=height)) {
+    throw std::invalid_argument("yCbCrToRGB: line is outside the picture");
+  }
+  if ((bytes!=1) && (bytes!=2)) {
+    throw std::invalid_argument("yCbCrToRGB: bytes per sample must be 1 or 2");
+  }
+  const InverseCoefficients k = inverseCoefficients(matrix, bitDepth);
+  const int* y = &picture.y()[line][0];
+  if (format.chromaFormat()==RGB) {
+    const int* g = &picture.c1()[line][0];
+    const int* b = &picture.c2()[line][0];
+    for (int pixel=0; pixel<width; ++pixel) {
+      out = pack(clamp(y[pixel], k.maxValue), bytes, out);
+      out = pack(clamp(g[pixel], k.maxValue), bytes, out);
+      out = pack(clamp(b[pixel], k.maxValue), bytes, out);
+    }
+    return;
+  }
+  // Find the chroma line(s) for this picture line
+  const int chromaHeight = format.chromaHeight();
+  const int chromaWidth = format.chromaWidth();
+  int chromaRow = line; // For 4:4:4 and 4:2:2
+  int nextRow = -1; // Chroma line below, if this line is between chroma lines
+  switch (format.chromaFormat()) {
+    case CF444:
+    case CF422:
+      break;
+    case CF420:
+      chromaRow = line/2;
+      if (line%2) nextRow = chromaRow+1;
+      break;
+    default:
+      throw std::invalid_argument("yCbCrToRGB: invalid colour format");
+  }
+  // Colour difference signals for this line (with a zero after the end)
+  ArenaScope scope(ScratchArena::local());
+  int* const u = ScratchArena::local().allocate(chromaWidth+1);
+  int* const v = ScratchArena::local().allocate(chromaWidth+1);
+  if (chromaRow<chromaHeight) {
+    const bool between = ((nextRow>=0) && (nextRow<chromaHeight));
+    chromaLine(&picture.c1()[chromaRow][0], (between ? &picture.c1()[nextRow][0] : 0),
+               chromaWidth, k.cOffset, k.maxValue, u);
+    chromaLine(&picture.c2()[chromaRow][0], (between ? &picture.c2()[nextRow][0] : 0),
+               chromaWidth, k.cOffset, k.maxValue, v);
+    // The last line between chroma lines averages with zero colour difference
+    if ((nextRow>=0) && !between) {
+      for (int i=0; i<chromaWidth; ++i) {
+        u[i] = (u[i] + 1) >> 1;
+        v[i] = (v[i] + 1) >> 1;
+      }
+    }
+  }
+  else {
+    // No chroma (last line of a picture with an odd number of lines)
+    std::fill(u, u+chromaWidth+1, 0);
+    std::fill(v, v+chromaWidth+1, 0);
+  }
+  const bool upsample = (chromaWidth<width);
+  for (int pixel=0; pixel<width; ++pixel) {
+    int cb, cr;
+    if (!upsample) {
+      cb = u[pixel];
+      cr = v[pixel];
+    }
+    else if (pixel%2==0) {
+      // Co-sited with a chroma sample (or beyond the last, for odd widths)
+      const int i = (pixel/2<chromaWidth) ? pixel/2 : chromaWidth;
+      cb = u[i];
+      cr = v[i];
+    }
+    else {
+      cb = (u[pixel/2] + u[pixel/2+1] + 1) >> 1;
+      cr = (v[pixel/2] + v[pixel/2+1] + 1) >> 1;
+    }
+    const int luma = clamp(y[pixel], k.maxValue) - k.yOffset;
+    const int r = (k.ry*luma + k.rv*cr + k.round) >> k.shift;
+    const int g = (k.gy*luma + k.gu*cb + k.gv*cr + k.round) >> k.shift;
+    const int b = (k.by*luma + k.bu*cb + k.round) >> k.shift;
+    out = pack(clamp(r, k.maxValue), bytes, out);
+    out = pack(clamp(g, k.maxValue), bytes, out);
+    out = pack(clamp(b, k.maxValue), bytes, out);
+  }
+}
@@ -135,24 +135,24 @@ std::ostream& HQWrappedPictureIO(std::ostream& stream, const WrappedPicture& d)
   std::ostringstream ss;
   ss.copyfmt(stream);
 
-  //// Picture Header
-  //ss << Bytes(4, d.picture_number);
-
-  //// Transform Params
-  //ss << vlc::unbounded
-  //   << UnsignedVLC(d.wavelet_kernel)
-  //   << UnsignedVLC(d.depth)
-  //   << UnsignedVLC(d.slices_x)
-  //   << UnsignedVLC(d.slices_y)
-  //   << UnsignedVLC(d.slice_prefix)
-  //   << UnsignedVLC(d.slice_size_scalar)
-  //   << Boolean(false)
-  //   << vlc::align;
+  // Picture Header
+  ss << Bytes(4, d.picture_number);
+
+  // Transform Params (the slice prefix and scalar may vary between pictures)
+  ss << vlc::unbounded
+     << UnsignedVLC(d.wavelet_kernel)
+     << UnsignedVLC(d.depth)
+     << UnsignedVLC(d.slices_x)
+     << UnsignedVLC(d.slices_y)
+     << UnsignedVLC(d.slice_prefix)
+     << UnsignedVLC(d.slice_size_scalar)
+     << Boolean(false)
+     << vlc::align;
 
   // Transform Data
   ss << d.slices;
 
-  // stream << ParseInfoIO(HQ_PICTURE, ss.str().size());
+  stream << ParseInfoIO(HQ_PICTURE, ss.str().size());
 
   return (stream << ss.str());
 }
@@ -636,8 +636,7 @@ std::istream& operator >> (std::istream& stream, DataUnit &d) {
     d.strm.str(std::string(buf, sizeof(buf)));
   }
   */
-  Bytes prefix(4);
-  stream >> prefix;
+  // The parse info ends here, the data unit (e.g. a PicturePreamble) follows
 
   return stream;
 }
@@ -756,6 +755,7 @@ PicturePreamble::PicturePreamble()
 }
 
 std::istream& operator >> (std::istream& stream, PicturePreamble &hdr) {
+  stream >> vlc::unbounded; // The transform parameters are not a bounded block
   Bytes picture_number(4);
   stream >> picture_number;
   hdr.picture_number = picture_number;
@@ -0,0 +1,248 @@
+/*********************************************************************/
+/* Instrumentation.cpp                                               */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines lightweight per frame timing and counters for the         */
+/* encoder and decoder, exported as JSON lines and a counter dump.   */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include <ostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdio> // For rename, remove
+#include <climits>
+#include <stdexcept>
+
+#include "boost/date_time/posix_time/posix_time_types.hpp"
+
+#include "Instrumentation.h"
+
+namespace instrumentation {
+
+  namespace {
+
+    const char* const stageNames[numberOfStages] = {
+      "read", "transform", "rate_control", "quantise", "slice_pack", "write",
+      "slice_unpack", "inverse_quantise", "inverse_transform"};
+
+    const boost::posix_time::ptime now() {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    // Restores the format of a stream on destruction
+    class FormatSaver {
+      public:
+        FormatSaver(std::ostream& s):
+          os(s), flags(s.flags()), precision(s.precision()) {}
+        ~FormatSaver() {os.flags(flags); os.precision(precision);}
+      private:
+        std::ostream& os;
+        const std::ios_base::fmtflags flags;
+        const std::streamsize precision;
+    };
+
+  } // end unnamed namespace
+
+  const char* stageName(Stage stage) {
+    if ((stage<0) || (stage>=numberOfStages)) {
+      throw std::invalid_argument("instrumentation: unknown stage");
+    }
+    return stageNames[stage];
+  }
+
+  std::ostream& operator<<(std::ostream& os, Stage stage) {
+    return os << stageName(stage);
+  }
+
+  FrameStats::FrameStats(int frame):
+    frameNumber(frame), sliceCount(0), minBytes(0), maxBytes(0),
+    totalBytes(0), padding(0), codedKnown(false) {
+    for (int s=0; s<numberOfStages; ++s) {
+      stageTimed[s] = false;
+      stageSeconds[s] = 0.0;
+    }
+  }
+
+  void FrameStats::addTime(Stage stage, double seconds) {
+    stageTimed[stage] = true;
+    stageSeconds[stage] += seconds;
+  }
+
+  void FrameStats::slices(const Array2D& qIndices,
+                          const Array2D& sliceBytes,
+                          const Array2D& codedBytes) {
+    const int ySlices = qIndices.shape()[0];
+    const int xSlices = qIndices.shape()[1];
+    const bool haveBytes = (sliceBytes.num_elements()>0);
+    const bool haveCoded = (codedBytes.num_elements()>0);
+    if ( (haveBytes && (sliceBytes.num_elements()!=qIndices.num_elements())) ||
+         (haveCoded && (codedBytes.num_elements()!=qIndices.num_elements())) ) {
+      throw std::invalid_argument("FrameStats: slice arrays are different sizes");
+    }
+    sliceCount = ySlices*xSlices;
+    minBytes = (haveBytes ? INT_MAX : 0);
+    maxBytes = 0;
+    totalBytes = 0;
+    padding = 0;
+    codedKnown = (haveBytes && haveCoded);
+    histogram.clear();
+    for (int row=0; row<ySlices; ++row) {
+      for (int column=0; column<xSlices; ++column) {
+        ++histogram[qIndices[row][column]];
+        if (haveBytes) {
+          const int bytes = sliceBytes[row][column];
+          if (bytes<minBytes) minBytes = bytes;
+          if (bytes>maxBytes) maxBytes = bytes;
+          totalBytes += bytes;
+          if (haveCoded) padding += (bytes - codedBytes[row][column]);
+        }
+      }
+    }
+  }
+
+  std::ostream& operator<<(std::ostream& os, const FrameStats& stats) {
+    FormatSaver saver(os);
+    os << std::fixed << std::setprecision(3);
+    os << "{\"frame\":" << stats.frame();
+    os << ",\"stages_ms\":{";
+    bool first = true;
+    for (int s=0; s<numberOfStages; ++s) {
+      const Stage stage = static_cast<Stage>(s);
+      if (!stats.timed(stage)) continue;
+      if (!first) os << ",";
+      os << "\"" << stage << "\":" << 1000.0*stats.seconds(stage);
+      first = false;
+    }
+    os << "}";
+    const int slices = stats.numberOfSlices();
+    if (slices>0) {
+      os << ",\"slices\":" << slices;
+      os << ",\"slice_bytes\":{\"min\":" << stats.minSliceBytes()
+         << ",\"mean\":" << static_cast<double>(stats.totalSliceBytes())/slices
+         << ",\"max\":" << stats.maxSliceBytes()
+         << ",\"total\":" << stats.totalSliceBytes() << "}";
+      if (stats.paddingKnown()) os << ",\"padding_bytes\":" << stats.paddingBytes();
+      const std::map<int, int>& histogram = stats.qIndexHistogram();
+      long long sum = 0;
+      for (std::map<int, int>::const_iterator h=histogram.begin(); h!=histogram.end(); ++h) {
+        sum += static_cast<long long>(h->first)*h->second;
+      }
+      os << ",\"qindex\":{\"min\":" << histogram.begin()->first
+         << ",\"mean\":" << static_cast<double>(sum)/slices
+         << ",\"max\":" << histogram.rbegin()->first
+         << ",\"histogram\":[";
+      for (std::map<int, int>::const_iterator h=histogram.begin(); h!=histogram.end(); ++h) {
+        if (h!=histogram.begin()) os << ",";
+        os << "[" << h->first << "," << h->second << "]";
+      }
+      os << "]}";
+    }
+    os << "}";
+    return os;
+  }
+
+  StageTimer::StageTimer(FrameStats& s, Stage st):
+    stats(s), stage(st), start(now()), running(true) {
+  }
+
+  StageTimer::~StageTimer() {
+    if (running) stop();
+  }
+
+  void StageTimer::stop() {
+    if (!running) return;
+    running = false;
+    const boost::posix_time::time_duration elapsed = now() - start;
+    stats.addTime(stage, elapsed.total_microseconds()/1.0e6);
+  }
+
+  Counters::Counters():
+    frameCount(0), sliceCount(0), totalBytes(0), padding(0) {
+    for (int s=0; s<numberOfStages; ++s) {
+      stageCount[s] = 0;
+      stageTotal[s] = 0.0;
+      stageMax[s] = 0.0;
+    }
+  }
+
+  void Counters::add(const FrameStats& stats) {
+    ++frameCount;
+    for (int s=0; s<numberOfStages; ++s) {
+      const Stage stage = static_cast<Stage>(s);
+      if (!stats.timed(stage)) continue;
+      const double seconds = stats.seconds(stage);
+      ++stageCount[s];
+      stageTotal[s] += seconds;
+      if (seconds>stageMax[s]) stageMax[s] = seconds;
+    }
+    sliceCount += stats.numberOfSlices();
+    totalBytes += stats.totalSliceBytes();
+    padding += stats.paddingBytes();
+    const std::map<int, int>& frameHistogram = stats.qIndexHistogram();
+    for (std::map<int, int>::const_iterator h=frameHistogram.begin(); h!=frameHistogram.end(); ++h) {
+      histogram[h->first] += h->second;
+    }
+  }
+
+  std::ostream& operator<<(std::ostream& os, const Counters& counters) {
+    FormatSaver saver(os);
+    os << std::fixed << std::setprecision(6);
+    os << "vc2_frames_total " << counters.frameCount << "\n";
+    for (int s=0; s<numberOfStages; ++s) {
+      if (counters.stageCount[s]==0) continue;
+      const Stage stage = static_cast<Stage>(s);
+      os << "vc2_stage_frames_total{stage=\"" << stage << "\"} " << counters.stageCount[s] << "\n";
+      os << "vc2_stage_seconds_total{stage=\"" << stage << "\"} " << counters.stageTotal[s] << "\n";
+      os << "vc2_stage_seconds_max{stage=\"" << stage << "\"} " << counters.stageMax[s] << "\n";
+    }
+    os << "vc2_slices_total " << counters.sliceCount << "\n";
+    os << "vc2_slice_bytes_total " << counters.totalBytes << "\n";
+    os << "vc2_padding_bytes_total " << counters.padding << "\n";
+    for (std::map<int, long long>::const_iterator h=counters.histogram.begin();
+         h!=counters.histogram.end(); ++h) {
+      os << "vc2_qindex_slices_total{qindex=\"" << h->first << "\"} " << h->second << "\n";
+    }
+    return os;
+  }
+
+  StatsWriter::StatsWriter(std::ostream* jsonStream,
+                           const std::string& countersFileName,
+                           int p):
+    json(jsonStream), countersFile(countersFileName), period(p), unflushed(0) {
+    if (period<1) throw std::invalid_argument("StatsWriter: period must be > 0");
+  }
+
+  StatsWriter::~StatsWriter() {
+    try {
+      if (unflushed>0) flush();
+    }
+    catch (...) {} // Never throw from a destructor
+  }
+
+  void StatsWriter::record(const FrameStats& stats) {
+    totals.add(stats);
+    if (json) *json << stats << std::endl;
+    if (++unflushed>=period) flush();
+  }
+
+  // Write to a temporary file then rename it, so the counter file is always complete
+  void StatsWriter::flush() {
+    unflushed = 0;
+    if (countersFile.empty()) return;
+    const std::string tempFile = countersFile + ".tmp";
+    {
+      std::ofstream file(tempFile.c_str(), std::ios_base::out | std::ios_base::trunc);
+      file << totals;
+      if (!file) throw std::runtime_error("StatsWriter: failed to write \"" + tempFile + "\"");
+    }
+#ifdef _WIN32
+    std::remove(countersFile.c_str()); // rename does not replace files on Windows
+#endif
+    if (std::rename(tempFile.c_str(), countersFile.c_str())!=0) {
+      throw std::runtime_error("StatsWriter: failed to rename \"" + tempFile + "\"");
+    }
+  }
+
+} // end namespace instrumentation
@@ -0,0 +1,76 @@
+/*********************************************************************/
+/* Numa.cpp                                                          */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines the NUMA topology of the machine (the cores of each       */
+/* node, e.g. socket) and binding of threads to a node.              */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "Numa.h"
+
+#include <algorithm> // For max
+#include <cstdlib> // For atoi
+#include <fstream>
+#include <sstream>
+
+#include "boost/thread/thread.hpp"
+
+#if defined(__linux__)
+#include <pthread.h> // For pthread_setaffinity_np
+#include <sched.h> // For cpu_set_t
+#endif
+
+const CoreSet parseCoreList(const std::string& list) {
+  CoreSet cores;
+  std::istringstream ranges(list);
+  std::string range;
+  while (std::getline(ranges, range, ',')) {
+    if (range.find_first_of("0123456789")==std::string::npos) continue;
+    const std::string::size_type dash = range.find('-');
+    const int first = std::atoi(range.substr(0, dash).c_str());
+    const int last = (dash==std::string::npos) ? first : std::atoi(range.substr(dash+1).c_str());
+    for (int core=first; core<=last; ++core) cores.push_back(core);
+  }
+  return cores;
+}
+
+const std::vector<CoreSet> numaNodes() {
+  std::vector<CoreSet> nodes;
+#if defined(__linux__)
+  // Node numbers may have gaps, so stop after a run of missing nodes
+  for (int node=0, missing=0; missing<64; ++node) {
+    std::ostringstream fileName;
+    fileName << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::ifstream file(fileName.str().c_str());
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+      ++missing;
+      continue;
+    }
+    missing = 0;
+    const CoreSet cores = parseCoreList(list);
+    if (!cores.empty()) nodes.push_back(cores);
+  }
+#endif
+  if (nodes.empty()) {
+    const int cores = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+    CoreSet all;
+    for (int core=0; core<cores; ++core) all.push_back(core);
+    nodes.push_back(all);
+  }
+  return nodes;
+}
+
+void bindThread(const CoreSet& cores) {
+#if defined(__linux__)
+  if (cores.empty()) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (CoreSet::const_iterator core=cores.begin(); core!=cores.end(); ++core) {
+    if ((*core>=0) && (*core<CPU_SETSIZE)) CPU_SET(*core, &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
@@ -0,0 +1,450 @@
+/*********************************************************************/
+/* PackedIO.cpp                                                      */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines reading and writing of packed video formats (UYVY, v210   */
+/* and P010) directly from/to picture or transform buffers.          */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "PackedIO.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm> // For copy and fill
+#include <stdexcept> // For invalid_argument
+
+std::ostream& operator<<(std::ostream& os, PackedFormat format) {
+  const char* s;
+  switch (format) {
+    case UYVY:
+      s = "8 bit 4:2:2 UYVY (\"UYVY\")";
+      break;
+    case V210:
+      s = "10 bit 4:2:2 v210 (\"v210\")";
+      break;
+    case P010:
+      s = "10 bit 4:2:0 P010 (\"P010\")";
+      break;
+    default:
+      s = "Unknown packed format!";
+      break;
+  }
+  return os<<s;
+}
+
+std::istream& operator>>(std::istream& strm, PackedFormat& format) {
+  std::string text;
+  strm >> text;
+  if (text == "UYVY") format = UYVY;
+  else if (text == "v210") format = V210;
+  else if (text == "P010") format = P010;
+  else throw std::invalid_argument("invalid packed format");
+  return strm;
+}
+
+const ColourFormat packedColourFormat(PackedFormat format) {
+  switch (format) {
+    case UYVY:
+    case V210:
+      return CF422;
+    case P010:
+      return CF420;
+    default:
+      throw std::invalid_argument("invalid packed format");
+  }
+}
+
+const int packedBitDepth(PackedFormat format) {
+  switch (format) {
+    case UYVY:
+      return 8;
+    case V210:
+    case P010:
+      return 10;
+    default:
+      throw std::invalid_argument("invalid packed format");
+  }
+}
+
+namespace {
+
+  // Bytes in one line of a packed format (for P010, one line of each plane)
+  const int lineBytes(PackedFormat format, int width) {
+    switch (format) {
+      case UYVY:
+        return 2*width;
+      case V210:
+        return 128*((width+47)/48); // 48 pixels per 128 bytes
+      case P010:
+        return 2*width;
+      default:
+        throw std::invalid_argument("invalid packed format");
+    }
+  }
+
+  void checkSize(PackedFormat format, int height, int width) {
+    if ((height<1) || (width<1)) {
+      throw std::invalid_argument("packed picture height and width must be > 0");
+    }
+    if (width%2) {
+      throw std::invalid_argument("packed picture width must be even");
+    }
+    if ((packedColourFormat(format)==CF420) && (height%2)) {
+      throw std::invalid_argument("4:2:0 packed picture height must be even");
+    }
+  }
+
+  inline unsigned int word32(const unsigned char* p) {
+    return p[0] | (p[1]<<8) | (p[2]<<16) | (static_cast<unsigned int>(p[3])<<24);
+  }
+
+  // 16 bit little endian word with 10 bit data in the most significant bits
+  inline int word10(const unsigned char* p) {
+    return (p[0] | (p[1]<<8)) >> 6;
+  }
+
+  // The unpackers convert one line of bytes to samples.
+  // Each loop handles a whole group of samples so the compiler can unroll
+  // (and vectorise) it; partial groups at the end of a line are done separately.
+
+  template <class T>
+  void unpackUYVY(const unsigned char* in, int width, T* y, T* cb, T* cr) {
+    for (int pair=0; pair<width/2; ++pair) {
+      cb[pair] = in[4*pair];
+      y[2*pair] = in[4*pair+1];
+      cr[pair] = in[4*pair+2];
+      y[2*pair+1] = in[4*pair+3];
+    }
+  }
+
+  template <class T>
+  void unpackV210(const unsigned char* in, int width, T* y, T* cb, T* cr) {
+    const int groups = width/6; // Complete groups of 6 pixels
+    for (int group=0; group<groups; ++group) {
+      const unsigned char* const p = in + 16*group;
+      const unsigned int w0 = word32(p);
+      const unsigned int w1 = word32(p+4);
+      const unsigned int w2 = word32(p+8);
+      const unsigned int w3 = word32(p+12);
+      T* const yg = y + 6*group;
+      T* const cbg = cb + 3*group;
+      T* const crg = cr + 3*group;
+      cbg[0] = w0 & 0x3ff;
+      yg[0] = (w0>>10) & 0x3ff;
+      crg[0] = (w0>>20) & 0x3ff;
+      yg[1] = w1 & 0x3ff;
+      cbg[1] = (w1>>10) & 0x3ff;
+      yg[2] = (w1>>20) & 0x3ff;
+      crg[1] = w2 & 0x3ff;
+      yg[3] = (w2>>10) & 0x3ff;
+      cbg[2] = (w2>>20) & 0x3ff;
+      yg[4] = w3 & 0x3ff;
+      crg[2] = (w3>>10) & 0x3ff;
+      yg[5] = (w3>>20) & 0x3ff;
+    }
+    // Remaining 2 or 4 pixels: unpack the last group's 12 samples, in order,
+    // and keep those that are in the picture.
+    const int remaining = width - 6*groups;
+    if (remaining>0) {
+      const unsigned char* const p = in + 16*groups;
+      int samples[12];
+      for (int w=0; w<4; ++w) {
+        const unsigned int word = word32(p+4*w);
+        samples[3*w] = word & 0x3ff;
+        samples[3*w+1] = (word>>10) & 0x3ff;
+        samples[3*w+2] = (word>>20) & 0x3ff;
+      }
+      // Sample order is Cb Y Cr Y for each pair of pixels
+      for (int pair=0; pair<remaining/2; ++pair) {
+        cb[3*groups+pair] = samples[4*pair];
+        y[6*groups+2*pair] = samples[4*pair+1];
+        cr[3*groups+pair] = samples[4*pair+2];
+        y[6*groups+2*pair+1] = samples[4*pair+3];
+      }
+    }
+  }
+
+  template <class T>
+  void unpackP010Luma(const unsigned char* in, int width, T* y) {
+    for (int pixel=0; pixel<width; ++pixel) {
+      y[pixel] = word10(in+2*pixel);
+    }
+  }
+
+  template <class T>
+  void unpackP010Chroma(const unsigned char* in, int chromaWidth, T* cb, T* cr) {
+    for (int pixel=0; pixel<chromaWidth; ++pixel) {
+      cb[pixel] = word10(in+4*pixel);
+      cr[pixel] = word10(in+4*pixel+2);
+    }
+  }
+
+  // Fill the part of a component outside a height by width picture by edge
+  // extension (the same as waveletPad)
+  template <class Array>
+  void extendEdges(Array& component, int height, int width) {
+    const int paddedHeight = component.shape()[0];
+    const int paddedWidth = component.shape()[1];
+    if (width<paddedWidth) {
+      for (int line=0; line<height; ++line) {
+        typename Array::element* const row = &component[line][0];
+        std::fill(row+width, row+paddedWidth, row[width-1]);
+      }
+    }
+    const typename Array::element* const last = &component[height-1][0];
+    for (int line=height; line<paddedHeight; ++line) {
+      std::copy(last, last+paddedWidth, &component[line][0]);
+    }
+  }
+
+  template <class Array>
+  void checkComponent(const Array& component, int height, int width) {
+    if ((static_cast<int>(component.shape()[0])<height) ||
+        (static_cast<int>(component.shape()[1])<width)) {
+      throw std::invalid_argument("readPacked: picture components are too small");
+    }
+  }
+
+  // Read a line of bytes. Returns false (with the stream failbit set) at end of input
+  bool readLine(std::istream& stream, std::vector<unsigned char>& line) {
+    stream.read(reinterpret_cast<char*>(&line[0]), line.size());
+    return static_cast<bool>(stream);
+  }
+
+  template <class Array>
+  std::istream& readPacked(std::istream& stream, PackedFormat format,
+                           int height, int width,
+                           Array& y, Array& c1, Array& c2) {
+    checkSize(format, height, width);
+    const int chromaHeight = (packedColourFormat(format)==CF420) ? height/2 : height;
+    const int chromaWidth = width/2;
+    checkComponent(y, height, width);
+    checkComponent(c1, chromaHeight, chromaWidth);
+    checkComponent(c2, chromaHeight, chromaWidth);
+    std::vector<unsigned char> line(lineBytes(format, width));
+    switch (format) {
+      case UYVY:
+        for (int row=0; row<height; ++row) {
+          if (!readLine(stream, line)) return stream;
+          unpackUYVY(&line[0], width, &y[row][0], &c1[row][0], &c2[row][0]);
+        }
+        break;
+      case V210:
+        for (int row=0; row<height; ++row) {
+          if (!readLine(stream, line)) return stream;
+          unpackV210(&line[0], width, &y[row][0], &c1[row][0], &c2[row][0]);
+        }
+        break;
+      case P010:
+        for (int row=0; row<height; ++row) {
+          if (!readLine(stream, line)) return stream;
+          unpackP010Luma(&line[0], width, &y[row][0]);
+        }
+        for (int row=0; row<chromaHeight; ++row) {
+          if (!readLine(stream, line)) return stream;
+          unpackP010Chroma(&line[0], chromaWidth, &c1[row][0], &c2[row][0]);
+        }
+        break;
+      default:
+        throw std::invalid_argument("invalid packed format");
+    }
+    extendEdges(y, height, width);
+    extendEdges(c1, chromaHeight, chromaWidth);
+    extendEdges(c2, chromaHeight, chromaWidth);
+    return stream;
+  }
+
+  // Converts samples to the bit depth of an output format, with clipping.
+  // The clipping and rounding are done together so the packers have a
+  // single, branch free, expression per sample.
+  class SampleConverter {
+    public:
+      SampleConverter(int bitDepth, int outDepth):
+        maxValue((1<<bitDepth)-1),
+        downShift((bitDepth>outDepth) ? bitDepth-outDepth : 0),
+        upShift((outDepth>bitDepth) ? outDepth-bitDepth : 0),
+        round(downShift ? 1<<(downShift-1) : 0),
+        outMax((1<<outDepth)-1) {
+        if ((bitDepth<1) || (bitDepth>16)) {
+          throw std::invalid_argument("bit depth must be in the range 1 to 16");
+        }
+      }
+      int operator()(int value) const {
+        const int clipped = (value<0) ? 0 : ((value>maxValue) ? maxValue : value);
+        const int rounded = ((clipped + round) >> downShift) << upShift;
+        return (rounded>outMax) ? outMax : rounded;
+      }
+    private:
+      const int maxValue;
+      const int downShift;
+      const int upShift;
+      const int round;
+      const int outMax;
+  };
+
+  inline void putWord32(unsigned int word, unsigned char* p) {
+    p[0] = static_cast<unsigned char>(word);
+    p[1] = static_cast<unsigned char>(word>>8);
+    p[2] = static_cast<unsigned char>(word>>16);
+    p[3] = static_cast<unsigned char>(word>>24);
+  }
+
+  // 16 bit little endian word with 10 bit data in the most significant bits
+  inline void putWord10(int value, unsigned char* p) {
+    const unsigned int word = static_cast<unsigned int>(value)<<6;
+    p[0] = static_cast<unsigned char>(word);
+    p[1] = static_cast<unsigned char>(word>>8);
+  }
+
+  void packUYVY(const int* y, const int* cb, const int* cr, int width,
+                const SampleConverter& convert, unsigned char* out) {
+    for (int pair=0; pair<width/2; ++pair) {
+      out[4*pair] = static_cast<unsigned char>(convert(cb[pair]));
+      out[4*pair+1] = static_cast<unsigned char>(convert(y[2*pair]));
+      out[4*pair+2] = static_cast<unsigned char>(convert(cr[pair]));
+      out[4*pair+3] = static_cast<unsigned char>(convert(y[2*pair+1]));
+    }
+  }
+
+  // "out" must be zeroed beforehand, for the padding at the end of the line
+  void packV210(const int* y, const int* cb, const int* cr, int width,
+                const SampleConverter& convert, unsigned char* out) {
+    const int groups = width/6; // Complete groups of 6 pixels
+    for (int group=0; group<groups; ++group) {
+      const int* const yg = y + 6*group;
+      const int* const cbg = cb + 3*group;
+      const int* const crg = cr + 3*group;
+      unsigned char* const p = out + 16*group;
+      putWord32(convert(cbg[0]) | (convert(yg[0])<<10) | (convert(crg[0])<<20), p);
+      putWord32(convert(yg[1]) | (convert(cbg[1])<<10) | (convert(yg[2])<<20), p+4);
+      putWord32(convert(crg[1]) | (convert(yg[3])<<10) | (convert(cbg[2])<<20), p+8);
+      putWord32(convert(yg[4]) | (convert(crg[2])<<10) | (convert(yg[5])<<20), p+12);
+    }
+    // Remaining 2 or 4 pixels: pack their samples, in order, into the last
+    // group with the unused samples zero.
+    const int remaining = width - 6*groups;
+    if (remaining>0) {
+      int samples[12] = {0};
+      // Sample order is Cb Y Cr Y for each pair of pixels
+      for (int pair=0; pair<remaining/2; ++pair) {
+        samples[4*pair] = convert(cb[3*groups+pair]);
+        samples[4*pair+1] = convert(y[6*groups+2*pair]);
+        samples[4*pair+2] = convert(cr[3*groups+pair]);
+        samples[4*pair+3] = convert(y[6*groups+2*pair+1]);
+      }
+      unsigned char* const p = out + 16*groups;
+      for (int w=0; w<4; ++w) {
+        putWord32(samples[3*w] | (samples[3*w+1]<<10) | (samples[3*w+2]<<20), p+4*w);
+      }
+    }
+  }
+
+  void packP010Luma(const int* y, int width, const SampleConverter& convert, unsigned char* out) {
+    for (int pixel=0; pixel<width; ++pixel) {
+      putWord10(convert(y[pixel]), out+2*pixel);
+    }
+  }
+
+  void packP010Chroma(const int* cb, const int* cr, int chromaWidth,
+                      const SampleConverter& convert, unsigned char* out) {
+    for (int pixel=0; pixel<chromaWidth; ++pixel) {
+      putWord10(convert(cb[pixel]), out+4*pixel);
+      putWord10(convert(cr[pixel]), out+4*pixel+2);
+    }
+  }
+
+  void packPlanar16(const int* component, int width,
+                    const SampleConverter& convert, unsigned char* out) {
+    for (int pixel=0; pixel<width; ++pixel) {
+      const int value = convert(component[pixel]);
+      out[2*pixel] = static_cast<unsigned char>(value>>8);
+      out[2*pixel+1] = static_cast<unsigned char>(value);
+    }
+  }
+
+  // Write a line of bytes. Returns false (with the stream badbit set) on failure
+  bool writeLine(std::ostream& stream, const std::vector<unsigned char>& line) {
+    stream.write(reinterpret_cast<const char*>(&line[0]), line.size());
+    return static_cast<bool>(stream);
+  }
+
+} // end unnamed namespace
+
+const int packedPictureBytes(PackedFormat format, int height, int width) {
+  checkSize(format, height, width);
+  if (format==P010) return (height + height/2)*lineBytes(format, width);
+  return height*lineBytes(format, width);
+}
+
+std::istream& readPacked(std::istream& stream, PackedFormat format,
+                         int height, int width, Picture& picture) {
+  return readPacked(stream, format, height, width, picture.y(), picture.c1(), picture.c2());
+}
+
+std::istream& readPacked(std::istream& stream, PackedFormat format,
+                         int height, int width, ShortPicture& picture) {
+  return readPacked(stream, format, height, width, picture.y(), picture.c1(), picture.c2());
+}
+
+std::ostream& writePacked(std::ostream& stream, PackedFormat format,
+                          const Picture& picture, int bitDepth) {
+  const PictureFormat picFormat = picture.format();
+  const int height = picFormat.lumaHeight();
+  const int width = picFormat.lumaWidth();
+  checkSize(format, height, width);
+  if (picFormat.chromaFormat()!=packedColourFormat(format)) {
+    throw std::invalid_argument("writePacked: picture colour format does not match the packed format");
+  }
+  const SampleConverter convert(bitDepth, packedBitDepth(format));
+  const Array2D& y = picture.y();
+  const Array2D& c1 = picture.c1();
+  const Array2D& c2 = picture.c2();
+  std::vector<unsigned char> line(lineBytes(format, width), 0);
+  switch (format) {
+    case UYVY:
+      for (int row=0; row<height; ++row) {
+        packUYVY(&y[row][0], &c1[row][0], &c2[row][0], width, convert, &line[0]);
+        if (!writeLine(stream, line)) return stream;
+      }
+      break;
+    case V210:
+      for (int row=0; row<height; ++row) {
+        packV210(&y[row][0], &c1[row][0], &c2[row][0], width, convert, &line[0]);
+        if (!writeLine(stream, line)) return stream;
+      }
+      break;
+    case P010:
+      for (int row=0; row<height; ++row) {
+        packP010Luma(&y[row][0], width, convert, &line[0]);
+        if (!writeLine(stream, line)) return stream;
+      }
+      for (int row=0; row<picFormat.chromaHeight(); ++row) {
+        packP010Chroma(&c1[row][0], &c2[row][0], picFormat.chromaWidth(), convert, &line[0]);
+        if (!writeLine(stream, line)) return stream;
+      }
+      break;
+    default:
+      throw std::invalid_argument("invalid packed format");
+  }
+  return stream;
+}
+
+std::ostream& writePlanar16(std::ostream& stream, const Picture& picture, int bitDepth) {
+  const PictureFormat picFormat = picture.format();
+  const SampleConverter convert(bitDepth, 16);
+  const Array2D* const components[3] = {&picture.y(), &picture.c1(), &picture.c2()};
+  for (int c=0; c<3; ++c) {
+    const int height = (c==0) ? picFormat.lumaHeight() : picFormat.chromaHeight();
+    const int width = (c==0) ? picFormat.lumaWidth() : picFormat.chromaWidth();
+    if ((height==0) || (width==0)) continue;
+    std::vector<unsigned char> line(2*width);
+    for (int row=0; row<height; ++row) {
+      packPlanar16(&(*components[c])[row][0], width, convert, &line[0]);
+      if (!writeLine(stream, line)) return stream;
+    }
+  }
+  return stream;
+}
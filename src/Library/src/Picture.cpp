@@ -16,6 +16,9 @@
 #include "Picture.h"
 #include "FrameResolutions.h" //List of frame resolutions (frameResolutions)
 #include "Utils.h"
+#include "TaskScheduler.h"
+
+#include "boost/bind.hpp"
 
 std::ostream& operator<<(std::ostream& os, ColourFormat format) {
   const char* s;
@@ -200,6 +203,18 @@ const Array2D& Picture::c2() const {
   return chroma2;
 }
 
+Array2D& Picture::y() {
+  return luma;
+}
+
+Array2D& Picture::c1() {
+  return chroma1;
+}
+
+Array2D& Picture::c2() {
+  return chroma2;
+}
+
 void Picture::y(const Array2D& arg) {
   if (shape(arg)[0]!=picFormat.lumaHeight()) {
     throw std::invalid_argument("wrong luma height");
@@ -230,6 +245,43 @@ void Picture::c2(const Array2D& arg) {
   chroma2 = arg;
 }
 
+ShortPicture::ShortPicture() {}
+
+ShortPicture::ShortPicture(const PictureFormat& f):
+  picFormat(f),
+  luma(f.lumaShape()),
+  chroma1(f.chromaShape()),
+  chroma2(f.chromaShape()) {
+}
+
+PictureFormat ShortPicture::format() const {
+  return picFormat;
+}
+
+const ShortArray2D& ShortPicture::y() const {
+  return luma;
+}
+
+const ShortArray2D& ShortPicture::c1() const {
+  return chroma1;
+}
+
+const ShortArray2D& ShortPicture::c2() const {
+  return chroma2;
+}
+
+ShortArray2D& ShortPicture::y() {
+  return luma;
+}
+
+ShortArray2D& ShortPicture::c1() {
+  return chroma1;
+}
+
+ShortArray2D& ShortPicture::c2() {
+  return chroma2;
+}
+
 // Get the shape of a 2D PictureArray
 const Shape2D shape(const PictureArray& arg) {
   const Shape2D result = {{static_cast<Index>(arg.shape()[0]), static_cast<Index>(arg.shape()[1])}};
@@ -278,6 +330,82 @@ const Picture merge_blocks(const PictureArray& blocks) {
   return Picture(pictureFormat, luma, chroma1, chroma2);
 }
 
+namespace {
+
+  // Copy rows [firstRow, lastRow) of slices out of a picture
+  void split_rows(const Picture* picture, PictureArray* slices, int firstRow, int lastRow) {
+    const int ySlices = slices->shape()[0];
+    const int xSlices = slices->shape()[1];
+    const Array2D* const components[3] = {&picture->y(), &picture->c1(), &picture->c2()};
+    for (int c=0; c<3; ++c) {
+      const Array2D& component = *components[c];
+      const int height = component.shape()[0];
+      const int width = component.shape()[1];
+      // Note Range(left, right) defines the half open range [left, right),
+      // i.e. the rightmost element is not included
+      for (int y=firstRow; y<lastRow; ++y) {
+        const int top = (y*height)/ySlices;
+        const int bottom = ((y+1)*height)/ySlices;
+        for (int x=0, left=0, right=width/xSlices;
+             x<xSlices;
+             ++x, left=right, right=((x+1)*width/xSlices) ) {
+          Picture& slice = (*slices)[y][x];
+          Array2D& block = (c==0) ? slice.y() : ((c==1) ? slice.c1() : slice.c2());
+          block = component[indices[Range(top,bottom)][Range(left,right)]];
+        }
+      }
+    }
+  }
+
+  // Copy rows [firstRow, lastRow) of slices into a picture
+  void merge_rows(const PictureArray* blocks, Picture* picture, int firstRow, int lastRow) {
+    const int xSlices = blocks->shape()[1];
+    for (int c=0; c<3; ++c) {
+      Array2D& component = (c==0) ? picture->y() : ((c==1) ? picture->c1() : picture->c2());
+      // Top of the first row is the sum of the heights of the rows above
+      int top = 0;
+      for (int y=0; y<firstRow; ++y) {
+        const Picture& slice = (*blocks)[y][0];
+        top += ((c==0) ? slice.y() : ((c==1) ? slice.c1() : slice.c2())).shape()[0];
+      }
+      int bottom;
+      for (int y=firstRow; y<lastRow; ++y, top=bottom) {
+        int right;
+        for (int x=0, left=0; x<xSlices; ++x, left=right) {
+          const Picture& slice = (*blocks)[y][x];
+          const Array2D& block = (c==0) ? slice.y() : ((c==1) ? slice.c1() : slice.c2());
+          bottom = top + block.shape()[0];
+          right = left + block.shape()[1];
+          component[indices[Range(top,bottom)][Range(left,right)]] = block;
+        }
+      }
+    }
+  }
+
+} // end unnamed namespace
+
+// Copy a picture into an existing array of slices.
+// The slices must already have the right shapes (e.g. from Slices(PictureFormat, ...)).
+void split_into_blocks(const Picture& picture, PictureArray& slices) {
+  split_rows(&picture, &slices, 0, slices.shape()[0]);
+}
+
+void split_into_blocks(const Picture& picture, PictureArray& slices, TaskScheduler& scheduler) {
+  parallel_for(scheduler, 0, slices.shape()[0],
+               boost::bind(&split_rows, &picture, &slices, _1, _2));
+}
+
+// Copy an array of slices into an existing picture (the inverse of the above).
+// The picture must already be the size of the merged slices.
+void merge_blocks(const PictureArray& blocks, Picture& picture) {
+  merge_rows(&blocks, &picture, 0, blocks.shape()[0]);
+}
+
+void merge_blocks(const PictureArray& blocks, Picture& picture, TaskScheduler& scheduler) {
+  parallel_for(scheduler, 0, blocks.shape()[0],
+               boost::bind(&merge_rows, &blocks, &picture, _1, _2));
+}
+
 // Clip a Picture to specified limits
 // First function clips all components to the same values (good for RGB)
 const Picture clip(const Picture& picture, const int min_value, const int max_value) {
@@ -299,6 +427,21 @@ const Picture clip(const Picture& picture,
   return result;
 }
 
+void clip(const Picture& picture, const int min_value, const int max_value, Picture& result) {
+  clip(picture.y(), min_value, max_value, result.y());
+  clip(picture.c1(), min_value, max_value, result.c1());
+  clip(picture.c2(), min_value, max_value, result.c2());
+}
+
+void clip(const Picture& picture,
+          const int luma_min, const int luma_max,
+          const int chroma_min, const int chroma_max,
+          Picture& result) {
+  clip(picture.y(), luma_min, luma_max, result.y());
+  clip(picture.c1(), chroma_min, chroma_max, result.c1());
+  clip(picture.c2(), chroma_min, chroma_max, result.c2());
+}
+
 //**************** IO functions ****************//
 
 namespace {
@@ -0,0 +1,233 @@
+/*********************************************************************/
+/* QualityMonitor.cpp                                                */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines measurement, in the encoder, of the quality of coded      */
+/* pictures: reconstruction from the quantised coefficients on a     */
+/* worker thread, and per component PSNR.                            */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "QualityMonitor.h"
+
+#include <ostream>
+#include <algorithm> // For copy
+#include <stdexcept> // For runtime_error, invalid_argument, logic_error
+
+#include "Quantisation.h"
+#include "RateControl.h" // For squared_error and psnr
+
+PictureQuality::PictureQuality():
+  picture(0), bitDepth(8) {
+  for (int c=0; c<3; ++c) {
+    squaredError[c] = 0.0;
+    samples[c] = 0.0;
+  }
+}
+
+const double PictureQuality::mse(int component) const {
+  return (samples[component]>0.0) ? squaredError[component]/samples[component] : 0.0;
+}
+
+const double PictureQuality::psnr(int component) const {
+  return ::psnr(squaredError[component], samples[component], bitDepth);
+}
+
+const double PictureQuality::psnr() const {
+  return ::psnr(squaredError[0]+squaredError[1]+squaredError[2],
+                samples[0]+samples[1]+samples[2], bitDepth);
+}
+
+namespace {
+
+  const char* const componentNames[3] = {"y", "c1", "c2"};
+
+  // Write a PSNR as a JSON number, or null if infinite
+  void writePSNR(std::ostream& os, const char* name, double value) {
+    os << '"' << name << "\":";
+    if (value<=1.0e300) os << value;
+    else os << "null";
+  }
+
+} // end unnamed namespace
+
+std::ostream& operator<<(std::ostream& os, const PictureQuality& quality) {
+  os << "{\"picture\":" << quality.picture << ",\"mse\":{";
+  for (int c=0; c<3; ++c) {
+    if (c) os << ',';
+    os << '"' << componentNames[c] << "\":" << quality.mse(c);
+  }
+  os << "},\"psnr\":{";
+  for (int c=0; c<3; ++c) {
+    writePSNR(os, componentNames[c], quality.psnr(c));
+    os << ',';
+  }
+  writePSNR(os, "yuv", quality.psnr());
+  os << "}}";
+  return os;
+}
+
+namespace {
+
+  void copy_field(const Array2D& frame, int field, Array2D& picture) {
+    const int height = picture.shape()[0];
+    const int width = picture.shape()[1];
+    if ((static_cast<int>(frame.shape()[1])!=width) ||
+        (static_cast<int>(frame.shape()[0])<2*height)) {
+      throw std::invalid_argument("copy_field: picture is not the size of a field of the frame");
+    }
+    for (int y=0; y<height; ++y) {
+      const int* const from = frame.data() + (2*y+field)*width;
+      std::copy(from, from+width, picture.data() + y*width);
+    }
+  }
+
+  template <class Array>
+  void copy_unpadded(const Array& padded, Array2D& picture) {
+    const int height = picture.shape()[0];
+    const int width = picture.shape()[1];
+    if ((static_cast<int>(padded.shape()[0])<height) ||
+        (static_cast<int>(padded.shape()[1])<width)) {
+      throw std::invalid_argument("copy_unpadded: padded array is smaller than the picture");
+    }
+    for (int y=0; y<height; ++y) {
+      const typename Array::element* const from = padded.data() + y*padded.shape()[1];
+      std::copy(from, from+width, picture.data() + y*width);
+    }
+  }
+
+} // end unnamed namespace
+
+void copy_field(const Picture& frame, int field, Picture& picture) {
+  copy_field(frame.y(), field, picture.y());
+  copy_field(frame.c1(), field, picture.c1());
+  copy_field(frame.c2(), field, picture.c2());
+}
+
+void copy_unpadded(const Picture& padded, Picture& picture) {
+  copy_unpadded(padded.y(), picture.y());
+  copy_unpadded(padded.c1(), picture.c1());
+  copy_unpadded(padded.c2(), picture.c2());
+}
+
+void copy_unpadded(const ShortPicture& padded, Picture& picture) {
+  copy_unpadded(padded.y(), picture.y());
+  copy_unpadded(padded.c1(), picture.c1());
+  copy_unpadded(padded.c2(), picture.c2());
+}
+
+QualityMonitor::QualityMonitor(const FrameBuffers& prototype,
+                               WaveletKernel k, int d,
+                               const Array1D& q, int b,
+                               bool ld, bool keep):
+  scratch(prototype),
+  kernel(k), waveletDepth(d), qMatrix(q), bitDepth(b), lowDelay(ld), keepDecoded(keep),
+  submitted(0), stopping(false),
+  worker(&QualityMonitor::run, this) {
+}
+
+QualityMonitor::~QualityMonitor() {
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+  worker.join();
+}
+
+void QualityMonitor::submit(const FrameBuffers& buffers, int pictureNumber) {
+  const Job job = {&buffers, pictureNumber};
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    jobs.push_back(job);
+    ++submitted;
+  }
+  changed.notify_all();
+}
+
+const bool QualityMonitor::collect(PictureQuality& quality, bool wait) {
+  boost::mutex::scoped_lock lock(mutex);
+  while (wait && results.empty() && error.empty() && (submitted>0)) changed.wait(lock);
+  if (!error.empty()) throw std::runtime_error(error);
+  if (results.empty()) return false;
+  quality = results.front();
+  results.pop_front();
+  --submitted;
+  return true;
+}
+
+const bool QualityMonitor::collect(PictureQuality& quality, Picture& decoded, bool wait) {
+  if (!keepDecoded) throw std::logic_error("QualityMonitor: decoded pictures are not kept");
+  boost::mutex::scoped_lock lock(mutex);
+  while (wait && results.empty() && error.empty() && (submitted>0)) changed.wait(lock);
+  if (!error.empty()) throw std::runtime_error(error);
+  if (results.empty()) return false;
+  quality = results.front();
+  clip(decodedPictures.front(), 0, (1<<bitDepth)-1, decoded);
+  results.pop_front();
+  decodedPictures.pop_front();
+  --submitted;
+  return true;
+}
+
+const int QualityMonitor::outstanding() const {
+  boost::mutex::scoped_lock lock(mutex);
+  return submitted;
+}
+
+void QualityMonitor::run() {
+  for (;;) {
+    Job job;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while (jobs.empty() && !stopping) changed.wait(lock);
+      if (jobs.empty()) return; // Stopping, and all pictures measured
+      job = jobs.front();
+    }
+    PictureQuality quality;
+    quality.picture = job.picture;
+    try {
+      measure(*job.buffers, quality);
+    }
+    catch (const std::exception& e) {
+      boost::mutex::scoped_lock lock(mutex);
+      error = e.what();
+      jobs.clear();
+      changed.notify_all();
+      return;
+    }
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      jobs.pop_front();
+      results.push_back(quality);
+      // Copy the reconstruction, if kept, before the next picture overwrites it
+      if (keepDecoded) decodedPictures.push_back(scratch.picture);
+    }
+    changed.notify_all();
+  }
+}
+
+void QualityMonitor::measure(const FrameBuffers& buffers, PictureQuality& quality) {
+  const Array2D& qIndices = buffers.slices.qIndices;
+  // Reconstruct the picture, as a decoder would
+  if (scratch.hasShortTransform()) {
+    if (lowDelay) inverse_quantise_transform(buffers.quantised, qIndices, qMatrix, scratch.shortTransform);
+    else inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, scratch.shortTransform);
+    inverseWaveletTransform(scratch.shortTransform, kernel, waveletDepth, scratch.picture);
+  }
+  else {
+    if (lowDelay) inverse_quantise_transform(buffers.quantised, qIndices, qMatrix, scratch.transform);
+    else inverse_quantise_transform_np(buffers.quantised, qIndices, qMatrix, scratch.transform);
+    inverseWaveletTransform(scratch.transform, kernel, waveletDepth, scratch.picture);
+  }
+  const Picture& original = buffers.picture;
+  const Picture& decoded = scratch.picture;
+  quality.bitDepth = bitDepth;
+  quality.squaredError[0] = squared_error(original.y(), -1, decoded.y(), bitDepth);
+  quality.squaredError[1] = squared_error(original.c1(), -1, decoded.c1(), bitDepth);
+  quality.squaredError[2] = squared_error(original.c2(), -1, decoded.c2(), bitDepth);
+  quality.samples[0] = decoded.y().num_elements();
+  quality.samples[1] = decoded.c1().num_elements();
+  quality.samples[2] = decoded.c2().num_elements();
+}
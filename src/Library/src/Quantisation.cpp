@@ -9,7 +9,15 @@
 
 #include "Quantisation.h"
 #include "WaveletTransform.h"
+#include "Arena.h"
 #include "Utils.h"
+#include "TaskScheduler.h"
+
+#include <algorithm> // For min and max
+#include <climits> // For SHRT_MIN and SHRT_MAX
+#include <stdexcept> // For overflow_error
+
+#include "boost/bind.hpp"
 
 using utils::pow;
 
@@ -203,6 +211,123 @@ const int predictDC(const Array2D& llSubband, int y, int x) {
   }
 }
 
+namespace {
+
+  // Store a (inverse) quantised value in an int or, checking it fits, in a short
+  inline void store(int& result, const int value) {
+    result = value;
+  }
+
+  inline void store(short& result, const int value) {
+    if ((value<SHRT_MIN) || (value>SHRT_MAX)) {
+      throw std::overflow_error("inverse quantised coefficient does not fit in 16 bits");
+    }
+    result = static_cast<short>(value);
+  }
+
+  // Divide by 3, rounding away from zero as predictDC does, using a multiply
+  // and shift (exact for all int values) rather than a division.
+  inline const int rounded_third(const int sum) {
+    if (sum>=0) {
+      return static_cast<int>(((static_cast<unsigned int>(sum)+1u)*0xAAAAAAABull)>>33);
+    }
+    else {
+      return -static_cast<int>(((1u-static_cast<unsigned int>(sum))*0xAAAAAAABull)>>33);
+    }
+  }
+
+  // (Inverse) quantise n coefficients of one row of an LL subband, with DC
+  // prediction, using quantisation index q. "above" is the restored row above
+  // (null for the top row), "restored" receives the restored coefficients and
+  // "leftEdge" is true if the row starts at the left edge of the subband (else
+  // restored[-1] is the restored coefficient to the left).
+  // The prediction is as predictDC but the edge cases are taken out of the loop.
+  // "in" and "out" may be strided (e.g. in in-place transform order).
+  template <class InElement, class OutElement>
+  void quantise_LL_row(const InElement* in, const Index inStep,
+                       OutElement* out, const Index outStep,
+                       const int n, const int q,
+                       const int* above, int* restored,
+                       const bool leftEdge, const bool inverse) {
+    int i = 0;
+    int left = (leftEdge ? 0 : restored[-1]);
+    if (leftEdge && n>0) {
+      const int prediction = (above ? above[0] : 0);
+      if (inverse) {
+        left = scale(*in, q) + prediction;
+        store(*out, left);
+      }
+      else {
+        const int value = quant(*in-prediction, q);
+        store(*out, value);
+        left = scale(value, q) + prediction;
+      }
+      restored[i++] = left;
+      in += inStep;
+      out += outStep;
+    }
+    for (; i<n; ++i, in+=inStep, out+=outStep) {
+      const int prediction = (above ? rounded_third(above[i-1]+above[i]+left) : left);
+      if (inverse) {
+        left = scale(*in, q) + prediction;
+        store(*out, left);
+      }
+      else {
+        const int value = quant(*in-prediction, q);
+        store(*out, value);
+        left = scale(value, q) + prediction;
+      }
+      restored[i] = left;
+    }
+  }
+
+  // (Inverse) quantise an LL subband, of height by width coefficients, with DC
+  // prediction. It is processed row by row, each row slice by slice, using slice
+  // (or codeblock) boundaries calculated once, so there are no divisions per
+  // coefficient. Only two rows of restored coefficients are kept, in the thread's
+  // scratch arena, so no memory is allocated (once the arena is big enough).
+  // The rows of "in" and "out" start every inRowStep and outRowStep elements,
+  // with successive coefficients every inStep and outStep elements.
+  // The quantisation indices are adjusted by the quantisation matrix entry "qMatrix".
+  template <class InElement, class OutElement>
+  void quantise_LL(const InElement* in, const Index inRowStep, const Index inStep,
+                   OutElement* out, const Index outRowStep, const Index outStep,
+                   const int height, const int width,
+                   const Array2D& qIndices, const int qMatrix, const bool inverse) {
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
+    const int yBlocks = qIndices.shape()[0];
+    const int xBlocks = qIndices.shape()[1];
+    // Slice (or codeblock) boundaries across the subband
+    int* const edges = arena.allocate(xBlocks+1);
+    for (int x=0; x<=xBlocks; ++x) edges[x] = (x*width)/xBlocks;
+    int* rows[2] = {arena.allocate(width), arena.allocate(width)};
+    const int* above = 0;
+    for (int y=0, row=0; y<yBlocks; ++y) {
+      const int bottom = ((y+1)*height)/yBlocks;
+      for (; row<bottom; ++row) {
+        int* const restored = rows[row&1];
+        const InElement* const inRow = in + row*inRowStep;
+        OutElement* const outRow = out + row*outRowStep;
+        for (int x=0; x<xBlocks; ++x) {
+          const int left = edges[x];
+          quantise_LL_row(inRow + left*inStep, inStep, outRow + left*outStep, outStep,
+                          edges[x+1]-left, adjust_quant_index(qIndices[y][x], qMatrix),
+                          (above ? above+left : 0), restored+left, (left==0), inverse);
+        }
+        above = restored;
+      }
+    }
+  }
+
+} // end unnamed namespace
+
+// Quantise n coefficients of one row of an LL subband with DC prediction
+void quantise_LL_row(const int* coeffs, int* quantised, const int n, const int q,
+                     const int* above, int* restored, const bool leftEdge) {
+  quantise_LL_row(coeffs, 1, quantised, 1, n, q, above, restored, leftEdge, false);
+}
+
 // Quantise an LL (DC) subband, including prediction
 // This version either quantises the LL subband for low delay mode or
 // codes the LL subband for core syntax using codeblocks
@@ -210,22 +335,10 @@ const Array2D quantise_LLSubband(const ConstView2D& llSubband,
                                  const Array2D& qIndices) {
   const int LLHeight = llSubband.shape()[0]; // Height of the LL subband
   const int LLWidth = llSubband.shape()[1]; // Width of the LL subband
-  const int yBlocks = qIndices.shape()[0]; // Number of vertical slices/codeblocks in the LL subband
-  const int xBlocks = qIndices.shape()[1]; // Number of horizontal slices/codeblocks in the LL subband
   Array2D quantisedLL(llSubband.ranges());
-  Array2D restoredLL(llSubband.ranges());
-  for (int y=0; y<LLHeight; ++y) {
-    for (int x=0; x<LLWidth; ++x) {
-      // TO DO: Implement more efficient calculation of yb/xb.
-      // Calculate (y+1)*yBlocks by incrementing previous version by yBlocks
-      // Do division by shift (width is always a power of 2)
-      const int yb = ((y+1)*yBlocks-1)/LLHeight; // vertical slice/codeblock number
-      const int xb = ((x+1)*xBlocks-1)/LLWidth; // horizontal slice/codeblock number
-      const int prediction = predictDC(restoredLL, y, x);
-      quantisedLL[y][x] = quant(llSubband[y][x]-prediction, qIndices[yb][xb]);
-      restoredLL[y][x] = scale(quantisedLL[y][x], qIndices[yb][xb])+prediction;
-    }
-  }
+  // The indices are already adjusted by the quantisation matrix
+  quantise_LL(llSubband.origin(), llSubband.strides()[0], llSubband.strides()[1],
+              quantisedLL.data(), LLWidth, 1, LLHeight, LLWidth, qIndices, 0, false);
   return quantisedLL;
 }
 
@@ -284,20 +397,10 @@ const Array2D inverse_quantise_LLSubband(const ConstView2D& llSubband,
                                          const Array2D& qIndices) {
   const int LLHeight = llSubband.shape()[0]; // Height of the LL subband
   const int LLWidth = llSubband.shape()[1]; // Width of the LL subband
-  const int yBlocks = qIndices.shape()[0]; // Number of vertical slices/codeblocks in the LL subband
-  const int xBlocks = qIndices.shape()[1]; // Number of horizontal slices/codeblocks in the LL subband
   Array2D invQuantisedLL(llSubband.ranges());
-  for (int y=0; y<LLHeight; ++y) {
-    for (int x=0; x<LLWidth; ++x) {
-      // TO DO: Implement more efficient calculation of yb/xb.
-      // Calculate (y+1)*yBlocks by incrementing previous version by yBlocks
-      // Do division by shift (width is always a power of 2)
-      const int yb = ((y+1)*yBlocks-1)/LLHeight; // vertical slice/codeblock number
-      const int xb = ((x+1)*xBlocks-1)/LLWidth; // horizontal slice/codeblock number
-      const int prediction = predictDC(invQuantisedLL, y, x);
-      invQuantisedLL[y][x] = scale(llSubband[y][x], qIndices[yb][xb])+prediction;
-    }
-  }
+  // The indices are already adjusted by the quantisation matrix
+  quantise_LL(llSubband.origin(), llSubband.strides()[0], llSubband.strides()[1],
+              invQuantisedLL.data(), LLWidth, 1, LLHeight, LLWidth, qIndices, 0, true);
   return invQuantisedLL;
 }
 
@@ -470,18 +573,177 @@ const Array2D inverse_quantise_subbands_np(const Array2D& coefficients, const Bl
   return result;
 }
 
+namespace {
+
+  // Apply a (inverse) quantisation function to one subband, in place transform order,
+  // writing the result into "result" at the same positions. The subband is specified
+  // by its subsampling factor (stride) and phase (rowOffset, colOffset). The subband
+  // is divided into slices, each with its own quantisation index given by qIndices
+  // adjusted by the quantisation matrix entry for this subband. Only rows of
+  // slices [firstRow, lastRow) are quantised (so stripes may be done concurrently).
+  // No memory is allocated. The arrays may hold ints or shorts.
+  template <class InArray, class OutArray>
+  void quantise_subband_np(const InArray& coefficients, OutArray& result,
+                           const Index rowOffset, const Index colOffset, const Index stride,
+                           const Array2D& qIndices, const int qMatrix,
+                           const int (*op)(int, int),
+                           int firstRow, int lastRow) {
+    const Index transformWidth = coefficients.shape()[1];
+    const int bandHeight = (coefficients.shape()[0]-rowOffset+stride-1)/stride;
+    const int bandWidth = (transformWidth-colOffset+stride-1)/stride;
+    const int yBlocks = qIndices.shape()[0];
+    const int xBlocks = qIndices.shape()[1];
+    const typename InArray::element* const in = coefficients.data();
+    typename OutArray::element* const out = result.data();
+    for (int y=firstRow; y<lastRow; ++y) {
+      const int top = (y*bandHeight)/yBlocks;
+      const int bottom = ((y+1)*bandHeight)/yBlocks;
+      for (int x=0; x<xBlocks; ++x) {
+        const int left = (x*bandWidth)/xBlocks;
+        const int right = ((x+1)*bandWidth)/xBlocks;
+        const int q = adjust_quant_index(qIndices[y][x], qMatrix);
+        for (int row=top; row<bottom; ++row) {
+          const Index base = (rowOffset+row*stride)*transformWidth + colOffset;
+          for (int col=left; col<right; ++col) {
+            const Index i = base + col*stride;
+            store(out[i], op(in[i], q));
+          }
+        }
+      }
+    }
+  }
+
+  // Apply (inverse) quantisation to all the subbands of rows of slices
+  // [firstRow, lastRow) of a transform. "result" must be the same shape as
+  // the coefficients.
+  template <class InArray, class OutArray>
+  void quantise_rows_np(const InArray* coefficients,
+                        const Array2D* qIndices,
+                        const Array1D* qMatrix,
+                        OutArray* result,
+                        const int (*op)(int, int),
+                        int firstRow, int lastRow) {
+    // TO DO: Check numberOfSubbands=3n+1 ?
+    const int numberOfSubbands = qMatrix->size();
+    const int waveletDepth = (numberOfSubbands-1)/3;
+    // LL subband
+    quantise_subband_np(*coefficients, *result, 0, 0, pow(2, waveletDepth),
+                        *qIndices, (*qMatrix)[0], op, firstRow, lastRow);
+    // HL, LH and HH subbands, from low to high frequencies
+    for (int level=1, band=1; level<=waveletDepth; ++level) {
+      const Index stride = pow(2, waveletDepth+1-level);
+      const Index offset = stride/2;
+      quantise_subband_np(*coefficients, *result, 0, offset, stride,
+                          *qIndices, (*qMatrix)[band++], op, firstRow, lastRow);
+      quantise_subband_np(*coefficients, *result, offset, 0, stride,
+                          *qIndices, (*qMatrix)[band++], op, firstRow, lastRow);
+      quantise_subband_np(*coefficients, *result, offset, offset, stride,
+                          *qIndices, (*qMatrix)[band++], op, firstRow, lastRow);
+    }
+  }
+
+  // Apply (inverse) quantisation to all the subbands of a transform
+  template <class InArray, class OutArray>
+  void quantise_transform_np(const InArray& coefficients,
+                             const Array2D& qIndices,
+                             const Array1D& qMatrix,
+                             OutArray& result,
+                             const int (*op)(int, int)) {
+    if ((result.shape()[0]!=coefficients.shape()[0]) ||
+        (result.shape()[1]!=coefficients.shape()[1])) {
+      result.resize(coefficients.ranges());
+    }
+    quantise_rows_np(&coefficients, &qIndices, &qMatrix, &result, op, 0, qIndices.shape()[0]);
+  }
+
+  // Quantise (inverse == false), or inverse quantise (inverse == true), the LL
+  // subband of a transform with DC prediction, writing into "result" at the
+  // same positions. The arrays may hold ints or shorts.
+  template <class InArray, class OutArray>
+  void quantise_LLSubband(const InArray& coefficients, OutArray& result,
+                          const Index stride, const Array2D& qIndices,
+                          const int qMatrix, const bool inverse) {
+    const Index transformWidth = coefficients.shape()[1];
+    const int bandHeight = (coefficients.shape()[0]+stride-1)/stride;
+    const int bandWidth = (transformWidth+stride-1)/stride;
+    quantise_LL(coefficients.data(), stride*transformWidth, stride,
+                result.data(), stride*transformWidth, stride,
+                bandHeight, bandWidth, qIndices, qMatrix, inverse);
+  }
+
+  // Apply (inverse) quantisation, with LL subband prediction, to all the
+  // subbands of a transform. Only the LL subband differs from quantise_transform_np.
+  template <class InArray, class OutArray>
+  void quantise_transform(const InArray& coefficients,
+                          const Array2D& qIndices,
+                          const Array1D& qMatrix,
+                          OutArray& result,
+                          const bool inverse) {
+    if ((result.shape()[0]!=coefficients.shape()[0]) ||
+        (result.shape()[1]!=coefficients.shape()[1])) {
+      result.resize(coefficients.ranges());
+    }
+    const int (*op)(int, int) = (inverse ? scale : quant);
+    const int numberOfSubbands = qMatrix.size();
+    const int waveletDepth = (numberOfSubbands-1)/3;
+    // LL subband
+    quantise_LLSubband(coefficients, result, pow(2, waveletDepth),
+                       qIndices, qMatrix[0], inverse);
+    // HL, LH and HH subbands, from low to high frequencies
+    for (int level=1, band=1; level<=waveletDepth; ++level) {
+      const Index stride = pow(2, waveletDepth+1-level);
+      const Index offset = stride/2;
+      quantise_subband_np(coefficients, result, 0, offset, stride,
+                          qIndices, qMatrix[band++], op, 0, qIndices.shape()[0]);
+      quantise_subband_np(coefficients, result, offset, 0, stride,
+                          qIndices, qMatrix[band++], op, 0, qIndices.shape()[0]);
+      quantise_subband_np(coefficients, result, offset, offset, stride,
+                          qIndices, qMatrix[band++], op, 0, qIndices.shape()[0]);
+    }
+  }
+
+} // end unnamed namespace
+
+// Quantise in-place transformed coefficients of a whole picture as slices
+// into a pre-allocated array (without LL subband prediction)
+void quantise_transform_np(const Array2D& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Array2D& result) {
+  quantise_transform_np(coefficients, qIndices, qMatrix, result, quant);
+}
+
+// Inverse quantise into a pre-allocated array (without LL subband prediction)
+void inverse_quantise_transform_np(const Array2D& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Array2D& result) {
+  quantise_transform_np(qCoeffs, qIndices, qMatrix, result, scale);
+}
+
+// 16 bit versions
+void quantise_transform_np(const ShortArray2D& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Array2D& result) {
+  quantise_transform_np(coefficients, qIndices, qMatrix, result, quant);
+}
+
+void inverse_quantise_transform_np(const Array2D& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortArray2D& result) {
+  quantise_transform_np(qCoeffs, qIndices, qMatrix, result, scale);
+}
+
 // Quantise in-place transformed coefficients of a whole picture as slices
 // Uses a quantisation matrix
 const Array2D quantise_transform_np(const Array2D& coefficients,
                                     const Array2D& qIndices,
                                     const Array1D& qMatrix) {
-  // TO DO: Check numberOfSubbands=3n+1 ?
-  BlockVector aQIndices(qMatrix.ranges());
-  const int numberOfSubbands = qMatrix.size();
-  for (char band=0; band<numberOfSubbands; ++band) {
-    aQIndices[band] = adjust_quant_indices(qIndices, qMatrix[band]);
-  }
-  return quantise_subbands_np(coefficients, aQIndices);
+  Array2D result(coefficients.ranges());
+  quantise_transform_np(coefficients, qIndices, qMatrix, result);
+  return result;
 }
 
 // Quantise all the coefficients in a block using
@@ -517,13 +779,9 @@ const Array2D quantise_transform_np(const Array2D& coefficients,
 const Array2D inverse_quantise_transform_np(const Array2D& qCoeffs,
                                             const Array2D& qIndices,
                                             const Array1D& qMatrix) {
-  // TO DO: Check numberOfSubbands=3n+1 ?
-  BlockVector aQIndices(qMatrix.ranges());
-  const int numberOfSubbands = qMatrix.size();
-  for (char band=0; band<numberOfSubbands; ++band) {
-    aQIndices[band] = adjust_quant_indices(qIndices, qMatrix[band]);
-  }
-  return inverse_quantise_subbands_np(qCoeffs, aQIndices);
+  Array2D result(qCoeffs.ranges());
+  inverse_quantise_transform_np(qCoeffs, qIndices, qMatrix, result);
+  return result;
 }
 
 // Quantise in-place transformed coefficients of a whole picture as slices
@@ -582,3 +840,192 @@ const Picture inverse_quantise_transform_np(const Picture& qCoeffs,
   result.c2(inverse_quantise_transform_np(qCoeffs.c2(), qIndices, qMatrix));
   return result;
 }
+
+// Picture versions of quantisation into pre-allocated pictures
+void quantise_transform_np(const Picture& transform,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result) {
+  quantise_transform_np(transform.y(), qIndices, qMatrix, result.y());
+  quantise_transform_np(transform.c1(), qIndices, qMatrix, result.c1());
+  quantise_transform_np(transform.c2(), qIndices, qMatrix, result.c2());
+}
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Picture& result) {
+  inverse_quantise_transform_np(qCoeffs.y(), qIndices, qMatrix, result.y());
+  inverse_quantise_transform_np(qCoeffs.c1(), qIndices, qMatrix, result.c1());
+  inverse_quantise_transform_np(qCoeffs.c2(), qIndices, qMatrix, result.c2());
+}
+
+void quantise_transform_np(const ShortPicture& transform,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result) {
+  quantise_transform_np(transform.y(), qIndices, qMatrix, result.y());
+  quantise_transform_np(transform.c1(), qIndices, qMatrix, result.c1());
+  quantise_transform_np(transform.c2(), qIndices, qMatrix, result.c2());
+}
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortPicture& result) {
+  inverse_quantise_transform_np(qCoeffs.y(), qIndices, qMatrix, result.y());
+  inverse_quantise_transform_np(qCoeffs.c1(), qIndices, qMatrix, result.c1());
+  inverse_quantise_transform_np(qCoeffs.c2(), qIndices, qMatrix, result.c2());
+}
+
+namespace {
+
+  // Queue the (inverse) quantisation of one component, in "stripes" stripes of
+  // rows of slices, as tasks of a group. "result" must already be the same
+  // shape as the coefficients.
+  template <class InArray, class OutArray>
+  void quantise_component_np(TaskGroup& tasks, const InArray& coefficients,
+                             const Array2D& qIndices, const Array1D& qMatrix,
+                             OutArray& result, const int (*op)(int, int), int stripes) {
+    const int rows = qIndices.shape()[0];
+    stripes = std::max(1, std::min(stripes, rows));
+    for (int stripe=0; stripe<stripes; ++stripe) {
+      tasks.run(boost::bind(&quantise_rows_np<InArray, OutArray>,
+                            &coefficients, &qIndices, &qMatrix, &result, op,
+                            (stripe*rows)/stripes, ((stripe+1)*rows)/stripes));
+    }
+  }
+
+  template <class InArray, class OutArray>
+  void match_shape(const InArray& coefficients, OutArray& result) {
+    if ((result.shape()[0]!=coefficients.shape()[0]) ||
+        (result.shape()[1]!=coefficients.shape()[1])) {
+      result.resize(coefficients.ranges());
+    }
+  }
+
+  // (Inverse) quantise the components of a picture concurrently. The results
+  // are resized (if need be) first, then each component is divided into
+  // stripes of rows of slices, about 2 per thread in all, shared between the
+  // components in proportion to their size (so luma has most).
+  template <class InPicture, class OutPicture>
+  void quantise_picture_np(const InPicture& coefficients,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           OutPicture& result,
+                           const int (*op)(int, int),
+                           TaskScheduler& scheduler) {
+    match_shape(coefficients.y(), result.y());
+    match_shape(coefficients.c1(), result.c1());
+    match_shape(coefficients.c2(), result.c2());
+    const double lumaSize = coefficients.y().num_elements();
+    const double chromaSize = coefficients.c1().num_elements();
+    const double total = lumaSize + 2*chromaSize;
+    const int stripes = 2*scheduler.threads();
+    const int lumaStripes = (total>0) ? static_cast<int>(stripes*lumaSize/total + 0.5) : 1;
+    const int chromaStripes = (total>0) ? static_cast<int>(stripes*chromaSize/total + 0.5) : 1;
+    TaskGroup tasks(scheduler);
+    quantise_component_np(tasks, coefficients.y(), qIndices, qMatrix, result.y(), op, lumaStripes);
+    quantise_component_np(tasks, coefficients.c1(), qIndices, qMatrix, result.c1(), op, chromaStripes);
+    quantise_component_np(tasks, coefficients.c2(), qIndices, qMatrix, result.c2(), op, chromaStripes);
+    tasks.wait();
+  }
+
+} // end unnamed namespace
+
+void quantise_transform_np(const Picture& transform,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result,
+                           TaskScheduler& scheduler) {
+  quantise_picture_np(transform, qIndices, qMatrix, result, quant, scheduler);
+}
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   Picture& result,
+                                   TaskScheduler& scheduler) {
+  quantise_picture_np(qCoeffs, qIndices, qMatrix, result, scale, scheduler);
+}
+
+void quantise_transform_np(const ShortPicture& transform,
+                           const Array2D& qIndices,
+                           const Array1D& qMatrix,
+                           Picture& result,
+                           TaskScheduler& scheduler) {
+  quantise_picture_np(transform, qIndices, qMatrix, result, quant, scheduler);
+}
+
+void inverse_quantise_transform_np(const Picture& qCoeffs,
+                                   const Array2D& qIndices,
+                                   const Array1D& qMatrix,
+                                   ShortPicture& result,
+                                   TaskScheduler& scheduler) {
+  quantise_picture_np(qCoeffs, qIndices, qMatrix, result, scale, scheduler);
+}
+
+// Quantisation with LL (DC) subband prediction into pre-allocated arrays
+void quantise_transform(const Array2D& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Array2D& result) {
+  quantise_transform(coefficients, qIndices, qMatrix, result, false);
+}
+
+void inverse_quantise_transform(const Array2D& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                Array2D& result) {
+  quantise_transform(qCoeffs, qIndices, qMatrix, result, true);
+}
+
+void quantise_transform(const ShortArray2D& coefficients,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Array2D& result) {
+  quantise_transform(coefficients, qIndices, qMatrix, result, false);
+}
+
+void inverse_quantise_transform(const Array2D& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                ShortArray2D& result) {
+  quantise_transform(qCoeffs, qIndices, qMatrix, result, true);
+}
+
+void quantise_transform(const Picture& transform,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Picture& result) {
+  quantise_transform(transform.y(), qIndices, qMatrix, result.y());
+  quantise_transform(transform.c1(), qIndices, qMatrix, result.c1());
+  quantise_transform(transform.c2(), qIndices, qMatrix, result.c2());
+}
+
+void inverse_quantise_transform(const Picture& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                Picture& result) {
+  inverse_quantise_transform(qCoeffs.y(), qIndices, qMatrix, result.y());
+  inverse_quantise_transform(qCoeffs.c1(), qIndices, qMatrix, result.c1());
+  inverse_quantise_transform(qCoeffs.c2(), qIndices, qMatrix, result.c2());
+}
+
+void quantise_transform(const ShortPicture& transform,
+                        const Array2D& qIndices,
+                        const Array1D& qMatrix,
+                        Picture& result) {
+  quantise_transform(transform.y(), qIndices, qMatrix, result.y());
+  quantise_transform(transform.c1(), qIndices, qMatrix, result.c1());
+  quantise_transform(transform.c2(), qIndices, qMatrix, result.c2());
+}
+
+void inverse_quantise_transform(const Picture& qCoeffs,
+                                const Array2D& qIndices,
+                                const Array1D& qMatrix,
+                                ShortPicture& result) {
+  inverse_quantise_transform(qCoeffs.y(), qIndices, qMatrix, result.y());
+  inverse_quantise_transform(qCoeffs.c1(), qIndices, qMatrix, result.c1());
+  inverse_quantise_transform(qCoeffs.c2(), qIndices, qMatrix, result.c2());
+}
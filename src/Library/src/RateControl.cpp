@@ -0,0 +1,249 @@
+/*********************************************************************/
+/* RateControl.cpp                                                   */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines variable bit rate (VBR) rate control: a first pass that   */
+/* measures each picture's rate and quality, and a look-ahead that   */
+/* shares a maximum bit rate between pictures.                       */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "RateControl.h"
+
+#include <cmath> // For log10
+#include <limits> // For infinity
+#include <algorithm> // For max
+#include <stdexcept> // For invalid_argument
+
+#include "Slices.h"
+
+/***** Picture quality *****/
+
+const double squared_error(const Array2D& original, int field,
+                           const Array2D& decoded, int bitDepth) {
+  const int maxValue = (1<<bitDepth)-1;
+  const int height = decoded.shape()[0];
+  const int width = decoded.shape()[1];
+  const int originalWidth = original.shape()[1];
+  const bool isField = ((field==0) || (field==1));
+  if ((originalWidth<width) ||
+      (static_cast<int>(original.shape()[0]) < (isField ? 2*height : height))) {
+    throw std::invalid_argument("squared_error: decoded component is bigger than the original");
+  }
+  double sum = 0.0;
+  for (int y=0; y<height; ++y) {
+    const int line = (isField ? 2*y+field : y);
+    const int* const o = original.data() + line*originalWidth;
+    const int* const d = decoded.data() + y*width;
+    long long rowSum = 0;
+    for (int x=0; x<width; ++x) {
+      const int value = (d[x]<0) ? 0 : ((d[x]>maxValue) ? maxValue : d[x]);
+      const long long difference = value - o[x];
+      rowSum += difference*difference;
+    }
+    sum += rowSum;
+  }
+  return sum;
+}
+
+const double psnr(double squaredError, double samples, int bitDepth) {
+  if (squaredError<=0.0) return std::numeric_limits<double>::infinity();
+  const double peak = (1<<bitDepth)-1;
+  return 10.0*std::log10(peak*peak*samples/squaredError);
+}
+
+const double psnr(const Picture& original, int field, const Picture& decoded, int bitDepth) {
+  const double error = squared_error(original.y(), field, decoded.y(), bitDepth) +
+                       squared_error(original.c1(), field, decoded.c1(), bitDepth) +
+                       squared_error(original.c2(), field, decoded.c2(), bitDepth);
+  const double samples = static_cast<double>(decoded.y().num_elements()) +
+                         decoded.c1().num_elements() + decoded.c2().num_elements();
+  return psnr(error, samples, bitDepth);
+}
+
+/***** Variable bit rate *****/
+
+VBRAnalysis::VBRAnalysis():
+  transform(0), shortTransform(0), qMatrix(0),
+  ySlices(0), xSlices(0), scalar(1) {
+}
+
+VBRAnalysis::VBRAnalysis(const Picture& t,
+                         int y, int x,
+                         const Array1D& q,
+                         int s):
+  transform(&t), shortTransform(0), qMatrix(&q),
+  ySlices(y), xSlices(x), scalar(s),
+  curve(maxQuantIndex+1, -1) {
+  analyse(t);
+}
+
+VBRAnalysis::VBRAnalysis(const ShortPicture& t,
+                         int y, int x,
+                         const Array1D& q,
+                         int s):
+  transform(0), shortTransform(&t), qMatrix(&q),
+  ySlices(y), xSlices(x), scalar(s),
+  curve(maxQuantIndex+1, -1) {
+  analyse(t);
+}
+
+namespace {
+
+  // True if every component of a slice fits the one byte VBR length
+  const bool fits(const HQSliceSizer& slice, int qIndex, int maxComponentBytes) {
+    int componentBytes[3];
+    slice.bytes(qIndex, componentBytes);
+    return (componentBytes[0]<=maxComponentBytes) &&
+           (componentBytes[1]<=maxComponentBytes) &&
+           (componentBytes[2]<=maxComponentBytes);
+  }
+
+} // end unnamed namespace
+
+template <class Transform>
+void VBRAnalysis::analyse(const Transform& t) {
+  const int maxComponentBytes = 255*scalar;
+  minIndices.resize(extents[ySlices][xSlices]);
+  for (int row=0; row<ySlices; ++row) {
+    for (int column=0; column<xSlices; ++column) {
+      const HQSliceSizer slice(t, ySlices, xSlices, row, column, *qMatrix, scalar);
+      // Nearly all slices fit at any index, otherwise binary search
+      int low = 0;
+      if (!fits(slice, 0, maxComponentBytes)) {
+        low = 1;
+        int high = maxQuantIndex;
+        while (low<high) {
+          const int trialQ = (low+high)/2;
+          if (fits(slice, trialQ, maxComponentBytes)) high = trialQ;
+          else low = trialQ+1;
+        }
+      }
+      minIndices[row][column] = low;
+    }
+  }
+}
+
+template <class Transform>
+const int VBRAnalysis::pictureBytes(const Transform& t, int qIndex) const {
+  int total = 0;
+  for (int row=0; row<ySlices; ++row) {
+    for (int column=0; column<xSlices; ++column) {
+      const HQSliceSizer slice(t, ySlices, xSlices, row, column, *qMatrix, scalar);
+      total += 4 + slice.bytes(std::max(qIndex, minIndices[row][column]));
+    }
+  }
+  return total;
+}
+
+const int VBRAnalysis::bytes(int qIndex) const {
+  if (!qMatrix) throw std::logic_error("VBRAnalysis: picture has not been analysed");
+  qIndex = std::max(0, std::min(qIndex, maxQuantIndex));
+  if (curve[qIndex]<0) {
+    curve[qIndex] = (transform ? pictureBytes(*transform, qIndex) : pictureBytes(*shortTransform, qIndex));
+  }
+  return curve[qIndex];
+}
+
+void VBRAnalysis::quantIndices(int qIndex, Array2D& qIndices, Array2D& sliceBytes) const {
+  if (!qMatrix) throw std::logic_error("VBRAnalysis: picture has not been analysed");
+  qIndex = std::max(0, std::min(qIndex, maxQuantIndex));
+  qIndices.resize(extents[ySlices][xSlices]);
+  sliceBytes.resize(extents[ySlices][xSlices]);
+  for (int row=0; row<ySlices; ++row) {
+    for (int column=0; column<xSlices; ++column) {
+      const int q = std::max(qIndex, minIndices[row][column]);
+      qIndices[row][column] = q;
+      if (transform) {
+        const HQSliceSizer slice(*transform, ySlices, xSlices, row, column, *qMatrix, scalar);
+        sliceBytes[row][column] = 4 + slice.bytes(q);
+      }
+      else {
+        const HQSliceSizer slice(*shortTransform, ySlices, xSlices, row, column, *qMatrix, scalar);
+        sliceBytes[row][column] = 4 + slice.bytes(q);
+      }
+    }
+  }
+}
+
+const double VBRAnalysis::psnr(int qIndex, const Picture& original, int field,
+                               WaveletKernel kernel, int bitDepth,
+                               FrameBuffers& scratch) const {
+  if (!qMatrix) throw std::logic_error("VBRAnalysis: picture has not been analysed");
+  qIndex = std::max(0, std::min(qIndex, maxQuantIndex));
+  const int waveletDepth = (qMatrix->size()-1)/3;
+  Array2D& qIndices = scratch.slices.qIndices;
+  qIndices.resize(extents[ySlices][xSlices]);
+  for (int row=0; row<ySlices; ++row) {
+    for (int column=0; column<xSlices; ++column) {
+      qIndices[row][column] = std::max(qIndex, minIndices[row][column]);
+    }
+  }
+  // Code and decode the picture, as the decoder would
+  if (transform) quantise_transform_np(*transform, qIndices, *qMatrix, scratch.quantised);
+  else quantise_transform_np(*shortTransform, qIndices, *qMatrix, scratch.quantised);
+  if (scratch.hasShortTransform()) {
+    inverse_quantise_transform_np(scratch.quantised, qIndices, *qMatrix, scratch.shortTransform);
+    inverseWaveletTransform(scratch.shortTransform, kernel, waveletDepth, scratch.picture);
+  }
+  else {
+    inverse_quantise_transform_np(scratch.quantised, qIndices, *qMatrix, scratch.transform);
+    inverseWaveletTransform(scratch.transform, kernel, waveletDepth, scratch.picture);
+  }
+  return ::psnr(original, field, scratch.picture, bitDepth);
+}
+
+const int psnrQIndex(const VBRAnalysis& analysis, double targetPSNR,
+                     const Picture& original, int field,
+                     WaveletKernel kernel, int bitDepth,
+                     FrameBuffers& scratch) {
+  // Largest index, in [low, high], that reaches the target (0 if none does)
+  int low = 0;
+  int high = maxQuantIndex;
+  while (low<high) {
+    const int trialQ = (low+high+1)/2;
+    if (analysis.psnr(trialQ, original, field, kernel, bitDepth, scratch)>=targetPSNR) low = trialQ;
+    else high = trialQ-1;
+  }
+  return low;
+}
+
+VBRRateControl::VBRRateControl(int lookAhead, int bytes):
+  window(lookAhead), maxBytes(bytes) {
+  if (lookAhead<1) throw std::invalid_argument("VBRRateControl: look ahead must be at least 1 picture");
+  if (bytes<1) throw std::invalid_argument("VBRRateControl: maximum bytes must be > 0");
+}
+
+const int VBRRateControl::qIndex(const std::vector<const VBRAnalysis*>& pictures,
+                                 const std::vector<int>& qualityIndices) const {
+  const int count = std::min(static_cast<int>(pictures.size()), window);
+  if ((count==0) || (qualityIndices.size()<pictures.size())) {
+    throw std::invalid_argument("VBRRateControl: no pictures, or no quality index for each picture");
+  }
+  // Smallest common minimum index at which the waiting pictures fit the rate
+  const long long budget = static_cast<long long>(count)*maxBytes;
+  int low = 0;
+  int high = maxQuantIndex;
+  while (low<high) {
+    const int trialQ = (low+high)/2;
+    long long total = 0;
+    for (int i=0; i<count; ++i) {
+      total += pictures[i]->bytes(std::max(qualityIndices[i], trialQ));
+    }
+    if (total<=budget) high = trialQ;
+    else low = trialQ+1;
+  }
+  int q = std::max(qualityIndices[0], low);
+  // Then make sure the window ending with this picture does not exceed the rate
+  long long previous = 0;
+  for (std::deque<int>::const_iterator i=history.begin(); i!=history.end(); ++i) previous += *i;
+  const long long windowBytes = static_cast<long long>(window)*maxBytes;
+  while ((q<maxQuantIndex) && ((previous + pictures[0]->bytes(q))>windowBytes)) ++q;
+  return q;
+}
+
+void VBRRateControl::coded(int bytes) {
+  history.push_back(bytes);
+  while (static_cast<int>(history.size())>window-1) history.pop_front();
+}
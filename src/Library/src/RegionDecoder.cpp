@@ -0,0 +1,155 @@
+/*********************************************************************/
+/* RegionDecoder.cpp                                                 */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines decoding of a region of an HQ picture (e.g. a crop, or a  */
+/* multiviewer tile) from just the slices that cover it.             */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "RegionDecoder.h"
+
+#include <algorithm> // For min and max
+#include <stdexcept> // For invalid_argument
+
+#include "Quantisation.h"
+#include "Utils.h"
+
+PictureRegion::PictureRegion(int t, int l, int h, int w):
+  top(t), left(l), height(h), width(w) {
+}
+
+namespace {
+
+  // Samples, in its own level, that one level of the inverse transform reaches
+  // (over all its lifting steps). Samples near the edge of a window of the
+  // transform are extended from within the window rather than taken from the
+  // neighbouring slices, so are wrong. Each level spreads the error this far,
+  // so, over all the levels, it spreads less than reach*2**depth samples into
+  // the decoded window.
+  const int inverseReach(WaveletKernel kernel) {
+    switch (kernel) {
+      case Haar0:
+      case Haar1:
+        return 1;
+      case LeGall:
+        return 3;
+      case DD97:
+      case Daub97:
+        return 6;
+      case DD137:
+        return 8;
+      case Fidelity:
+        return 16;
+      default:
+        return 0;
+    }
+  }
+
+  // Slices [first, last) covering samples [first, last) of a component, which
+  // is divided into "slices" slices of "sliceSize" samples
+  void cover(int first, int last, int sliceSize, int slices, int& firstSlice, int& lastSlice) {
+    firstSlice = std::min(firstSlice, std::max(0, first/sliceSize));
+    lastSlice = std::max(lastSlice, std::min(slices, (last + sliceSize - 1)/sliceSize));
+  }
+
+  // Copy the slices of a component into a window of the component
+  void mergeComponent(const Array2D& block, int row, int column, Array2D& window) {
+    const int height = block.shape()[0];
+    const int width = block.shape()[1];
+    window[indices[Range(row*height, (row+1)*height)][Range(column*width, (column+1)*width)]] = block;
+  }
+
+  // Copy a rectangle of a component, starting at (top, left), into "region"
+  void cropComponent(const Array2D& window, int top, int left, Array2D& region) {
+    const int height = region.shape()[0];
+    const int width = region.shape()[1];
+    region = window[indices[Range(top, top+height)][Range(left, left+width)]];
+  }
+
+} // end unnamed namespace
+
+RegionDecoder::RegionDecoder(const PictureFormat& format, WaveletKernel k, int depth,
+                             int ySlices, int xSlices, const PictureRegion& r):
+  kernel(k), waveletDepth(depth), region(r),
+  regionFormat(r.height, r.width, format.chromaFormat()),
+  yRatio(format.lumaHeight()/format.chromaHeight()),
+  xRatio(format.lumaWidth()/format.chromaWidth()) {
+  if ((region.height<=0) || (region.width<=0) || (region.top<0) || (region.left<0) ||
+      ((region.top+region.height)>format.lumaHeight()) ||
+      ((region.left+region.width)>format.lumaWidth())) {
+    throw std::invalid_argument("RegionDecoder: the region is not within the picture");
+  }
+  if ((region.top%yRatio!=0) || (region.height%yRatio!=0) ||
+      (region.left%xRatio!=0) || (region.width%xRatio!=0)) {
+    throw std::invalid_argument("RegionDecoder: the region is not aligned with the chroma samples");
+  }
+  // Slice sizes of each component (of its padded transform)
+  const int lumaSliceHeight = paddedSize(format.lumaHeight(), waveletDepth)/ySlices;
+  const int lumaSliceWidth = paddedSize(format.lumaWidth(), waveletDepth)/xSlices;
+  const int chromaSliceHeight = paddedSize(format.chromaHeight(), waveletDepth)/ySlices;
+  const int chromaSliceWidth = paddedSize(format.chromaWidth(), waveletDepth)/xSlices;
+  // The slices covering the region, and its margin, in every component
+  const int margin = inverseReach(kernel)*utils::pow(2, waveletDepth);
+  int top = ySlices, bottom = 0, left = xSlices, right = 0;
+  cover(region.top-margin, region.top+region.height+margin, lumaSliceHeight, ySlices, top, bottom);
+  cover(region.left-margin, region.left+region.width+margin, lumaSliceWidth, xSlices, left, right);
+  cover(region.top/yRatio-margin, (region.top+region.height)/yRatio+margin,
+        chromaSliceHeight, ySlices, top, bottom);
+  cover(region.left/xRatio-margin, (region.left+region.width)/xRatio+margin,
+        chromaSliceWidth, xSlices, left, right);
+  sliceRegion = SliceRegion(top, left, bottom-top, right-left);
+  // Allocate the buffers for the window of the transform
+  const PictureFormat windowFormat(sliceRegion.height*lumaSliceHeight, sliceRegion.width*lumaSliceWidth,
+                                   sliceRegion.height*chromaSliceHeight, sliceRegion.width*chromaSliceWidth,
+                                   format.chromaFormat());
+  qIndices.resize(extents[sliceRegion.height][sliceRegion.width]);
+  quantised = Picture(windowFormat);
+  transform = Picture(windowFormat);
+  window = Picture(windowFormat);
+}
+
+void RegionDecoder::merge(const Slices& inSlices) {
+  for (int v=0; v<sliceRegion.height; ++v) {
+    for (int h=0; h<sliceRegion.width; ++h) {
+      const Picture& slice = inSlices.yuvSlices[sliceRegion.top+v][sliceRegion.left+h];
+      mergeComponent(slice.y(), v, h, quantised.y());
+      mergeComponent(slice.c1(), v, h, quantised.c1());
+      mergeComponent(slice.c2(), v, h, quantised.c2());
+      qIndices[v][h] = inSlices.qIndices[sliceRegion.top+v][sliceRegion.left+h];
+    }
+  }
+}
+
+// Copy the region out of the decoded window
+void RegionDecoder::crop(Picture& picture) const {
+  if ((picture.y().shape()[0]!=static_cast<size_t>(regionFormat.lumaHeight())) ||
+      (picture.y().shape()[1]!=static_cast<size_t>(regionFormat.lumaWidth())) ||
+      (picture.c1().shape()[0]!=static_cast<size_t>(regionFormat.chromaHeight())) ||
+      (picture.c1().shape()[1]!=static_cast<size_t>(regionFormat.chromaWidth()))) {
+    picture = Picture(regionFormat);
+  }
+  const int lumaTop = region.top - sliceRegion.top*(window.y().shape()[0]/sliceRegion.height);
+  const int lumaLeft = region.left - sliceRegion.left*(window.y().shape()[1]/sliceRegion.width);
+  const int chromaTop = region.top/yRatio - sliceRegion.top*(window.c1().shape()[0]/sliceRegion.height);
+  const int chromaLeft = region.left/xRatio - sliceRegion.left*(window.c1().shape()[1]/sliceRegion.width);
+  cropComponent(window.y(), lumaTop, lumaLeft, picture.y());
+  cropComponent(window.c1(), chromaTop, chromaLeft, picture.c1());
+  cropComponent(window.c2(), chromaTop, chromaLeft, picture.c2());
+}
+
+void RegionDecoder::decode(const Slices& inSlices, const Array1D& qMatrix, Picture& picture) {
+  merge(inSlices);
+  inverse_quantise_transform_np(quantised, qIndices, qMatrix, transform);
+  inverseWaveletTransform(transform, kernel, waveletDepth, window);
+  crop(picture);
+}
+
+void RegionDecoder::decode(const Slices& inSlices, const Array1D& qMatrix, Picture& picture,
+                           TaskScheduler& scheduler) {
+  merge(inSlices);
+  inverse_quantise_transform_np(quantised, qIndices, qMatrix, transform, scheduler);
+  inverseWaveletTransform(transform, kernel, waveletDepth, window, scheduler);
+  crop(picture);
+}
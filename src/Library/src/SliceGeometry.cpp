@@ -0,0 +1,121 @@
+/*********************************************************************/
+/* SliceGeometry.cpp                                                 */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines the choice of slice size for a picture format, bit rate   */
+/* and number of threads, with its expected cost.                    */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "SliceGeometry.h"
+
+#include <ostream>
+#include <cmath> // For ceil
+#include <stdexcept> // For invalid_argument
+
+#include "WaveletTransform.h" // For paddedSize
+#include "Utils.h"
+
+SliceGeometry::SliceGeometry():
+  ySize(0), xSize(0), ySlices(0), xSlices(0),
+  sliceBytes(0.0), sliceScalar(1),
+  overheadBytes(0.0), roundingBytes(0.0), granularityBytes(0.0), efficiency(0.0) {
+}
+
+std::ostream& operator<<(std::ostream& os, const SliceGeometry& geometry) {
+  const double pictureBytes = geometry.sliceBytes*geometry.slices();
+  const double percent = (pictureBytes>0.0) ? 100.0/pictureBytes : 0.0;
+  os << "ySize " << geometry.ySize << ", xSize " << geometry.xSize
+     << " (" << geometry.ySlices << " x " << geometry.xSlices << " slices of "
+     << geometry.sliceBytes << " bytes, scalar " << geometry.sliceScalar << "): overhead "
+     << geometry.overheadBytes << " bytes (" << geometry.overheadBytes*percent << "%), rounding "
+     << geometry.roundingBytes << " bytes (" << geometry.roundingBytes*percent << "%), granularity "
+     << geometry.granularityBytes << " bytes (" << geometry.granularityBytes*percent << "%), parallel efficiency "
+     << geometry.efficiency;
+  return os;
+}
+
+namespace {
+
+  // Greatest common divisor
+  const int gcd(int a, int b) {
+    while (b!=0) {
+      const int r = a%b;
+      a = b;
+      b = r;
+    }
+    return a;
+  }
+
+} // end unnamed namespace
+
+const std::vector<SliceGeometry> sliceGeometries(const PictureFormat& format, int waveletDepth,
+                                                 int pictureBytes, int threads,
+                                                 int slicePrefix) {
+  if (threads<1) threads = 1;
+  // Numbers of slices must divide the (padded) transform of every component,
+  // in units of 2**waveletDepth
+  const int unit = utils::pow(2, waveletDepth);
+  const int lumaHeight = paddedSize(format.lumaHeight(), waveletDepth)/unit;
+  const int lumaWidth = paddedSize(format.lumaWidth(), waveletDepth)/unit;
+  const int rows = gcd(lumaHeight, paddedSize(format.chromaHeight(), waveletDepth)/unit);
+  const int columns = gcd(lumaWidth, paddedSize(format.chromaWidth(), waveletDepth)/unit);
+  // Share of the coded samples in the luma component (the largest)
+  const double lumaSamples = static_cast<double>(format.lumaHeight())*format.lumaWidth();
+  const double chromaSamples = static_cast<double>(format.chromaHeight())*format.chromaWidth();
+  const double lumaShare = lumaSamples/(lumaSamples + 2.0*chromaSamples);
+  std::vector<SliceGeometry> geometries;
+  for (int ySlices=rows; ySlices>=1; --ySlices) {
+    if (rows%ySlices!=0) continue;
+    for (int xSlices=columns; xSlices>=1; --xSlices) {
+      if (columns%xSlices!=0) continue;
+      SliceGeometry geometry;
+      geometry.ySize = lumaHeight/ySlices;
+      geometry.xSize = lumaWidth/xSlices;
+      geometry.ySlices = ySlices;
+      geometry.xSlices = xSlices;
+      const int slices = geometry.slices();
+      geometry.sliceBytes = static_cast<double>(pictureBytes)/slices;
+      geometry.overheadBytes = static_cast<double>(slices)*(4 + slicePrefix);
+      // The luma component is estimated to use its share of the slice's bytes
+      const double lumaBytes = lumaShare*(geometry.sliceBytes - 4 - slicePrefix);
+      geometry.sliceScalar = (lumaBytes>255.0) ? static_cast<int>(std::ceil(lumaBytes/255.0)) : 1;
+      // Each of the 3 components is rounded up by half a scalar unit on average
+      geometry.roundingBytes = 3.0*slices*(geometry.sliceScalar - 1)/2.0;
+      geometry.granularityBytes = geometry.sliceBytes;
+      // Slices are shared between the threads in rounds
+      const int rounds = (slices + threads - 1)/threads;
+      geometry.efficiency = static_cast<double>(slices)/(static_cast<double>(rounds)*threads);
+      geometries.push_back(geometry);
+    }
+  }
+  return geometries;
+}
+
+const SliceGeometry chooseSliceGeometry(const PictureFormat& format, int waveletDepth,
+                                        int pictureBytes, int threads,
+                                        int slicePrefix, int minSlicesPerThread) {
+  if (threads<1) threads = 1;
+  const std::vector<SliceGeometry> geometries =
+    sliceGeometries(format, waveletDepth, pictureBytes, threads, slicePrefix);
+  if (geometries.empty()) {
+    throw std::invalid_argument("chooseSliceGeometry: the picture cannot be divided into slices");
+  }
+  const SliceGeometry* best = 0;
+  const SliceGeometry* most = 0;
+  for (std::vector<SliceGeometry>::const_iterator g=geometries.begin(); g!=geometries.end(); ++g) {
+    // Slices cover a compact area: as wide as high, up to 4 times as wide
+    if ((g->xSize < g->ySize) || (g->xSize > 4*g->ySize)) continue;
+    if (!most || (g->slices() > most->slices())) most = &*g;
+    // Slices must cover their headers with room to spare, and be enough to share
+    if (g->sliceBytes < 4.0*(4 + slicePrefix)) continue;
+    if ((g->slices() < minSlicesPerThread*threads) || (g->efficiency < 0.9)) continue;
+    if (!best || (g->cost() < best->cost()) ||
+        ((g->cost() == best->cost()) && (g->slices() > best->slices()))) {
+      best = &*g;
+    }
+  }
+  if (!most) most = &geometries[0]; // No compact slices, so the most slices
+  return best ? *best : *most;
+}
@@ -8,11 +8,19 @@
 /*********************************************************************/
 
 #include <iostream> //For cin, cout, cerr
+#include <vector>
+#include <algorithm> // For sort, max, min
+#include <stdexcept> // For logic_error
+#include <cmath> // For pow
 
 #include "Slices.h"
 #include "WaveletTransform.h"
+#include "Quantisation.h"
 #include "VLC.h"
 #include "Utils.h"
+#include "TaskScheduler.h"
+
+#include "boost/bind.hpp"
 
 const int slice_bytes(int v, int h, // Slice co-ordinates
                      const int ySlices, const int xSlices, // Number of slices
@@ -25,7 +33,8 @@ const int slice_bytes(int v, int h, // Slice co-ordinates
 }
 
 const Array2D slice_bytes(const int ySlices, const int xSlices, const int totalBytes, const int scalar) {
-  const utils::Rational rationalBytes = utils::rationalise(totalBytes/scalar - 4*(ySlices*xSlices), (ySlices*xSlices));
+  // Share the bytes after the slice overheads in units of the scalar
+  const utils::Rational rationalBytes = utils::rationalise((totalBytes - 4*(ySlices*xSlices))/scalar, (ySlices*xSlices));
   const int sliceBytesNumerator = rationalBytes.numerator;
   const int sliceBytesDenominator = rationalBytes.denominator;
   const int ratio = sliceBytesNumerator/sliceBytesDenominator;
@@ -47,70 +56,906 @@ const Array2D slice_bytes(const int ySlices, const int xSlices, const int totalB
   return bytes;
 }
 
-const int luma_slice_bits(const Array2D& lumaSlice, const char waveletDepth) {
-  const int numberOfSubbands = 3*waveletDepth+1;
-  const BlockVector subbands = split_into_subbands(lumaSlice, waveletDepth);
-  int count = 0;
-  int gross = 0;
-  for (int band=0; band<numberOfSubbands; ++band) {
-    const Array2D& subband = subbands[band];
-    const int height = subband.shape()[0];
-    const int width = subband.shape()[1];
-    for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x) {
-        const int numBits = SignedVLC(subband[y][x]).numOfBits();
-        gross += numBits;
-        if (numBits>1) count=gross;
+namespace {
+
+  // Subsampling phase (offset) and factor (stride) of a subband within a
+  // slice in in-place transform order. Subbands are numbered in coding order,
+  // i.e. LL then HL, LH, HH for each level from low to high frequency.
+  struct Subband {
+    int rowOffset;
+    int colOffset;
+    int stride;
+  };
+
+  const Subband subband(const int band, const int waveletDepth) {
+    Subband result = {0, 0, utils::pow(2, waveletDepth)};
+    if (band==0) return result;
+    const int level = (band-1)/3 + 1;
+    result.stride = utils::pow(2, waveletDepth+1-level);
+    const int offset = result.stride/2;
+    switch ((band-1)%3) {
+      case 0: result.colOffset = offset; break; // HL
+      case 1: result.rowOffset = offset; break; // LH
+      case 2: result.rowOffset = offset; result.colOffset = offset; break; // HH
+    }
+    return result;
+  }
+
+  // Copy the coefficients of a slice component, in in-place transform order,
+  // into "coeffs" in coding order (i.e. subband by subband, each in raster order).
+  // This is the order of split_into_subbands but no arrays are created.
+  // "rowStride" is the distance between the start of successive rows of the component.
+  // If "bandEnds" is not null the (exclusive) end of each subband is stored there.
+  // Returns the number of coefficients copied.
+  // The component may be of ints or shorts (see ShortPicture).
+  template <class T>
+  int gather_subbands(const T* component, const int rowStride,
+                      const int height, const int width, const int waveletDepth,
+                      int* coeffs, int* bandEnds=0) {
+    const int numberOfSubbands = 3*waveletDepth+1;
+    int* out = coeffs;
+    for (int band=0; band<numberOfSubbands; ++band) {
+      const Subband sb = subband(band, waveletDepth);
+      for (int y=sb.rowOffset; y<height; y+=sb.stride) {
+        const T* line = component + y*rowStride;
+        for (int x=sb.colOffset; x<width; x+=sb.stride) {
+          *out++ = line[x];
+        }
       }
+      if (bandEnds) bandEnds[band] = static_cast<int>(out-coeffs);
     }
+    return static_cast<int>(out-coeffs);
   }
-  return count;
+
+  int gather_subbands(const Array2D& component, const int waveletDepth, int* coeffs) {
+    return gather_subbands(component.data(), component.shape()[1],
+                           component.shape()[0], component.shape()[1],
+                           waveletDepth, coeffs);
+  }
+
+  // The inverse of gather_subbands, copies coefficients in coding order into
+  // a slice component in in-place transform order (cf. merge_subbands).
+  void scatter_subbands(const int* coeffs, const int waveletDepth, Array2D& component) {
+    const int height = component.shape()[0];
+    const int width = component.shape()[1];
+    const int numberOfSubbands = 3*waveletDepth+1;
+    for (int band=0; band<numberOfSubbands; ++band) {
+      const Subband sb = subband(band, waveletDepth);
+      for (int y=sb.rowOffset; y<height; y+=sb.stride) {
+        int* line = component.data() + y*width;
+        for (int x=sb.colOffset; x<width; x+=sb.stride) {
+          line[x] = *coeffs++;
+        }
+      }
+    }
+  }
+
+  // Scratch space, from the arena, for all the coefficients of a slice component
+  int* component_scratch(const Array2D& component, ScratchArena& arena) {
+    return arena.allocate(component.num_elements());
+  }
+
+  // Number of bits needed to code coefficients in coding order, excluding
+  // trailing zeros (which need not be coded, since they are implied by the size
+  // of the bounded block).
+  // "count" and "gross" carry the state between successive calls.
+  void coded_bits(const int* coeffs, const int n, int& count, int& gross) {
+    for (int i=0; i<n; ++i) {
+      const int numBits = SignedVLC(coeffs[i]).numOfBits();
+      gross += numBits;
+      if (numBits>1) count=gross;
+    }
+  }
+
+  const int coded_bits(const int* coeffs, const int n) {
+    int count = 0;
+    int gross = 0;
+    coded_bits(coeffs, n, count, gross);
+    return count;
+  }
+
+  // Round a number of bits up to a whole number of scalar byte units
+  const int scaled_bytes(const int bits, const int scalar) {
+    return (((bits+7)/8 + scalar - 1)/scalar)*scalar;
+  }
+
+} // End unnamed namespace
+
+const int luma_slice_bits(const Array2D& lumaSlice, const char waveletDepth) {
+  ScratchArena& arena = ScratchArena::local();
+  ArenaScope scope(arena);
+  int* const coeffs = component_scratch(lumaSlice, arena);
+  const int n = gather_subbands(lumaSlice, waveletDepth, coeffs);
+  return coded_bits(coeffs, n);
 }
 
 const int chroma_slice_bits(const Array2D& uSlice, const Array2D& vSlice, const char waveletDepth) {
-  const int numberOfSubbands = 3*waveletDepth+1;
-  const BlockVector uSubbands = split_into_subbands(uSlice, waveletDepth);
-  const BlockVector vSubbands = split_into_subbands(vSlice, waveletDepth);
+  // TO DO: Check uSlice & vSlice have the same shape?
+  ScratchArena& arena = ScratchArena::local();
+  ArenaScope scope(arena);
+  int* const uCoeffs = component_scratch(uSlice, arena);
+  int* const vCoeffs = component_scratch(vSlice, arena);
+  const int n = gather_subbands(uSlice, waveletDepth, uCoeffs);
+  gather_subbands(vSlice, waveletDepth, vCoeffs);
+  // u and v coefficients are interleaved
   int count = 0;
   int gross = 0;
-  for (int band=0; band<numberOfSubbands; ++band) {
-    const Array2D& uSubband = uSubbands[band];
-    const Array2D& vSubband = vSubbands[band];
-    // TO DO: Check uSubband & vSubband have the same shape?
-    const int height = uSubband.shape()[0];
-    const int width = uSubband.shape()[1];
-    for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x) {
-        int numBits = SignedVLC(uSubband[y][x]).numOfBits();
+  for (int i=0; i<n; ++i) {
+    coded_bits(uCoeffs+i, 1, count, gross);
+    coded_bits(vCoeffs+i, 1, count, gross);
+  }
+  return count;
+}
+
+const int component_slice_bytes(const Array2D& slice, const char waveletDepth, const int scalar) {
+  ScratchArena& arena = ScratchArena::local();
+  ArenaScope scope(arena);
+  int* const coeffs = component_scratch(slice, arena);
+  const int n = gather_subbands(slice, waveletDepth, coeffs);
+  return scaled_bytes(coded_bits(coeffs, n), scalar); // return whole number of scalar byte units
+}
+
+namespace {
+
+  // Copy one component of slice [v][h] of a transform, in coding order, into the arena
+  template <class Array>
+  void gather_slice(const Array& component,
+                    int ySlices, int xSlices, int v, int h,
+                    const int waveletDepth, ScratchArena& arena,
+                    int*& coeffs, int*& bandEnds) {
+    // Slice boundaries, as for split_into_blocks
+    const int height = component.shape()[0];
+    const int width = component.shape()[1];
+    const int top = (v*height)/ySlices;
+    const int bottom = ((v+1)*height)/ySlices;
+    const int left = (h*width)/xSlices;
+    const int right = ((h+1)*width)/xSlices;
+    coeffs = arena.allocate((bottom-top)*(right-left));
+    bandEnds = arena.allocate(3*waveletDepth+1);
+    gather_subbands(component.data() + top*width + left, width,
+                    bottom-top, right-left, waveletDepth,
+                    coeffs, bandEnds);
+  }
+
+} // end unnamed namespace
+
+HQSliceSizer::HQSliceSizer(const Picture& transform,
+                           int ySlices, int xSlices, int v, int h,
+                           const Array1D& quantMatrix, const int s):
+  scope(ScratchArena::local()),
+  qMatrix(quantMatrix),
+  scalar(s),
+  numberOfSubbands(quantMatrix.size()),
+  waveletDepth((numberOfSubbands-1)/3) {
+  ScratchArena& arena = ScratchArena::local();
+  gather_slice(transform.y(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[0], bandEnds[0]);
+  gather_slice(transform.c1(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[1], bandEnds[1]);
+  gather_slice(transform.c2(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[2], bandEnds[2]);
+}
+
+HQSliceSizer::HQSliceSizer(const ShortPicture& transform,
+                           int ySlices, int xSlices, int v, int h,
+                           const Array1D& quantMatrix, const int s):
+  scope(ScratchArena::local()),
+  qMatrix(quantMatrix),
+  scalar(s),
+  numberOfSubbands(quantMatrix.size()),
+  waveletDepth((numberOfSubbands-1)/3) {
+  ScratchArena& arena = ScratchArena::local();
+  gather_slice(transform.y(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[0], bandEnds[0]);
+  gather_slice(transform.c1(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[1], bandEnds[1]);
+  gather_slice(transform.c2(), ySlices, xSlices, v, h, waveletDepth, arena, coeffs[2], bandEnds[2]);
+}
+
+const int HQSliceSizer::bytes(const int qIndex) const {
+  int componentBytes[3];
+  return bytes(qIndex, componentBytes);
+}
+
+const int HQSliceSizer::bytes(const int qIndex, int componentBytes[3]) const {
+  int total = 0;
+  for (int c=0; c<3; ++c) {
+    int count = 0;
+    int gross = 0;
+    for (int band=0, i=0; band<numberOfSubbands; ++band) {
+      const int q = adjust_quant_index(qIndex, qMatrix[band]);
+      for (; i<bandEnds[c][band]; ++i) {
+        const int numBits = SignedVLC(quant(coeffs[c][i], q)).numOfBits();
         gross += numBits;
         if (numBits>1) count=gross;
-        numBits = SignedVLC(vSubband[y][x]).numOfBits();
+      }
+    }
+    componentBytes[c] = scaled_bytes(count, scalar);
+    total += componentBytes[c];
+  }
+  return total;
+}
+
+const int HQSliceSizer::bytes(const int qIndex, double& distortion) const {
+  int total = 0;
+  distortion = 0.0;
+  for (int c=0; c<3; ++c) {
+    int count = 0;
+    int gross = 0;
+    for (int band=0, i=0; band<numberOfSubbands; ++band) {
+      const int q = adjust_quant_index(qIndex, qMatrix[band]);
+      long long error = 0;
+      for (; i<bandEnds[c][band]; ++i) {
+        const int value = quant(coeffs[c][i], q);
+        const int numBits = SignedVLC(value).numOfBits();
         gross += numBits;
         if (numBits>1) count=gross;
+        const long long difference = coeffs[c][i] - scale(value, q);
+        error += difference*difference;
       }
+      distortion += std::pow(2.0, 0.5*qMatrix[band])*error;
     }
+    total += scaled_bytes(count, scalar);
   }
-  return count;
+  return total;
 }
 
-const int component_slice_bytes(const Array2D& slice, const char waveletDepth, const int scalar) {
-  const int numberOfSubbands = 3*waveletDepth+1;
-  const BlockVector subbands = split_into_subbands(slice, waveletDepth);
+namespace {
+
+  // Indices for the slices in rows [firstRow, lastRow). If "codedBytes" is
+  // not null it is set to the bytes actually needed by each slice.
+  template <class Transform>
+  void quantIndexRows(const Transform& transform,
+                      const Array1D& qMatrix,
+                      const Array2D& sliceBytes,
+                      const int scalar,
+                      Array2D* indices,
+                      Array2D* codedBytes,
+                      int firstRow, int lastRow) {
+    const int ySlices = sliceBytes.shape()[0];
+    const int xSlices = sliceBytes.shape()[1];
+    for (int row=firstRow; row<lastRow; ++row) {
+      for (int column=0; column<xSlices; ++column) {
+        // Available bytes is the size of slice less 4 byte overhead
+        const int bytesAvailable = sliceBytes[row][column] - 4;
+        // Slice coefficients are held in scratch memory, released after each slice
+        const HQSliceSizer slice(transform, ySlices, xSlices, row, column, qMatrix, scalar);
+        int trialQ = 63;
+        int q = 127;
+        int delta = 64;
+        int bytesUsed = -1;
+        while (delta>0) {
+          delta >>= 1;
+          const int bytesRequired = slice.bytes(trialQ);
+          if (bytesRequired<=bytesAvailable) {
+            if (trialQ<q) {
+              q = trialQ;
+              bytesUsed = bytesRequired;
+            }
+            trialQ -= delta;
+          }
+          else {
+            trialQ += delta;
+          }
+        }
+        (*indices)[row][column] = q;
+        if (codedBytes) {
+          if (bytesUsed<0) bytesUsed = slice.bytes(q); // Nothing fitted
+          (*codedBytes)[row][column] = bytesUsed + 4;
+        }
+      }
+    }
+  }
+
+  // If "scheduler" is not null rows of slices are searched concurrently
+  template <class Transform>
+  const Array2D quantIndices(const Transform& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             const int scalar,
+                             Array2D* codedBytes,
+                             TaskScheduler* scheduler=0) {
+    const int ySlices = sliceBytes.shape()[0];
+    const int xSlices = sliceBytes.shape()[1];
+    // Create an empty array of indices to fill and return
+    Array2D indices(extents[ySlices][xSlices]);
+    if (codedBytes) codedBytes->resize(extents[ySlices][xSlices]);
+    if (scheduler) {
+      parallel_for(*scheduler, 0, ySlices,
+                   boost::bind(&quantIndexRows<Transform>, boost::cref(transform),
+                               boost::cref(qMatrix), boost::cref(sliceBytes), scalar,
+                               &indices, codedBytes, _1, _2));
+    }
+    else quantIndexRows(transform, qMatrix, sliceBytes, scalar, &indices, codedBytes, 0, ySlices);
+    return indices;
+  }
+
+} // end unnamed namespace
+
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar) {
+  return quantIndices<Picture>(transform, qMatrix, sliceBytes, scalar, 0);
+}
+
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar) {
+  return quantIndices<ShortPicture>(transform, qMatrix, sliceBytes, scalar, 0);
+}
+
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes) {
+  return quantIndices<Picture>(transform, qMatrix, sliceBytes, scalar, &codedBytes);
+}
+
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes) {
+  return quantIndices<ShortPicture>(transform, qMatrix, sliceBytes, scalar, &codedBytes);
+}
+
+const Array2D quantIndices(const Picture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes,
+                           TaskScheduler& scheduler) {
+  return quantIndices<Picture>(transform, qMatrix, sliceBytes, scalar, &codedBytes, &scheduler);
+}
+
+const Array2D quantIndices(const ShortPicture& transform,
+                           const Array1D& qMatrix,
+                           const Array2D& sliceBytes,
+                           const int scalar,
+                           Array2D& codedBytes,
+                           TaskScheduler& scheduler) {
+  return quantIndices<ShortPicture>(transform, qMatrix, sliceBytes, scalar, &codedBytes, &scheduler);
+}
+
+namespace {
+
+  // Bytes for slice [v][h], and each of its components, quantised with qIndex
+  template <class Transform>
+  const int hq_slice_bytes(const Transform& transform,
+                           int ySlices, int xSlices, int v, int h,
+                           const Array1D& qMatrix, const int scalar,
+                           const int qIndex, int componentBytes[3]) {
+    const HQSliceSizer slice(transform, ySlices, xSlices, v, h, qMatrix, scalar);
+    return slice.bytes(qIndex, componentBytes);
+  }
+
+  // True if every component fits in its one byte length
+  const bool fits_length(const int componentBytes[3], const int scalar) {
+    return (componentBytes[0]<=255*scalar) &&
+           (componentBytes[1]<=255*scalar) &&
+           (componentBytes[2]<=255*scalar);
+  }
+
+  // A slice that might use one less than the common index, and the extra bytes it would need
+  struct Refinement {
+    int v;
+    int h;
+    int extraBytes;
+    bool operator<(const Refinement& other) const {return extraBytes<other.extraBytes;}
+  };
+
+  // Code the slices with the common index, then use the remaining bytes to code
+  // the slices that need fewest extra bytes with one less.
+  // Returns the total bytes of the slices.
+  template <class Transform>
+  const long long common_indices(const Transform& transform,
+                                 const int ySlices, const int xSlices,
+                                 const Array1D& qMatrix, const int scalar,
+                                 const Array2D& minIndices, const int commonIndex,
+                                 const long long budget,
+                                 Array2D& indices, Array2D& codedBytes) {
+    int componentBytes[3];
+    long long total = 0;
+    std::vector<Refinement> refinements;
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        const int q = std::max(commonIndex, static_cast<int>(minIndices[v][h]));
+        indices[v][h] = q;
+        codedBytes[v][h] = 4 + hq_slice_bytes(transform, ySlices, xSlices, v, h,
+                                              qMatrix, scalar, q, componentBytes);
+        total += codedBytes[v][h];
+        if ((q==commonIndex) && (q>minIndices[v][h])) {
+          const Refinement refinement = {v, h, 0};
+          refinements.push_back(refinement);
+        }
+      }
+    }
+    for (std::vector<Refinement>::iterator r=refinements.begin(); r!=refinements.end(); ++r) {
+      r->extraBytes = 4 + hq_slice_bytes(transform, ySlices, xSlices, r->v, r->h,
+                                         qMatrix, scalar, commonIndex-1, componentBytes) -
+                      codedBytes[r->v][r->h];
+    }
+    std::sort(refinements.begin(), refinements.end());
+    for (std::vector<Refinement>::const_iterator r=refinements.begin(); r!=refinements.end(); ++r) {
+      if (total+r->extraBytes > budget) break;
+      indices[r->v][r->h] = commonIndex-1;
+      codedBytes[r->v][r->h] += r->extraBytes;
+      total += r->extraBytes;
+    }
+    return total;
+  }
+
+  // A candidate index for a slice, with its bytes (including the 4 byte
+  // overhead) and distortion
+  struct Candidate {
+    int qIndex;
+    int bytes;
+    double distortion;
+  };
+
+  // Candidates chosen by each slice, given a Lagrange multiplier: those that
+  // minimise distortion + lambda*bytes. Returns the total bytes.
+  const long long lagrangian_choice(const std::vector<Candidate>& candidates,
+                                    const std::vector<int>& first,
+                                    const double lambda,
+                                    std::vector<int>& choice) {
+    long long total = 0;
+    const int numberOfSlices = choice.size();
+    for (int slice=0; slice<numberOfSlices; ++slice) {
+      int best = first[slice];
+      double bestCost = candidates[best].distortion + lambda*candidates[best].bytes;
+      for (int i=first[slice]+1; i<first[slice+1]; ++i) {
+        const double cost = candidates[i].distortion + lambda*candidates[i].bytes;
+        if ((cost<bestCost) ||
+            ((cost==bestCost) && (candidates[i].bytes<candidates[best].bytes))) {
+          best = i;
+          bestCost = cost;
+        }
+      }
+      choice[slice] = best;
+      total += candidates[best].bytes;
+    }
+    return total;
+  }
+
+  // A finer candidate for a slice, and the distortion it saves per extra byte
+  struct Improvement {
+    int slice;
+    int candidate;
+    double gain;
+    bool operator<(const Improvement& other) const {return gain>other.gain;} // Largest gain first
+  };
+
+  // Choose the indices, within "range" of the common index, that minimise the
+  // total distortion of the slices for the budget.
+  // Returns the total bytes of the slices.
+  template <class Transform>
+  const long long rd_indices(const Transform& transform,
+                             const int ySlices, const int xSlices,
+                             const Array1D& qMatrix, const int scalar,
+                             const Array2D& minIndices, const int commonIndex,
+                             const long long budget,
+                             Array2D& indices, Array2D& codedBytes) {
+    const int range = 8;
+    const int numberOfSlices = ySlices*xSlices;
+    // Bytes and distortion of each slice for the indices it may use. These
+    // include the common index (or the slice's minimum), which fit the budget.
+    std::vector<Candidate> candidates;
+    candidates.reserve(numberOfSlices*(2*range+1));
+    std::vector<int> first(numberOfSlices+1); // Each slice's first candidate
+    for (int v=0, slice=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h, ++slice) {
+        first[slice] = candidates.size();
+        const HQSliceSizer sizer(transform, ySlices, xSlices, v, h, qMatrix, scalar);
+        const int low = std::max(commonIndex-range, static_cast<int>(minIndices[v][h]));
+        const int high = std::max(low, std::min(commonIndex+range, maxQuantIndex));
+        for (int q=low; q<=high; ++q) {
+          Candidate candidate;
+          candidate.qIndex = q;
+          candidate.bytes = 4 + sizer.bytes(q, candidate.distortion);
+          candidates.push_back(candidate);
+        }
+      }
+    }
+    first[numberOfSlices] = candidates.size();
+    // Smallest Lagrange multiplier for which the slices fit (a bisection)
+    std::vector<int> choice(numberOfSlices);
+    long long total = lagrangian_choice(candidates, first, 0.0, choice);
+    if (total>budget) {
+      double low = 0.0;
+      double high = 1.0;
+      for (int i=0; (i<200) && (lagrangian_choice(candidates, first, high, choice)>budget); ++i) {
+        low = high;
+        high *= 2.0;
+      }
+      for (int i=0; i<50; ++i) {
+        const double lambda = 0.5*(low+high);
+        if (lagrangian_choice(candidates, first, lambda, choice)>budget) low = lambda;
+        else high = lambda;
+      }
+      total = lagrangian_choice(candidates, first, high, choice);
+    }
+    // Use any remaining bytes for the finer candidates that save most
+    // distortion per byte
+    std::vector<Improvement> improvements;
+    for (int slice=0; slice<numberOfSlices; ++slice) {
+      const Candidate& chosen = candidates[choice[slice]];
+      Improvement best = {slice, -1, 0.0};
+      for (int i=first[slice]; i<first[slice+1]; ++i) {
+        const int extraBytes = candidates[i].bytes - chosen.bytes;
+        const double saving = chosen.distortion - candidates[i].distortion;
+        if ((extraBytes>0) && (saving>0.0) && (saving/extraBytes>best.gain)) {
+          best.candidate = i;
+          best.gain = saving/extraBytes;
+        }
+      }
+      if (best.candidate>=0) improvements.push_back(best);
+    }
+    std::sort(improvements.begin(), improvements.end());
+    for (std::vector<Improvement>::const_iterator i=improvements.begin(); i!=improvements.end(); ++i) {
+      const int extraBytes = candidates[i->candidate].bytes - candidates[choice[i->slice]].bytes;
+      if (total+extraBytes<=budget) {
+        choice[i->slice] = i->candidate;
+        total += extraBytes;
+      }
+    }
+    for (int v=0, slice=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h, ++slice) {
+        indices[v][h] = candidates[choice[slice]].qIndex;
+        codedBytes[v][h] = candidates[choice[slice]].bytes;
+      }
+    }
+    return total;
+  }
+
+  template <class Transform>
+  const Array2D pictureQuantIndices(const Transform& transform,
+                                    const Array1D& qMatrix,
+                                    const Array2D& sliceBytes,
+                                    const int scalar,
+                                    Array2D& codedBytes,
+                                    Array2D& allocatedBytes,
+                                    const bool minimiseDistortion) {
+    const int ySlices = sliceBytes.shape()[0];
+    const int xSlices = sliceBytes.shape()[1];
+    int componentBytes[3];
+    // Start from the indices for fixed slice sizes, which fit the picture
+    Array2D indices = quantIndices<Transform>(transform, qMatrix, sliceBytes, scalar, &codedBytes);
+    allocatedBytes.resize(extents[ySlices][xSlices]);
+    allocatedBytes = sliceBytes;
+    long long budget = 0;
+    int maxIndex = 0;
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        budget += sliceBytes[v][h];
+        maxIndex = std::max(maxIndex, static_cast<int>(indices[v][h]));
+      }
+    }
+    // Smallest index at which each slice's components fit their lengths
+    Array2D minIndices(extents[ySlices][xSlices]);
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        const HQSliceSizer slice(transform, ySlices, xSlices, v, h, qMatrix, scalar);
+        int low = 0;
+        int high = indices[v][h];
+        slice.bytes(high, componentBytes);
+        if (!fits_length(componentBytes, scalar)) {
+          return indices; // Slices cannot be coded any differently
+        }
+        while (low<high) {
+          const int trialQ = (low+high)/2;
+          slice.bytes(trialQ, componentBytes);
+          if (fits_length(componentBytes, scalar)) high = trialQ;
+          else low = trialQ+1;
+        }
+        minIndices[v][h] = low;
+      }
+    }
+    // Smallest common index for which the picture fits. The largest of the
+    // fixed size indices always fits, since every slice then fits its fixed size.
+    int low = 0;
+    int high = maxIndex;
+    while (low<high) {
+      const int trialQ = (low+high)/2;
+      long long trialTotal = 0;
+      for (int v=0; (v<ySlices) && (trialTotal<=budget); ++v) {
+        for (int h=0; h<xSlices; ++h) {
+          trialTotal += 4 + hq_slice_bytes(transform, ySlices, xSlices, v, h, qMatrix, scalar,
+                                           std::max(trialQ, static_cast<int>(minIndices[v][h])),
+                                           componentBytes);
+        }
+      }
+      if (trialTotal<=budget) high = trialQ;
+      else low = trialQ+1;
+    }
+    const int commonIndex = low;
+    const long long total = minimiseDistortion ?
+      rd_indices(transform, ySlices, xSlices, qMatrix, scalar, minIndices, commonIndex, budget, indices, codedBytes) :
+      common_indices(transform, ySlices, xSlices, qMatrix, scalar, minIndices, commonIndex, budget, indices, codedBytes);
+    // Pad slices (in their last component, as HQSliceIO_CBR does) so that the
+    // picture is exactly its size
+    long long padding = budget - total;
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        int slicePadding = 0;
+        if (padding>0) {
+          hq_slice_bytes(transform, ySlices, xSlices, v, h, qMatrix, scalar, indices[v][h], componentBytes);
+          slicePadding = static_cast<int>(std::min<long long>(padding, 255*scalar - componentBytes[2]));
+          padding -= slicePadding;
+        }
+        allocatedBytes[v][h] = codedBytes[v][h] + slicePadding;
+      }
+    }
+    if (padding>0) {
+      throw std::logic_error("pictureQuantIndices: too many bytes for the slices of the picture");
+    }
+    return indices;
+  }
+
+} // end unnamed namespace
+
+const Array2D pictureQuantIndices(const Picture& transform,
+                                  const Array1D& qMatrix,
+                                  const Array2D& sliceBytes,
+                                  const int scalar,
+                                  Array2D& codedBytes,
+                                  Array2D& allocatedBytes) {
+  return pictureQuantIndices<Picture>(transform, qMatrix, sliceBytes, scalar, codedBytes, allocatedBytes, false);
+}
+
+const Array2D pictureQuantIndices(const ShortPicture& transform,
+                                  const Array1D& qMatrix,
+                                  const Array2D& sliceBytes,
+                                  const int scalar,
+                                  Array2D& codedBytes,
+                                  Array2D& allocatedBytes) {
+  return pictureQuantIndices<ShortPicture>(transform, qMatrix, sliceBytes, scalar, codedBytes, allocatedBytes, false);
+}
+
+const Array2D rdQuantIndices(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             const int scalar,
+                             Array2D& codedBytes,
+                             Array2D& allocatedBytes) {
+  return pictureQuantIndices<Picture>(transform, qMatrix, sliceBytes, scalar, codedBytes, allocatedBytes, true);
+}
+
+const Array2D rdQuantIndices(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             const int scalar,
+                             Array2D& codedBytes,
+                             Array2D& allocatedBytes) {
+  return pictureQuantIndices<ShortPicture>(transform, qMatrix, sliceBytes, scalar, codedBytes, allocatedBytes, true);
+}
+
+const int min_slice_scalar(const int sliceBytes) {
+  const int componentBytes = (sliceBytes - 4 + 2)/3;
+  return std::max(1, (componentBytes + 254)/255);
+}
+
+namespace {
+
+  // Smallest scalar for a component of the given bytes (counted with scalar 1)
+  const int component_scalar(const int bytes) {
+    return (bytes + 254)/255;
+  }
+
+  template <class Transform>
+  const int required_slice_scalar(const Transform& transform, const Array1D& qMatrix,
+                                  const Array2D& qIndices, const Array2D& sliceBytes) {
+    const int ySlices = qIndices.shape()[0];
+    const int xSlices = qIndices.shape()[1];
+    int scalar = 1;
+    int componentBytes[3];
+    for (int v=0; v<ySlices; ++v) {
+      for (int h=0; h<xSlices; ++h) {
+        // Component sizes with a scalar of 1 (so each is the fewest bytes it needs)
+        const HQSliceSizer slice(transform, ySlices, xSlices, v, h, qMatrix, 1);
+        const int qIndex = qIndices[v][h];
+        slice.bytes(qIndex, componentBytes);
+        // The last component is padded to the size of the slice
+        componentBytes[2] = std::max(componentBytes[2],
+                                     sliceBytes[v][h] - 4 - componentBytes[0] - componentBytes[1]);
+        for (int c=0; c<3; ++c) scalar = std::max(scalar, component_scalar(componentBytes[c]));
+        if (qIndex>0) {
+          slice.bytes(qIndex-1, componentBytes);
+          for (int c=0; c<3; ++c) scalar = std::max(scalar, component_scalar(componentBytes[c]));
+        }
+      }
+    }
+    return scalar;
+  }
+
+} // end unnamed namespace
+
+const int required_slice_scalar(const Picture& transform, const Array1D& qMatrix,
+                                const Array2D& qIndices, const Array2D& sliceBytes) {
+  return required_slice_scalar<Picture>(transform, qMatrix, qIndices, sliceBytes);
+}
+
+const int required_slice_scalar(const ShortPicture& transform, const Array1D& qMatrix,
+                                const Array2D& qIndices, const Array2D& sliceBytes) {
+  return required_slice_scalar<ShortPicture>(transform, qMatrix, qIndices, sliceBytes);
+}
+
+// Copy one component of the slice into the arena and locate it within the LL subband
+template <class Array>
+void LDSliceSizer::gather(const int c, const Array& component,
+                          int ySlices, int xSlices, int v, int h) {
+  ScratchArena& arena = ScratchArena::local();
+  gather_slice(component, ySlices, xSlices, v, h, waveletDepth, arena, coeffs[c], bandEnds[c]);
+  quantised[c] = arena.allocate(bandEnds[c][numberOfSubbands-1]);
+  // LL subband boundaries of the slice, as for quantise_transform
+  const int stride = utils::pow(2, waveletDepth);
+  const int bandHeight = component.shape()[0]/stride;
+  const int bandWidth = component.shape()[1]/stride;
+  llWidth[c] = bandWidth;
+  llTop[c] = (v*bandHeight)/ySlices;
+  llLeft[c] = (h*bandWidth)/xSlices;
+  llBottom[c] = ((v+1)*bandHeight)/ySlices;
+  llRight[c] = ((h+1)*bandWidth)/xSlices;
+}
+
+LDSliceSizer::LDSliceSizer(const Picture& transform,
+                           int ySlices, int xSlices, int v, int h,
+                           const Array1D& quantMatrix,
+                           int* const restoredLL[3]):
+  scope(ScratchArena::local()),
+  qMatrix(quantMatrix),
+  numberOfSubbands(quantMatrix.size()),
+  waveletDepth((numberOfSubbands-1)/3) {
+  for (int c=0; c<3; ++c) restored[c] = restoredLL[c];
+  gather(0, transform.y(), ySlices, xSlices, v, h);
+  gather(1, transform.c1(), ySlices, xSlices, v, h);
+  gather(2, transform.c2(), ySlices, xSlices, v, h);
+}
+
+LDSliceSizer::LDSliceSizer(const ShortPicture& transform,
+                           int ySlices, int xSlices, int v, int h,
+                           const Array1D& quantMatrix,
+                           int* const restoredLL[3]):
+  scope(ScratchArena::local()),
+  qMatrix(quantMatrix),
+  numberOfSubbands(quantMatrix.size()),
+  waveletDepth((numberOfSubbands-1)/3) {
+  for (int c=0; c<3; ++c) restored[c] = restoredLL[c];
+  gather(0, transform.y(), ySlices, xSlices, v, h);
+  gather(1, transform.c1(), ySlices, xSlices, v, h);
+  gather(2, transform.c2(), ySlices, xSlices, v, h);
+}
+
+// Quantise the LL coefficients of one component with DC prediction,
+// restoring them for the prediction of the coefficients that follow
+void LDSliceSizer::quantise_LL(const int c, const int qIndex) {
+  const int q = adjust_quant_index(qIndex, qMatrix[0]);
+  const int width = llWidth[c];
+  const int columns = llRight[c]-llLeft[c];
+  const int* in = coeffs[c];
+  int* out = quantised[c];
+  for (int row=llTop[c]; row<llBottom[c]; ++row, in+=columns, out+=columns) {
+    int* const line = restored[c] + row*width + llLeft[c];
+    quantise_LL_row(in, out, columns, q, ((row>0) ? line-width : 0), line, (llLeft[c]==0));
+  }
+}
+
+void LDSliceSizer::bits(const int qIndex, int& yBits, int& uvBits) {
+  for (int c=0; c<3; ++c) {
+    quantise_LL(c, qIndex);
+    for (int band=1, i=bandEnds[c][0]; band<numberOfSubbands; ++band) {
+      const int q = adjust_quant_index(qIndex, qMatrix[band]);
+      for (; i<bandEnds[c][band]; ++i) {
+        quantised[c][i] = quant(coeffs[c][i], q);
+      }
+    }
+  }
+  yBits = coded_bits(quantised[0], bandEnds[0][numberOfSubbands-1]);
+  // u and v coefficients are interleaved
   int count = 0;
   int gross = 0;
-  for (int band=0; band<numberOfSubbands; ++band) {
-    const Array2D& subband = subbands[band];
-    const int height = subband.shape()[0];
-    const int width = subband.shape()[1];
-    for (int y=0; y<height; ++y) {
-      for (int x=0; x<width; ++x) {
-        const int numBits = SignedVLC(subband[y][x]).numOfBits();
-        gross += numBits;
-        if (numBits>1) count=gross;
+  const int uvCount = bandEnds[1][numberOfSubbands-1];
+  for (int i=0; i<uvCount; ++i) {
+    coded_bits(quantised[1]+i, 1, count, gross);
+    coded_bits(quantised[2]+i, 1, count, gross);
+  }
+  uvBits = count;
+}
+
+void LDSliceSizer::restore(const int qIndex) {
+  for (int c=0; c<3; ++c) quantise_LL(c, qIndex);
+}
+
+namespace {
+
+  // Bytes needed by an LD slice: 7 bit quantisation index, length of the luma
+  // block, then the luma and chroma blocks. Returns 0 if they do not fit.
+  const int ld_slice_bytes(const int yBits, const int uvBits, const int sliceBytes) {
+    const int uvSplitBits = utils::intlog2(8*sliceBytes-7);
+    const int bits = 7 + uvSplitBits + yBits + uvBits;
+    if (bits>8*sliceBytes) return 0;
+    return (bits+7)/8;
+  }
+
+  // If "codedBytes" is not null it is set to the bytes actually needed by each slice
+  template <class Transform>
+  const Array2D quantIndicesLD(const Transform& transform,
+                               const Array1D& qMatrix,
+                               const Array2D& sliceBytes,
+                               Array2D* codedBytes) {
+    const int ySlices = sliceBytes.shape()[0];
+    const int xSlices = sliceBytes.shape()[1];
+    Array2D indices(extents[ySlices][xSlices]);
+    if (codedBytes) codedBytes->resize(extents[ySlices][xSlices]);
+    // Restored LL subbands, for prediction, held in scratch memory for the whole picture
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
+    const int waveletDepth = (qMatrix.size()-1)/3;
+    const int stride = utils::pow(2, waveletDepth);
+    int* const restoredLL[3] = {
+      arena.allocate((transform.y().num_elements())/(stride*stride)),
+      arena.allocate((transform.c1().num_elements())/(stride*stride)),
+      arena.allocate((transform.c2().num_elements())/(stride*stride)) };
+    for (int row=0; row<ySlices; ++row) {
+      for (int column=0; column<xSlices; ++column) {
+        const int bytesAvailable = sliceBytes[row][column];
+        LDSliceSizer slice(transform, ySlices, xSlices, row, column, qMatrix, restoredLL);
+        int yBits, uvBits;
+        int trialQ = 63;
+        int q = 127;
+        int delta = 64;
+        int bytesUsed = 0;
+        while (delta>0) {
+          delta >>= 1;
+          slice.bits(trialQ, yBits, uvBits);
+          const int bytesRequired = ld_slice_bytes(yBits, uvBits, bytesAvailable);
+          if (bytesRequired>0) {
+            if (trialQ<q) {
+              q = trialQ;
+              bytesUsed = bytesRequired;
+            }
+            trialQ -= delta;
+          }
+          else {
+            trialQ += delta;
+          }
+        }
+        // Later slices are predicted from this slice restored with its chosen index
+        slice.restore(q);
+        indices[row][column] = q;
+        if (codedBytes) {
+          if (bytesUsed==0) bytesUsed = bytesAvailable; // Nothing fitted
+          (*codedBytes)[row][column] = bytesUsed;
+        }
       }
     }
+    return indices;
   }
-  return (((count+7)/8 + scalar - 1)/scalar)*scalar; // return whole number of scalar byte units
+
+} // end unnamed namespace
+
+const Array2D quantIndicesLD(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes) {
+  return quantIndicesLD<Picture>(transform, qMatrix, sliceBytes, 0);
+}
+
+const Array2D quantIndicesLD(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes) {
+  return quantIndicesLD<ShortPicture>(transform, qMatrix, sliceBytes, 0);
+}
+
+const Array2D quantIndicesLD(const Picture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             Array2D& codedBytes) {
+  return quantIndicesLD<Picture>(transform, qMatrix, sliceBytes, &codedBytes);
+}
+
+const Array2D quantIndicesLD(const ShortPicture& transform,
+                             const Array1D& qMatrix,
+                             const Array2D& sliceBytes,
+                             Array2D& codedBytes) {
+  return quantIndicesLD<ShortPicture>(transform, qMatrix, sliceBytes, &codedBytes);
 }
 
 SliceQuantiser::SliceQuantiser(const Array2D& coefficients,
@@ -143,19 +988,29 @@ const bool SliceQuantiser::next_slice() {
 
 //**** IO functions ****//
 
+// A slice to be written (refers to, rather than copies, the slice coefficients)
 struct Slice {
     Slice(const Picture& p, int d, int i):
       yuvSlice(p), waveletDepth(d), qIndex(i) {};
-    Slice(const PictureFormat& f, int d):
-      yuvSlice(f), waveletDepth(d) {};
-    Picture yuvSlice;
+    const Picture& yuvSlice;
+    const int waveletDepth;
+    const int qIndex;
+};
+
+// A slice to be read. Coefficients are read directly into an existing picture,
+// which must already be the size of the slice.
+struct SliceIn {
+    SliceIn(Picture& p, int d):
+      yuvSlice(p), waveletDepth(d), qIndex(0), bytes(0) {};
+    Picture& yuvSlice;
     const int waveletDepth;
     int qIndex;
+    int bytes; // Size of the slice read
 };
 
 std::ostream& operator << (std::ostream& stream, const Slice& s);
 
-std::istream& operator >> (std::istream& stream, Slice& s);
+std::istream& operator >> (std::istream& stream, SliceIn& s);
 
 // ostream format manipulator to set the size of a single slice
 class setBytes {
@@ -191,63 +1046,125 @@ namespace {
       return stream.iword(i);
   }
 
+  long& slice_prefix(std::ios_base& stream) {
+      static const int i = std::ios_base::xalloc();
+      return stream.iword(i);
+  }
+
   long& single_slice_size(std::ios_base& stream) {
       static const int i = std::ios_base::xalloc();
       return stream.iword(i);
   }
 
+  // Pointer to the SliceRegion to read, or 0 to read every slice
+  long& slice_region(std::ios_base& stream) {
+      static const int i = std::ios_base::xalloc();
+      return stream.iword(i);
+  }
+
+  // Write coefficients, in coding order, as signed exp-Golomb codes
+  void write_coeffs(std::ostream& stream, const int* coeffs, const int n) {
+    for (int i=0; i<n; ++i) {
+      stream << SignedVLC(coeffs[i]);
+    }
+  }
+
+  // Read n signed exp-Golomb coded coefficients
+  void read_coeffs(std::istream& stream, int* coeffs, const int n) {
+    SignedVLC inVLC;
+    for (int i=0; i<n; ++i) {
+      stream >> inVLC;
+      coeffs[i] = inVLC;
+    }
+  }
+
+  // Write one component of an HQ slice, comprising its length, in units of
+  // the slice size scalar, followed by a bounded block of coefficients.
+  void HQComponentIO(std::ostream& stream, const int* coeffs, const int n,
+                     const int bytes, const int scalar) {
+    stream << Bytes(1, bytes/scalar);
+    stream << vlc::bounded(8*bytes);
+    write_coeffs(stream, coeffs, n);
+    stream << vlc::flush << vlc::align;
+  }
+
+  // Read the bounded block of coefficients for one component of an HQ slice
+  // (the length has already been read).
+  void HQComponentIO(std::istream& stream, int* coeffs, const int n, const int bytes) {
+    stream >> vlc::bounded(8*bytes);
+    read_coeffs(stream, coeffs, n);
+    stream >> vlc::flush >> vlc::align;
+  }
+
+  // Write the prefix bytes of an HQ slice (zero, their use is application specific)
+  void HQPrefixIO(std::ostream& stream, const int prefix) {
+    for (int i=0; i<prefix; ++i) stream << Bytes(1, 0);
+  }
+
+  // Skip the prefix bytes of an HQ slice
+  void HQPrefixIO(std::istream& stream, const int prefix) {
+    Bytes b(1);
+    for (int i=0; i<prefix; ++i) stream >> b;
+  }
+
+  // Note: All the slice IO functions use the thread's scratch arena, for the
+  // slice coefficients in coding order, and release it when they return.
+  // So no memory is allocated per slice (once the arena is big enough).
+
   std::ostream& LDSliceIO(std::ostream& stream, const Slice& s) {
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
+
     //Get slice size from the stream
     const int sliceSize = static_cast<int>(single_slice_size(stream));
 
-    const BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    const BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    const BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
+    const Array2D& ySlice = s.yuvSlice.y();
+    const Array2D& uSlice = s.yuvSlice.c1();
+    const Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+    const int yCount = gather_subbands(ySlice, s.waveletDepth, yCoeffs);
+    const int uvCount = gather_subbands(uSlice, s.waveletDepth, uCoeffs);
+    gather_subbands(vSlice, s.waveletDepth, vCoeffs);
 
     stream << Bits(7, s.qIndex);
 
-    const int yBits = luma_slice_bits(s.yuvSlice.y(), s.waveletDepth);
+    const int yBits = coded_bits(yCoeffs, yCount);
     const int uvSplitBits = utils::intlog2(8*sliceSize-7);
     const int uvBits = 8*sliceSize - 7 - uvSplitBits - yBits;
     stream << Bits(uvSplitBits, yBits);
 
-    const int numberOfSubbands = 3*s.waveletDepth+1;
     stream << vlc::bounded(yBits);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& ySubband = ySliceSubbands[band];
-      const int height = ySubband.shape()[0];
-      const int width = ySubband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(ySubband[y][x]);
-        }
-      }
-    }
+    write_coeffs(stream, yCoeffs, yCount);
     stream << vlc::flush;
 
+    // u and v coefficients are interleaved
     stream << vlc::bounded(uvBits);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& uSubband = uSliceSubbands[band];
-      const Array2D& vSubband = vSliceSubbands[band];
-      const int height = uSubband.shape()[0];
-      const int width = uSubband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(uSubband[y][x]);
-          stream << SignedVLC(vSubband[y][x]);
-        }
-      }
+    for (int i=0; i<uvCount; ++i) {
+      stream << SignedVLC(uCoeffs[i]);
+      stream << SignedVLC(vCoeffs[i]);
     }
     stream << vlc::flush << vlc::align;
     return stream;
   }
 
-  std::istream& LDSliceIO(std::istream& stream, Slice& s) {
-    const int sliceSize = static_cast<int>(single_slice_size(stream));
+  std::istream& LDSliceIO(std::istream& stream, SliceIn& s) {
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
 
-    BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
+    const int sliceSize = static_cast<int>(single_slice_size(stream));
+    s.bytes = sliceSize;
+
+    Array2D& ySlice = s.yuvSlice.y();
+    Array2D& uSlice = s.yuvSlice.c1();
+    Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+    const int yCount = ySlice.num_elements();
+    // TO DO: Check u and v slices have the same shape?
+    const int uvCount = uSlice.num_elements();
 
     Bits q(7);
     stream >> q;
@@ -259,335 +1176,222 @@ namespace {
     yBits = yb;
     const int uvBits = 8*sliceSize - 7 - uvSplitBits - yBits;
 
-    const int numberOfSubbands = 3*s.waveletDepth+1;
     stream >> vlc::bounded(yBits);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& ySubband = ySliceSubbands[band];
-      const int height = ySubband.shape()[0];
-      const int width = ySubband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          ySubband[y][x] = inVLC;
-        }
-      }
-    }
+    read_coeffs(stream, yCoeffs, yCount);
     stream >> vlc::flush;
 
     stream >> vlc::bounded(uvBits);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& uSubband = uSliceSubbands[band];
-      Array2D& vSubband = vSliceSubbands[band];
-      const int height = uSubband.shape()[0];
-      const int width = uSubband.shape()[1];
-      // TO DO: Check u and v subbands have the same shape?
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          uSubband[y][x] = inVLC;
-          stream >> inVLC;
-          vSubband[y][x] = inVLC;
-        }
-      }
+    SignedVLC inVLC;
+    for (int i=0; i<uvCount; ++i) {
+      stream >> inVLC;
+      uCoeffs[i] = inVLC;
+      stream >> inVLC;
+      vCoeffs[i] = inVLC;
     }
     stream >> vlc::flush >> vlc::align;
 
-    s.yuvSlice.y(merge_subbands(ySliceSubbands));
-    s.yuvSlice.c1(merge_subbands(uSliceSubbands));
-    s.yuvSlice.c2(merge_subbands(vSliceSubbands));
+    scatter_subbands(yCoeffs, s.waveletDepth, ySlice);
+    scatter_subbands(uCoeffs, s.waveletDepth, uSlice);
+    scatter_subbands(vCoeffs, s.waveletDepth, vSlice);
 
     return stream;
   }
 
   std::ostream& HQSliceIO_CBR(std::ostream& stream, const Slice& s) {
-    const int sliceSize = static_cast<int>(single_slice_size(stream));
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
 
-    const BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    const BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    const BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
-    const int numberOfSubbands = 3*s.waveletDepth+1;
+    const int sliceSize = static_cast<int>(single_slice_size(stream));
     const int scalar = slice_scalar(stream);
 
+    const Array2D& ySlice = s.yuvSlice.y();
+    const Array2D& uSlice = s.yuvSlice.c1();
+    const Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+    const int yCount = gather_subbands(ySlice, s.waveletDepth, yCoeffs);
+    const int uCount = gather_subbands(uSlice, s.waveletDepth, uCoeffs);
+    const int vCount = gather_subbands(vSlice, s.waveletDepth, vCoeffs);
+
+    HQPrefixIO(stream, static_cast<int>(slice_prefix(stream)));
     stream << Bytes(1, s.qIndex);
 
     // Output first (y/luma) component
-    const int yBytes = component_slice_bytes(s.yuvSlice.y(), s.waveletDepth, scalar);
-    stream << Bytes(1, yBytes/scalar);
-    stream << vlc::bounded(8*yBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = ySliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    const int yBytes = scaled_bytes(coded_bits(yCoeffs, yCount), scalar);
+    HQComponentIO(stream, yCoeffs, yCount, yBytes, scalar);
 
     // Output secomd (u/c1/chroma) component
-    const int uBytes = component_slice_bytes(s.yuvSlice.c1(), s.waveletDepth, scalar);
-    stream << Bytes(1, uBytes/scalar);
-    stream << vlc::bounded(8*uBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = uSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    const int uBytes = scaled_bytes(coded_bits(uCoeffs, uCount), scalar);
+    HQComponentIO(stream, uCoeffs, uCount, uBytes, scalar);
     
     // Output third (v/c2/chroma) component
     // Calculate bytes left for u, and throw if too few bytes avaiable
     const int vBytes = sliceSize - 4 - yBytes - uBytes;
-    if (vBytes < component_slice_bytes(s.yuvSlice.c2(), s.waveletDepth, scalar) ) {
+    if (vBytes < scaled_bytes(coded_bits(vCoeffs, vCount), scalar) ) {
       throw std::logic_error("SliceIO, HQ CBR mode: Too many bytes for the slice");
     }
-    stream << Bytes(1, vBytes/scalar);
-    stream << vlc::bounded(8*vBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = vSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    HQComponentIO(stream, vCoeffs, vCount, vBytes, scalar);
 
     return stream;
   }
 
-  std::istream& HQSliceIO_CBR(std::istream& stream, Slice& s) {
-    const int sliceSize = static_cast<int>(single_slice_size(stream));
+  std::istream& HQSliceIO_CBR(std::istream& stream, SliceIn& s) {
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
 
-    BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
-    const int numberOfSubbands = 3*s.waveletDepth+1;
+    const int sliceSize = static_cast<int>(single_slice_size(stream));
+    s.bytes = sliceSize;
     const int scalar = slice_scalar(stream);
 
+    Array2D& ySlice = s.yuvSlice.y();
+    Array2D& uSlice = s.yuvSlice.c1();
+    Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+
     Bytes bytes(1);
 
+    HQPrefixIO(stream, static_cast<int>(slice_prefix(stream)));
     Bytes q(1);
     stream >> q;
+    if (!stream) return stream; // End of input (e.g. after the last frame)
     s.qIndex = q;
 
     // Input first (y/luma) component
     stream >> bytes;
     const int yBytes = ((int)bytes)*scalar;
-    stream >> vlc::bounded(8*yBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = ySliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, yCoeffs, ySlice.num_elements(), yBytes);
 
     // Input second (u/c1/chroma) component
     stream >> bytes;
     const int uBytes = ((int)bytes)*scalar;
-    stream >> vlc::bounded(8*uBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = uSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, uCoeffs, uSlice.num_elements(), uBytes);
     
     // Input third (v/c2/chroma) component
     stream >> bytes;
-    // Calculate bytes left for u, and throw if number of bytes read from stream disagrees
+    // Calculate bytes left for u, and throw if number of bytes read from stream
+    // disagrees (the length is in units of the slice size scalar)
     const int vBytes = sliceSize - 4 - yBytes - uBytes;
-    if (vBytes != static_cast<const int>(bytes) )
+    if (vBytes != ((int)bytes)*scalar)
       throw std::logic_error("SliceIO, HQ CBR mode: Wrong number of bytes for a slice");
-    stream >> vlc::bounded(8*vBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = vSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, vCoeffs, vSlice.num_elements(), vBytes);
 
-    s.yuvSlice.y(merge_subbands(ySliceSubbands));
-    s.yuvSlice.c1(merge_subbands(uSliceSubbands));
-    s.yuvSlice.c2(merge_subbands(vSliceSubbands));
+    scatter_subbands(yCoeffs, s.waveletDepth, ySlice);
+    scatter_subbands(uCoeffs, s.waveletDepth, uSlice);
+    scatter_subbands(vCoeffs, s.waveletDepth, vSlice);
 
     return stream;
   }
 
   std::ostream& HQSliceIO_VBR(std::ostream& stream, const Slice& s) {
-    const BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    const BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    const BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
-    const int numberOfSubbands = 3*s.waveletDepth+1;
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
 
     const int scalar = slice_scalar(stream);
 
+    const Array2D& ySlice = s.yuvSlice.y();
+    const Array2D& uSlice = s.yuvSlice.c1();
+    const Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+    const int yCount = gather_subbands(ySlice, s.waveletDepth, yCoeffs);
+    const int uCount = gather_subbands(uSlice, s.waveletDepth, uCoeffs);
+    const int vCount = gather_subbands(vSlice, s.waveletDepth, vCoeffs);
+
+    HQPrefixIO(stream, static_cast<int>(slice_prefix(stream)));
     stream << Bytes(1, s.qIndex);
 
     // Output first (y/luma) component
-    const int yBytes = component_slice_bytes(s.yuvSlice.y(), s.waveletDepth, scalar);
-    stream << Bytes(1, yBytes/scalar);
-    stream << vlc::bounded(8*yBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = ySliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    const int yBytes = scaled_bytes(coded_bits(yCoeffs, yCount), scalar);
+    HQComponentIO(stream, yCoeffs, yCount, yBytes, scalar);
 
     // Output secomd (u/c1/chroma) component
-    const int uBytes = component_slice_bytes(s.yuvSlice.c1(), s.waveletDepth, scalar);
-    stream << Bytes(1, uBytes/scalar);
-    stream << vlc::bounded(8*uBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = uSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    const int uBytes = scaled_bytes(coded_bits(uCoeffs, uCount), scalar);
+    HQComponentIO(stream, uCoeffs, uCount, uBytes, scalar);
     
     // Output third (v/c2/chroma) component
-    const int vBytes = component_slice_bytes(s.yuvSlice.c2(), s.waveletDepth, scalar);
-    stream << Bytes(1, vBytes/scalar);
-    stream << vlc::bounded(8*vBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      const Array2D& subband = vSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream << SignedVLC(subband[y][x]);
-        }
-      }
-    }
-    stream << vlc::flush << vlc::align;
+    const int vBytes = scaled_bytes(coded_bits(vCoeffs, vCount), scalar);
+    HQComponentIO(stream, vCoeffs, vCount, vBytes, scalar);
 
     return stream;
   }
 
-  std::istream& HQSliceIO_VBR(std::istream& stream, Slice& s) {
-    BlockVector ySliceSubbands = split_into_subbands(s.yuvSlice.y(), s.waveletDepth);
-    BlockVector uSliceSubbands = split_into_subbands(s.yuvSlice.c1(), s.waveletDepth);
-    BlockVector vSliceSubbands = split_into_subbands(s.yuvSlice.c2(), s.waveletDepth);
-    const int numberOfSubbands = 3*s.waveletDepth+1;
+  std::istream& HQSliceIO_VBR(std::istream& stream, SliceIn& s) {
+    ScratchArena& arena = ScratchArena::local();
+    ArenaScope scope(arena);
+
     const int scalar = slice_scalar(stream);
+
+    Array2D& ySlice = s.yuvSlice.y();
+    Array2D& uSlice = s.yuvSlice.c1();
+    Array2D& vSlice = s.yuvSlice.c2();
+    int* const yCoeffs = component_scratch(ySlice, arena);
+    int* const uCoeffs = component_scratch(uSlice, arena);
+    int* const vCoeffs = component_scratch(vSlice, arena);
+
     Bytes bytes(1);
 
+    HQPrefixIO(stream, static_cast<int>(slice_prefix(stream)));
     Bytes q(1);
     stream >> q;
+    if (!stream) return stream; // End of input (e.g. after the last frame)
     s.qIndex = q;
 
     // Input first (y/luma) component
     stream >> bytes;
     const int yBytes = ((int)bytes)*scalar;
-    stream >> vlc::bounded(8*yBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = ySliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, yCoeffs, ySlice.num_elements(), yBytes);
 
     // Input second (u/c1/chroma) component
     stream >> bytes;
     const int uBytes = ((int)bytes)*scalar;
-    stream >> vlc::bounded(8*uBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = uSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, uCoeffs, uSlice.num_elements(), uBytes);
     
     // Input third (v/c2/chroma) component
     stream >> bytes;
     const int vBytes = ((int)bytes)*scalar;
-    stream >> vlc::bounded(8*vBytes);
-    for (int band=0; band<numberOfSubbands; ++band) {
-      Array2D& subband = vSliceSubbands[band];
-      const int height = subband.shape()[0];
-      const int width = subband.shape()[1];
-      SignedVLC inVLC;
-      for (int y=0; y<height; ++y) {
-        for (int x=0; x<width; ++x) {
-          stream >> inVLC;
-          subband[y][x] = inVLC;
-        }
-      }
-    }
-    stream >> vlc::flush >> vlc::align;
+    HQComponentIO(stream, vCoeffs, vSlice.num_elements(), vBytes);
+    s.bytes = 4 + yBytes + uBytes + vBytes; // Excluding the prefix
 
-    s.yuvSlice.y(merge_subbands(ySliceSubbands));
-    s.yuvSlice.c1(merge_subbands(uSliceSubbands));
-    s.yuvSlice.c2(merge_subbands(vSliceSubbands));
+    scatter_subbands(yCoeffs, s.waveletDepth, ySlice);
+    scatter_subbands(uCoeffs, s.waveletDepth, uSlice);
+    scatter_subbands(vCoeffs, s.waveletDepth, vSlice);
 
     return stream;
   }
 
+  // Skip an HQ slice, using the lengths of its components, without decoding it.
+  // Returns the size of the slice (excluding the prefix).
+  const int HQSkipSlice(std::istream& stream) {
+    const int scalar = slice_scalar(stream);
+    HQPrefixIO(stream, static_cast<int>(slice_prefix(stream)));
+    Bytes q(1);
+    stream >> q;
+    Bytes bytes(1);
+    int sliceBytes = 4;
+    for (int component=0; component<3; ++component) {
+      stream >> bytes;
+      stream.ignore(((int)bytes)*scalar);
+      sliceBytes += ((int)bytes)*scalar;
+    }
+    return sliceBytes;
+  }
+
 } // End unnamed namespace
 
 sliceio::SliceIOMode &sliceio::sliceIOMode(std::ios_base& stream) {
   return reinterpret_cast<sliceio::SliceIOMode &>(slice_IO_format(stream));
 }
 
+SliceRegion::SliceRegion(int t, int l, int h, int w):
+  top(t), left(l), height(h), width(w) {
+}
+
 Slices::Slices(const PictureArray& s, const int d, const Array2D& i):
-  yuvSlices(s), waveletDepth(d), qIndices(i) {
+  yuvSlices(s), waveletDepth(d), qIndices(i), bytes(extents[i.shape()[0]][i.shape()[1]]) {
 };
 
 Slices::Slices(const PictureFormat& picFormat, int d,int ySlices, int xSlices):
@@ -607,6 +1411,7 @@ Slices::Slices(const PictureFormat& picFormat, int d,int ySlices, int xSlices):
     }
   }
   qIndices = Array2D(shape);
+  bytes = Array2D(shape);
 };
 
 #include <iostream>
@@ -636,15 +1441,22 @@ std::istream& operator >> (std::istream& stream, Slices& s) {
   const int waveletDepth = s.waveletDepth;
   const int ySlices = yuvSlices.shape()[0];
   const int xSlices = yuvSlices.shape()[1];
+  const SliceRegion* const region = reinterpret_cast<const SliceRegion *>(slice_region(stream));
+  if (region && (slice_IO_format(stream)==sliceio::LD)) {
+    throw std::logic_error("SliceIO: LD slices cannot be read as a region");
+  }
   for (int v=0; v<ySlices; ++v) {
     for (int h=0; h<xSlices; ++h) {
-      Slice inSlice(yuvSlices[v][h].format(), waveletDepth);
+      if (region && !region->contains(v, h)) {
+        s.bytes[v][h] = HQSkipSlice(stream);
+        continue;
+      }
+      // Read directly into the slice picture (which must be the right size)
+      SliceIn inSlice(yuvSlices[v][h], waveletDepth);
       if (bytes_valid) stream >> setBytes(bytes[v][h]);
       stream >> inSlice;
-      yuvSlices[v][h].y(inSlice.yuvSlice.y());
-      yuvSlices[v][h].c1(inSlice.yuvSlice.c1());
-      yuvSlices[v][h].c2(inSlice.yuvSlice.c2());
       qIndices[v][h] = inSlice.qIndex;
+      s.bytes[v][h] = inSlice.bytes;
     }
   }
   return stream;
@@ -668,7 +1480,7 @@ std::ostream& operator << (std::ostream& stream, const Slice& s) {
   }
 }
 
-std::istream& operator >> (std::istream& stream, Slice& s) {
+std::istream& operator >> (std::istream& stream, SliceIn& s) {
   if (!slice_IO_format(stream))
     throw std::logic_error("SliceIO: Input Format not set");
   switch (static_cast<sliceio::SliceIOMode>(slice_IO_format(stream))) {
@@ -709,6 +1521,7 @@ void sliceio::highQualityCBR::operator()(std::ios_base& stream) const {
   slice_IO_format(stream) = static_cast<long>(HQCBR);
   slice_sizes(stream) = reinterpret_cast<long>(&bytes);
   slice_scalar(stream) = static_cast<long>(scalar);
+  slice_prefix(stream) = static_cast<long>(prefix);
 }
 
 // ostream low delay format manipulator
@@ -726,7 +1539,9 @@ std::istream& operator >> (std::istream& stream, sliceio::highQualityCBR arg) {
 // IO format manipulator to set the high quality CBR IO format
 void sliceio::highQualityVBR::operator()(std::ios_base& stream) const {
   slice_IO_format(stream) = static_cast<long>(HQVBR);
+  slice_sizes(stream) = 0; // VBR slices carry their own lengths
   slice_scalar(stream) = static_cast<long>(scalar);
+  slice_prefix(stream) = static_cast<long>(prefix);
 }
 
 // ostream low delay format manipulator
@@ -741,6 +1556,17 @@ std::istream& operator >> (std::istream& stream, sliceio::highQualityVBR arg) {
   return stream;
 }
 
+// IO manipulator to read only the slices in a region
+void sliceio::region::operator()(std::ios_base& stream) const {
+  slice_region(stream) = reinterpret_cast<long>(slices);
+}
+
+// istream manipulator to read only the slices in a region
+std::istream& operator >> (std::istream& stream, sliceio::region arg) {
+  arg(stream);
+  return stream;
+}
+
 // IO format manipulator to set the size of a single slice
 void setBytes::operator()(std::ios_base& stream) const {
   single_slice_size(stream) = bytes;
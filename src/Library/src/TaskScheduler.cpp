@@ -0,0 +1,230 @@
+/*********************************************************************/
+/* TaskScheduler.cpp                                                 */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines a work stealing task scheduler, with a fixed set of       */
+/* worker threads, shared by all the stages of coding a picture.     */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "TaskScheduler.h"
+#include "Numa.h"
+
+#include <algorithm> // For min and max
+
+#include "boost/bind.hpp"
+#include "boost/thread/tss.hpp"
+
+namespace {
+
+  // The scheduler, and worker index, of a worker thread
+  struct Identity {
+    const TaskScheduler* scheduler;
+    int index;
+  };
+
+  boost::thread_specific_ptr<Identity>& identity() {
+    static boost::thread_specific_ptr<Identity> id;
+    return id;
+  }
+
+} // end unnamed namespace
+
+TaskScheduler::TaskScheduler(int threads, bool pinThreads, int firstCore):
+  workerCount(0), queued(0), stopping(false) {
+  const int cores = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+  if (threads<1) threads = cores;
+  workerCount = threads-1;
+  for (int q=0; q<=workerCount; ++q) queues.push_back(new Queue);
+  for (int w=0; w<workerCount; ++w) {
+    const CoreSet core = pinThreads ? CoreSet(1, (firstCore+1+w)%cores) : CoreSet();
+    workers.create_thread(boost::bind(&TaskScheduler::work, this, w, core));
+  }
+}
+
+TaskScheduler::TaskScheduler(const CoreSet& cores):
+  workerCount(std::max(1, static_cast<int>(cores.size()))-1), queued(0), stopping(false) {
+  for (int q=0; q<=workerCount; ++q) queues.push_back(new Queue);
+  for (int w=0; w<workerCount; ++w) {
+    workers.create_thread(boost::bind(&TaskScheduler::work, this, w, cores));
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    boost::mutex::scoped_lock lock(idleMutex);
+    stopping = true;
+  }
+  idle.notify_all();
+  workers.join_all();
+  for (std::vector<Queue*>::iterator q=queues.begin(); q!=queues.end(); ++q) delete *q;
+}
+
+const int TaskScheduler::self() const {
+  const Identity* const id = identity().get();
+  return (id && (id->scheduler==this)) ? id->index : -1;
+}
+
+void TaskScheduler::submit(const Task& task, TaskGroup* group) {
+  const Item item = {task, group};
+  const int index = self();
+  Queue& queue = *queues[(index<0) ? workerCount : index];
+  {
+    boost::mutex::scoped_lock lock(queue.mutex);
+    queue.items.push_back(item);
+  }
+  {
+    boost::mutex::scoped_lock lock(idleMutex);
+    ++queued;
+  }
+  idle.notify_one();
+}
+
+namespace {
+
+  template <class Queue, class Item>
+  const bool takeOldest(Queue& queue, Item& item) {
+    boost::mutex::scoped_lock lock(queue.mutex);
+    if (queue.items.empty()) return false;
+    item = queue.items.front();
+    queue.items.pop_front();
+    return true;
+  }
+
+} // end unnamed namespace
+
+// Take a task: the newest of the worker's own, else the oldest shared task,
+// else the oldest task of another worker (starting with the next).
+const bool TaskScheduler::take(Item& item) {
+  const int index = self();
+  bool found = false;
+  if (index>=0) {
+    Queue& own = *queues[index];
+    boost::mutex::scoped_lock lock(own.mutex);
+    if (!own.items.empty()) {
+      item = own.items.back();
+      own.items.pop_back();
+      found = true;
+    }
+  }
+  if (!found) found = takeOldest(*queues[workerCount], item);
+  for (int k=1; (k<=workerCount) && !found; ++k) {
+    const int victim = (std::max(index, 0)+k)%workerCount;
+    if (victim!=index) found = takeOldest(*queues[victim], item);
+  }
+  if (found) {
+    boost::mutex::scoped_lock lock(idleMutex);
+    --queued;
+  }
+  return found;
+}
+
+void TaskScheduler::run(Item& item) {
+  try {
+    item.task();
+  }
+  catch (...) {
+    const boost::exception_ptr error = boost::current_exception();
+    item.group->finished(&error);
+    return;
+  }
+  item.group->finished(0);
+}
+
+const bool TaskScheduler::runOne() {
+  Item item;
+  if (!take(item)) return false;
+  run(item);
+  return true;
+}
+
+void TaskScheduler::work(int index, const CoreSet& cores) {
+  Identity* const id = new Identity;
+  id->scheduler = this;
+  id->index = index;
+  identity().reset(id);
+  bindThread(cores);
+  for (;;) {
+    if (runOne()) continue;
+    boost::mutex::scoped_lock lock(idleMutex);
+    while ((queued==0) && !stopping) idle.wait(lock);
+    if ((queued==0) && stopping) return;
+  }
+}
+
+TaskGroup::TaskGroup(TaskScheduler& s):
+  scheduler(s), outstanding(0) {
+}
+
+TaskGroup::~TaskGroup() {
+  waitAll();
+}
+
+void TaskGroup::run(const TaskScheduler::Task& task) {
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    ++outstanding;
+  }
+  scheduler.submit(task, this);
+}
+
+void TaskGroup::finished(const boost::exception_ptr* exception) {
+  boost::mutex::scoped_lock lock(mutex);
+  if (exception && !error) error = *exception;
+  if (--outstanding==0) done.notify_all();
+}
+
+// Run tasks until the group's have all finished. When there are none to run
+// the group's remaining tasks are running on other threads, so just wait.
+const bool TaskGroup::waitAll() {
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      if (outstanding==0) break;
+    }
+    if (scheduler.runOne()) continue;
+    boost::mutex::scoped_lock lock(mutex);
+    if (outstanding>0) done.wait(lock);
+  }
+  boost::mutex::scoped_lock lock(mutex);
+  return !error;
+}
+
+void TaskGroup::wait() {
+  if (!waitAll()) {
+    boost::exception_ptr exception;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      exception = error;
+      error = boost::exception_ptr();
+    }
+    boost::rethrow_exception(exception);
+  }
+}
+
+namespace {
+
+  void call(const boost::function<void (int, int)>& body, int first, int last) {
+    body(first, last);
+  }
+
+} // end unnamed namespace
+
+void parallel_for(TaskScheduler& scheduler, int begin, int end,
+                  const boost::function<void (int, int)>& body, int grain) {
+  const int count = end-begin;
+  if (count<=0) return;
+  const int tasks = std::max(1, std::min(4*scheduler.threads(), count/std::max(1, grain)));
+  if (tasks==1) {
+    body(begin, end);
+    return;
+  }
+  TaskGroup group(scheduler);
+  for (int t=0; t<tasks; ++t) {
+    const int first = begin + (t*count)/tasks;
+    const int last = begin + ((t+1)*count)/tasks;
+    group.run(boost::bind(&call, boost::cref(body), first, last));
+  }
+  group.wait();
+}
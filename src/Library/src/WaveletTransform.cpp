@@ -14,8 +14,11 @@
 
 #include <iostream>
 #include <string>
-#include <stdexcept> // For invalid_argument
+#include <stdexcept> // For invalid_argument and overflow_error
 #include <cfloat> // For FLT_MAX in quantMatrix
+#include <algorithm> // For copy and fill in waveletPad
+#include <vector> // For impulse responses in coefficientBits
+#include <cmath> // For ceil and log in coefficientBits
 
 std::ostream& operator<<(std::ostream& os, WaveletKernel kernel) {
   const char* s;
@@ -67,72 +70,163 @@ std::istream& operator>>(std::istream& strm, WaveletKernel& kernel) {
 }
 
 #include "Utils.h"
+#include "TaskScheduler.h"
+
+#include "boost/bind.hpp"
 
 const int paddedSize(int size, int depth) {
   const int cell = utils::pow(2, depth);
   return cell*((size+cell-1)/cell);
 }
 
-const Array2D waveletPad(const Array2D& picture, int depth) {
-  const Index pictureHeight = picture.shape()[0];
+// Pad a picture, by edge extension, into an existing array.
+// "padded" is only (re)allocated if it is not already the padded size.
+// Number of lines in a picture made from every "lineStep"th line of an
+// array, starting at "firstLine" (e.g. 0 or 1 and 2 for the fields of a frame)
+const Index stridedHeight(const Array2D& picture, int firstLine, int lineStep) {
+  const Index height = picture.shape()[0];
+  if ((firstLine<0) || (lineStep<1) || (firstLine>=lineStep)) {
+    throw std::invalid_argument("invalid first line or line step for wavelet padding");
+  }
+  return (height-firstLine+lineStep-1)/lineStep;
+}
+
+// Pad the picture comprising every "lineStep"th line of "picture", starting
+// at "firstLine". So fields are padded straight from a frame, without copying
+// them to a picture of their own.
+// Samples are shifted left by "shift" bits as they are copied. So, given the
+// kernel's accuracy bits, padding also does the first step of the first
+// transform level, which then need not make another pass over the picture.
+void waveletPad(const Array2D& picture, int firstLine, int lineStep, int depth,
+                unsigned int shift, Array2D& padded) {
+  const Index pictureHeight = stridedHeight(picture, firstLine, lineStep);
   const Index pictureWidth = picture.shape()[1];
   const Index paddedHeight = paddedSize(pictureHeight, depth);
   const Index paddedWidth = paddedSize(pictureWidth, depth);
-  const Shape2D paddedShape = {{paddedHeight, paddedWidth}};
-  Array2D padded(paddedShape);
+  if ((static_cast<Index>(padded.shape()[0])!=paddedHeight) ||
+      (static_cast<Index>(padded.shape()[1])!=paddedWidth)) {
+    padded.resize(extents[paddedHeight][paddedWidth]);
+  }
   for (int line=0; line<paddedHeight; ++line) {
-    for (int pixel=0; pixel<paddedWidth; ++pixel) {
-      const int picLine = (line<pictureHeight)?line:(pictureHeight-1);
-      const int picPixel = (pixel<pictureWidth)?pixel:(pictureWidth-1);
-      padded[line][pixel] = picture[picLine][picPixel];
+    const int picLine = firstLine + lineStep*((line<pictureHeight)?line:(pictureHeight-1));
+    const int* const inLine = picture.data() + picLine*pictureWidth;
+    int* const outLine = padded.data() + line*paddedWidth;
+    if (shift) {
+      for (int pixel=0; pixel<pictureWidth; ++pixel) {
+        outLine[pixel] = inLine[pixel]<<shift;
+      }
     }
+    else std::copy(inLine, inLine+pictureWidth, outLine);
+    std::fill(outLine+pictureWidth, outLine+paddedWidth, outLine[pictureWidth-1]);
   }
+}
+
+void waveletPad(const Array2D& picture, int depth, Array2D& padded) {
+  waveletPad(picture, 0, 1, depth, 0, padded);
+}
+
+const Array2D waveletPad(const Array2D& picture, int depth) {
+  Array2D padded;
+  waveletPad(picture, depth, padded);
   return padded;
 }
 
+// Pad a picture into an array of 16 bit values, checking that the samples are
+// in the range (0 to 2**bitDepth-1) for which coefficientBits is calculated.
+// The accuracy bits ("shift") are included in coefficientBits, so the shifted
+// samples fit in 16 bits.
+void waveletPad(const Array2D& picture, int firstLine, int lineStep,
+                int depth, int bitDepth, unsigned int shift, ShortArray2D& padded) {
+  const Index pictureHeight = stridedHeight(picture, firstLine, lineStep);
+  const Index pictureWidth = picture.shape()[1];
+  const Index paddedHeight = paddedSize(pictureHeight, depth);
+  const Index paddedWidth = paddedSize(pictureWidth, depth);
+  if ((static_cast<Index>(padded.shape()[0])!=paddedHeight) ||
+      (static_cast<Index>(padded.shape()[1])!=paddedWidth)) {
+    padded.resize(extents[paddedHeight][paddedWidth]);
+  }
+  const unsigned int maxValue = (1u<<bitDepth)-1;
+  for (int line=0; line<paddedHeight; ++line) {
+    const int picLine = firstLine + lineStep*((line<pictureHeight)?line:(pictureHeight-1));
+    const int* const inLine = picture.data() + picLine*pictureWidth;
+    short* const outLine = padded.data() + line*paddedWidth;
+    for (int pixel=0; pixel<pictureWidth; ++pixel) {
+      // Negative values become large unsigned values, so one test suffices
+      if (static_cast<unsigned int>(inLine[pixel])>maxValue) {
+        throw std::overflow_error("picture sample out of range for 16 bit wavelet transform");
+      }
+      outLine[pixel] = static_cast<short>(inLine[pixel]<<shift);
+    }
+    std::fill(outLine+pictureWidth, outLine+paddedWidth, outLine[pictureWidth-1]);
+  }
+}
+
+void waveletPad(const Array2D& picture, int depth, int bitDepth, ShortArray2D& padded) {
+  waveletPad(picture, 0, 1, depth, bitDepth, 0, padded);
+}
+
+// Parts of a wavelet level. The horizontal lifting steps (with the accuracy
+// bits) act within lines and the vertical steps within columns. So each part
+// may be done on stripes of a level (of lines or of columns) independently.
+enum LevelPasses {HORIZONTAL=1, VERTICAL=2, BOTH_PASSES=HORIZONTAL|VERTICAL};
+
 // Forward declarations of functions to implement a single wavelet level
-void waveletLevelDD97(View2D&, unsigned int shift);
-void inverseWaveletLevelDD97(View2D&, unsigned int shift);
-void waveletLevelLeGall(View2D&, unsigned int shift);
-void inverseWaveletLevelLeGall(View2D&, unsigned int shift);
-void waveletLevelDD137(View2D&, unsigned int shift);
-void inverseWaveletLevelDD137(View2D&, unsigned int shift);
-void waveletLevelHaar(View2D&, unsigned int shift);
-void inverseWaveletLevelHaar(View2D&, unsigned int shift);
-void waveletLevelFidelity(View2D&, unsigned int shift);
-void inverseWaveletLevelFidelity(View2D&, unsigned int shift);
-void waveletLevelDaub97(View2D&, unsigned int shift);
-void inverseWaveletLevelDaub97(View2D&, unsigned int shift);
-
-void waveletLevel(View2D& p, WaveletKernel kernel) {
+template <class View> void waveletLevelDD97(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelDD97(View&, unsigned int shift, int passes);
+template <class View> void waveletLevelLeGall(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelLeGall(View&, unsigned int shift, int passes);
+template <class View> void waveletLevelDD137(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelDD137(View&, unsigned int shift, int passes);
+template <class View> void waveletLevelHaar(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelHaar(View&, unsigned int shift, int passes);
+template <class View> void waveletLevelFidelity(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelFidelity(View&, unsigned int shift, int passes);
+template <class View> void waveletLevelDaub97(View&, unsigned int shift, int passes);
+template <class View> void inverseWaveletLevelDaub97(View&, unsigned int shift, int passes);
+
+// Number of accuracy bits (left shift) introduced by each level of a kernel
+const unsigned int accuracyBits(WaveletKernel kernel) {
+  switch(kernel) {
+    case DD97:
+    case LeGall:
+    case DD137:
+    case Haar1:
+    case Daub97:
+      return 1;
+    case Haar0:
+    case Fidelity:
+    case NullKernel:
+      return 0;
+    default:
+      throw std::invalid_argument("invalid wavelet kernel");
+  }
+}
+
+// One level of forward transform. If "scaled" the samples have already been
+// shifted left by the kernel's accuracy bits (e.g. by waveletPad).
+template <class View>
+void waveletLevel(View& p, WaveletKernel kernel, bool scaled, int passes=BOTH_PASSES) {
+  const unsigned int shift = scaled ? 0 : accuracyBits(kernel);
   switch(kernel) {
     case DD97:
-      // DD97 uses 1 accuracy bit (shift=1)
-      waveletLevelDD97(p, 1);
+      waveletLevelDD97(p, shift, passes);
       break;
     case LeGall:
-      // LeGall uses 1 accuracy bit (shift=1)
-      waveletLevelLeGall(p, 1);
+      waveletLevelLeGall(p, shift, passes);
       break;
     case DD137:
-      // DD137 uses 1 accuracy bit (shift=1)
-      waveletLevelDD137(p, 1);
+      waveletLevelDD137(p, shift, passes);
       break;
     case Haar0:
-      // Haar0 uses no accuracy bit (shift=0)
-      waveletLevelHaar(p, 0);
-      break;
     case Haar1:
-      // Haar1 uses 1 accuracy bit (shift=1)
-      waveletLevelHaar(p, 1);
+      // Haar0 and Haar1 differ only in their accuracy bits
+      waveletLevelHaar(p, shift, passes);
       break;
     case Fidelity:
-      // Fidelity uses 1 accuracy bit (shift=0)
-      waveletLevelFidelity(p, 0);
+      waveletLevelFidelity(p, shift, passes);
       break;
     case Daub97:
-      // Daub97 uses 1 accuracy bit (shift=1)
-      waveletLevelDaub97(p, 1);
+      waveletLevelDaub97(p, shift, passes);
       break;
     case NullKernel:
       // Null Kernel does nothing (for testing)
@@ -142,10 +236,10 @@ void waveletLevel(View2D& p, WaveletKernel kernel) {
   }
 }
 
-const Array2D waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth) {
-
-  Array2D transform = waveletPad(picture, depth);
-
+// Forward transform, in place, of a padded array (of int or short). If
+// "scaled" the array was padded with the accuracy bits of the first level.
+template <class Array>
+void waveletTransform(Array& transform, WaveletKernel kernel, int depth, bool scaled=false) {
   // Iterate over levels
   // Note: Level numbers go from zero for high frequencies to depth for
   // the lowest ("DC") frequencies. This is the opposite way round to
@@ -155,43 +249,83 @@ const Array2D waveletTransform(const Array2D& picture, WaveletKernel kernel, int
     const Index height = transform.shape()[0];
     const Index width = transform.shape()[1];
     const Index stride = utils::pow(2, level);
-    View2D view =
+    typename Array::template array_view<2>::type view =
       transform[indices[Range(0,height,stride)][Range(0,width,stride)]];
     // Do one level of in place wavelet transform
-    waveletLevel(view, kernel);
+    waveletLevel(view, kernel, (scaled && (level==0)));
+  }
+}
+
+void waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth, Array2D& transform) {
+  waveletPad(picture, 0, 1, depth, accuracyBits(kernel), transform);
+  waveletTransform(transform, kernel, depth, true);
+}
+
+void waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortArray2D& transform) {
+  if (!shortCoefficients(kernel, depth, bitDepth)) {
+    throw std::overflow_error("wavelet coefficients might not fit in 16 bits");
+  }
+  waveletPad(picture, 0, 1, depth, bitDepth, accuracyBits(kernel), transform);
+  waveletTransform(transform, kernel, depth, true);
+}
+
+void fieldWaveletTransform(const Array2D& frame, int field, WaveletKernel kernel, int depth,
+                           Array2D& transform) {
+  waveletPad(frame, field, 2, depth, accuracyBits(kernel), transform);
+  waveletTransform(transform, kernel, depth, true);
+}
+
+void fieldWaveletTransform(const Array2D& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortArray2D& transform) {
+  if (!shortCoefficients(kernel, depth, bitDepth)) {
+    throw std::overflow_error("wavelet coefficients might not fit in 16 bits");
+  }
+  waveletPad(frame, field, 2, depth, bitDepth, accuracyBits(kernel), transform);
+  waveletTransform(transform, kernel, depth, true);
+}
+
+void paddedWaveletTransform(Array2D& padded, WaveletKernel kernel, int depth) {
+  waveletTransform(padded, kernel, depth);
+}
+
+void paddedWaveletTransform(ShortArray2D& padded, WaveletKernel kernel, int depth, int bitDepth) {
+  if (!shortCoefficients(kernel, depth, bitDepth)) {
+    throw std::overflow_error("wavelet coefficients might not fit in 16 bits");
   }
+  waveletTransform(padded, kernel, depth);
+}
+
+const Array2D waveletTransform(const Array2D& picture, WaveletKernel kernel, int depth) {
+  Array2D transform;
+  waveletTransform(picture, kernel, depth, transform);
   return transform;
 }
 
-void inverseWaveletLevel(View2D& p, WaveletKernel kernel) {
+// One level of inverse transform. If "scaled" the result is left shifted by
+// the kernel's accuracy bits (for the caller to remove, e.g. when unpadding).
+template <class View>
+void inverseWaveletLevel(View& p, WaveletKernel kernel, bool scaled, int passes=BOTH_PASSES) {
+  const unsigned int shift = scaled ? 0 : accuracyBits(kernel);
   switch(kernel) {
     case DD97:
-      // DD97 uses 1 accuracy bit (shift=1)
-      inverseWaveletLevelDD97(p, 1);
+      inverseWaveletLevelDD97(p, shift, passes);
       break;
     case LeGall:
-      // LeGall uses 1 accuracy bit (shift=1)
-      inverseWaveletLevelLeGall(p, 1);
+      inverseWaveletLevelLeGall(p, shift, passes);
       break;
     case DD137:
-      // DD137 uses 1 accuracy bit (shift=1)
-      inverseWaveletLevelDD137(p, 1);
+      inverseWaveletLevelDD137(p, shift, passes);
       break;
     case Haar0:
-      // Haar0 uses no accuracy bit (shift=0)
-      inverseWaveletLevelHaar(p, 0);
-      break;
     case Haar1:
-      // Haar1 uses 1 accuracy bit (shift=1)
-      inverseWaveletLevelHaar(p, 1);
+      inverseWaveletLevelHaar(p, shift, passes);
       break;
     case Fidelity:
-      // Fidelity uses 1 accuracy bit (shift=0)
-      inverseWaveletLevelFidelity(p, 0);
+      inverseWaveletLevelFidelity(p, shift, passes);
       break;
     case Daub97:
-      // Daub97 uses 1 accuracy bit (shift=1)
-      inverseWaveletLevelDaub97(p, 1);
+      inverseWaveletLevelDaub97(p, shift, passes);
       break;
     case NullKernel:
       // Null Kernel does nothing (for testing)
@@ -201,11 +335,10 @@ void inverseWaveletLevel(View2D& p, WaveletKernel kernel) {
   }
 }
 
-const Array2D inverseWaveletTransform(const Array2D& transform,
-                                      WaveletKernel kernel,
-                                      int depth,
-                                      Shape2D shape) {
-  Array2D picture = transform;
+// Inverse transform, in place, of a padded array (of int or short). If
+// "scaled" the last level leaves its accuracy bits in the array.
+template <class Array>
+void inverseWaveletTransform(Array& picture, WaveletKernel kernel, int depth, bool scaled=false) {
   // Iterate over levels
   // Note: Level numbers go from zero for high frequencies to depth-1 for
   // the lowest frequencies. This is the opposite way round to the level 
@@ -215,15 +348,307 @@ const Array2D inverseWaveletTransform(const Array2D& transform,
     const Index height = picture.shape()[0];
     const Index width = picture.shape()[1];
     const Index stride = utils::pow(2, level);
-    View2D view =
+    typename Array::template array_view<2>::type view =
       picture[indices[Range(0,height,stride)][Range(0,width,stride)]];
     // Do one level of in place wavelet transform
-    inverseWaveletLevel(view, kernel);
+    inverseWaveletLevel(view, kernel, (scaled && (level==0)));
   }
+}
+
+const Array2D inverseWaveletTransform(const Array2D& transform,
+                                      WaveletKernel kernel,
+                                      int depth,
+                                      Shape2D shape) {
+  Array2D picture = transform;
+  inverseWaveletTransform(picture, kernel, depth);
   picture.resize(shape); // remove wavelet padding
   return picture;
 }
 
+// Copy (and widen) the unpadded picture out of a padded array, rounding and
+// shifting right the last level's accuracy bits ("shift") on the way. So the
+// last inverse level need not make another pass over the (padded) picture.
+template <class Array>
+void unpad(const Array& transform, unsigned int shift, Array2D& picture) {
+  const Index height = picture.shape()[0];
+  const Index width = picture.shape()[1];
+  const Index paddedWidth = transform.shape()[1];
+  const int offset = shift ? utils::pow(2, shift-1) : 0;
+  for (int line=0; line<height; ++line) {
+    const typename Array::element* const inLine = transform.data() + line*paddedWidth;
+    int* const outLine = picture.data() + line*width;
+    if (shift) {
+      for (int pixel=0; pixel<width; ++pixel) {
+        outLine[pixel] = (inLine[pixel]+offset)>>shift;
+      }
+    }
+    else std::copy(inLine, inLine+width, outLine);
+  }
+}
+
+void inverseWaveletTransform(Array2D& transform,
+                             WaveletKernel kernel,
+                             int depth,
+                             Array2D& picture) {
+  inverseWaveletTransform(transform, kernel, depth, true);
+  unpad(transform, accuracyBits(kernel), picture);
+}
+
+void inverseWaveletTransform(ShortArray2D& transform,
+                             WaveletKernel kernel,
+                             int depth,
+                             Array2D& picture) {
+  inverseWaveletTransform(transform, kernel, depth, true);
+  unpad(transform, accuracyBits(kernel), picture);
+}
+
+namespace {
+
+  // Minimum samples in a stripe, so tasks are worth scheduling
+  const int stripeSamples = 4096;
+
+  // Do part ("passes") of one level of (inverse) transform on lines, if
+  // HORIZONTAL, or columns, if VERTICAL, [first, last) of the level's view
+  template <class View>
+  void levelStripe(View* level, WaveletKernel kernel, bool scaled, bool inverse,
+                   int passes, int first, int last) {
+    const Index height = level->shape()[0];
+    const Index width = level->shape()[1];
+    View stripe = (passes==HORIZONTAL) ?
+      (*level)[indices[Range(first,last)][Range(0,width)]] :
+      (*level)[indices[Range(0,height)][Range(first,last)]];
+    if (inverse) inverseWaveletLevel(stripe, kernel, scaled, passes);
+    else waveletLevel(stripe, kernel, scaled, passes);
+  }
+
+  // Do one level of (inverse) transform in stripes, as tasks of the scheduler
+  template <class View>
+  void stripedLevel(View& level, WaveletKernel kernel, bool scaled, bool inverse,
+                    TaskScheduler& scheduler) {
+    const int height = level.shape()[0];
+    const int width = level.shape()[1];
+    const int passes[2] = {(inverse ? VERTICAL : HORIZONTAL), (inverse ? HORIZONTAL : VERTICAL)};
+    for (int pass=0; pass<2; ++pass) {
+      const bool lines = (passes[pass]==HORIZONTAL);
+      parallel_for(scheduler, 0, (lines ? height : width),
+                   boost::bind(&levelStripe<View>, &level, kernel, scaled, inverse, passes[pass], _1, _2),
+                   std::max(1, stripeSamples/(lines ? width : height)));
+    }
+  }
+
+  // Forward transform, in place, of a padded array, in stripes
+  template <class Array>
+  void stripedTransform(Array& transform, WaveletKernel kernel, int depth, bool scaled,
+                        TaskScheduler& scheduler) {
+    for (int level=0; level<depth; ++level) {
+      const Index height = transform.shape()[0];
+      const Index width = transform.shape()[1];
+      const Index stride = utils::pow(2, level);
+      typename Array::template array_view<2>::type view =
+        transform[indices[Range(0,height,stride)][Range(0,width,stride)]];
+      stripedLevel(view, kernel, (scaled && (level==0)), false, scheduler);
+    }
+  }
+
+  // Inverse transform, in place, of a padded array, in stripes
+  template <class Array>
+  void stripedInverseTransform(Array& transform, WaveletKernel kernel, int depth, bool scaled,
+                               TaskScheduler& scheduler) {
+    for (int level=depth-1; level>=0; --level) {
+      const Index height = transform.shape()[0];
+      const Index width = transform.shape()[1];
+      const Index stride = utils::pow(2, level);
+      typename Array::template array_view<2>::type view =
+        transform[indices[Range(0,height,stride)][Range(0,width,stride)]];
+      stripedLevel(view, kernel, (scaled && (level==0)), true, scheduler);
+    }
+  }
+
+  // Tasks to transform one component of a picture (or field)
+  void transformComponent(const Array2D* picture, int firstLine, int lineStep,
+                          WaveletKernel kernel, int depth,
+                          Array2D* transform, TaskScheduler* scheduler) {
+    waveletPad(*picture, firstLine, lineStep, depth, accuracyBits(kernel), *transform);
+    stripedTransform(*transform, kernel, depth, true, *scheduler);
+  }
+
+  void transformShortComponent(const Array2D* picture, int firstLine, int lineStep,
+                               WaveletKernel kernel, int depth, int bitDepth,
+                               ShortArray2D* transform, TaskScheduler* scheduler) {
+    waveletPad(*picture, firstLine, lineStep, depth, bitDepth, accuracyBits(kernel), *transform);
+    stripedTransform(*transform, kernel, depth, true, *scheduler);
+  }
+
+  template <class Array>
+  void inverseComponent(Array* transform, WaveletKernel kernel, int depth,
+                        Array2D* picture, TaskScheduler* scheduler) {
+    stripedInverseTransform(*transform, kernel, depth, true, *scheduler);
+    unpad(*transform, accuracyBits(kernel), *picture);
+  }
+
+} // end unnamed namespace
+
+namespace {
+
+  // One lifting step of a wavelet kernel, in one dimension, as used to bound
+  // the size of the coefficients (the transform itself is in the level functions).
+  // The "target" samples (odd or even) are updated by adding sign*sum/divisor,
+  // where "sum" is the weighted sum of "taps" samples of the other phase.
+  // Tap j is at offset first+j relative to the target, in units of sample pairs,
+  // (so the odd sample following even sample n, and the even sample n, have offset 0).
+  struct LiftingStep {
+    bool odd; // true if the odd samples are updated, false for the even samples
+    int sign;
+    int divisor;
+    int first;
+    int taps;
+    int weights[8];
+  };
+
+  const LiftingStep dd97Steps[] = {
+    {true, -1, 16, -1, 4, {-1, 9, 9, -1}},
+    {false, 1, 4, -1, 2, {1, 1}}};
+  const LiftingStep leGallSteps[] = {
+    {true, -1, 2, 0, 2, {1, 1}},
+    {false, 1, 4, -1, 2, {1, 1}}};
+  const LiftingStep dd137Steps[] = {
+    {true, -1, 16, -1, 4, {-1, 9, 9, -1}},
+    {false, 1, 32, -2, 4, {-1, 9, 9, -1}}};
+  const LiftingStep haarSteps[] = {
+    {true, -1, 1, 0, 1, {1}},
+    {false, 1, 2, 0, 1, {1}}};
+  const LiftingStep fidelitySteps[] = {
+    {false, 1, 256, -4, 8, {-8, 21, -46, 161, 161, -46, 21, -8}},
+    {true, -1, 256, -3, 8, {-2, 10, -25, 81, 81, -25, 10, -2}}};
+  const LiftingStep daub97Steps[] = {
+    {true, -1, 4096, 0, 2, {6497, 6497}},
+    {false, -1, 4096, -1, 2, {217, 217}},
+    {true, 1, 4096, 0, 2, {3616, 3616}},
+    {false, 1, 4096, -1, 2, {1817, 1817}}};
+
+  // The sums of the positive, and of the (magnitudes of the) negative, weights
+  // of an impulse response. For samples between 0 and max the response lies
+  // between -negative*max and positive*max.
+  struct Gain {
+    double positive;
+    double negative;
+  };
+
+  // Impulse response, in one dimension, of a sample in the transform.
+  // Element i is the weight of input sample i-origin.
+  typedef std::vector<double> Response;
+
+  const Gain gain(const Response& response) {
+    Gain result = {0.0, 0.0};
+    for (Response::const_iterator r=response.begin(); r!=response.end(); ++r) {
+      if (*r>0) result.positive += *r;
+      else result.negative -= *r;
+    }
+    return result;
+  }
+
+  // Gain of the separable 2D response with the given row and column responses
+  const double gain(const Gain& row, const Gain& column) {
+    const double positive = row.positive*column.positive + row.negative*column.negative;
+    const double negative = row.positive*column.negative + row.negative*column.positive;
+    return (positive>negative) ? positive : negative;
+  }
+
+  // target += weight * (source delayed by offset samples)
+  void accumulate(Response& target, const Response& source, int offset, double weight) {
+    const int size = static_cast<int>(source.size());
+    for (int i=0; i<size; ++i) {
+      const int j = i+offset;
+      if ((source[i]!=0.0) && (j>=0) && (j<size)) target[j] += weight*source[i];
+    }
+  }
+
+} // end unnamed namespace
+
+// The bound is found by following the impulse responses of the lifting steps
+// through each level. Each level operates on the low pass (even) output of the
+// level before, so the response of sample n at level k is that of sample 0
+// delayed by n*2**k input samples. Only the responses of sample 0 (of each phase)
+// need be calculated. The responses are those of an infinitely wide picture, the
+// edge extension only repeats samples within the picture. Rounding in the lifting
+// steps is allowed for by the spare bit required by shortCoefficients.
+const int coefficientBits(WaveletKernel kernel, int depth, int bitDepth) {
+  const LiftingStep* steps;
+  int numberOfSteps;
+  int shift;
+  switch(kernel) {
+    case DD97:
+      steps = dd97Steps; numberOfSteps = 2; shift = 1;
+      break;
+    case LeGall:
+      steps = leGallSteps; numberOfSteps = 2; shift = 1;
+      break;
+    case DD137:
+      steps = dd137Steps; numberOfSteps = 2; shift = 1;
+      break;
+    case Haar0:
+      steps = haarSteps; numberOfSteps = 2; shift = 0;
+      break;
+    case Haar1:
+      steps = haarSteps; numberOfSteps = 2; shift = 1;
+      break;
+    case Fidelity:
+      steps = fidelitySteps; numberOfSteps = 2; shift = 0;
+      break;
+    case Daub97:
+      steps = daub97Steps; numberOfSteps = 4; shift = 1;
+      break;
+    case NullKernel:
+      steps = 0; numberOfSteps = 0; shift = 0;
+      break;
+    default:
+      throw std::invalid_argument("invalid wavelet kernel");
+  }
+  // The responses spread by less than 16 sample pairs per level, so this is wide enough
+  const int origin = utils::pow(2, depth+5);
+  Response low(2*origin+1, 0.0); // Low pass response from the previous level
+  low[origin] = 1.0;
+  double bound = 1.0; // Bound on (the magnitude of) any value, relative to the largest sample
+  for (int level=1; level<=depth; ++level) {
+    const int spacing = utils::pow(2, level-1); // between samples at this level
+    const Gain lowGain = gain(low);
+    Response even(low);
+    Response odd(low.size(), 0.0);
+    accumulate(odd, low, spacing, 1.0);
+    std::vector<Gain> intermediate(1, lowGain);
+    for (int s=0; s<numberOfSteps; ++s) {
+      const LiftingStep& step = steps[s];
+      const Response& source = step.odd ? even : odd;
+      Response& target = step.odd ? odd : even;
+      for (int tap=0; tap<step.taps; ++tap) {
+        accumulate(target, source, (step.first+tap)*2*spacing,
+                   static_cast<double>(step.sign*step.weights[tap])/step.divisor);
+      }
+      intermediate.push_back(gain(target));
+    }
+    // Values during the horizontal lifting steps have the vertical response of
+    // the previous level. Values during the vertical steps have the final
+    // horizontal response of this level.
+    const Gain final[2] = {gain(even), gain(odd)};
+    double levelBound = 0.0;
+    for (std::vector<Gain>::const_iterator g=intermediate.begin(); g!=intermediate.end(); ++g) {
+      levelBound = std::max(levelBound, gain(*g, lowGain));
+      levelBound = std::max(levelBound, gain(*g, final[0]));
+      levelBound = std::max(levelBound, gain(*g, final[1]));
+    }
+    // Accuracy bits are introduced at the start of each level
+    bound = std::max(bound, levelBound*utils::pow(2, shift*level));
+    low.swap(even);
+  }
+  const double maxValue = bound*(utils::pow(2, bitDepth)-1);
+  // Bits for magnitude, plus sign bit
+  return static_cast<int>(std::ceil(std::log(maxValue+1.0)/std::log(2.0)))+1;
+}
+
+const bool shortCoefficients(WaveletKernel kernel, int depth, int bitDepth) {
+  return coefficientBits(kernel, depth, bitDepth)<16;
+}
+
 // Return the quantisation matrix for a given wavelet kernel and depth
 const Array1D quantMatrix(WaveletKernel kernel, int depth) {
   using std::vector;
@@ -358,790 +783,848 @@ const Array2D merge_subbands(const BlockVector& subbands) {
   return picture;
 }
 
-void waveletLevelDD97(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelDD97(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap1 = pixel;
-      const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      p[line][pixel+1] -=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+    // horizontal predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap1 = pixel;
+        const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        p[line][pixel+1] -=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+      }
     }
-  }
 
-  // horizontal update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap1 = pixel+1;
-      p[line][pixel] += (p[line][tap0]+p[line][tap1] + 2)>>2;
+    // horizontal update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap1 = pixel+1;
+        p[line][pixel] += (p[line][tap0]+p[line][tap1] + 2)>>2;
+      }
     }
   }
 
-  // vertical predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap1 = line;
-    const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+  if (passes & VERTICAL) {
+    // vertical predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap1 = line;
+      const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+      }
     }
-  }
 
-  // vertical update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] += (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+    // vertical update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] += (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+      }
     }
   }
 }
 
 
-void inverseWaveletLevelDD97(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelDD97(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical inverse update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -= (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+  if (passes & VERTICAL) {
+    // vertical inverse update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -= (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+      }
     }
-  }
 
-  // vertical inverse predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap1 = line;
-    const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] +=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+    // vertical inverse predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap1 = line;
+      const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] +=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+      }
     }
   }
 
-  // horizontal inverse update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap1 = pixel+1;
-      p[line][pixel] -= (p[line][tap0]+p[line][tap1] + 2)>>2;
+  if (passes & HORIZONTAL) {
+    // horizontal inverse update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap1 = pixel+1;
+        p[line][pixel] -= (p[line][tap0]+p[line][tap1] + 2)>>2;
+      }
     }
-  }
 
-  // horizontal inverse predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap1 = pixel;
-      const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      p[line][pixel+1] +=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+    // horizontal inverse predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap1 = pixel;
+        const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        p[line][pixel+1] +=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+      }
     }
-  }
 
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
 }
 
-void waveletLevelLeGall(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelLeGall(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal LeGall (5,3): Predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] -= (p[line][tap0]+p[line][tap1]+1)>>1;
+    // horizontal LeGall (5,3): Predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] -= (p[line][tap0]+p[line][tap1]+1)>>1;
+      }
     }
-  }
 
-  // horizontal LeGall (5,3): Update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap1 = pixel+1;
-      p[line][pixel] += (p[line][tap0]+p[line][tap1] + 2)>>2;
+    // horizontal LeGall (5,3): Update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap1 = pixel+1;
+        p[line][pixel] += (p[line][tap0]+p[line][tap1] + 2)>>2;
+      }
     }
   }
 
-  // vertical LeGall (5,3): Predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -= (p[tap0][pixel]+p[tap1][pixel]+1)>>1;
+  if (passes & VERTICAL) {
+    // vertical LeGall (5,3): Predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -= (p[tap0][pixel]+p[tap1][pixel]+1)>>1;
+      }
     }
-  }
 
-  // vertical LeGall (5,3): Update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] += (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+    // vertical LeGall (5,3): Update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] += (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+      }
     }
   }
 }
 
 
-void inverseWaveletLevelLeGall(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelLeGall(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical LeGall (5,3): Inverse Update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -= (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+  if (passes & VERTICAL) {
+    // vertical LeGall (5,3): Inverse Update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -= (p[tap0][pixel]+p[tap1][pixel] + 2)>>2;
+      }
     }
-  }
 
-  // vertical LeGall (5,3): Inverse Predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] += (p[tap0][pixel]+p[tap1][pixel]+1)>>1;
+    // vertical LeGall (5,3): Inverse Predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] += (p[tap0][pixel]+p[tap1][pixel]+1)>>1;
+      }
     }
   }
 
-  // horizontal LeGall (5,3): Inverse Update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap1 = pixel+1;
-      p[line][pixel] -= (p[line][tap0]+p[line][tap1] + 2)>>2;
+  if (passes & HORIZONTAL) {
+    // horizontal LeGall (5,3): Inverse Update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap1 = pixel+1;
+        p[line][pixel] -= (p[line][tap0]+p[line][tap1] + 2)>>2;
+      }
     }
-  }
 
-  // horizontal LeGall (5,3): Inverse Predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] += (p[line][tap0]+p[line][tap1]+1)>>1;
+    // horizontal LeGall (5,3): Inverse Predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] += (p[line][tap0]+p[line][tap1]+1)>>1;
+      }
     }
-  }
 
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
 }
 
-void waveletLevelDD137(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelDD137(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap1 = pixel;
-      const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      p[line][pixel+1] -=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+    // horizontal predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap1 = pixel;
+        const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        p[line][pixel+1] -=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+      }
     }
-  }
 
-  // horizontal update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-3)>=0) ? (pixel-3) : 1 ;
-      const int tap1 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap2 = pixel+1;
-      const int tap3 = ((pixel+3)<width) ? (pixel+3) : (width-1) ;
-      p[line][pixel] +=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+16)>>5;
+    // horizontal update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-3)>=0) ? (pixel-3) : 1 ;
+        const int tap1 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap2 = pixel+1;
+        const int tap3 = ((pixel+3)<width) ? (pixel+3) : (width-1) ;
+        p[line][pixel] +=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+16)>>5;
+      }
     }
   }
 
-  // vertical predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap1 = line;
-    const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+  if (passes & VERTICAL) {
+    // vertical predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap1 = line;
+      const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+      }
     }
-  }
 
-  // vertical update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-3)>=0) ? (line-3) : 1 ;
-    const int tap1 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap2 = line+1;
-    const int tap3 = ((line+3)<height) ? (line+3) : (height-1) ;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] +=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+16)>>5;
+    // vertical update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-3)>=0) ? (line-3) : 1 ;
+      const int tap1 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap2 = line+1;
+      const int tap3 = ((line+3)<height) ? (line+3) : (height-1) ;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] +=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+16)>>5;
+      }
     }
   }
 }
 
 
-void inverseWaveletLevelDD137(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelDD137(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical inverse update
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-3)>=0) ? (line-3) : 1 ;
-    const int tap1 = ((line-1)>=0) ? (line-1) : 1 ;
-    const int tap2 = line+1;
-    const int tap3 = ((line+3)<height) ? (line+3) : (height-1) ;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+16)>>5;
+  if (passes & VERTICAL) {
+    // vertical inverse update
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-3)>=0) ? (line-3) : 1 ;
+      const int tap1 = ((line-1)>=0) ? (line-1) : 1 ;
+      const int tap2 = line+1;
+      const int tap3 = ((line+3)<height) ? (line+3) : (height-1) ;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+16)>>5;
+      }
     }
-  }
 
-  // vertical inverse predict
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap1 = line;
-    const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] +=
-        (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+    // vertical inverse predict
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap1 = line;
+      const int tap2 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap3 = ((line+4)<height) ? (line+4) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] +=
+          (-p[tap0][pixel]+9*p[tap1][pixel]+9*p[tap2][pixel]-p[tap3][pixel]+8)>>4;
+      }
     }
   }
 
-  // horizontal inverse update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-3)>=0) ? (pixel-3) : 1 ;
-      const int tap1 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
-      const int tap2 = pixel+1;
-      const int tap3 = ((pixel+3)<width) ? (pixel+3) : (width-1) ;
-      p[line][pixel] -=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+16)>>5;
+  if (passes & HORIZONTAL) {
+    // horizontal inverse update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-3)>=0) ? (pixel-3) : 1 ;
+        const int tap1 = ((pixel-1)>=0) ? (pixel-1) : 1 ;
+        const int tap2 = pixel+1;
+        const int tap3 = ((pixel+3)<width) ? (pixel+3) : (width-1) ;
+        p[line][pixel] -=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+16)>>5;
+      }
     }
-  }
 
-  // horizontal inverse predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap1 = pixel;
-      const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      p[line][pixel+1] +=
-        (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+    // horizontal inverse predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap1 = pixel;
+        const int tap2 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap3 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        p[line][pixel+1] +=
+          (-p[line][tap0]+9*p[line][tap1]+9*p[line][tap2]-p[line][tap3]+8)>>4;
+      }
     }
-  }
 
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
 }
 
-void waveletLevelHaar(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelHaar(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal predict
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      p[line][pixel+1] -= p[line][pixel];
+    // horizontal predict
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        p[line][pixel+1] -= p[line][pixel];
+      }
     }
-  }
 
-  // horizontal update
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      p[line][pixel] += ((p[line][pixel+1] + 1)>>1);
+    // horizontal update
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        p[line][pixel] += ((p[line][pixel+1] + 1)>>1);
+      }
     }
   }
 
-  // vertical predict
-  for (int pixel=0; pixel<width; ++pixel) {
-    for (int line=0; line<height; line+=2) {
-      p[line+1][pixel] -= p[line][pixel];
+  if (passes & VERTICAL) {
+    // vertical predict
+    for (int pixel=0; pixel<width; ++pixel) {
+      for (int line=0; line<height; line+=2) {
+        p[line+1][pixel] -= p[line][pixel];
+      }
     }
-  }
 
-  // vertical update
-  for (int pixel=0; pixel<width; ++pixel) {
-    for (int line=0; line<height; line+=2) {
-      p[line][pixel] += ((p[line+1][pixel] + 1)>>1);
+    // vertical update
+    for (int pixel=0; pixel<width; ++pixel) {
+      for (int line=0; line<height; line+=2) {
+        p[line][pixel] += ((p[line+1][pixel] + 1)>>1);
+      }
     }
   }
-
 }
 
 
-void inverseWaveletLevelHaar(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelHaar(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical Haar: Inverse Update
-  for (int line=0; line<height; line+=2) {
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -= ((p[line+1][pixel] + 1)>>1);
+  if (passes & VERTICAL) {
+    // vertical Haar: Inverse Update
+    for (int line=0; line<height; line+=2) {
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -= ((p[line+1][pixel] + 1)>>1);
+      }
     }
-  }
 
-  // vertical Haar: Inverse Predict
-  for (int line=0; line<height; line+=2) {
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] += p[line][pixel];
+    // vertical Haar: Inverse Predict
+    for (int line=0; line<height; line+=2) {
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] += p[line][pixel];
+      }
     }
   }
 
-  // horizontal Haar: Inverse Update
-  for (int pixel=0; pixel<width; pixel+=2) {
-    for (int line=0; line<height; ++line) {
-      p[line][pixel] -= ((p[line][pixel+1] + 1)>>1);
+  if (passes & HORIZONTAL) {
+    // horizontal Haar: Inverse Update
+    for (int pixel=0; pixel<width; pixel+=2) {
+      for (int line=0; line<height; ++line) {
+        p[line][pixel] -= ((p[line][pixel+1] + 1)>>1);
+      }
     }
-  }
 
-  // horizontal Haar: Inverse Predict
-  for (int pixel=0; pixel<width; pixel+=2) {
-    for (int line=0; line<height; ++line) {
-      p[line][pixel+1] += p[line][pixel];
-	  }
-  }
-
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
+    // horizontal Haar: Inverse Predict
+    for (int pixel=0; pixel<width; pixel+=2) {
       for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+        p[line][pixel+1] += p[line][pixel];
+      }
+    }
+
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
 }
 
-void waveletLevelFidelity(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelFidelity(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal type 1
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-7)>=0) ? (pixel-7) : 1;
-      const int tap1 = ((pixel-5)>=0) ? (pixel-5) : 1;
-      const int tap2 = ((pixel-3)>=0) ? (pixel-3) : 1;
-      const int tap3 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap4 = pixel+1;
-      const int tap5 = ((pixel+3)<width) ? (pixel+3) : (width-1);
-      const int tap6 = ((pixel+5)<width) ? (pixel+5) : (width-1);
-      const int tap7 = ((pixel+7)<width) ? (pixel+7) : (width-1);
-      p[line][pixel] +=
-        (-8*p[line][tap0]+21*p[line][tap1]-46*p[line][tap2]+161*p[line][tap3]
-         +161*p[line][tap4]-46*p[line][tap5]+21*p[line][tap6]-8*p[line][tap7]+128)>>8;
+    // horizontal type 1
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-7)>=0) ? (pixel-7) : 1;
+        const int tap1 = ((pixel-5)>=0) ? (pixel-5) : 1;
+        const int tap2 = ((pixel-3)>=0) ? (pixel-3) : 1;
+        const int tap3 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap4 = pixel+1;
+        const int tap5 = ((pixel+3)<width) ? (pixel+3) : (width-1);
+        const int tap6 = ((pixel+5)<width) ? (pixel+5) : (width-1);
+        const int tap7 = ((pixel+7)<width) ? (pixel+7) : (width-1);
+        p[line][pixel] +=
+          (-8*p[line][tap0]+21*p[line][tap1]-46*p[line][tap2]+161*p[line][tap3]
+           +161*p[line][tap4]-46*p[line][tap5]+21*p[line][tap6]-8*p[line][tap7]+128)>>8;
+      }
     }
-  }
 
-  // horizontal type 4
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-6)>=0) ? (pixel-6) : 0;
-      const int tap1 = ((pixel-4)>=0) ? (pixel-4) : 0;
-      const int tap2 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap3 = pixel;
-      const int tap4 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap5 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      const int tap6 = ((pixel+6)<width) ? (pixel+6) : (width-2);
-      const int tap7 = ((pixel+8)<width) ? (pixel+8) : (width-2);
-      p[line][pixel+1] -=
-        (-2*p[line][tap0]+10*p[line][tap1]-25*p[line][tap2]+81*p[line][tap3]
-         +81*p[line][tap4]-25*p[line][tap5]+10*p[line][tap6]-2*p[line][tap7]+128)>>8;
+    // horizontal type 4
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-6)>=0) ? (pixel-6) : 0;
+        const int tap1 = ((pixel-4)>=0) ? (pixel-4) : 0;
+        const int tap2 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap3 = pixel;
+        const int tap4 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap5 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        const int tap6 = ((pixel+6)<width) ? (pixel+6) : (width-2);
+        const int tap7 = ((pixel+8)<width) ? (pixel+8) : (width-2);
+        p[line][pixel+1] -=
+          (-2*p[line][tap0]+10*p[line][tap1]-25*p[line][tap2]+81*p[line][tap3]
+           +81*p[line][tap4]-25*p[line][tap5]+10*p[line][tap6]-2*p[line][tap7]+128)>>8;
+      }
     }
   }
 
-  // vertical type 1
-  for (int line=0; line<height; line+=2) {    
-    const int tap0 = ((line-7)>=0) ? (line-7) : 1;
-    const int tap1 = ((line-5)>=0) ? (line-5) : 1;
-    const int tap2 = ((line-3)>=0) ? (line-3) : 1;
-    const int tap3 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap4 = line+1;
-    const int tap5 = ((line+3)<height) ? (line+3) : (height-1);
-    const int tap6 = ((line+5)<height) ? (line+5) : (height-1);
-    const int tap7 = ((line+7)<height) ? (line+7) : (height-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] +=
-        (-8*p[tap0][pixel]+21*p[tap1][pixel]-46*p[tap2][pixel]+161*p[tap3][pixel]
-         +161*p[tap4][pixel]-46*p[tap5][pixel]+21*p[tap6][pixel]-8*p[tap7][pixel]+128)>>8;
+  if (passes & VERTICAL) {
+    // vertical type 1
+    for (int line=0; line<height; line+=2) {    
+      const int tap0 = ((line-7)>=0) ? (line-7) : 1;
+      const int tap1 = ((line-5)>=0) ? (line-5) : 1;
+      const int tap2 = ((line-3)>=0) ? (line-3) : 1;
+      const int tap3 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap4 = line+1;
+      const int tap5 = ((line+3)<height) ? (line+3) : (height-1);
+      const int tap6 = ((line+5)<height) ? (line+5) : (height-1);
+      const int tap7 = ((line+7)<height) ? (line+7) : (height-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] +=
+          (-8*p[tap0][pixel]+21*p[tap1][pixel]-46*p[tap2][pixel]+161*p[tap3][pixel]
+           +161*p[tap4][pixel]-46*p[tap5][pixel]+21*p[tap6][pixel]-8*p[tap7][pixel]+128)>>8;
+      }
     }
-  }
 
-  // vertical type 4
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-6)>=0) ? (line-6) : 0;
-    const int tap1 = ((line-4)>=0) ? (line-4) : 0;
-    const int tap2 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap3 = line;
-    const int tap4 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap5 = ((line+4)<height) ? (line+4) : (height-2);
-    const int tap6 = ((line+6)<height) ? (line+6) : (height-2);
-    const int tap7 = ((line+8)<height) ? (line+8) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -=
-        (-2*p[tap0][pixel]+10*p[tap1][pixel]-25*p[tap2][pixel]+81*p[tap3][pixel]
-         +81*p[tap4][pixel]-25*p[tap5][pixel]+10*p[tap6][pixel]-2*p[tap7][pixel]+128)>>8;
+    // vertical type 4
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-6)>=0) ? (line-6) : 0;
+      const int tap1 = ((line-4)>=0) ? (line-4) : 0;
+      const int tap2 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap3 = line;
+      const int tap4 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap5 = ((line+4)<height) ? (line+4) : (height-2);
+      const int tap6 = ((line+6)<height) ? (line+6) : (height-2);
+      const int tap7 = ((line+8)<height) ? (line+8) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -=
+          (-2*p[tap0][pixel]+10*p[tap1][pixel]-25*p[tap2][pixel]+81*p[tap3][pixel]
+           +81*p[tap4][pixel]-25*p[tap5][pixel]+10*p[tap6][pixel]-2*p[tap7][pixel]+128)>>8;
+      }
     }
   }
-
 }
 
 
-void inverseWaveletLevelFidelity(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelFidelity(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical type 3
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-6)>=0) ? (line-6) : 0;
-    const int tap1 = ((line-4)>=0) ? (line-4) : 0;
-    const int tap2 = ((line-2)>=0) ? (line-2) : 0;
-    const int tap3 = line;
-    const int tap4 = ((line+2)<height) ? (line+2) : (height-2);
-    const int tap5 = ((line+4)<height) ? (line+4) : (height-2);
-    const int tap6 = ((line+6)<height) ? (line+6) : (height-2);
-    const int tap7 = ((line+8)<height) ? (line+8) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] +=
-        (-2*p[tap0][pixel]+10*p[tap1][pixel]-25*p[tap2][pixel]+81*p[tap3][pixel]
-         +81*p[tap4][pixel]-25*p[tap5][pixel]+10*p[tap6][pixel]-2*p[tap7][pixel]+128)>>8;
+  if (passes & VERTICAL) {
+    // vertical type 3
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-6)>=0) ? (line-6) : 0;
+      const int tap1 = ((line-4)>=0) ? (line-4) : 0;
+      const int tap2 = ((line-2)>=0) ? (line-2) : 0;
+      const int tap3 = line;
+      const int tap4 = ((line+2)<height) ? (line+2) : (height-2);
+      const int tap5 = ((line+4)<height) ? (line+4) : (height-2);
+      const int tap6 = ((line+6)<height) ? (line+6) : (height-2);
+      const int tap7 = ((line+8)<height) ? (line+8) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] +=
+          (-2*p[tap0][pixel]+10*p[tap1][pixel]-25*p[tap2][pixel]+81*p[tap3][pixel]
+           +81*p[tap4][pixel]-25*p[tap5][pixel]+10*p[tap6][pixel]-2*p[tap7][pixel]+128)>>8;
+      }
     }
-  }
 
-  // vertical type 2
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-7)>=0) ? (line-7) : 1;
-    const int tap1 = ((line-5)>=0) ? (line-5) : 1;
-    const int tap2 = ((line-3)>=0) ? (line-3) : 1;
-    const int tap3 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap4 = line+1;
-    const int tap5 = ((line+3)<height) ? (line+3) : (height-1);
-    const int tap6 = ((line+5)<height) ? (line+5) : (height-1);
-    const int tap7 = ((line+7)<height) ? (line+7) : (height-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -=
-        (-8*p[tap0][pixel]+21*p[tap1][pixel]-46*p[tap2][pixel]+161*p[tap3][pixel]
-         +161*p[tap4][pixel]-46*p[tap5][pixel]+21*p[tap6][pixel]-8*p[tap7][pixel]+128)>>8;
+    // vertical type 2
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-7)>=0) ? (line-7) : 1;
+      const int tap1 = ((line-5)>=0) ? (line-5) : 1;
+      const int tap2 = ((line-3)>=0) ? (line-3) : 1;
+      const int tap3 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap4 = line+1;
+      const int tap5 = ((line+3)<height) ? (line+3) : (height-1);
+      const int tap6 = ((line+5)<height) ? (line+5) : (height-1);
+      const int tap7 = ((line+7)<height) ? (line+7) : (height-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -=
+          (-8*p[tap0][pixel]+21*p[tap1][pixel]-46*p[tap2][pixel]+161*p[tap3][pixel]
+           +161*p[tap4][pixel]-46*p[tap5][pixel]+21*p[tap6][pixel]-8*p[tap7][pixel]+128)>>8;
+      }
     }
   }
 
-  // horizontal type 3
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-6)>=0) ? (pixel-6) : 0;
-      const int tap1 = ((pixel-4)>=0) ? (pixel-4) : 0;
-      const int tap2 = ((pixel-2)>=0) ? (pixel-2) : 0;
-      const int tap3 = pixel;
-      const int tap4 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      const int tap5 = ((pixel+4)<width) ? (pixel+4) : (width-2);
-      const int tap6 = ((pixel+6)<width) ? (pixel+6) : (width-2);
-      const int tap7 = ((pixel+8)<width) ? (pixel+8) : (width-2);
-      p[line][pixel+1] +=
-        (-2*p[line][tap0]+10*p[line][tap1]-25*p[line][tap2]+81*p[line][tap3]
-         +81*p[line][tap4]-25*p[line][tap5]+10*p[line][tap6]-2*p[line][tap7]+128)>>8;
+  if (passes & HORIZONTAL) {
+    // horizontal type 3
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-6)>=0) ? (pixel-6) : 0;
+        const int tap1 = ((pixel-4)>=0) ? (pixel-4) : 0;
+        const int tap2 = ((pixel-2)>=0) ? (pixel-2) : 0;
+        const int tap3 = pixel;
+        const int tap4 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        const int tap5 = ((pixel+4)<width) ? (pixel+4) : (width-2);
+        const int tap6 = ((pixel+6)<width) ? (pixel+6) : (width-2);
+        const int tap7 = ((pixel+8)<width) ? (pixel+8) : (width-2);
+        p[line][pixel+1] +=
+          (-2*p[line][tap0]+10*p[line][tap1]-25*p[line][tap2]+81*p[line][tap3]
+           +81*p[line][tap4]-25*p[line][tap5]+10*p[line][tap6]-2*p[line][tap7]+128)>>8;
 
+      }
     }
-  }
 
-  // horizontal type 2
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-7)>=0) ? (pixel-7) : 1;
-      const int tap1 = ((pixel-5)>=0) ? (pixel-5) : 1;
-      const int tap2 = ((pixel-3)>=0) ? (pixel-3) : 1;
-      const int tap3 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap4 = pixel+1;
-      const int tap5 = ((pixel+3)<width) ? (pixel+3) : (width-1);
-      const int tap6 = ((pixel+5)<width) ? (pixel+5) : (width-1);
-      const int tap7 = ((pixel+7)<width) ? (pixel+7) : (width-1);
-      p[line][pixel] -=
-        (-8*p[line][tap0]+21*p[line][tap1]-46*p[line][tap2]+161*p[line][tap3]
-         +161*p[line][tap4]-46*p[line][tap5]+21*p[line][tap6]-8*p[line][tap7]+128)>>8;
+    // horizontal type 2
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-7)>=0) ? (pixel-7) : 1;
+        const int tap1 = ((pixel-5)>=0) ? (pixel-5) : 1;
+        const int tap2 = ((pixel-3)>=0) ? (pixel-3) : 1;
+        const int tap3 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap4 = pixel+1;
+        const int tap5 = ((pixel+3)<width) ? (pixel+3) : (width-1);
+        const int tap6 = ((pixel+5)<width) ? (pixel+5) : (width-1);
+        const int tap7 = ((pixel+7)<width) ? (pixel+7) : (width-1);
+        p[line][pixel] -=
+          (-8*p[line][tap0]+21*p[line][tap1]-46*p[line][tap2]+161*p[line][tap3]
+           +161*p[line][tap4]-46*p[line][tap5]+21*p[line][tap6]-8*p[line][tap7]+128)>>8;
+      }
     }
-  }
 
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
 }
 
-void waveletLevelDaub97(View2D& p, unsigned int shift) {
+template <class View>
+void waveletLevelDaub97(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // Do shift to introduce accuracy bits
-  if (shift) {
-    for (int line=0; line<height; ++line) {
-      for (int pixel=0; pixel<width; ++pixel) {
-	    p[line][pixel] <<= shift;
+  if (passes & HORIZONTAL) {
+    // Do shift to introduce accuracy bits
+    if (shift) {
+      for (int line=0; line<height; ++line) {
+        for (int pixel=0; pixel<width; ++pixel) {
+          p[line][pixel] <<= shift;
+        }
       }
     }
-  }
 
-  // horizontal type 4
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] -= (6497*p[line][tap0]+6497*p[line][tap1]+2048)>>12;
+    // horizontal type 4
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] -= (6497*p[line][tap0]+6497*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 2
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap1 = pixel+1;
-      p[line][pixel] -= (217*p[line][tap0]+217*p[line][tap1]+2048)>>12;
+    // horizontal type 2
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap1 = pixel+1;
+        p[line][pixel] -= (217*p[line][tap0]+217*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 3
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] += (3616*p[line][tap0]+3616*p[line][tap1]+2048)>>12;
+    // horizontal type 3
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] += (3616*p[line][tap0]+3616*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 1
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap1 = pixel+1;
-      p[line][pixel] += (1817*p[line][tap0]+1817*p[line][tap1]+2048)>>12;
+    // horizontal type 1
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap1 = pixel+1;
+        p[line][pixel] += (1817*p[line][tap0]+1817*p[line][tap1]+2048)>>12;
+      }
     }
   }
 
-  // vertical type 4
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -= (6497*p[tap0][pixel]+6497*p[tap1][pixel]+2048)>>12;
+  if (passes & VERTICAL) {
+    // vertical type 4
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -= (6497*p[tap0][pixel]+6497*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 2
-  for (int line=0; line<height; line+=2) { 
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -= (217*p[tap0][pixel]+217*p[tap1][pixel]+2048)>>12;
+    // vertical type 2
+    for (int line=0; line<height; line+=2) { 
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -= (217*p[tap0][pixel]+217*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 3
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] += (3616*p[tap0][pixel]+3616*p[tap1][pixel]+2048)>>12;
+    // vertical type 3
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] += (3616*p[tap0][pixel]+3616*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 1
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] += (1817*p[tap0][pixel]+1817*p[tap1][pixel]+2048)>>12;
+    // vertical type 1
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] += (1817*p[tap0][pixel]+1817*p[tap1][pixel]+2048)>>12;
+      }
     }
   }
 }
 
 
-void inverseWaveletLevelDaub97(View2D& p, unsigned int shift) {
+template <class View>
+void inverseWaveletLevelDaub97(View& p, unsigned int shift, int passes) {
 
   const Index height = p.shape()[0];
   const Index width = p.shape()[1];
 
-  // vertical type 2
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] -= (1817*p[tap0][pixel]+1817*p[tap1][pixel]+2048)>>12;
+  if (passes & VERTICAL) {
+    // vertical type 2
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] -= (1817*p[tap0][pixel]+1817*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 4
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] -= (3616*p[tap0][pixel]+3616*p[tap1][pixel]+2048)>>12;
+    // vertical type 4
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] -= (3616*p[tap0][pixel]+3616*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 1
-  for (int line=0; line<height; line+=2) { 
-    const int tap0 = ((line-1)>=0) ? (line-1) : 1;
-    const int tap1 = line+1;
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line][pixel] += (217*p[tap0][pixel]+217*p[tap1][pixel]+2048)>>12;
+    // vertical type 1
+    for (int line=0; line<height; line+=2) { 
+      const int tap0 = ((line-1)>=0) ? (line-1) : 1;
+      const int tap1 = line+1;
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line][pixel] += (217*p[tap0][pixel]+217*p[tap1][pixel]+2048)>>12;
+      }
     }
-  }
 
-  // vertical type 3
-  for (int line=0; line<height; line+=2) {
-    const int tap0 = line;
-    const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
-    for (int pixel=0; pixel<width; ++pixel) {
-      p[line+1][pixel] += (6497*p[tap0][pixel]+6497*p[tap1][pixel]+2048)>>12;
+    // vertical type 3
+    for (int line=0; line<height; line+=2) {
+      const int tap0 = line;
+      const int tap1 = ((line+2)<height) ? (line+2) : (height-2);
+      for (int pixel=0; pixel<width; ++pixel) {
+        p[line+1][pixel] += (6497*p[tap0][pixel]+6497*p[tap1][pixel]+2048)>>12;
+      }
     }
   }
 
-  // horizontal type 2
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap1 = pixel+1;
-      p[line][pixel] -= (1817*p[line][tap0]+1817*p[line][tap1]+2048)>>12;
+  if (passes & HORIZONTAL) {
+    // horizontal type 2
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap1 = pixel+1;
+        p[line][pixel] -= (1817*p[line][tap0]+1817*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 4
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] -= (3616*p[line][tap0]+3616*p[line][tap1]+2048)>>12;
+    // horizontal type 4
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] -= (3616*p[line][tap0]+3616*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 1
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
-      const int tap1 = pixel+1;
-      p[line][pixel] += (217*p[line][tap0]+217*p[line][tap1]+2048)>>12;
+    // horizontal type 1
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = ((pixel-1)>=0) ? (pixel-1) : 1;
+        const int tap1 = pixel+1;
+        p[line][pixel] += (217*p[line][tap0]+217*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // horizontal type 3
-  for (int line=0; line<height; ++line) {
-    for (int pixel=0; pixel<width; pixel+=2) {
-      const int tap0 = pixel;
-      const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
-      p[line][pixel+1] += (6497*p[line][tap0]+6497*p[line][tap1]+2048)>>12;
+    // horizontal type 3
+    for (int line=0; line<height; ++line) {
+      for (int pixel=0; pixel<width; pixel+=2) {
+        const int tap0 = pixel;
+        const int tap1 = ((pixel+2)<width) ? (pixel+2) : (width-2);
+        p[line][pixel+1] += (6497*p[line][tap0]+6497*p[line][tap1]+2048)>>12;
+      }
     }
-  }
 
-  // Round & shift right "shift" bits (with rounding)
-  if (shift) {
-    View2D::element offset = utils::pow(2, shift-1);
-    for (int pixel=0; pixel<width; ++pixel) {
-      for (int line=0; line<height; ++line) {
-		    p[line][pixel] += offset;
-		    p[line][pixel] >>= shift;
+    // Round & shift right "shift" bits (with rounding)
+    if (shift) {
+      typename View::element offset = utils::pow(2, shift-1);
+      for (int pixel=0; pixel<width; ++pixel) {
+        for (int line=0; line<height; ++line) {
+          p[line][pixel] += offset;
+          p[line][pixel] >>= shift;
+        }
       }
     }
   }
@@ -1173,3 +1656,153 @@ const Picture inverseWaveletTransform(const Picture& transform,
   picture.c2(inverseWaveletTransform(transform.c2(), kernel, depth, chromaShape));
   return picture;
 }
+
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth, Picture& transform) {
+  waveletTransform(picture.y(), kernel, depth, transform.y());
+  waveletTransform(picture.c1(), kernel, depth, transform.c1());
+  waveletTransform(picture.c2(), kernel, depth, transform.c2());
+}
+
+void inverseWaveletTransform(Picture& transform, WaveletKernel kernel, int depth, Picture& picture) {
+  inverseWaveletTransform(transform.y(), kernel, depth, picture.y());
+  inverseWaveletTransform(transform.c1(), kernel, depth, picture.c1());
+  inverseWaveletTransform(transform.c2(), kernel, depth, picture.c2());
+}
+
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortPicture& transform) {
+  waveletTransform(picture.y(), kernel, depth, bitDepth, transform.y());
+  waveletTransform(picture.c1(), kernel, depth, bitDepth, transform.c1());
+  waveletTransform(picture.c2(), kernel, depth, bitDepth, transform.c2());
+}
+
+void inverseWaveletTransform(ShortPicture& transform, WaveletKernel kernel, int depth, Picture& picture) {
+  inverseWaveletTransform(transform.y(), kernel, depth, picture.y());
+  inverseWaveletTransform(transform.c1(), kernel, depth, picture.c1());
+  inverseWaveletTransform(transform.c2(), kernel, depth, picture.c2());
+}
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           Picture& transform) {
+  fieldWaveletTransform(frame.y(), field, kernel, depth, transform.y());
+  fieldWaveletTransform(frame.c1(), field, kernel, depth, transform.c1());
+  fieldWaveletTransform(frame.c2(), field, kernel, depth, transform.c2());
+}
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortPicture& transform) {
+  fieldWaveletTransform(frame.y(), field, kernel, depth, bitDepth, transform.y());
+  fieldWaveletTransform(frame.c1(), field, kernel, depth, bitDepth, transform.c1());
+  fieldWaveletTransform(frame.c2(), field, kernel, depth, bitDepth, transform.c2());
+}
+
+void paddedWaveletTransform(Picture& padded, WaveletKernel kernel, int depth) {
+  paddedWaveletTransform(padded.y(), kernel, depth);
+  paddedWaveletTransform(padded.c1(), kernel, depth);
+  paddedWaveletTransform(padded.c2(), kernel, depth);
+}
+
+void paddedWaveletTransform(ShortPicture& padded, WaveletKernel kernel, int depth, int bitDepth) {
+  paddedWaveletTransform(padded.y(), kernel, depth, bitDepth);
+  paddedWaveletTransform(padded.c1(), kernel, depth, bitDepth);
+  paddedWaveletTransform(padded.c2(), kernel, depth, bitDepth);
+}
+
+namespace {
+
+  // Transform the components of a picture, or field, concurrently
+  void transformPicture(const Picture& picture, int firstLine, int lineStep,
+                        WaveletKernel kernel, int depth,
+                        Picture& transform, TaskScheduler& scheduler) {
+    TaskGroup components(scheduler);
+    components.run(boost::bind(&transformComponent, &picture.y(), firstLine, lineStep,
+                               kernel, depth, &transform.y(), &scheduler));
+    components.run(boost::bind(&transformComponent, &picture.c1(), firstLine, lineStep,
+                               kernel, depth, &transform.c1(), &scheduler));
+    components.run(boost::bind(&transformComponent, &picture.c2(), firstLine, lineStep,
+                               kernel, depth, &transform.c2(), &scheduler));
+    components.wait();
+  }
+
+  void transformPicture(const Picture& picture, int firstLine, int lineStep,
+                        WaveletKernel kernel, int depth, int bitDepth,
+                        ShortPicture& transform, TaskScheduler& scheduler) {
+    if (!shortCoefficients(kernel, depth, bitDepth)) {
+      throw std::overflow_error("wavelet coefficients might not fit in 16 bits");
+    }
+    TaskGroup components(scheduler);
+    components.run(boost::bind(&transformShortComponent, &picture.y(), firstLine, lineStep,
+                               kernel, depth, bitDepth, &transform.y(), &scheduler));
+    components.run(boost::bind(&transformShortComponent, &picture.c1(), firstLine, lineStep,
+                               kernel, depth, bitDepth, &transform.c1(), &scheduler));
+    components.run(boost::bind(&transformShortComponent, &picture.c2(), firstLine, lineStep,
+                               kernel, depth, bitDepth, &transform.c2(), &scheduler));
+    components.wait();
+  }
+
+  // Transform the components (y, c1 and c2) of a padded picture, in place, concurrently
+  template <class Array>
+  void paddedPicture(Array* y, Array* c1, Array* c2, WaveletKernel kernel, int depth,
+                     TaskScheduler& scheduler) {
+    TaskGroup components(scheduler);
+    components.run(boost::bind(&stripedTransform<Array>, boost::ref(*y), kernel, depth, false, boost::ref(scheduler)));
+    components.run(boost::bind(&stripedTransform<Array>, boost::ref(*c1), kernel, depth, false, boost::ref(scheduler)));
+    components.run(boost::bind(&stripedTransform<Array>, boost::ref(*c2), kernel, depth, false, boost::ref(scheduler)));
+    components.wait();
+  }
+
+  // Inverse transform the components (y, c1 and c2) of a picture concurrently
+  template <class Array>
+  void inversePicture(Array* y, Array* c1, Array* c2, WaveletKernel kernel, int depth,
+                      Picture& picture, TaskScheduler& scheduler) {
+    TaskGroup components(scheduler);
+    components.run(boost::bind(&inverseComponent<Array>, y, kernel, depth, &picture.y(), &scheduler));
+    components.run(boost::bind(&inverseComponent<Array>, c1, kernel, depth, &picture.c1(), &scheduler));
+    components.run(boost::bind(&inverseComponent<Array>, c2, kernel, depth, &picture.c2(), &scheduler));
+    components.wait();
+  }
+
+} // end unnamed namespace
+
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      Picture& transform, TaskScheduler& scheduler) {
+  transformPicture(picture, 0, 1, kernel, depth, transform, scheduler);
+}
+
+void waveletTransform(const Picture& picture, WaveletKernel kernel, int depth,
+                      int bitDepth, ShortPicture& transform, TaskScheduler& scheduler) {
+  transformPicture(picture, 0, 1, kernel, depth, bitDepth, transform, scheduler);
+}
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           Picture& transform, TaskScheduler& scheduler) {
+  transformPicture(frame, field, 2, kernel, depth, transform, scheduler);
+}
+
+void fieldWaveletTransform(const Picture& frame, int field, WaveletKernel kernel, int depth,
+                           int bitDepth, ShortPicture& transform, TaskScheduler& scheduler) {
+  transformPicture(frame, field, 2, kernel, depth, bitDepth, transform, scheduler);
+}
+
+void paddedWaveletTransform(Picture& padded, WaveletKernel kernel, int depth,
+                            TaskScheduler& scheduler) {
+  paddedPicture(&padded.y(), &padded.c1(), &padded.c2(), kernel, depth, scheduler);
+}
+
+void paddedWaveletTransform(ShortPicture& padded, WaveletKernel kernel, int depth,
+                            int bitDepth, TaskScheduler& scheduler) {
+  if (!shortCoefficients(kernel, depth, bitDepth)) {
+    throw std::overflow_error("wavelet coefficients might not fit in 16 bits");
+  }
+  paddedPicture(&padded.y(), &padded.c1(), &padded.c2(), kernel, depth, scheduler);
+}
+
+void inverseWaveletTransform(Picture& transform, WaveletKernel kernel, int depth,
+                             Picture& picture, TaskScheduler& scheduler) {
+  inversePicture(&transform.y(), &transform.c1(), &transform.c2(), kernel, depth, picture, scheduler);
+}
+
+void inverseWaveletTransform(ShortPicture& transform, WaveletKernel kernel, int depth,
+                             Picture& picture, TaskScheduler& scheduler) {
+  inversePicture(&transform.y(), &transform.c1(), &transform.c2(), kernel, depth, picture, scheduler);
+}
@@ -0,0 +1,235 @@
+/*********************************************************************/
+/* Y4MIO.cpp                                                         */
+/* Author: BBC R&D                                                   */
+/* This version 18th October 2026                                    */
+/*                                                                   */
+/* Defines reading and writing of YUV4MPEG2 ("Y4M") streams, a       */
+/* frame at a time, so that video may be piped through the codec.    */
+/* Copyright (c) BBC 2011-2015 -- For license see the LICENSE file   */
+/*********************************************************************/
+
+#include "Y4MIO.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib> // For strtol
+#include <stdexcept> // For invalid_argument
+
+Y4MFormat::Y4MFormat():
+  picFormat(), depth(0),
+  isInterlaced(false), isTopFieldFirst(true),
+  rateNumerator(0), rateDenominator(0) {
+}
+
+Y4MFormat::Y4MFormat(const PictureFormat& format, int bitDepth,
+                     bool interlaced, bool topFieldFirst,
+                     int frameRateNumerator, int frameRateDenominator):
+  picFormat(format), depth(bitDepth),
+  isInterlaced(interlaced), isTopFieldFirst(topFieldFirst),
+  rateNumerator(frameRateNumerator), rateDenominator(frameRateDenominator) {
+  switch (format.chromaFormat()) {
+    case CF444:
+    case CF422:
+    case CF420:
+      break;
+    default:
+      throw std::invalid_argument("Y4M chroma format must be 4:4:4, 4:2:2 or 4:2:0");
+  }
+  if ((bitDepth<8) || (bitDepth>16)) {
+    throw std::invalid_argument("Y4M bit depth must be in the range 8 to 16");
+  }
+  if ((frameRateNumerator<1) || (frameRateDenominator<1)) {
+    throw std::invalid_argument("Y4M frame rate must be > 0");
+  }
+}
+
+Y4MFormat::operator const bool() const {
+  return (depth!=0) && picFormat;
+}
+
+namespace {
+
+  const char streamTag[] = "YUV4MPEG2";
+  const char frameTag[] = "FRAME";
+
+  // Parse a whole, positive, decimal number. Returns 0 if invalid.
+  const int number(const std::string& text) {
+    if (text.empty()) return 0;
+    char* end;
+    const long value = std::strtol(text.c_str(), &end, 10);
+    return ((*end=='\0') && (value>0)) ? static_cast<int>(value) : 0;
+  }
+
+  // Parse a Y4M colour space, e.g. "420jpeg", "422p10"
+  void colourSpace(const std::string& text, ColourFormat& format, int& bitDepth) {
+    const std::string subsampling = text.substr(0, 3);
+    if (subsampling=="444") format = CF444;
+    else if (subsampling=="422") format = CF422;
+    else if (subsampling=="420") format = CF420;
+    else throw std::invalid_argument("unsupported Y4M colour space \"" + text + "\"");
+    const std::string suffix = text.substr(3);
+    if ((suffix.size()>1) && (suffix[0]=='p')) {
+      bitDepth = number(suffix.substr(1));
+      if ((bitDepth<8) || (bitDepth>16)) {
+        throw std::invalid_argument("unsupported Y4M bit depth \"" + text + "\"");
+      }
+    }
+    else if ((suffix.empty()) || (format==CF420 &&
+             ((suffix=="jpeg") || (suffix=="mpeg2") || (suffix=="paldv")))) {
+      bitDepth = 8;
+    }
+    else throw std::invalid_argument("unsupported Y4M colour space \"" + text + "\"");
+  }
+
+  // Check that a picture has the shape given by a Y4M format
+  void checkFormat(const Y4MFormat& format, const Picture& picture) {
+    const PictureFormat& required = format.pictureFormat();
+    const PictureFormat actual = picture.format();
+    if ((actual.lumaHeight()!=required.lumaHeight()) ||
+        (actual.lumaWidth()!=required.lumaWidth()) ||
+        (actual.chromaHeight()!=required.chromaHeight()) ||
+        (actual.chromaWidth()!=required.chromaWidth())) {
+      throw std::invalid_argument("picture does not match the Y4M picture format");
+    }
+  }
+
+} // end unnamed namespace
+
+std::istream& operator>>(std::istream& stream, Y4MFormat& format) {
+  std::string header;
+  if (!std::getline(stream, header)) return stream;
+  std::istringstream parameters(header);
+  std::string parameter;
+  parameters >> parameter;
+  if (parameter!=streamTag) {
+    stream.setstate(std::ios_base::failbit);
+    return stream;
+  }
+  // Y4M defaults
+  int height = 0;
+  int width = 0;
+  ColourFormat chroma = CF420;
+  int bitDepth = 8;
+  bool interlaced = false;
+  bool topFieldFirst = true;
+  int rateNumerator = 25;
+  int rateDenominator = 1;
+  while (parameters >> parameter) {
+    const std::string value = parameter.substr(1);
+    switch (parameter[0]) {
+      case 'W':
+        width = number(value);
+        break;
+      case 'H':
+        height = number(value);
+        break;
+      case 'C':
+        colourSpace(value, chroma, bitDepth);
+        break;
+      case 'I':
+        if (value=="t") {
+          interlaced = true;
+          topFieldFirst = true;
+        }
+        else if (value=="b") {
+          interlaced = true;
+          topFieldFirst = false;
+        }
+        else if (value=="m") {
+          throw std::invalid_argument("mixed interlacing Y4M streams are not supported");
+        }
+        else interlaced = false; // "p" or "?"
+        break;
+      case 'F': {
+        const std::string::size_type colon = value.find(':');
+        if (colon!=std::string::npos) {
+          const int numerator = number(value.substr(0, colon));
+          const int denominator = number(value.substr(colon+1));
+          // Ignore unknown ("F0:0") or invalid frame rates
+          if (numerator && denominator) {
+            rateNumerator = numerator;
+            rateDenominator = denominator;
+          }
+        }
+        break;
+      }
+      default:
+        // Ignore pixel aspect ratio ("A"), extensions ("X") etc.
+        break;
+    }
+  }
+  if ((height==0) || (width==0)) {
+    stream.setstate(std::ios_base::failbit);
+    return stream;
+  }
+  format = Y4MFormat(PictureFormat(height, width, chroma), bitDepth,
+                     interlaced, topFieldFirst, rateNumerator, rateDenominator);
+  return stream;
+}
+
+std::ostream& operator<<(std::ostream& stream, const Y4MFormat& format) {
+  if (!format) throw std::invalid_argument("invalid Y4M format");
+  const PictureFormat& picFormat = format.pictureFormat();
+  const char* subsampling;
+  switch (picFormat.chromaFormat()) {
+    case CF444:
+      subsampling = "444";
+      break;
+    case CF422:
+      subsampling = "422";
+      break;
+    default:
+      subsampling = "420";
+      break;
+  }
+  stream << streamTag
+         << " W" << picFormat.lumaWidth()
+         << " H" << picFormat.lumaHeight()
+         << " F" << format.frameRateNumerator() << ':' << format.frameRateDenominator()
+         << " I" << (format.interlaced() ? (format.topFieldFirst() ? 't' : 'b') : 'p')
+         << " C" << subsampling;
+  if (format.bitDepth()>8) stream << 'p' << format.bitDepth();
+  stream << '\n';
+  return stream;
+}
+
+std::istream& readY4MFrame(std::istream& stream, const Y4MFormat& format, Picture& picture) {
+  checkFormat(format, picture);
+  // Frame header is "FRAME", optionally followed by (ignored) parameters
+  for (const char* tag=frameTag; *tag; ++tag) {
+    if (stream.get()!=*tag) {
+      stream.setstate(std::ios_base::failbit);
+      return stream;
+    }
+  }
+  int c;
+  while (((c = stream.get())!='\n') && (c!=std::char_traits<char>::eof())) {}
+  if (!stream) return stream;
+  stream >> pictureio::wordWidth(format.bytesPerSample())
+         >> pictureio::little_endian
+         >> pictureio::right_justified
+         >> pictureio::format(arrayio::UNSIGNED)
+         >> pictureio::bitDepth(format.bitDepth());
+  stream >> picture;
+  return stream;
+}
+
+std::ostream& writeY4MFrame(std::ostream& stream, const Y4MFormat& format, const Picture& picture) {
+  checkFormat(format, picture);
+  stream << frameTag << '\n';
+  stream << pictureio::wordWidth(format.bytesPerSample())
+         << pictureio::little_endian
+         << pictureio::right_justified
+         << pictureio::format(arrayio::UNSIGNED)
+         << pictureio::bitDepth(format.bitDepth());
+  stream << picture;
+  return stream;
+}
+
+const bool isY4MFileName(const std::string& fileName) {
+  const std::string extension = ".y4m";
+  if (fileName=="-") return true;
+  return (fileName.size()>extension.size()) &&
+         (fileName.compare(fileName.size()-extension.size(), extension.size(), extension)==0);
+}